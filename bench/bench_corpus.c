@@ -0,0 +1,345 @@
+#include "bench_corpus.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void buf_reserve(BenchBuf *b, size_t extra) {
+    size_t need = b->len + extra;
+    uint8_t *grown;
+
+    if (need <= b->cap) {
+        return;
+    }
+    if (b->cap == 0) {
+        b->cap = 64 * 1024;
+    }
+    while (b->cap < need) {
+        b->cap *= 2;
+    }
+    grown = realloc(b->data, b->cap);
+    if (!grown) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    b->data = grown;
+}
+
+static void put_bytes(BenchBuf *b, const void *p, size_t n) {
+    buf_reserve(b, n);
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+static void put_str(BenchBuf *b, const char *s) {
+    put_bytes(b, s, strlen(s));
+}
+
+static void put_fmt(BenchBuf *b, const char *fmt, ...) {
+    char tmp[256];
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        put_bytes(b, tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+    }
+}
+
+static void put_utf8(BenchBuf *b, uint32_t cp) {
+    uint8_t u[4];
+    size_t n;
+
+    if (cp < 0x80) {
+        u[0] = (uint8_t)cp; n = 1;
+    } else if (cp < 0x800) {
+        u[0] = (uint8_t)(0xC0 | (cp >> 6));
+        u[1] = (uint8_t)(0x80 | (cp & 0x3F)); n = 2;
+    } else if (cp < 0x10000) {
+        u[0] = (uint8_t)(0xE0 | (cp >> 12));
+        u[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        u[2] = (uint8_t)(0x80 | (cp & 0x3F)); n = 3;
+    } else {
+        u[0] = (uint8_t)(0xF0 | (cp >> 18));
+        u[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+        u[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        u[3] = (uint8_t)(0x80 | (cp & 0x3F)); n = 4;
+    }
+    put_bytes(b, u, n);
+}
+
+/* xorshift32: small, deterministic, identical on every platform */
+static uint32_t rnd(uint32_t *s) {
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *s = x;
+    return x;
+}
+
+static int rnd_range(uint32_t *s, int lo, int hi) {
+    return lo + (int)(rnd(s) % (uint32_t)(hi - lo + 1));
+}
+
+static const char *const words[] = {
+    "static", "int", "return", "const", "char", "void", "struct", "buffer",
+    "terminal", "render", "glyph", "cursor", "scroll", "region", "if", "else",
+    "for", "while", "size_t", "uint32_t", "NULL", "state", "row", "col",
+};
+#define NWORDS (sizeof(words) / sizeof(words[0]))
+
+static void gen_ascii(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    (void)rows;
+    while (out->len < BENCH_CORPUS_BYTES) {
+        int width = rnd_range(&seed, cols / 4, cols);
+        int used = 0;
+        while (used < width) {
+            const char *w = words[rnd(&seed) % NWORDS];
+            int n = (int)strlen(w);
+            if (used + n + 1 > cols) break;
+            put_str(out, w);
+            put_str(out, " ");
+            used += n + 1;
+        }
+        put_str(out, "\r\n");
+    }
+}
+
+static void gen_sgr_truecolor(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    (void)rows;
+    while (out->len < BENCH_CORPUS_BYTES) {
+        for (int c = 0; c < cols; c++) {
+            uint32_t fg = rnd(&seed), bg = rnd(&seed);
+            put_fmt(out, "\033[38;2;%u;%u;%u;48;2;%u;%u;%um%c",
+                    fg & 0xFF, (fg >> 8) & 0xFF, (fg >> 16) & 0xFF,
+                    bg & 0xFF, (bg >> 8) & 0xFF, (bg >> 16) & 0xFF,
+                    'a' + (int)(fg % 26));
+        }
+        put_str(out, "\033[0m\r\n");
+    }
+}
+
+/* Full-screen editor redraws: line numbers, syntax colours, status line,
+ * then a burst of single-character insert-mode edits. */
+static void gen_vim(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    int top = 1;
+
+    while (out->len < BENCH_CORPUS_BYTES) {
+        put_str(out, "\033[?25l\033[H");
+        for (int r = 1; r < rows - 1; r++) {
+            int used = 5;
+            put_fmt(out, "\033[%d;1H\033[33m%4d \033[0m", r, top + r);
+            while (used < cols - 10) {
+                const char *w = words[rnd(&seed) % NWORDS];
+                int kind = rnd_range(&seed, 0, 5);
+                if (kind == 0) put_str(out, "\033[1;34m");
+                else if (kind == 1) put_str(out, "\033[32m\"");
+                put_str(out, w);
+                if (kind == 1) put_str(out, "\"");
+                if (kind <= 1) put_str(out, "\033[0m");
+                put_str(out, " ");
+                used += (int)strlen(w) + 3;
+            }
+            put_str(out, "\033[K");
+        }
+        put_fmt(out, "\033[%d;1H\033[7m src/terminal_state.c [+]%*s%d,%d \033[0m",
+                rows - 1, cols > 40 ? cols - 40 : 1, "", top, 1);
+        put_fmt(out, "\033[%d;1H-- INSERT --\033[K", rows);
+        for (int i = 0; i < 200; i++) {
+            int r = rnd_range(&seed, 1, rows - 2);
+            int c = rnd_range(&seed, 6, cols - 1);
+            put_fmt(out, "\033[%d;%dH%c\033[%d;%dH", r, c, 'a' + i % 26, r, c + 1);
+        }
+        put_str(out, "\033[?25h");
+        top += rows / 2;
+    }
+}
+
+/* Process monitor: coloured meters, reverse-video header, table rows
+ * rewritten in place every refresh. */
+static void gen_htop(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    int bar = cols / 2 - 10;
+
+    if (bar < 4) bar = 4;
+    while (out->len < BENCH_CORPUS_BYTES) {
+        put_str(out, "\033[H");
+        for (int cpu = 0; cpu < 4 && cpu < rows - 4; cpu++) {
+            int fill = rnd_range(&seed, 0, bar);
+            put_fmt(out, "\033[%d;1H\033[36m%3d\033[0m\033[1m[\033[0m", cpu + 1, cpu);
+            put_str(out, "\033[32m");
+            for (int i = 0; i < fill; i++) put_str(out, "|");
+            put_str(out, "\033[31m");
+            for (int i = fill; i < bar; i++) put_str(out, " ");
+            put_fmt(out, "\033[0m%5.1f%%\033[1m]\033[0m", fill * 100.0 / bar);
+        }
+        put_fmt(out, "\033[6;1H\033[30;46m%-*s\033[0m", cols, "    PID USER      PRI  NI  VIRT   RES S CPU% MEM%   TIME+  Command");
+        for (int r = 7; r <= rows - 1; r++) {
+            put_fmt(out, "\033[%d;1H%7d \033[1mroot\033[0m      20   0 %5dM %5dM \033[32mS\033[0m %4.1f %4.1f  0:%02d.%02d %s\033[K",
+                    r, rnd_range(&seed, 1, 99999), rnd_range(&seed, 1, 9999), rnd_range(&seed, 1, 999),
+                    rnd_range(&seed, 0, 999) / 10.0, rnd_range(&seed, 0, 999) / 10.0,
+                    rnd_range(&seed, 0, 59), rnd_range(&seed, 0, 99), words[rnd(&seed) % NWORDS]);
+        }
+        put_fmt(out, "\033[%d;1H\033[30;46mF1\033[0mHelp  \033[30;46mF10\033[0mQuit\033[K", rows);
+    }
+}
+
+/* Resource monitor: rounded boxes, truecolor gradients and Braille graphs. */
+static void gen_btop(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    while (out->len < BENCH_CORPUS_BYTES) {
+        put_str(out, "\033[?2026h\033[H\033[38;2;90;90;120m");
+        put_utf8(out, 0x256D);
+        for (int c = 1; c < cols - 1; c++) put_utf8(out, 0x2500);
+        put_utf8(out, 0x256E);
+        for (int r = 2; r < rows; r++) {
+            put_fmt(out, "\033[%d;1H\033[38;2;90;90;120m", r);
+            put_utf8(out, 0x2502);
+            for (int c = 1; c < cols - 1; c++) {
+                int level = rnd_range(&seed, 0, 255);
+                put_fmt(out, "\033[38;2;%d;%d;%dm", level, 255 - level, 128);
+                put_utf8(out, 0x2800 + (rnd(&seed) & 0xFF));
+            }
+            put_str(out, "\033[38;2;90;90;120m");
+            put_utf8(out, 0x2502);
+        }
+        put_fmt(out, "\033[%d;1H", rows);
+        put_utf8(out, 0x2570);
+        for (int c = 1; c < cols - 1; c++) put_utf8(out, 0x2500);
+        put_utf8(out, 0x256F);
+        put_str(out, "\033[0m\033[?2026l");
+    }
+}
+
+static void gen_cjk_emoji(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    (void)rows;
+    while (out->len < BENCH_CORPUS_BYTES) {
+        int used = 0;
+        while (used < cols - 2) {
+            int kind = rnd_range(&seed, 0, 9);
+            if (kind < 5) {
+                put_utf8(out, 0x4E00 + rnd(&seed) % 0x5000);   /* CJK ideograph */
+                used += 2;
+            } else if (kind < 7) {
+                put_utf8(out, 0xAC00 + rnd(&seed) % 0x2B00);   /* Hangul */
+                used += 2;
+            } else if (kind < 9) {
+                put_utf8(out, 0x1F600 + rnd(&seed) % 0x50);    /* emoji */
+                used += 2;
+            } else {
+                put_str(out, "e");
+                put_utf8(out, 0x0301);                         /* combining acute */
+                used += 1;
+            }
+        }
+        put_str(out, "\r\n");
+    }
+}
+
+/* Pager/log-follow style scrolling inside a margin, with reverse index and
+ * line insert/delete. */
+static void gen_scroll_region(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    int top = rows > 6 ? 3 : 1;
+    int bottom = rows > 6 ? rows - 2 : rows;
+
+    while (out->len < BENCH_CORPUS_BYTES) {
+        put_fmt(out, "\033[%d;%dr\033[%d;1H", top, bottom, bottom);
+        for (int i = 0; i < rows * 4; i++) {
+            int n = rnd_range(&seed, 1, cols - 1);
+            for (int c = 0; c < n; c++) put_bytes(out, "abcdefghijklmnopqrstuvwxyz" + (c % 26), 1);
+            put_str(out, "\r\n");
+        }
+        put_fmt(out, "\033[%d;1H", top);
+        for (int i = 0; i < rows; i++) put_str(out, "\033Mreverse index line\r");
+        put_fmt(out, "\033[%d;1H\033[3L\033[2M\033[5S\033[4T", top + 1);
+        put_str(out, "\033[r");
+    }
+}
+
+/*
+ * Hostile streams: cheap to send, expensive if a handler's cost follows its
+ * parameters instead of its bytes.
+ */
+static void gen_hostile_rep(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    (void)rows;
+    (void)cols;
+    while (out->len < BENCH_CORPUS_BYTES) {
+        int n = rnd_range(&seed, 30000, 65535);
+        put_fmt(out, "x\033[%db\xe4\xb8\x80\033[%db\033[?7l\033[%db\033[?7h", n, n, n);
+        put_fmt(out, "\033[%dS\033[%dT\033[%dL\033[%dM\033[%d@\033[%dP\033[%dX", n, n, n, n, n, n, n);
+    }
+}
+
+static void gen_hostile_params(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    (void)rows;
+    (void)cols;
+    while (out->len < BENCH_CORPUS_BYTES) {
+        static const char finals[] = "mHJKrSTLM@Pbh";
+        char final = finals[rnd(&seed) % (sizeof(finals) - 1)];
+
+        put_str(out, final == 'h' ? "\033[?" : "\033[");
+        for (int i = 0; i < 1000; i++) put_fmt(out, "%d;", rnd_range(&seed, 0, 99999));
+        put_bytes(out, &final, 1);
+        put_str(out, "text");
+    }
+}
+
+static void gen_hostile_osc(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    (void)rows;
+    (void)cols;
+    (void)seed;
+    /* One title that never ends, then an unterminated DCS. */
+    put_str(out, "\033]2;");
+    while (out->len < BENCH_CORPUS_BYTES / 2) put_str(out, "title title title ");
+    put_str(out, "\033P1;1|");
+    while (out->len < BENCH_CORPUS_BYTES) put_str(out, "deadbeef");
+}
+
+static void gen_hostile_combining(BenchBuf *out, int rows, int cols, uint32_t seed) {
+    (void)rows;
+    (void)cols;
+    while (out->len < BENCH_CORPUS_BYTES) {
+        put_str(out, "e");
+        for (int i = 0; i < 4000; i++) put_utf8(out, 0x0300 + (uint32_t)rnd_range(&seed, 0, 0x6f));
+        put_str(out, "\r\n");
+    }
+}
+
+const BenchCorpus bench_corpora[] = {
+    { "ascii",         gen_ascii },
+    { "sgr_truecolor", gen_sgr_truecolor },
+    { "vim",           gen_vim },
+    { "htop",          gen_htop },
+    { "btop",          gen_btop },
+    { "cjk_emoji",     gen_cjk_emoji },
+    { "scroll_region", gen_scroll_region },
+    { "hostile_rep",   gen_hostile_rep },
+    { "hostile_params", gen_hostile_params },
+    { "hostile_osc",   gen_hostile_osc },
+    { "hostile_combining", gen_hostile_combining },
+};
+const size_t bench_corpora_count = sizeof(bench_corpora) / sizeof(bench_corpora[0]);
+
+void bench_buf_free(BenchBuf *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+int bench_buf_load_file(BenchBuf *b, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    uint8_t chunk[65536];
+    size_t n;
+
+    if (!fp) {
+        return -1;
+    }
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        put_bytes(b, chunk, n);
+    }
+    fclose(fp);
+    return 0;
+}
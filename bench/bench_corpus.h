@@ -0,0 +1,33 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Growable byte buffer holding one corpus stream. */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} BenchBuf;
+
+typedef void (*bench_gen_fn)(BenchBuf *out, int rows, int cols, uint32_t seed);
+
+typedef struct {
+    const char *name;
+    bench_gen_fn generate;
+} BenchCorpus;
+
+/* Synthetic corpora, deterministic for a given (rows, cols, seed).  Each
+ * generator emits roughly BENCH_CORPUS_BYTES of output shaped like the
+ * application it is named after. */
+#define BENCH_CORPUS_BYTES (2u * 1024u * 1024u)
+
+extern const BenchCorpus bench_corpora[];
+extern const size_t bench_corpora_count;
+
+void bench_buf_free(BenchBuf *b);
+/* Read a recorded byte stream (e.g. from `script` or `cupidterminal -o`). */
+int bench_buf_load_file(BenchBuf *b, const char *path);
+
+#endif /* BENCH_CORPUS_H */
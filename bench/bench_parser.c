@@ -0,0 +1,168 @@
+/* Headless parser throughput benchmark.
+ *
+ * Feeds synthetic corpora (and any recorded streams given on the command
+ * line) through terminal_feed() at several window sizes and reports
+ * MB/s, ns/byte, allocation count and peak RSS.  Nothing touches X11.
+ *
+ * Usage: bench_parser [--label NAME] [-t SECONDS] [recorded.raw ...]
+ * TSV goes to stdout (one row per corpus and size), a table to stderr.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "../src/seqprof.h"
+#include "../src/terminal_state.h"
+#include "bench_corpus.h"
+
+/* Config symbols terminal_state.o expects from main.c */
+unsigned int tabspaces = 8;
+char *vtiden = "\033[?6c";
+int allowwindowops = 1;
+
+#define BENCH_CHUNK 65536
+
+/* Allocation accounting via -Wl,--wrap=malloc,... (see Makefile). */
+static unsigned long alloc_count;
+static unsigned long long alloc_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    alloc_count++;
+    alloc_bytes += (unsigned long long)nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+static const struct { int rows, cols; } sizes[] = {
+    { 24, 80 }, { 43, 132 }, { 67, 240 },
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0;
+    }
+    return ru.ru_maxrss;
+}
+
+static void feed(Terminal *t, const BenchBuf *buf) {
+    for (size_t off = 0; off < buf->len; off += BENCH_CHUNK) {
+        size_t n = buf->len - off < BENCH_CHUNK ? buf->len - off : BENCH_CHUNK;
+        terminal_feed(t, buf->data + off, n, NULL, NULL);
+    }
+}
+
+static void run_one(const char *label, const char *name, const BenchBuf *buf,
+                    int rows, int cols, double min_seconds) {
+    unsigned long long total = 0;
+    unsigned long allocs;
+    unsigned long long abytes;
+    double start, elapsed, mb_s, ns_byte;
+    Terminal *t = terminal_create(rows, cols);
+
+    if (!t) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    feed(t, buf); /* warm-up: first-touch of buffers, history growth */
+
+    alloc_count = 0;
+    alloc_bytes = 0;
+    start = now_sec();
+    do {
+        feed(t, buf);
+        total += buf->len;
+        elapsed = now_sec() - start;
+    } while (elapsed < min_seconds);
+    allocs = alloc_count;
+    abytes = alloc_bytes;
+    terminal_destroy(t);
+
+    mb_s = (double)total / elapsed / 1e6;
+    ns_byte = elapsed * 1e9 / (double)total;
+    printf("%s\t%s\t%d\t%d\t%llu\t%.4f\t%.2f\t%.3f\t%lu\t%llu\t%ld\n",
+           label, name, rows, cols, total, elapsed, mb_s, ns_byte,
+           allocs, abytes, peak_rss_kb());
+    fprintf(stderr, "%-16s %4dx%-4d %9.2f MB/s %8.3f ns/B %9lu allocs\n",
+            name, cols, rows, mb_s, ns_byte, allocs);
+    fflush(stdout);
+#ifdef CUPID_SEQPROF
+    /* make SEQPROF=1 bench: which handlers this corpus spends its time in */
+    seqprof_report(stderr);
+    seqprof_reset();
+#endif
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+int main(int argc, char **argv) {
+    const char *label = "current";
+    double min_seconds = 0.5;
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            min_seconds = atof(argv[++i]);
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+    if (!setlocale(LC_CTYPE, "C.UTF-8")) {
+        setlocale(LC_CTYPE, "");
+    }
+
+    printf("# label\tcorpus\trows\tcols\tbytes\tseconds\tmb_s\tns_byte\tallocs\talloc_bytes\tpeak_rss_kb\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int rows = sizes[s].rows, cols = sizes[s].cols;
+
+        for (size_t c = 0; c < bench_corpora_count; c++) {
+            BenchBuf buf = { 0 };
+            bench_corpora[c].generate(&buf, rows, cols, 0x9E3779B9u);
+            run_one(label, bench_corpora[c].name, &buf, rows, cols, min_seconds);
+            bench_buf_free(&buf);
+        }
+        for (int i = first_file; i < argc; i++) {
+            BenchBuf buf = { 0 };
+            if (bench_buf_load_file(&buf, argv[i]) != 0 || buf.len == 0) {
+                fprintf(stderr, "bench: cannot read %s\n", argv[i]);
+                bench_buf_free(&buf);
+                continue;
+            }
+            run_one(label, base_name(argv[i]), &buf, rows, cols, min_seconds);
+            bench_buf_free(&buf);
+        }
+    }
+    return EXIT_SUCCESS;
+}
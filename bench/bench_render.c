@@ -0,0 +1,103 @@
+/* Headless renderer-frontend benchmark.
+ *
+ * Plays each synthetic corpus through the parser in PTY-read-sized chunks
+ * and renders a frame after every chunk with the recording backend, so the
+ * cost of render_frame() (cell walk, colour resolution, run batching,
+ * damage) is measured without an X server, along with the number of
+ * primitives a real backend would have to issue per frame.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/render.h"
+#include "../src/terminal_state.h"
+#include "bench_corpus.h"
+
+/* Config symbols terminal_state.o expects from main.c */
+unsigned int tabspaces = 8;
+char *vtiden = "\033[?6c";
+int allowwindowops = 1;
+
+#define BENCH_READ 4095
+
+static const struct { int rows, cols; } sizes[] = {
+    { 24, 80 }, { 67, 240 },
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+    RenderBackend be;
+    RenderRecorder rec;
+    RenderParams p;
+
+    if (!setlocale(LC_CTYPE, "C.UTF-8")) {
+        setlocale(LC_CTYPE, "");
+    }
+    render_recorder_init(&be, &rec);
+    printf("# corpus\trows\tcols\tframes\tus_frame\trects_frame\tglyph_calls_frame\tglyphs_frame\tcopy_px_frame\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int rows = sizes[s].rows, cols = sizes[s].cols;
+
+        memset(&p, 0, sizeof(p));
+        p.width = 10 + cols * 8;
+        p.height = 5 + rows * 16;
+        p.left_pad = 10;
+        p.top_pad = 5;
+        p.cell_w = 8;
+        p.cell_h = 16;
+        p.ascent = 12;
+        p.cursor_thickness = 2;
+        p.boxdraw = 1;
+        p.boxdraw_braille = 1;
+        p.cursor_color = 256;
+        p.rcursor_color = 257;
+
+        for (size_t c = 0; c < bench_corpora_count; c++) {
+            BenchBuf buf = { 0 };
+            unsigned long frames = 0;
+            unsigned long long copy_px = 0;
+            double render_s = 0.0, t;
+            unsigned long before[RENDER_OP_COUNT];
+            unsigned long glyphs_before = render_stats()->glyphs;
+
+            bench_corpora[c].generate(&buf, rows, cols, 0x9E3779B9u);
+            initialize_terminal_state(&term_state);
+            resize_terminal(rows, cols);
+            render_invalidate();
+            memcpy(before, rec.totals, sizeof(before));
+            for (size_t off = 0; off < buf.len; off += BENCH_READ) {
+                size_t n = buf.len - off < BENCH_READ ? buf.len - off : BENCH_READ;
+                terminal_consume_bytes(buf.data + off, n, &term_state, NULL, NULL);
+                render_recorder_reset(&rec);
+                t = now_sec();
+                frames += (unsigned long)render_frame(&be, &p);
+                render_s += now_sec() - t;
+                for (size_t i = 0; i < rec.count; i++) {
+                    if (rec.ops[i].kind == RENDER_OP_COPY)
+                        copy_px += (unsigned long long)rec.ops[i].w * (unsigned long long)rec.ops[i].h;
+                }
+            }
+            if (frames == 0)
+                frames = 1;
+            printf("%s\t%d\t%d\t%lu\t%.2f\t%.1f\t%.1f\t%.1f\t%llu\n",
+                   bench_corpora[c].name, rows, cols, frames, render_s * 1e6 / (double)frames,
+                   (double)(rec.totals[RENDER_OP_RECT] - before[RENDER_OP_RECT]) / (double)frames,
+                   (double)(rec.totals[RENDER_OP_GLYPHS] - before[RENDER_OP_GLYPHS]) / (double)frames,
+                   (double)(render_stats()->glyphs - glyphs_before) / (double)frames,
+                   copy_px / frames);
+            bench_buf_free(&buf);
+        }
+    }
+    render_recorder_free(&rec);
+    return EXIT_SUCCESS;
+}
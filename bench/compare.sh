@@ -0,0 +1,23 @@
+#!/bin/sh
+# Compare two `make bench` outputs: bench/compare.sh before.txt after.txt
+# Prints MB/s for each corpus and window size and the relative change.
+if [ $# -ne 2 ]; then
+    echo "usage: $0 before.txt after.txt" >&2
+    exit 1
+fi
+
+awk -F'\t' '
+    /^#/ { next }
+    FNR == NR { base[$2 "\t" $4 "x" $3] = $7; order[n++] = $2 "\t" $4 "x" $3; next }
+    { cur[$2 "\t" $4 "x" $3] = $7 }
+    END {
+        printf "%-16s %-8s %10s %10s %8s\n", "corpus", "size", "before", "after", "delta"
+        for (i = 0; i < n; i++) {
+            k = order[i]
+            if (!(k in cur)) continue
+            split(k, f, "\t")
+            d = base[k] > 0 ? (cur[k] - base[k]) * 100.0 / base[k] : 0
+            printf "%-16s %-8s %10.2f %10.2f %+7.1f%%\n", f[1], f[2], base[k], cur[k], d
+        }
+    }
+' "$1" "$2"
@@ -0,0 +1,372 @@
+// boxdraw.c - box drawing, block elements and Braille from cell geometry
+#include "boxdraw.h"
+
+/*
+ * Lines: two bits per arm (0 none, 1 light, 2 heavy, 3 double) packed as
+ * left | right << 2 | up << 4 | down << 6.  0 means not a plain line
+ * (dashes are handled separately, diagonals not at all).
+ */
+#define NONE 0
+#define LT 1
+#define HV 2
+#define DB 3
+#define LINE(l, r, u, d) (uint8_t)((l) | (r) << 2 | (u) << 4 | (d) << 6)
+
+static const uint8_t lines[0x80] = {
+    [0x00] = LINE(LT, LT, NONE, NONE), [0x01] = LINE(HV, HV, NONE, NONE),
+    [0x02] = LINE(NONE, NONE, LT, LT), [0x03] = LINE(NONE, NONE, HV, HV),
+    [0x0C] = LINE(NONE, LT, NONE, LT), [0x0D] = LINE(NONE, HV, NONE, LT),
+    [0x0E] = LINE(NONE, LT, NONE, HV), [0x0F] = LINE(NONE, HV, NONE, HV),
+    [0x10] = LINE(LT, NONE, NONE, LT), [0x11] = LINE(HV, NONE, NONE, LT),
+    [0x12] = LINE(LT, NONE, NONE, HV), [0x13] = LINE(HV, NONE, NONE, HV),
+    [0x14] = LINE(NONE, LT, LT, NONE), [0x15] = LINE(NONE, HV, LT, NONE),
+    [0x16] = LINE(NONE, LT, HV, NONE), [0x17] = LINE(NONE, HV, HV, NONE),
+    [0x18] = LINE(LT, NONE, LT, NONE), [0x19] = LINE(HV, NONE, LT, NONE),
+    [0x1A] = LINE(LT, NONE, HV, NONE), [0x1B] = LINE(HV, NONE, HV, NONE),
+    [0x1C] = LINE(NONE, LT, LT, LT),   [0x1D] = LINE(NONE, HV, LT, LT),
+    [0x1E] = LINE(NONE, LT, HV, LT),   [0x1F] = LINE(NONE, LT, LT, HV),
+    [0x20] = LINE(NONE, LT, HV, HV),   [0x21] = LINE(NONE, HV, HV, LT),
+    [0x22] = LINE(NONE, HV, LT, HV),   [0x23] = LINE(NONE, HV, HV, HV),
+    [0x24] = LINE(LT, NONE, LT, LT),   [0x25] = LINE(HV, NONE, LT, LT),
+    [0x26] = LINE(LT, NONE, HV, LT),   [0x27] = LINE(LT, NONE, LT, HV),
+    [0x28] = LINE(LT, NONE, HV, HV),   [0x29] = LINE(HV, NONE, HV, LT),
+    [0x2A] = LINE(HV, NONE, LT, HV),   [0x2B] = LINE(HV, NONE, HV, HV),
+    [0x2C] = LINE(LT, LT, NONE, LT),   [0x2D] = LINE(HV, LT, NONE, LT),
+    [0x2E] = LINE(LT, HV, NONE, LT),   [0x2F] = LINE(HV, HV, NONE, LT),
+    [0x30] = LINE(LT, LT, NONE, HV),   [0x31] = LINE(HV, LT, NONE, HV),
+    [0x32] = LINE(LT, HV, NONE, HV),   [0x33] = LINE(HV, HV, NONE, HV),
+    [0x34] = LINE(LT, LT, LT, NONE),   [0x35] = LINE(HV, LT, LT, NONE),
+    [0x36] = LINE(LT, HV, LT, NONE),   [0x37] = LINE(HV, HV, LT, NONE),
+    [0x38] = LINE(LT, LT, HV, NONE),   [0x39] = LINE(HV, LT, HV, NONE),
+    [0x3A] = LINE(LT, HV, HV, NONE),   [0x3B] = LINE(HV, HV, HV, NONE),
+    [0x3C] = LINE(LT, LT, LT, LT),     [0x3D] = LINE(HV, LT, LT, LT),
+    [0x3E] = LINE(LT, HV, LT, LT),     [0x3F] = LINE(HV, HV, LT, LT),
+    [0x40] = LINE(LT, LT, HV, LT),     [0x41] = LINE(LT, LT, LT, HV),
+    [0x42] = LINE(LT, LT, HV, HV),     [0x43] = LINE(HV, LT, HV, LT),
+    [0x44] = LINE(LT, HV, HV, LT),     [0x45] = LINE(HV, LT, LT, HV),
+    [0x46] = LINE(LT, HV, LT, HV),     [0x47] = LINE(HV, HV, HV, LT),
+    [0x48] = LINE(HV, HV, LT, HV),     [0x49] = LINE(HV, LT, HV, HV),
+    [0x4A] = LINE(LT, HV, HV, HV),     [0x4B] = LINE(HV, HV, HV, HV),
+    [0x50] = LINE(DB, DB, NONE, NONE), [0x51] = LINE(NONE, NONE, DB, DB),
+    [0x52] = LINE(NONE, DB, NONE, LT), [0x53] = LINE(NONE, LT, NONE, DB),
+    [0x54] = LINE(NONE, DB, NONE, DB), [0x55] = LINE(DB, NONE, NONE, LT),
+    [0x56] = LINE(LT, NONE, NONE, DB), [0x57] = LINE(DB, NONE, NONE, DB),
+    [0x58] = LINE(NONE, DB, LT, NONE), [0x59] = LINE(NONE, LT, DB, NONE),
+    [0x5A] = LINE(NONE, DB, DB, NONE), [0x5B] = LINE(DB, NONE, LT, NONE),
+    [0x5C] = LINE(LT, NONE, DB, NONE), [0x5D] = LINE(DB, NONE, DB, NONE),
+    [0x5E] = LINE(NONE, DB, LT, LT),   [0x5F] = LINE(NONE, LT, DB, DB),
+    [0x60] = LINE(NONE, DB, DB, DB),   [0x61] = LINE(DB, NONE, LT, LT),
+    [0x62] = LINE(LT, NONE, DB, DB),   [0x63] = LINE(DB, NONE, DB, DB),
+    [0x64] = LINE(DB, DB, NONE, LT),   [0x65] = LINE(LT, LT, NONE, DB),
+    [0x66] = LINE(DB, DB, NONE, DB),   [0x67] = LINE(DB, DB, LT, NONE),
+    [0x68] = LINE(LT, LT, DB, NONE),   [0x69] = LINE(DB, DB, DB, NONE),
+    [0x6A] = LINE(DB, DB, LT, LT),     [0x6B] = LINE(LT, LT, DB, DB),
+    [0x6C] = LINE(DB, DB, DB, DB),
+    /* Rounded corners, drawn square. */
+    [0x6D] = LINE(NONE, LT, NONE, LT), [0x6E] = LINE(LT, NONE, NONE, LT),
+    [0x6F] = LINE(LT, NONE, LT, NONE), [0x70] = LINE(NONE, LT, LT, NONE),
+    [0x74] = LINE(LT, NONE, NONE, NONE), [0x75] = LINE(NONE, NONE, LT, NONE),
+    [0x76] = LINE(NONE, LT, NONE, NONE), [0x77] = LINE(NONE, NONE, NONE, LT),
+    [0x78] = LINE(HV, NONE, NONE, NONE), [0x79] = LINE(NONE, NONE, HV, NONE),
+    [0x7A] = LINE(NONE, HV, NONE, NONE), [0x7B] = LINE(NONE, NONE, NONE, HV),
+    [0x7C] = LINE(LT, HV, NONE, NONE), [0x7D] = LINE(NONE, NONE, LT, HV),
+    [0x7E] = LINE(HV, LT, NONE, NONE), [0x7F] = LINE(NONE, NONE, HV, LT),
+};
+
+/* Dashed lines: segments, weight and direction. */
+typedef struct {
+    uint8_t offset;         /* cp - 0x2500 */
+    uint8_t segments;
+    uint8_t weight;         /* LT or HV */
+    uint8_t vertical;
+} Dash;
+
+static const Dash dashes[] = {
+    { 0x04, 3, LT, 0 }, { 0x05, 3, HV, 0 }, { 0x06, 3, LT, 1 }, { 0x07, 3, HV, 1 },
+    { 0x08, 4, LT, 0 }, { 0x09, 4, HV, 0 }, { 0x0A, 4, LT, 1 }, { 0x0B, 4, HV, 1 },
+    { 0x4C, 2, LT, 0 }, { 0x4D, 2, HV, 0 }, { 0x4E, 2, LT, 1 }, { 0x4F, 2, HV, 1 },
+};
+
+static const Dash *find_dash(uint32_t off) {
+    for (unsigned i = 0; i < sizeof(dashes) / sizeof(dashes[0]); i++) {
+        if (dashes[i].offset == off)
+            return &dashes[i];
+    }
+    return NULL;
+}
+
+int boxdraw_handles(uint32_t cp, int braille) {
+    if (cp >= 0x2500 && cp < 0x2580)
+        return lines[cp - 0x2500] != 0 || find_dash(cp - 0x2500) != NULL;
+    if (cp >= 0x2580 && cp < 0x25A0)
+        return 1;
+    return braille && cp >= 0x2800 && cp < 0x2900;
+}
+
+uint32_t boxdraw_cell_cp(const char *utf8) {
+    const unsigned char *s = (const unsigned char *)utf8;
+
+    /* All three ranges are three-byte sequences starting E2 94..96 / E2 A0..A3. */
+    if (s[0] != 0xE2 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || s[3] != '\0')
+        return 0;
+    if (!((s[1] >= 0x94 && s[1] <= 0x96) || (s[1] >= 0xA0 && s[1] <= 0xA3)))
+        return 0;
+    return 0x2000u | (uint32_t)(s[1] & 0x3F) << 6 | (uint32_t)(s[2] & 0x3F);
+}
+
+static int push(RenderRect *out, int n, int x, int y, int w, int h) {
+    if (w <= 0 || h <= 0 || n >= BOXDRAW_MAX_RECTS)
+        return n;
+    out[n].x = x;
+    out[n].y = y;
+    out[n].w = w;
+    out[n].h = h;
+    return n + 1;
+}
+
+static int stroke(int weight, int lw) {
+    return weight == HV ? 2 * lw : weight == DB ? 3 * lw : weight == LT ? lw : 0;
+}
+
+static int max2(int a, int b) {
+    return a > b ? a : b;
+}
+
+/*
+ * Each arm runs from the cell edge to the strokes crossing the centre.
+ * A single arm meeting a double line that runs straight through stops at
+ * its near side (unless the arm crosses it too); each line of a double arm stops at the inner
+ * line when an arm leaves on its side, at the outer one otherwise.
+ */
+static int draw_lines(uint8_t spec, int x, int y, int w, int h, int lw, RenderRect *out) {
+    const int l = spec & 3, r = (spec >> 2) & 3, u = (spec >> 4) & 3, d = (spec >> 6) & 3;
+    int tv = max2(stroke(u, lw), stroke(d, lw));
+    int th = max2(stroke(l, lw), stroke(r, lw));
+    int va, vb, ha, hb;
+    const int dx0 = x + (w - 3 * lw) / 2, dx1 = dx0 + 2 * lw;
+    const int dy0 = y + (h - 3 * lw) / 2, dy1 = dy0 + 2 * lw;
+    int n = 0;
+
+    if (!tv) tv = th;
+    if (!th) th = tv;
+    va = x + (w - tv) / 2;
+    vb = va + tv;
+    ha = y + (h - th) / 2;
+    hb = ha + th;
+
+    if (l == DB) {
+        n = push(out, n, x, dy0, (u ? va + lw : vb) - x, lw);
+        n = push(out, n, x, dy1, (d ? va + lw : vb) - x, lw);
+    } else if (l) {
+        int t = stroke(l, lw);
+        int end = u == DB && d == DB && !r ? va + lw : vb;
+        n = push(out, n, x, y + (h - t) / 2, end - x, t);
+    }
+    if (r == DB) {
+        int s0 = u ? vb - lw : va, s1 = d ? vb - lw : va;
+        n = push(out, n, s0, dy0, x + w - s0, lw);
+        n = push(out, n, s1, dy1, x + w - s1, lw);
+    } else if (r) {
+        int t = stroke(r, lw);
+        int start = u == DB && d == DB && !l ? vb - lw : va;
+        n = push(out, n, start, y + (h - t) / 2, x + w - start, t);
+    }
+    if (u == DB) {
+        n = push(out, n, dx0, y, lw, (l ? ha + lw : hb) - y);
+        n = push(out, n, dx1, y, lw, (r ? ha + lw : hb) - y);
+    } else if (u) {
+        int t = stroke(u, lw);
+        int end = l == DB && r == DB && !d ? ha + lw : hb;
+        n = push(out, n, x + (w - t) / 2, y, t, end - y);
+    }
+    if (d == DB) {
+        int s0 = l ? hb - lw : ha, s1 = r ? hb - lw : ha;
+        n = push(out, n, dx0, s0, lw, y + h - s0);
+        n = push(out, n, dx1, s1, lw, y + h - s1);
+    } else if (d) {
+        int t = stroke(d, lw);
+        int start = l == DB && r == DB && !u ? hb - lw : ha;
+        n = push(out, n, x + (w - t) / 2, start, t, y + h - start);
+    }
+    return n;
+}
+
+static int draw_dash(const Dash *dash, int x, int y, int w, int h, int lw, RenderRect *out) {
+    const int t = stroke(dash->weight, lw);
+    const int len = dash->vertical ? h : w;
+    const int gap = max2(1, len / (dash->segments * 4));
+    int n = 0;
+
+    for (int i = 0; i < dash->segments; i++) {
+        int a = len * i / dash->segments;
+        int b = len * (i + 1) / dash->segments - gap;
+
+        if (dash->vertical)
+            n = push(out, n, x + (w - t) / 2, y + a, t, b - a);
+        else
+            n = push(out, n, x + a, y + (h - t) / 2, b - a, t);
+    }
+    return n;
+}
+
+/* Quadrants: upper left, upper right, lower left, lower right. */
+#define QUL 1
+#define QUR 2
+#define QLL 4
+#define QLR 8
+
+static int draw_quadrants(int mask, int x, int y, int w, int h, RenderRect *out) {
+    const int mx = x + w / 2, my = y + h / 2;
+    int n = 0;
+
+    if (mask & QUL) n = push(out, n, x, y, mx - x, my - y);
+    if (mask & QUR) n = push(out, n, mx, y, x + w - mx, my - y);
+    if (mask & QLL) n = push(out, n, x, my, mx - x, y + h - my);
+    if (mask & QLR) n = push(out, n, mx, my, x + w - mx, y + h - my);
+    return n;
+}
+
+static int draw_block(uint32_t off, int x, int y, int w, int h, RenderRect *out, int *shade) {
+    static const uint8_t quads[] = {
+        QLL, QLR, QUL, QUL | QLL | QLR, QUL | QLR, QUL | QUR | QLL,
+        QUL | QUR | QLR, QUR, QUR | QLL, QUR | QLL | QLR,
+    };
+    int k;
+
+    if (off == 0x00)                        /* upper half */
+        return push(out, 0, x, y, w, (h + 1) / 2);
+    if (off >= 0x01 && off <= 0x08) {       /* lower eighths .. full */
+        k = (h * (int)off + 4) / 8;
+        return push(out, 0, x, y + h - k, w, k);
+    }
+    if (off >= 0x09 && off <= 0x0F) {       /* left seven eighths .. one */
+        k = (w * (int)(0x10 - off) + 4) / 8;
+        return push(out, 0, x, y, k, h);
+    }
+    if (off == 0x10)                        /* right half */
+        return push(out, 0, x + w / 2, y, w - w / 2, h);
+    if (off >= 0x11 && off <= 0x13) {       /* light, medium, dark shade */
+        *shade = (int)(off - 0x10);
+        return push(out, 0, x, y, w, h);
+    }
+    if (off == 0x14)                        /* upper eighth */
+        return push(out, 0, x, y, w, max2(1, (h + 4) / 8));
+    if (off == 0x15) {                      /* right eighth */
+        k = max2(1, (w + 4) / 8);
+        return push(out, 0, x + w - k, y, k, h);
+    }
+    return draw_quadrants(quads[off - 0x16], x, y, w, h, out);
+}
+
+/* Dots 1-3 and 7 down the left column, 4-6 and 8 down the right. */
+static int draw_braille(uint32_t bits, int x, int y, int w, int h, RenderRect *out) {
+    static const uint8_t col[8] = { 0, 0, 0, 1, 1, 1, 0, 1 };
+    static const uint8_t row[8] = { 0, 1, 2, 0, 1, 2, 3, 3 };
+    int n = 0;
+
+    for (int i = 0; i < 8; i++) {
+        int sx0, sx1, sy0, sy1, dw, dh;
+
+        if (!(bits & (1u << i)))
+            continue;
+        sx0 = x + w * col[i] / 2;
+        sx1 = x + w * (col[i] + 1) / 2;
+        sy0 = y + h * row[i] / 4;
+        sy1 = y + h * (row[i] + 1) / 4;
+        dw = max2(1, (sx1 - sx0) * 2 / 3);
+        dh = max2(1, (sy1 - sy0) * 2 / 3);
+        if (dh > dw * 2)
+            dh = dw * 2;
+        n = push(out, n, sx0 + (sx1 - sx0 - dw) / 2, sy0 + (sy1 - sy0 - dh) / 2, dw, dh);
+    }
+    return n;
+}
+
+/* Tiny cells: double lines and dots can land outside. */
+static int clip(RenderRect *out, int n, int x, int y, int w, int h) {
+    int kept = 0;
+
+    for (int i = 0; i < n; i++) {
+        int x0 = max2(out[i].x, x), y0 = max2(out[i].y, y);
+        int x1 = out[i].x + out[i].w, y1 = out[i].y + out[i].h;
+
+        if (x1 > x + w) x1 = x + w;
+        if (y1 > y + h) y1 = y + h;
+        if (x1 <= x0 || y1 <= y0)
+            continue;
+        out[kept].x = x0;
+        out[kept].y = y0;
+        out[kept].w = x1 - x0;
+        out[kept].h = y1 - y0;
+        kept++;
+    }
+    return kept;
+}
+
+static int compute_rects(uint32_t cp, int x, int y, int w, int h, RenderRect *out, int *shade) {
+    const int lw = max2(1, (w < h ? w : h) / 8);
+    const Dash *dash;
+    int n = 0;
+
+    *shade = 0;
+    if (cp >= 0x2500 && cp < 0x2580) {
+        if (lines[cp - 0x2500]) {
+            n = draw_lines(lines[cp - 0x2500], x, y, w, h, lw, out);
+        } else {
+            dash = find_dash(cp - 0x2500);
+            n = dash ? draw_dash(dash, x, y, w, h, lw, out) : 0;
+        }
+    } else if (cp >= 0x2580 && cp < 0x25A0) {
+        n = draw_block(cp - 0x2580, x, y, w, h, out, shade);
+    } else if (cp >= 0x2800 && cp < 0x2900) {
+        n = draw_braille(cp - 0x2800, x, y, w, h, out);
+    }
+    return clip(out, n, x, y, w, h);
+}
+
+/* Shapes for the current cell size, at the origin; rebuilt on a size
+ * change.  count 0xFF marks a slot not computed yet. */
+#define CACHE_SLOTS (0xA0 + 0x100)   /* U+2500-U+259F, then U+2800-U+28FF */
+
+typedef struct {
+    RenderRect r[BOXDRAW_MAX_RECTS];
+    uint8_t count;
+    uint8_t shade;
+} Shape;
+
+static Shape cache[CACHE_SLOTS];
+static int cache_w, cache_h;
+
+int boxdraw_rects(uint32_t cp, int x, int y, int w, int h, RenderRect *out, int *shade) {
+    Shape *sh;
+    unsigned slot;
+    int sv;
+
+    *shade = 0;
+    if (w <= 0 || h <= 0)
+        return 0;
+    if (cp >= 0x2500 && cp < 0x25A0)
+        slot = cp - 0x2500;
+    else if (cp >= 0x2800 && cp < 0x2900)
+        slot = 0xA0 + (cp - 0x2800);
+    else
+        return 0;
+    if (w != cache_w || h != cache_h) {
+        for (unsigned i = 0; i < CACHE_SLOTS; i++)
+            cache[i].count = 0xFF;
+        cache_w = w;
+        cache_h = h;
+    }
+    sh = &cache[slot];
+    if (sh->count == 0xFF) {
+        sh->count = (uint8_t)compute_rects(cp, 0, 0, w, h, sh->r, &sv);
+        sh->shade = (uint8_t)sv;
+    }
+    for (int i = 0; i < sh->count; i++) {
+        out[i] = sh->r[i];
+        out[i].x += x;
+        out[i].y += y;
+    }
+    *shade = sh->shade;
+    return sh->count;
+}
@@ -0,0 +1,28 @@
+#ifndef BOXDRAW_H
+#define BOXDRAW_H
+
+#include <stdint.h>
+
+#include "render.h"
+
+/*
+ * Box drawing (U+2500-U+257F), block elements (U+2580-U+259F) and Braille
+ * (U+2800-U+28FF) drawn as rectangles from the cell geometry instead of
+ * font glyphs, so borders and graphs join up exactly at any font size and
+ * need no fallback lookup.  Diagonals (U+2571-U+2573) are left to the font;
+ * rounded corners are drawn square.
+ */
+
+/* Upper bound on the rectangles one cell needs. */
+#define BOXDRAW_MAX_RECTS 8
+
+/* Drawn procedurally (given whether Braille is enabled). */
+int boxdraw_handles(uint32_t cp, int braille);
+/* The code point of a cell holding one character from these ranges, or 0. */
+uint32_t boxdraw_cell_cp(const char *utf8);
+/* Rectangles for cp in the cell at x, y of w x h pixels.  *shade is set
+ * to 1-3 for the 25/50/75% shades (one rect in a mixed colour), else 0.
+ * Returns the count, 0 if cp is not handled. */
+int boxdraw_rects(uint32_t cp, int x, int y, int w, int h, RenderRect *out, int *shade);
+
+#endif /* BOXDRAW_H */
@@ -69,6 +69,21 @@ extern double defaultfontsize;
 static float zoomstep __attribute__((unused)) = 1.0f;
 static double minfontsize __attribute__((unused)) = 6.0;
 static double maxfontsize __attribute__((unused)) = 256.0;
+/* Font sizes kept loaded after zooming away from them (with their fallback
+ * faces), so zooming back is instant.  0 reloads every step. */
+static int fontsetcache __attribute__((unused)) = 4;
+
+/* Scrollback past the lines kept in memory (--spill): older lines are
+ * written to a file in spilldir (NULL: $XDG_RUNTIME_DIR, else /tmp) and
+ * read back when scrolled to.  The file is deleted on exit unless
+ * spillkeep is set (--keep-spill).  0 keeps history in memory only. */
+static int scrollspill __attribute__((unused)) = 0;
+static char *spilldir __attribute__((unused)) = NULL;
+static int spillkeep __attribute__((unused)) = 0;
+
+/* Scrollback search (TERMMOD+F): worker threads per scan, 0 = one per CPU
+ * up to 4.  Short histories are scanned without threads. */
+static int searchthreads __attribute__((unused)) = 0;
 
 /* Shell and execution */
 static char *shell __attribute__((unused)) = "/bin/bash";
@@ -83,6 +98,12 @@ extern char *vtiden;
 static float cwscale __attribute__((unused)) = 1.0f;
 static float chscale __attribute__((unused)) = 1.0f;
 
+/* Draw box drawing and block elements (U+2500-U+259F) from the cell
+ * geometry instead of the font, so they join up at any size; Braille
+ * (U+2800-U+28FF) too with boxdraw_braille. */
+static int boxdraw __attribute__((unused)) = 1;
+static int boxdraw_braille __attribute__((unused)) = 1;
+
 /* Word delimiters for selection snap */
 static wchar_t *worddelimiters __attribute__((unused)) = L" ";
 
@@ -96,10 +117,39 @@ extern int allowaltscreen;
 /* Allow OSC 52 clipboard (insecure) */
 extern int allowwindowops;
 
-/* Draw latency (ms) */
+/*
+ * Draw latency (ms): wait minlatency for output to go idle, but never batch
+ * longer than maxlatency.  Keystroke echo is drawn immediately.
+ */
 static double minlatency __attribute__((unused)) = 2;
 static double maxlatency __attribute__((unused)) = 33;
 
+/* After a keypress, wait up to echowait ms for the echo and draw it at
+ * once (0 = disable the instant-echo poll) */
+static double echowait __attribute__((unused)) = 3;
+
+/* Frame rate used while output is sustained bulk (cat of a large file) */
+static double bulkfps __attribute__((unused)) = 10;
+
+/* Display refresh rate in Hz (0 = unknown, batch up to maxlatency) */
+static double refreshrate __attribute__((unused)) = 0;
+
+/* Frame-rate cap while visible but unfocused (0 = no cap).  Nothing is
+ * drawn while the window is unmapped or fully obscured. */
+static double unfocusedfps __attribute__((unused)) = 10;
+
+/* Longest a synchronized update (DECSET ?2026) may hold drawing (ms) */
+static double synctimeout __attribute__((unused)) = 150;
+
+/* -o/-O output log: bytes buffered for the writer thread before PTY output
+ * is dropped (and counted) rather than stalling the terminal. */
+static unsigned int iologsize __attribute__((unused)) = 4 * 1024 * 1024;
+
+/* make TRACE=1 builds: trace events kept in memory (48 bytes each) and the
+ * Chrome trace JSON file written at exit and on SIGUSR2. */
+static unsigned int tracesize __attribute__((unused)) = 65536;
+static char *tracefile __attribute__((unused)) = "/tmp/cupidterminal-trace.json";
+
 /* Blink timeout (0 = disable) */
 static unsigned int blinktimeout __attribute__((unused)) = 800;
 
@@ -152,6 +202,8 @@ void zoom(const Arg *);
 void zoomreset(const Arg *);
 void sendbreak(const Arg *);
 void numlock(const Arg *);
+void perfhud(const Arg *);
+void searchstart(const Arg *);
 void ttysend(const Arg *);
 
 /* Config array sizes */
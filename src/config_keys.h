@@ -25,6 +25,8 @@ static Shortcut shortcuts[] = {
 	{ TERMMOD,        XK_Y,           selpaste,    {.i = 0} },
 	{ ShiftMask,      XK_Insert,      selpaste,    {.i = 0} },
 	{ TERMMOD,        XK_Num_Lock,    numlock,     {.i = 0} },
+	{ TERMMOD,        XK_F12,         perfhud,     {.i = 0} },
+	{ TERMMOD,        XK_F,           searchstart, {.i = 0} },
 };
 
 static KeySym mappedkeys[] = { (KeySym)-1 };
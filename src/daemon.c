@@ -0,0 +1,401 @@
+// daemon.c - --daemon / --client: fork warm terminals over a Unix socket
+#define _GNU_SOURCE     /* struct ucred */
+#include "daemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Reply sent once the child's first frame is presented. */
+#define DAEMON_READY "ok\n"
+
+static int g_client_fd = -1;    /* daemon child: connection to release */
+
+extern char **environ;
+
+int daemon_socket_path(char *buf, size_t cap, const char *display) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    char name[64];
+    size_t i;
+    int n;
+
+    if (!display || !display[0])
+        display = ":0";
+    /* "host:0.0" -> "host_0.0": keep the name a single path component. */
+    for (i = 0; display[i] && i < sizeof(name) - 1; i++)
+        name[i] = (display[i] == '/' || display[i] == ':') ? '_' : display[i];
+    name[i] = '\0';
+
+    if (dir && dir[0])
+        n = snprintf(buf, cap, "%s/cupidterminal-%s.sock", dir, name);
+    else
+        n = snprintf(buf, cap, "/tmp/cupidterminal-%ld/%s.sock", (long)getuid(), name);
+    return (n < 0 || (size_t)n >= cap) ? -1 : 0;
+}
+
+/* The directory holding path must be ours and closed to everyone else, or
+ * another user could put their own socket there first.  With create, a
+ * missing directory is made 0700.  Returns 0, or -1 with errno set. */
+static int private_dir(const char *path, int create) {
+    char dir[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    const char *slash = strrchr(path, '/');
+    struct stat st;
+    size_t n;
+
+    if (!slash) {
+        dir[0] = '.';
+        n = 1;
+    } else {
+        n = (slash == path) ? 1 : (size_t)(slash - path);
+        if (n >= sizeof(dir)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memcpy(dir, path, n);
+    }
+    dir[n] = '\0';
+    if (create && mkdir(dir, 0700) != 0 && errno != EEXIST)
+        return -1;
+    if (lstat(dir, &st) != 0)
+        return -1;
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077) != 0) {
+        errno = EACCES;
+        return -1;
+    }
+    return 0;
+}
+
+/* path is a socket of this user in a private directory. */
+static int own_socket(const char *path) {
+    struct stat st;
+
+    if (lstat(path, &st) != 0)
+        return -1;
+    if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()) {
+        errno = EACCES;
+        return -1;
+    }
+    return private_dir(path, 0);
+}
+
+/* The other end of a connected socket runs as this user. */
+static int peer_is_self(int fd) {
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+
+    return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#endif
+}
+
+/* Environment strings worth sending: NAME=value with a non-empty name. */
+static int env_entry(const char *s) {
+    return s && s[0] && s[0] != '=' && strchr(s, '=') != NULL;
+}
+
+static int put_string(char *buf, size_t cap, size_t *len, const char *s) {
+    size_t n = strlen(s) + 1;
+
+    if (n > cap - *len)
+        return -1;
+    memcpy(buf + *len, s, n);
+    *len += n;
+    return 0;
+}
+
+size_t daemon_encode(char *buf, size_t cap, const char *cwd, char *const envp[],
+                     int argc, char *const argv[]) {
+    size_t len = 0;
+
+    if (put_string(buf, cap, &len, cwd ? cwd : "") != 0)
+        return 0;
+    for (size_t i = 0; envp && envp[i]; i++) {
+        if (env_entry(envp[i]) && put_string(buf, cap, &len, envp[i]) != 0)
+            return 0;
+    }
+    if (put_string(buf, cap, &len, "") != 0)
+        return 0;
+    for (int i = 0; i < argc; i++) {
+        if (put_string(buf, cap, &len, argv[i] ? argv[i] : "") != 0)
+            return 0;
+    }
+    return len;
+}
+
+char **daemon_decode(char *buf, size_t len, char **cwd, char ***envp, int *argc) {
+    char **argv;
+    size_t strings = 0;
+    size_t off;
+    size_t nenv = 0;
+    int n = 0;
+
+    if (len == 0 || buf[len - 1] != '\0')
+        return NULL;
+    for (size_t i = 0; i < len; i++)
+        strings += (buf[i] == '\0');
+
+    *cwd = buf;
+    off = strlen(buf) + 1;
+    for (size_t o = off; o < len && buf[o]; o += strlen(buf + o) + 1) {
+        if (!env_entry(buf + o))
+            return NULL;
+        nenv++;
+    }
+    /* cwd, the environment, its terminator and at least argv[0] */
+    if (strings < nenv + 3)
+        return NULL;
+    argv = calloc(strings + 1, sizeof(char *));
+    if (!argv)
+        return NULL;
+
+    /* argv, NULL, then the environment and its NULL in the same block. */
+    *envp = argv + (strings - nenv - 1);
+    for (size_t i = 0; i < nenv; i++) {
+        (*envp)[i] = buf + off;
+        off += strlen(buf + off) + 1;
+    }
+    off++;                  /* the empty string ending the environment */
+    while (off < len) {
+        argv[n++] = buf + off;
+        off += strlen(buf + off) + 1;
+    }
+    argv[n] = NULL;
+    (*envp)[nenv] = NULL;
+    *argc = n;
+    return argv;
+}
+
+static int write_full(int fd, const void *data, size_t len) {
+    const char *p = data;
+
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void *data, size_t len) {
+    char *p = data;
+
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int open_socket(const char *path, struct sockaddr_un *addr) {
+    int fd;
+
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, strlen(path) + 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/* Forked per connection: read the request, become the window, exit. */
+static void serve_one(int conn, daemon_window_fn fn) {
+    static char msg[DAEMON_MSG_MAX];
+    struct timeval tv = { 5, 0 };   /* a client that never writes */
+    uint32_t len;
+    char *cwd;
+    char **argv, **envp;
+    int argc;
+
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (read_full(conn, &len, sizeof(len)) != 0 || len == 0 || len > sizeof(msg) ||
+        read_full(conn, msg, len) != 0)
+        _exit(1);
+    argv = daemon_decode(msg, len, &cwd, &envp, &argc);
+    if (!argv)
+        _exit(1);
+    if (cwd[0] && chdir(cwd) != 0)
+        fprintf(stderr, "cupidterminal: cannot enter %s: %s\n", cwd, strerror(errno));
+    /* The window and its shell see the client's environment, not the
+     * daemon's: TERM, locale, DISPLAY, SSH_AUTH_SOCK and the rest. */
+    environ = envp;
+
+    g_client_fd = conn;
+    exit(fn(argc, argv));
+}
+
+int daemon_serve(const char *path, daemon_window_fn fn) {
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    struct stat st;
+    int fd;
+
+    if (private_dir(path, 1) != 0)
+        return -1;
+    fd = open_socket(path, &addr);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        close(fd);
+        errno = EADDRINUSE;
+        return -1;
+    }
+    /* A stale socket left by a daemon that died is replaced; anything
+     * else on the path is left alone. */
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()) {
+            close(fd);
+            errno = EEXIST;
+            return -1;
+        }
+        unlink(path);
+    }
+    {
+        mode_t old = umask(077);
+        int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+
+        umask(old);
+        if (rc != 0 || listen(fd, 64) != 0) {
+            int err = errno;
+
+            close(fd);
+            errno = err;
+            return -1;
+        }
+    }
+
+    /* Windows are not waited for; the children reap themselves. */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_DFL;
+    sa.sa_flags = SA_NOCLDWAIT;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (;;) {
+        int conn = accept(fd, NULL, NULL);
+        pid_t pid;
+
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            close(fd);
+            return -1;
+        }
+        if (!peer_is_self(conn)) {
+            close(conn);    /* requests come from this user only */
+            continue;
+        }
+        fcntl(conn, F_SETFD, FD_CLOEXEC);
+        pid = fork();
+        if (pid == 0) {
+            close(fd);
+            signal(SIGPIPE, SIG_DFL);
+            serve_one(conn, fn);
+        }
+        if (pid < 0)
+            perror("cupidterminal: fork");
+        close(conn);
+    }
+}
+
+int daemon_client(const char *path, int argc, char *argv[]) {
+    static char msg[DAEMON_MSG_MAX];
+    struct sockaddr_un addr;
+    char cwd[4096];
+    char reply[sizeof(DAEMON_READY)];
+    uint32_t len;
+    size_t got = 0;
+    int fd;
+
+    if (!getcwd(cwd, sizeof(cwd)))
+        cwd[0] = '\0';
+    len = (uint32_t)daemon_encode(msg, sizeof(msg), cwd, environ, argc, argv);
+    if (len == 0) {
+        fprintf(stderr, "cupidterminal: arguments and environment too long for the daemon\n");
+        return 1;
+    }
+    /* The request carries the whole environment: only hand it to a
+     * daemon of this user, behind a socket nobody else could have made. */
+    if (own_socket(path) != 0) {
+        if (errno == EACCES)
+            fprintf(stderr, "cupidterminal: %s is not a private socket of this user\n", path);
+        else
+            fprintf(stderr, "cupidterminal: no daemon on %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    fd = open_socket(path, &addr);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "cupidterminal: no daemon on %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+    if (!peer_is_self(fd)) {
+        fprintf(stderr, "cupidterminal: the daemon on %s runs as another user\n", path);
+        close(fd);
+        return 1;
+    }
+    if (write_full(fd, &len, sizeof(len)) != 0 || write_full(fd, msg, len) != 0) {
+        fprintf(stderr, "cupidterminal: cannot send request: %s\n", strerror(errno));
+        close(fd);
+        return 1;
+    }
+    while (got < sizeof(reply) - 1) {
+        ssize_t n = read(fd, reply + got, sizeof(reply) - 1 - got);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (got != sizeof(reply) - 1 || memcmp(reply, DAEMON_READY, got) != 0) {
+        fprintf(stderr, "cupidterminal: the window did not start\n");
+        return 1;
+    }
+    return 0;
+}
+
+void daemon_window_ready(void) {
+    if (g_client_fd < 0)
+        return;
+    (void)write_full(g_client_fd, DAEMON_READY, sizeof(DAEMON_READY) - 1);
+    close(g_client_fd);
+    g_client_fd = -1;
+}
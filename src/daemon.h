@@ -0,0 +1,52 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stddef.h>
+
+/*
+ * --daemon / --client: one warm process that forks a terminal per request.
+ *
+ * The daemon loads fontconfig, matches the configured font in every style
+ * and sorts the fallback lists once (draw_prewarm_fonts()), then waits on a
+ * Unix socket.  Each client request (working directory, environment and the
+ * terminal's arguments) is answered by forking: the child enters the
+ * directory, takes on the client's environment and runs an ordinary
+ * terminal, sharing the already loaded font configuration copy-on-write.
+ * The client returns once the child has put its first frame on screen.
+ */
+
+/* Upper bound on one request (directory, environment and arguments). */
+#define DAEMON_MSG_MAX 65536
+
+/* Runs a terminal in the forked child; the return value is its exit status. */
+typedef int (*daemon_window_fn)(int argc, char *argv[]);
+
+/* $XDG_RUNTIME_DIR/cupidterminal-<display>.sock, or
+ * /tmp/cupidterminal-<uid>/<display>.sock without XDG_RUNTIME_DIR.  Returns
+ * 0, or -1 if it does not fit in cap. */
+int daemon_socket_path(char *buf, size_t cap, const char *display);
+/* Serve requests on path until an error; a live daemon already on path is
+ * an error, a stale socket is replaced.  The directory holding path is made
+ * 0700 if missing and must be owned by this user and closed to others;
+ * connections from other users are dropped.  Returns -1 (with errno set). */
+int daemon_serve(const char *path, daemon_window_fn fn);
+/* Ask the daemon on path for a window running argv.  The request is only
+ * sent if path is this user's socket in a private directory and the daemon
+ * runs as this user.  Returns 0 once the window is up, 1 if there is no
+ * daemon or the window failed to start. */
+int daemon_client(const char *path, int argc, char *argv[]);
+/* In a daemon child: the first frame is on screen, release the client.
+ * No-op outside daemon children and after the first call. */
+void daemon_window_ready(void);
+
+/* Request wire format: the payload is NUL-terminated strings: cwd, the
+ * NAME=value environment entries, an empty string, then argv.  encode
+ * returns the payload length or 0 if it does not fit; decode points into buf
+ * and returns a malloc'd argv (NULL-terminated) or NULL if the payload is
+ * malformed.  *envp (NULL-terminated) lives in the same block, freed with
+ * argv. */
+size_t daemon_encode(char *buf, size_t cap, const char *cwd, char *const envp[],
+                     int argc, char *const argv[]);
+char **daemon_decode(char *buf, size_t len, char **cwd, char ***envp, int *argc);
+
+#endif /* DAEMON_H */
@@ -10,8 +10,14 @@
 #include <time.h>
 #include "draw.h"
 #include "config.h"
+#include "font_resolve.h"
+#include "input.h"
+#include "search.h"
 #include "terminal_state.h"
 #include "input.h"
+#include "render.h"
+#include "perf.h"
+#include "trace.h"
 
 #define MAX_LINES 100    // Maximum number of lines
 #define MAX_CHARS 4096   // Increased to accommodate multi-byte UTF-8 characters
@@ -21,7 +27,6 @@ int line_count = 0;  // Track number of lines
 // Static constants (LEFT_PAD/TOP_PAD must match DRAW_LEFT_PAD/DRAW_TOP_PAD in draw.h)
 static const int LEFT_PAD = DRAW_LEFT_PAD;
 static const int LINE_GAP = 0;  /* 0 for btop graph alignment; Braille/block need contiguous rows */
-static int cell_selected(int r, int c);
 
 // Global variables
 XftDraw *xft_draw = NULL;
@@ -42,6 +47,7 @@ int g_cell_gap = 0; // Remove artificial spacing
 
 /* Double buffer to reduce flicker (btop and other TUIs) */
 static Pixmap back_pixmap = None;
+static unsigned long frames_presented;
 static XftDraw *xft_draw_buf = NULL;
 static int back_w = 0, back_h = 0;
 
@@ -195,7 +201,6 @@ static XftColor color_cache[COLOR_CACHE_SIZE];
 static int color_allocated[COLOR_CACHE_SIZE] = {0};
 static XftColor faint_color_cache[COLOR_CACHE_SIZE];
 static int faint_color_allocated[COLOR_CACHE_SIZE] = {0};
-static int draw_full_refresh;
 
 /* Open-addressing hash table for true-RGB XftColor allocation.
  * key == 0 is the empty-slot sentinel; no valid true-RGB key is 0 because
@@ -215,7 +220,7 @@ static void mark_all_rows_dirty_local(void) {
     if (!dirty_rows || term_rows <= 0) {
         return;
     }
-    memset(dirty_rows, 1, (size_t)term_rows);
+    memset(dirty_rows, DIRTY_ROW_FULL, (size_t)term_rows);
 }
 
 static void update_blink_state(void) {
@@ -265,17 +270,40 @@ static void update_blink_state(void) {
 /* Open-addressing hash table for glyph fallback font lookup.
  * occupied == 0 is the empty-slot sentinel (zero-initialized by static storage).
  * font == NULL with occupied == 1 means "tried, no font found" – the miss is
- * cached to avoid repeated FcFontMatch calls for unsupported codepoints.
- * 2048 slots handles 256 braille + 128 box-drawing + block elements with room. */
+ * cached to avoid repeated FcFontMatch calls for unsupported codepoints –
+ * or, with pending set, that the resolver thread is still matching it.
+ * font points into fb_faces[] below and is not owned by the entry.  At 3/4
+ * load the table is rebuilt from scratch: entries for cached faces come
+ * back through fallback_face_covering() without asking fontconfig. */
 #define GF_HASH_SIZE 2048
 #define GF_HASH_MASK (GF_HASH_SIZE - 1)
+#define GF_HASH_LIMIT (GF_HASH_SIZE / 4 * 3)
 typedef struct {
     utf8proc_int32_t cp;
     uint8_t          style;
     uint8_t          occupied;
+    uint8_t          pending;
     XftFont         *font;
 } GfEntry;
 static GfEntry gf_hash[GF_HASH_SIZE];
+static int gf_count;
+
+/*
+ * Fallback faces, one XftFont per (file, face index, style, pixel size), as
+ * st's frc[] keeps one per matched font.  A face's FcCharSet answers for
+ * every code point it covers, so a page of CJK or the braille block opens
+ * one handle per file, not one per glyph.
+ */
+typedef struct {
+    FcChar8 *file;
+    int      index;
+    uint8_t  style;
+    double   size;
+    XftFont *font;
+} FallbackFace;
+static FallbackFace *fb_faces;
+static int fb_faces_len;
+static int fb_faces_cap;
 
 /*
  * st keeps Font.pattern = configured (pre-match query pattern) and uses
@@ -317,14 +345,17 @@ static FcPattern *pattern_for_glyph_fallback(uint8_t style) {
 }
 
 static void clear_glyph_fallback_cache(Display *display) {
-    for (int i = 0; i < GF_HASH_SIZE; i++) {
-        if (gf_hash[i].occupied) {
-            if (display && gf_hash[i].font)
-                XftFontClose(display, gf_hash[i].font);
-            gf_hash[i].occupied = 0;
-            gf_hash[i].font = NULL;
-        }
+    memset(gf_hash, 0, sizeof(gf_hash));
+    gf_count = 0;
+    for (int i = 0; i < fb_faces_len; i++) {
+        if (display)
+            XftFontClose(display, fb_faces[i].font);
+        FcStrFree(fb_faces[i].file);
     }
+    free(fb_faces);
+    fb_faces = NULL;
+    fb_faces_len = fb_faces_cap = 0;
+    perf.fallback_faces = 0;
 }
 
 static uint8_t font_style_key(uint16_t attrs) {
@@ -335,7 +366,7 @@ static uint8_t font_style_key(uint16_t attrs) {
 }
 
 /* Returns 1 if (cp,style) is in the hash table (font_out set, may be NULL for
- * a cached miss), 0 if not yet tried. */
+ * a cached miss), 2 if it is still being resolved, 0 if not yet tried. */
 static int find_glyph_fallback(utf8proc_int32_t cp, uint8_t style, XftFont **font_out) {
     uint32_t k = ((uint32_t)cp ^ ((uint32_t)cp >> 8)) * 2654435769u ^ (uint32_t)style;
     unsigned slot = (k >> 21) & GF_HASH_MASK;
@@ -345,43 +376,129 @@ static int find_glyph_fallback(utf8proc_int32_t cp, uint8_t style, XftFont **fon
         if (!gf_hash[s].occupied) { *font_out = NULL; return 0; }
         if (gf_hash[s].cp == cp && gf_hash[s].style == style) {
             *font_out = gf_hash[s].font;
-            return 1;
+            return gf_hash[s].pending ? 2 : 1;
         }
     }
     *font_out = NULL;
     return 0;
 }
 
-static void insert_glyph_fallback(utf8proc_int32_t cp, uint8_t style, XftFont *font) {
+static void insert_glyph_fallback(utf8proc_int32_t cp, uint8_t style, XftFont *font, int pending);
+
+/* Keep only the lookups still in flight (keep_pending) or only the
+ * resolved ones, and rehash them. */
+static void rebuild_glyph_fallback(int keep_pending) {
+    static GfEntry keep[GF_HASH_LIMIT];
+    int n = 0;
+
+    for (int i = 0; i < GF_HASH_SIZE && n < GF_HASH_LIMIT; i++) {
+        if (gf_hash[i].occupied && gf_hash[i].pending == keep_pending)
+            keep[n++] = gf_hash[i];
+    }
+    memset(gf_hash, 0, sizeof(gf_hash));
+    gf_count = 0;
+    for (int i = 0; i < n; i++)
+        insert_glyph_fallback(keep[i].cp, keep[i].style, keep[i].font, keep[i].pending);
+}
+
+static void insert_glyph_fallback(utf8proc_int32_t cp, uint8_t style, XftFont *font, int pending) {
     uint32_t k = ((uint32_t)cp ^ ((uint32_t)cp >> 8)) * 2654435769u ^ (uint32_t)style;
     unsigned slot = (k >> 21) & GF_HASH_MASK;
     unsigned probe;
     for (probe = 0; probe < GF_HASH_SIZE; probe++) {
         unsigned s = (slot + probe) & GF_HASH_MASK;
+        if (!gf_hash[s].occupied && gf_count >= GF_HASH_LIMIT) {
+            rebuild_glyph_fallback(1);
+            insert_glyph_fallback(cp, style, font, pending);
+            return;
+        }
         if (!gf_hash[s].occupied || (gf_hash[s].cp == cp && gf_hash[s].style == style)) {
+            if (!gf_hash[s].occupied)
+                gf_count++;
             gf_hash[s].cp       = cp;
             gf_hash[s].style    = style;
             gf_hash[s].font     = font;
             gf_hash[s].occupied = 1;
+            gf_hash[s].pending  = (uint8_t)pending;
             return;
         }
     }
-    /*
-     * Table full: skip caching.
-     * Do not close FONT here because caller may still draw with it.
-     * (st uses a growable fallback cache; this fixed-size table must
-     * preserve correctness over aggressive reclamation.)
-     */
 }
 
+/* A cached face of this style that has cp, or NULL. */
+static XftFont *fallback_face_covering(uint8_t style, utf8proc_int32_t cp) {
+    for (int i = 0; i < fb_faces_len; i++) {
+        if (fb_faces[i].style == style &&
+            FcCharSetHasChar(fb_faces[i].font->charset, (FcChar32)cp))
+            return fb_faces[i].font;
+    }
+    return NULL;
+}
+
+/* The face for a matched pattern (takes ownership of pattern), opened once
+ * per file, index, style and size; NULL unless it really has cp. */
+static XftFont *open_fallback_face(Display *display, uint8_t style, FcPattern *pattern,
+                                   utf8proc_int32_t cp) {
+    FcChar8 *file = NULL;
+    int index = 0;
+    double size = 0;
+    XftFont *font;
+
+    if (!display) {
+        FcPatternDestroy(pattern);
+        return NULL;
+    }
+    FcPatternGetString(pattern, FC_FILE, 0, &file);
+    FcPatternGetInteger(pattern, FC_INDEX, 0, &index);
+    FcPatternGetDouble(pattern, FC_PIXEL_SIZE, 0, &size);
+    for (int i = 0; file && i < fb_faces_len; i++) {
+        FallbackFace *f = &fb_faces[i];
+
+        if (f->style == style && f->index == index && f->size == size &&
+            strcmp((const char *)f->file, (const char *)file) == 0) {
+            FcPatternDestroy(pattern);
+            return FcCharSetHasChar(f->font->charset, (FcChar32)cp) ? f->font : NULL;
+        }
+    }
+
+    if (fb_faces_len == fb_faces_cap) {
+        int cap = fb_faces_cap ? fb_faces_cap * 2 : 16;
+        FallbackFace *grown = realloc(fb_faces, (size_t)cap * sizeof(*grown));
+
+        if (!grown) {
+            FcPatternDestroy(pattern);
+            return NULL;
+        }
+        fb_faces = grown;
+        fb_faces_cap = cap;
+    }
+    file = file ? FcStrCopy(file) : NULL;
+    font = XftFontOpenPattern(display, pattern);
+    if (!font || !file || !font->charset) {
+        if (font)
+            XftFontClose(display, font);
+        else
+            FcPatternDestroy(pattern);
+        FcStrFree(file);
+        return NULL;
+    }
+    fb_faces[fb_faces_len].file = file;
+    fb_faces[fb_faces_len].index = index;
+    fb_faces[fb_faces_len].style = style;
+    fb_faces[fb_faces_len].size = size;
+    fb_faces[fb_faces_len].font = font;
+    fb_faces_len++;
+    perf.fallback_faces = (unsigned long)fb_faces_len;
+
+    /* Kept even when cp is missing: other code points may still use it. */
+    return FcCharSetHasChar(font->charset, (FcChar32)cp) ? font : NULL;
+}
+
+/* Synchronous path, used only when the resolver thread could not start. */
 static XftFont *load_glyph_fallback(Display *display, uint8_t style, utf8proc_int32_t cp) {
     FcPattern *base_pat;
-    FcPattern *fcpattern;
     FcPattern *fontpattern;
-    FcCharSet *fccharset;
-    FcFontSet *fcsets[1];
     FcResult fcres;
-    XftFont *font = NULL;
 
     if (!display || cp < 0)
         return NULL;
@@ -398,41 +515,75 @@ static XftFont *load_glyph_fallback(Display *display, uint8_t style, utf8proc_in
     if (!g_fc_set[style])
         return NULL;
 
-    fcpattern = FcPatternDuplicate(base_pat);
-    if (!fcpattern)
+    fontpattern = font_resolve_match(base_pat, g_fc_set[style], (uint32_t)cp);
+    if (!fontpattern)
         return NULL;
 
-    fccharset = FcCharSetCreate();
-    if (!fccharset) {
-        FcPatternDestroy(fcpattern);
-        return NULL;
-    }
+    return open_fallback_face(display, style, fontpattern, cp);
+}
 
-    FcCharSetAddChar(fccharset, (FcChar32)cp);
-    FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
-    FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
-    FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
-    FcDefaultSubstitute(fcpattern);
+/* Rows drawn with a placeholder while their glyph is being resolved. */
+static uint8_t *font_wait_rows;
+static int font_wait_cap;
 
-    fcsets[0] = g_fc_set[style];
-    fontpattern = FcFontSetMatch(NULL, fcsets, 1, fcpattern, &fcres);
+static void note_font_wait(int row) {
+    if (row < 0 || row >= term_rows)
+        return;
+    if (row >= font_wait_cap) {
+        uint8_t *grown = realloc(font_wait_rows, (size_t)term_rows);
+        if (!grown)
+            return;
+        memset(grown + font_wait_cap, 0, (size_t)(term_rows - font_wait_cap));
+        font_wait_rows = grown;
+        font_wait_cap = term_rows;
+    }
+    font_wait_rows[row] = 1;
+}
 
-    FcPatternDestroy(fcpattern);
-    FcCharSetDestroy(fccharset);
+static void fallback_resolved(uint32_t cp, uint8_t style, FcPattern *match, void *ctx) {
+    XftFont *font = NULL;
 
-    if (!fontpattern)
-        return NULL;
+    (void)ctx;
+    /* Only fill the placeholder; a full table never got one. */
+    if (find_glyph_fallback((utf8proc_int32_t)cp, style, &font) != 2) {
+        if (match)
+            FcPatternDestroy(match);
+        return;
+    }
+    if (match)
+        font = open_fallback_face(global_display, style, match, (utf8proc_int32_t)cp);
+    insert_glyph_fallback((utf8proc_int32_t)cp, style, font, 0);
+}
 
-    font = XftFontOpenPattern(display, fontpattern);
-    if (!font)
-        return NULL;
+int draw_poll_fonts(void) {
+    int n = font_resolve_drain(fallback_resolved, NULL);
 
-    if (XftCharIndex(display, font, (FcChar32)cp) == 0) {
-        XftFontClose(display, font);
-        return NULL;
+    if (n > 0 && font_wait_rows) {
+        int rows = font_wait_cap < term_rows ? font_wait_cap : term_rows;
+
+        for (int r = 0; r < rows; r++) {
+            if (font_wait_rows[r])
+                terminal_mark_cells_dirty(r, 0, term_cols - 1);
+        }
+        memset(font_wait_rows, 0, (size_t)font_wait_cap);
     }
+    return n;
+}
 
-    return font;
+int draw_font_fd(void) {
+    return font_resolve_fd();
+}
+
+/* The fallback styles' base patterns, as pattern_for_glyph_fallback() maps them. */
+static void start_font_resolver(void) {
+    FcPattern *pats[FONT_RESOLVE_STYLES];
+
+    for (int s = 0; s < FONT_RESOLVE_STYLES; s++)
+        pats[s] = pattern_for_glyph_fallback((uint8_t)s);
+    if (font_resolve_running())
+        font_resolve_set_patterns(pats);
+    else if (font_resolve_start(pats) != 0)
+        fprintf(stderr, "cupidterminal: font resolver thread unavailable, matching inline\n");
 }
 
 static unsigned short
@@ -571,9 +722,13 @@ static XftColor *get_xft_color(Display *d, Window w, uint32_t logical_color, int
         unsigned probe;
         for (probe = 0; probe < TC_HASH_SIZE; probe++) {
             unsigned s = (slot + probe) & TC_HASH_MASK;
-            if (table[s].key == logical_color) return &table[s].color;
+            if (table[s].key == logical_color) {
+                perf.color_hits++;
+                return &table[s].color;
+            }
             if (table[s].key == 0) {
                 XRenderColor rc = get_xrender_color(logical_color, is_bg, is_faint);
+                perf.color_misses++;
                 if (XftColorAllocValue(d, DefaultVisual(d, DefaultScreen(d)),
                         DefaultColormap(d, DefaultScreen(d)), &rc, &table[s].color)) {
                     table[s].key = logical_color;
@@ -599,6 +754,9 @@ static XftColor *get_xft_color(Display *d, Window w, uint32_t logical_color, int
                 return &xft_color_fg;
             }
             faint_color_allocated[idx] = 1;
+            perf.color_misses++;
+        } else {
+            perf.color_hits++;
         }
         return &faint_color_cache[idx];
     } else {
@@ -609,11 +767,44 @@ static XftColor *get_xft_color(Display *d, Window w, uint32_t logical_color, int
                 return is_bg ? &xft_color_bg : &xft_color_fg;
             }
             color_allocated[idx] = 1;
+            perf.color_misses++;
+        } else {
+            perf.color_hits++;
         }
         return &color_cache[idx];
     }
 }
 
+/* A copy of pattern with config and Xft defaults applied, ready to match. */
+static FcPattern *configure_pattern(Display *display, FcPattern *pattern) {
+    FcPattern *configured = FcPatternDuplicate(pattern);
+
+    if (!configured)
+        return NULL;
+    FcConfigSubstitute(NULL, configured, FcMatchPattern);
+    XftDefaultSubstitute(display, DefaultScreen(display), configured);
+    return configured;
+}
+
+/* The matching + FreeType load step, the expensive part of opening a face. */
+static int open_configured_font(Display *display, FcPattern *configured, XftFont **out_font) {
+    FcPattern *match;
+    FcResult result;
+
+    *out_font = NULL;
+    if (!configured)
+        return -1;
+    match = FcFontMatch(NULL, configured, &result);
+    if (!match)
+        return -1;
+    *out_font = XftFontOpenPattern(display, match);
+    if (!*out_font) {
+        FcPatternDestroy(match);
+        return -1;
+    }
+    return 0;
+}
+
 /*
  * Like st's xloadfont: keep the configured (pre-match) pattern for FcFontSort /
  * FcFontSetMatch.  If out_configured_keep is NULL, the configured pattern is freed.
@@ -621,30 +812,15 @@ static XftColor *get_xft_color(Display *d, Window w, uint32_t logical_color, int
 static int open_xft_font(Display *display, FcPattern *pattern, XftFont **out_font,
                          FcPattern **out_configured_keep) {
     FcPattern *configured;
-    FcPattern *match;
-    FcResult result;
 
     *out_font = NULL;
     if (out_configured_keep)
         *out_configured_keep = NULL;
 
-    configured = FcPatternDuplicate(pattern);
-    if (!configured)
-        return -1;
-
-    FcConfigSubstitute(NULL, configured, FcMatchPattern);
-    XftDefaultSubstitute(display, DefaultScreen(display), configured);
-
-    match = FcFontMatch(NULL, configured, &result);
-    if (!match) {
-        FcPatternDestroy(configured);
-        return -1;
-    }
-
-    *out_font = XftFontOpenPattern(display, match);
-    if (!*out_font) {
-        FcPatternDestroy(configured);
-        FcPatternDestroy(match);
+    configured = configure_pattern(display, pattern);
+    if (open_configured_font(display, configured, out_font) != 0) {
+        if (configured)
+            FcPatternDestroy(configured);
         return -1;
     }
 
@@ -655,22 +831,40 @@ static int open_xft_font(Display *display, FcPattern *pattern, XftFont **out_fon
     return 0;
 }
 
+static XftFont *open_emoji_font(Display *display, double size, XftFont *fallback) {
+    char emoji_buf[160];
+    FcPattern *epat;
+    FcResult eres;
+    XftFont *ne = NULL;
+    int psz = (int)(size > 0.0 ? size + 0.5 : 12);
+
+    if (psz < 6) psz = 6;
+    if (psz > 256) psz = 256;
+    snprintf(emoji_buf, sizeof(emoji_buf), "Noto Color Emoji:pixelsize=%d", psz);
+    epat = FcNameParse((const FcChar8 *)emoji_buf);
+    if (epat) {
+        FcConfigSubstitute(NULL, epat, FcMatchPattern);
+        XftDefaultSubstitute(display, DefaultScreen(display), epat);
+        ne = XftFontOpenPattern(display, FcFontMatch(NULL, epat, &eres));
+        FcPatternDestroy(epat);
+    }
+    return ne ? ne : fallback;
+}
+
 /*
- * Load primary + bold/italic/bold-italic + emoji from a full Fontconfig name string,
- * mirroring st's xloadfonts / xloadfont (st/x.c). fontsize_override > 1 forces FC_PIXEL_SIZE.
- * Returns 0 on success; on failure frees any opened fonts and returns -1.
+ * Load the primary face from a full Fontconfig name string, mirroring st's
+ * xloadfonts / xloadfont (st/x.c). fontsize_override > 1 forces FC_PIXEL_SIZE.
+ * The bold/italic/bold-italic patterns are prepared (for fallback matching
+ * too) but their faces, like the emoji face, open on first use: see
+ * style_font() and emoji_font().  Returns 0 on success, -1 on failure.
  */
 static int load_font_set(Display *display, const char *fontstr, double fontsize_override,
-                         XftFont **out_reg, XftFont **out_bold, XftFont **out_italic,
-                         XftFont **out_bold_italic, XftFont **out_emoji) {
+                         XftFont **out_reg) {
     FcPattern *pattern = NULL;
     double fontval;
-    XftFont *nf = NULL, *nb = NULL, *ni = NULL, *nbi = NULL, *ne = NULL;
-    char emoji_buf[160];
-    FcPattern *epat;
-    FcResult eres;
+    XftFont *nf = NULL;
 
-    *out_reg = *out_bold = *out_italic = *out_bold_italic = *out_emoji = NULL;
+    *out_reg = NULL;
 
     if (!fontstr || !fontstr[0])
         fontstr = "monospace:pixelsize=12";
@@ -721,24 +915,15 @@ static int load_font_set(Display *display, const char *fontstr, double fontsize_
         /* Italic — same mutation order as st xloadfonts */
         FcPatternDel(pattern, FC_SLANT);
         FcPatternAddInteger(pattern, FC_SLANT, FC_SLANT_ITALIC);
-        if (open_xft_font(display, pattern, &ni, &pat_italic) != 0) {
-            ni = nf;
-            pat_italic = NULL;
-        }
+        pat_italic = configure_pattern(display, pattern);
 
         FcPatternDel(pattern, FC_WEIGHT);
         FcPatternAddInteger(pattern, FC_WEIGHT, FC_WEIGHT_BOLD);
-        if (open_xft_font(display, pattern, &nbi, &pat_bi) != 0) {
-            nbi = (ni != nf) ? ni : nf;
-            pat_bi = NULL;
-        }
+        pat_bi = configure_pattern(display, pattern);
 
         FcPatternDel(pattern, FC_SLANT);
         FcPatternAddInteger(pattern, FC_SLANT, FC_SLANT_ROMAN);
-        if (open_xft_font(display, pattern, &nb, &pat_bold) != 0) {
-            nb = nf;
-            pat_bold = NULL;
-        }
+        pat_bold = configure_pattern(display, pattern);
 
         FcPatternDestroy(pattern);
         pattern = NULL;
@@ -751,27 +936,7 @@ static int load_font_set(Display *display, const char *fontstr, double fontsize_
         g_fc_pat[3] = pat_bi;
     }
 
-    {
-        int psz = (int)(usedfontsize > 0.0 ? usedfontsize + 0.5 : 12);
-        if (psz < 6) psz = 6;
-        if (psz > 256) psz = 256;
-        snprintf(emoji_buf, sizeof(emoji_buf), "Noto Color Emoji:pixelsize=%d", psz);
-        epat = FcNameParse((const FcChar8 *)emoji_buf);
-        if (epat) {
-            FcConfigSubstitute(NULL, epat, FcMatchPattern);
-            XftDefaultSubstitute(display, DefaultScreen(display), epat);
-            ne = XftFontOpenPattern(display, FcFontMatch(NULL, epat, &eres));
-            FcPatternDestroy(epat);
-        }
-        if (!ne)
-            ne = nf;
-    }
-
     *out_reg = nf;
-    *out_bold = nb;
-    *out_italic = ni;
-    *out_bold_italic = nbi;
-    *out_emoji = ne;
     return 0;
 }
 
@@ -827,9 +992,148 @@ static void recompute_cell_metrics(Display *display) {
     }
 }
 
+/*
+ * Font sets zoomed away from, most recently used first.  Each keeps its
+ * faces, fallback patterns and sorted lists, fallback faces and glyph map,
+ * and cell metrics, so returning to a size swaps them back in without
+ * touching fontconfig or FreeType.  At most fontsetcache are kept; the
+ * current set lives in the globals above.
+ */
+typedef struct {
+    double size;
+    double default_size;
+    XftFont *reg, *bold, *italic, *bold_italic, *emoji;
+    FcPattern *pat[4];
+    FcFontSet *set[4];
+    GfEntry *gf;
+    int gf_count;
+    FallbackFace *faces;
+    int faces_len, faces_cap;
+    int cell_w, cell_h;
+} FontSetSlot;
+
+#define FONT_SET_SLOTS_MAX 16
+static FontSetSlot font_set_slots[FONT_SET_SLOTS_MAX + 1];
+static int font_set_slots_len;
+/* Size the current set was loaded for; xft_zoom() moves usedfontsize first. */
+static double current_set_size;
+
+static int font_set_slots_cap(void) {
+    if (fontsetcache < 0)
+        return 0;
+    return fontsetcache < FONT_SET_SLOTS_MAX ? fontsetcache : FONT_SET_SLOTS_MAX;
+}
+
+static void free_font_set_slot(Display *display, FontSetSlot *slot) {
+    for (int i = 0; i < slot->faces_len; i++) {
+        XftFontClose(display, slot->faces[i].font);
+        FcStrFree(slot->faces[i].file);
+    }
+    free(slot->faces);
+    free(slot->gf);
+    for (int i = 0; i < 4; i++) {
+        if (slot->set[i])
+            FcFontSetDestroy(slot->set[i]);
+        if (slot->pat[i])
+            FcPatternDestroy(slot->pat[i]);
+    }
+    free_font_set(display, slot->reg, slot->bold, slot->italic, slot->bold_italic, slot->emoji);
+    memset(slot, 0, sizeof(*slot));
+}
+
+/* Move the current set to the front of the cache; the globals are left
+ * empty for load_font_set() or restore_font_set().  The cache may hold one
+ * set over its limit until trim_font_set_cache(). */
+static void stash_font_set(void) {
+    FontSetSlot slot;
+
+    memset(&slot, 0, sizeof(slot));
+    slot.size = current_set_size;
+    slot.default_size = defaultfontsize;
+    slot.reg = xft_font;
+    slot.bold = xft_font_bold;
+    slot.italic = xft_font_italic;
+    slot.bold_italic = xft_font_bold_italic;
+    slot.emoji = xft_font_emoji;
+    memcpy(slot.pat, g_fc_pat, sizeof(slot.pat));
+    memcpy(slot.set, g_fc_set, sizeof(slot.set));
+    slot.faces = fb_faces;
+    slot.faces_len = fb_faces_len;
+    slot.faces_cap = fb_faces_cap;
+    slot.cell_w = g_cell_w;
+    slot.cell_h = g_cell_h;
+
+    /* Lookups in flight are for this set's patterns and will be dropped. */
+    rebuild_glyph_fallback(0);
+    slot.gf = malloc(sizeof(gf_hash));
+    if (slot.gf) {
+        memcpy(slot.gf, gf_hash, sizeof(gf_hash));
+        slot.gf_count = gf_count;
+    }
+
+    xft_font = xft_font_bold = xft_font_italic = xft_font_bold_italic = xft_font_emoji = NULL;
+    memset(g_fc_pat, 0, sizeof(g_fc_pat));
+    memset(g_fc_set, 0, sizeof(g_fc_set));
+    fb_faces = NULL;
+    fb_faces_len = fb_faces_cap = 0;
+    memset(gf_hash, 0, sizeof(gf_hash));
+    gf_count = 0;
+    perf.fallback_faces = 0;
+
+    if (font_set_slots_len > FONT_SET_SLOTS_MAX)
+        free_font_set_slot(global_display, &font_set_slots[--font_set_slots_len]);
+    memmove(&font_set_slots[1], &font_set_slots[0],
+            (size_t)font_set_slots_len * sizeof(font_set_slots[0]));
+    font_set_slots[0] = slot;
+    font_set_slots_len++;
+}
+
+/* Make the cached set for size current.  Returns 0, or -1 if not cached. */
+static int restore_font_set(double size) {
+    FontSetSlot slot;
+    int i;
+
+    for (i = 0; i < font_set_slots_len; i++) {
+        if (font_set_slots[i].size == size)
+            break;
+    }
+    if (i == font_set_slots_len)
+        return -1;
+    slot = font_set_slots[i];
+    memmove(&font_set_slots[i], &font_set_slots[i + 1],
+            (size_t)(font_set_slots_len - i - 1) * sizeof(font_set_slots[0]));
+    font_set_slots_len--;
+
+    usedfontsize = current_set_size = slot.size;
+    defaultfontsize = slot.default_size;
+    xft_font = slot.reg;
+    xft_font_bold = slot.bold;
+    xft_font_italic = slot.italic;
+    xft_font_bold_italic = slot.bold_italic;
+    xft_font_emoji = slot.emoji;
+    memcpy(g_fc_pat, slot.pat, sizeof(g_fc_pat));
+    memcpy(g_fc_set, slot.set, sizeof(g_fc_set));
+    fb_faces = slot.faces;
+    fb_faces_len = slot.faces_len;
+    fb_faces_cap = slot.faces_cap;
+    if (slot.gf)
+        memcpy(gf_hash, slot.gf, sizeof(gf_hash));
+    gf_count = slot.gf_count;   /* 0 with no copy: the map is rebuilt on use */
+    free(slot.gf);
+    g_cell_w = slot.cell_w;
+    g_cell_h = slot.cell_h;
+    perf.fallback_faces = (unsigned long)fb_faces_len;
+    return 0;
+}
+
+static void trim_font_set_cache(Display *display, int keep) {
+    while (font_set_slots_len > keep)
+        free_font_set_slot(display, &font_set_slots[--font_set_slots_len]);
+}
+
 // Initialize Xft for Unicode and emoji support
 void initialize_xft(Display *display, Window window) {
-    XftFont *nf, *nb, *ni, *nbi, *ne;
+    XftFont *nf;
 
     global_display = display;
     global_window = window;
@@ -845,10 +1149,9 @@ void initialize_xft(Display *display, Window window) {
     }
 
     /* Full Fontconfig string + size from pattern (st xloadfonts with fontsize 0). */
-    if (load_font_set(display, FONT, 0.0, &nf, &nb, &ni, &nbi, &ne) != 0) {
+    if (load_font_set(display, FONT, 0.0, &nf) != 0) {
         fprintf(stderr, "cupidterminal: can't open font \"%s\", trying DejaVu Sans Mono\n", FONT);
-        if (load_font_set(display, "DejaVu Sans Mono:pixelsize=12:antialias=true", 12.0,
-                          &nf, &nb, &ni, &nbi, &ne) != 0) {
+        if (load_font_set(display, "DejaVu Sans Mono:pixelsize=12:antialias=true", 12.0, &nf) != 0) {
             fprintf(stderr, "cupidterminal: failed to load fallback font.\n");
             exit(EXIT_FAILURE);
         }
@@ -857,10 +1160,8 @@ void initialize_xft(Display *display, Window window) {
     }
 
     xft_font = nf;
-    xft_font_bold = nb;
-    xft_font_italic = ni;
-    xft_font_bold_italic = nbi;
-    xft_font_emoji = ne;
+    current_set_size = usedfontsize;
+    start_font_resolver();
 
     // Allocate default foreground/background with st-compatible indices.
     XRenderColor rc_white = get_xrender_color(COLOR_DEFAULT_FG, 0, 0);
@@ -888,9 +1189,81 @@ void initialize_xft(Display *display, Window window) {
     recompute_cell_metrics(display);
 
     /* IMPORTANT: initialize with the logic state */
-    initialize_terminal_state(&term_state);
+    terminal_reset(&term_default);
+}
+
+/* Match pattern as a window would (minus Xft's display defaults) and sort
+ * its fallback list; the results are dropped, the caches they filled stay. */
+static void prewarm_pattern(FcPattern *pattern) {
+    FcPattern *configured = FcPatternDuplicate(pattern);
+    FcPattern *match;
+    FcFontSet *sorted;
+    FcResult res;
+
+    if (!configured)
+        return;
+    FcConfigSubstitute(NULL, configured, FcMatchPattern);
+    FcDefaultSubstitute(configured);
+    match = FcFontMatch(NULL, configured, &res);
+    if (match)
+        FcPatternDestroy(match);
+    sorted = FcFontSort(NULL, configured, FcTrue, NULL, &res);
+    if (sorted)
+        FcFontSetDestroy(sorted);
+    FcPatternDestroy(configured);
+}
+
+/*
+ * --daemon, before the first fork(): repeat the fontconfig work of
+ * load_font_set() and the fallback resolver for the configured font, so
+ * every window inherits the loaded configuration and the cache pages it
+ * touched.  All four styles are matched and sorted (sorting reads the
+ * charset of every installed face), and so is the emoji face.  Opening the
+ * faces needs the window's display and is left to the child.
+ */
+void draw_prewarm_fonts(void) {
+    const char *fontstr = (FONT && FONT[0]) ? FONT : "monospace:pixelsize=12";
+    FcPattern *pattern;
+    double size;
+
+    if (!FcInit())
+        return;
+    if (fontstr[0] == '-')
+        pattern = XftXlfdParse(fontstr, False, False);
+    else
+        pattern = FcNameParse((const FcChar8 *)fontstr);
+    if (!pattern)
+        return;
+    if (FcPatternGetDouble(pattern, FC_PIXEL_SIZE, 0, &size) != FcResultMatch &&
+        FcPatternGetDouble(pattern, FC_SIZE, 0, &size) != FcResultMatch) {
+        size = 12.0;
+        FcPatternAddDouble(pattern, FC_PIXEL_SIZE, size);
+    }
 
-    /* Open XIM (or register a callback for when IM becomes available) */
+    /* Regular, italic, bold italic, bold: the order load_font_set() uses. */
+    prewarm_pattern(pattern);
+    FcPatternDel(pattern, FC_SLANT);
+    FcPatternAddInteger(pattern, FC_SLANT, FC_SLANT_ITALIC);
+    prewarm_pattern(pattern);
+    FcPatternDel(pattern, FC_WEIGHT);
+    FcPatternAddInteger(pattern, FC_WEIGHT, FC_WEIGHT_BOLD);
+    prewarm_pattern(pattern);
+    FcPatternDel(pattern, FC_SLANT);
+    FcPatternAddInteger(pattern, FC_SLANT, FC_SLANT_ROMAN);
+    prewarm_pattern(pattern);
+    FcPatternDestroy(pattern);
+
+    pattern = FcNameParse((const FcChar8 *)"Noto Color Emoji");
+    if (pattern) {
+        prewarm_pattern(pattern);
+        FcPatternDestroy(pattern);
+    }
+}
+
+/* Open XIM (or register a callback for when IM becomes available).  Called
+ * once the first frame is on screen: keys typed before then go through
+ * XLookupString. */
+void draw_open_im(Display *display) {
     if (!XSupportsLocale()) {
         fprintf(stderr, "warning: X does not support locale\n");
     } else {
@@ -909,31 +1282,35 @@ void initialize_xft(Display *display, Window window) {
     }
 }
 
+static void clear_emoji_cache(Display *display);
+
 static int xft_reload_fonts(Display *display) {
     double sz = usedfontsize;
-    XftFont *nf, *nb, *ni, *nbi, *ne;
-    XftFont *of = xft_font, *ob = xft_font_bold, *oi = xft_font_italic,
-            *obi = xft_font_bold_italic, *oe = xft_font_emoji;
+    double old_sz = current_set_size;
+    XftFont *nf;
 
     if (sz < minfontsize) sz = minfontsize;
     if (sz > maxfontsize) sz = maxfontsize;
 
-    clear_glyph_fallback_cache(display);
-
-    /* st xloadfonts: fontsize > 1 forces FC_PIXEL_SIZE */
-    if (load_font_set(display, FONT, sz, &nf, &nb, &ni, &nbi, &ne) != 0)
-        return -1;
-
-    xft_font = nf;
-    xft_font_bold = nb;
-    xft_font_italic = ni;
-    xft_font_bold_italic = nbi;
-    xft_font_emoji = ne;
+    /* Park the current set first: a cached size is just swapped back in,
+     * and a failed load restores the set it replaced. */
+    stash_font_set();
+    clear_emoji_cache(display);
+    if (restore_font_set(sz) != 0) {
+        /* st xloadfonts: fontsize > 1 forces FC_PIXEL_SIZE */
+        if (load_font_set(display, FONT, sz, &nf) != 0) {
+            restore_font_set(old_sz);
+            return -1;
+        }
 
-    free_font_set(display, of, ob, oi, obi, oe);
+        xft_font = nf;
+        current_set_size = usedfontsize;
+        recompute_cell_metrics(display);
+    }
+    trim_font_set_cache(display, font_set_slots_cap());
+    start_font_resolver();
 
-    recompute_cell_metrics(display);
-    draw_full_refresh = 1;
+    render_invalidate();
     mark_all_rows_dirty_local();
     return 0;
 }
@@ -958,8 +1335,14 @@ void xft_zoom_reset(Display *display, Window window) {
 void cleanup_xft(void) {
     if (g_xic) { XDestroyIC(g_xic); g_xic = NULL; }
     if (g_xim) { XCloseIM(g_xim);   g_xim = NULL; }
+    font_resolve_stop();
+    trim_font_set_cache(global_display, 0);
     clear_glyph_fallback_cache(global_display);
+    clear_emoji_cache(global_display);
     fc_fallback_teardown();
+    free(font_wait_rows);
+    font_wait_rows = NULL;
+    font_wait_cap = 0;
     if (xft_draw_buf) { XftDrawDestroy(xft_draw_buf); xft_draw_buf = NULL; }
     if (back_pixmap != None && global_display) {
         XFreePixmap(global_display, back_pixmap);
@@ -985,17 +1368,45 @@ void cleanup_xft(void) {
     }
 }
 
-static XftFont *font_for_cell(uint16_t attrs, utf8proc_int32_t cp) {
-    XftFont *font_to_use = xft_font;
-    uint8_t style = font_style_key(attrs);
+/*
+ * Only the regular face is opened with the font set; the others cost an
+ * FcFontMatch and a FreeType load each, so they wait until a cell needs
+ * them.  A face that fails to open falls back as in st (bold-italic to
+ * italic, the rest to regular).  pat is g_fc_pat[] order.
+ */
+static XftFont *lazy_face(XftFont **face, int pat) {
+    if (!*face) {
+        TRACE_BEGIN(t_face);
+        if (open_configured_font(global_display, g_fc_pat[pat], face) != 0)
+            *face = (pat == 3) ? lazy_face(&xft_font_italic, 2) : xft_font;
+        TRACE_END(t_face, "open face", "font", pat);
+    }
+    return *face;
+}
+
+static XftFont *style_font(uint16_t attrs) {
+    if ((attrs & ATTR_BOLD) && (attrs & ATTR_ITALIC))
+        return lazy_face(&xft_font_bold_italic, 3);
+    if (attrs & ATTR_BOLD)
+        return lazy_face(&xft_font_bold, 1);
+    if (attrs & ATTR_ITALIC)
+        return lazy_face(&xft_font_italic, 2);
+    return xft_font;
+}
 
-    if ((attrs & ATTR_BOLD) && (attrs & ATTR_ITALIC)) {
-        font_to_use = xft_font_bold_italic ? xft_font_bold_italic : xft_font;
-    } else if (attrs & ATTR_BOLD) {
-        font_to_use = xft_font_bold ? xft_font_bold : xft_font;
-    } else if (attrs & ATTR_ITALIC) {
-        font_to_use = xft_font_italic ? xft_font_italic : xft_font;
+static XftFont *emoji_font(void) {
+    if (!xft_font_emoji) {
+        TRACE_BEGIN(t_face);
+        xft_font_emoji = open_emoji_font(global_display, current_set_size, xft_font);
+        TRACE_END(t_face, "open face", "font", 4);
     }
+    return xft_font_emoji;
+}
+
+/* row is the screen row being drawn, redrawn once a pending face is ready. */
+static XftFont *font_for_cell(uint16_t attrs, utf8proc_int32_t cp, int row) {
+    XftFont *font_to_use = style_font(attrs);
+    uint8_t style = font_style_key(attrs);
 
     /*
      * Prefer style font first. If it lacks the glyph, fall back to emoji font,
@@ -1009,7 +1420,7 @@ static XftFont *font_for_cell(uint16_t attrs, utf8proc_int32_t cp) {
         if (font_to_use && XftCharIndex(global_display, font_to_use, (FcChar32)cp) != 0) {
             return font_to_use;
         }
-        if (xft_font_emoji && xft_font_emoji != font_to_use &&
+        if (emoji_font() != font_to_use &&
             XftCharIndex(global_display, xft_font_emoji, (FcChar32)cp) != 0) {
             return xft_font_emoji;
         }
@@ -1017,15 +1428,41 @@ static XftFont *font_for_cell(uint16_t attrs, utf8proc_int32_t cp) {
         {
             XftFont *cached;
             int in_cache = find_glyph_fallback(cp, style, &cached);
+            if (in_cache == 2) {
+                note_font_wait(row);
+                return font_to_use;
+            }
             if (in_cache) {
+                perf.glyph_hits++;
                 return cached ? cached : font_to_use; /* cached miss → use default */
             }
+            /* A face opened for another code point may already cover it. */
+            cached = fallback_face_covering(style, cp);
+            if (cached) {
+                perf.glyph_hits++;
+                insert_glyph_fallback(cp, style, cached, 0);
+                return cached;
+            }
+        }
+
+        /* Not cached yet: match in the background and draw with the style
+         * font meanwhile.  A full queue is retried on a later frame. */
+        if (font_resolve_running()) {
+            if (font_resolve_request((uint32_t)cp, style)) {
+                perf.glyph_misses++;
+                insert_glyph_fallback(cp, style, NULL, 1);
+            }
+            note_font_wait(row);
+            return font_to_use;
         }
 
-        /* Not cached yet: FcFontSetMatch like st (not FcFontMatch on the matched face only). */
+        /* FcFontSetMatch like st (not FcFontMatch on the matched face only). */
         {
+            TRACE_BEGIN(t_font);
             XftFont *fallback = load_glyph_fallback(global_display, style, cp);
-            insert_glyph_fallback(cp, style, fallback); /* caches both hits and misses */
+            TRACE_END(t_font, "font fallback", "font", cp);
+            perf.glyph_misses++;
+            insert_glyph_fallback(cp, style, fallback, 0); /* caches both hits and misses */
             if (fallback) return fallback;
         }
     }
@@ -1033,100 +1470,29 @@ static XftFont *font_for_cell(uint16_t attrs, utf8proc_int32_t cp) {
     return font_to_use;
 }
 
-static void resolve_cell_colors(uint32_t in_fg, uint32_t in_bg, uint16_t attrs, int selected,
-                                int hide_blink,
-                                uint32_t *out_fg, uint32_t *out_bg) {
-    uint32_t fg = in_fg;
-    uint32_t bg = in_bg;
-
-    /* st behavior: bold brightens basic ANSI colors 0-7 when faint is not active. */
-    if ((attrs & ATTR_BOLD) && !(attrs & ATTR_FAINT) && fg <= 7) {
-        fg += 8;
-    }
-
-    /* DECSCNM: mirror st behavior.
-       - swap defaults
-       - invert resolved RGB value for all non-default colors */
-    if (term_state.screen_reverse) {
-        if (fg == COLOR_DEFAULT_FG) {
-            fg = COLOR_DEFAULT_BG;
-        } else {
-            XRenderColor rc = get_xrender_color(fg, 0, 0);
-            uint32_t rgb = ((uint32_t)(rc.red >> 8) << 16) |
-                           ((uint32_t)(rc.green >> 8) << 8) |
-                           (uint32_t)(rc.blue >> 8);
-            fg = COLOR_TRUE_RGB_BASE | ((~rgb) & 0x00FFFFFFu);
-        }
-
-        if (bg == COLOR_DEFAULT_BG) {
-            bg = COLOR_DEFAULT_FG;
-        } else {
-            XRenderColor rc = get_xrender_color(bg, 1, 0);
-            uint32_t rgb = ((uint32_t)(rc.red >> 8) << 16) |
-                           ((uint32_t)(rc.green >> 8) << 8) |
-                           (uint32_t)(rc.blue >> 8);
-            bg = COLOR_TRUE_RGB_BASE | ((~rgb) & 0x00FFFFFFu);
-        }
-    }
-
-    if (attrs & ATTR_REVERSE) {
-        uint32_t tmp = fg;
-        fg = bg;
-        bg = tmp;
-    }
-    if (selected) {
-        uint32_t tmp = fg;
-        fg = bg;
-        bg = tmp;
-    }
-    if ((attrs & ATTR_BLINK) && hide_blink) {
-        fg = bg;
-    }
-    if (attrs & ATTR_INVISIBLE) {
-        fg = bg;
-    }
-
-    *out_fg = fg;
-    *out_bg = bg;
-}
-
-/* Triggers a full clear+redraw on next draw_text() call (set after resize). */
-static int draw_full_refresh = 1;
-/* Tracks previous cursor row to dirty it when cursor moves between rows. */
-static int prev_cursor_row = -1;
-
-// Draw text using TerminalState's current attr per character
-void draw_text(Display *display, Window window, GC gc) {
-    if (!xft_draw) return;
-
-    update_blink_state();
+/* ---- Xft render backend: primitives from render.c onto the back buffer ---- */
 
-    if (term_state.bell_rung) {
-        XBell(display, 0);
-        term_state.bell_rung = 0;
-    }
+typedef struct {
+    Display *display;
+    Window window;
+    GC gc;
+    XftDraw *draw;
+} XftTarget;
 
-    int win_w = cached_win_w;
-    int win_h = cached_win_h;
+static XftTarget xft_target;
 
-    /* Fall back to XGetWindowAttributes only if dimensions not yet known. */
-    if (win_w <= 0 || win_h <= 0) {
-        XWindowAttributes wa;
-        if (!XGetWindowAttributes(display, window, &wa)) return;
-        win_w = wa.width;
-        win_h = wa.height;
-        cached_win_w = win_w;
-        cached_win_h = win_h;
-    }
+static int xft_begin(void *ctx, int w, int h) {
+    XftTarget *t = ctx;
+    Display *display = t->display;
 
     /* Resize back buffer if window size changed */
-    if (back_pixmap == None || back_w != win_w || back_h != win_h) {
+    if (back_pixmap == None || back_w != w || back_h != h) {
         if (xft_draw_buf) { XftDrawDestroy(xft_draw_buf); xft_draw_buf = NULL; }
         if (back_pixmap != None) { XFreePixmap(display, back_pixmap); back_pixmap = None; }
-        back_w = win_w;
-        back_h = win_h;
+        back_w = w;
+        back_h = h;
         if (back_w > 0 && back_h > 0) {
-            back_pixmap = XCreatePixmap(display, window, back_w, back_h,
+            back_pixmap = XCreatePixmap(display, t->window, back_w, back_h,
                 DefaultDepth(display, DefaultScreen(display)));
             if (back_pixmap != None) {
                 xft_draw_buf = XftDrawCreate(display, back_pixmap,
@@ -1134,299 +1500,420 @@ void draw_text(Display *display, Window window, GC gc) {
                     DefaultColormap(display, DefaultScreen(display)));
             }
         }
-        draw_full_refresh = 1;
+        render_invalidate();
     }
 
-    XftDraw *draw = (xft_draw_buf != NULL) ? xft_draw_buf : xft_draw;
-    if (draw == NULL) return;
+    t->draw = (xft_draw_buf != NULL) ? xft_draw_buf : xft_draw;
+    return t->draw != NULL;
+}
 
-    const int left_pad = LEFT_PAD;
-    const int line_gap = LINE_GAP;
-    const int baseline0 = xft_font->ascent + DRAW_TOP_PAD;
-    const int step_w = g_cell_w + g_cell_gap;
-    const int buf_w = back_w > 0 ? back_w : win_w;
-    const int buf_h = back_h > 0 ? back_h : win_h;
-    const int scrollback_offset = terminal_get_scrollback_offset();
-    const int show_cursor = (scrollback_offset == 0);
-
-    /* Dirty the rows occupied by the cursor (old position + new position) so
-       the cursor shape is always erased/redrawn even when cell content is unchanged. */
-    int cursor_row = term_state.row;
-    if (cursor_row < 0) cursor_row = 0;
-    if (cursor_row >= term_rows) cursor_row = term_rows - 1;
-    if (dirty_rows) {
-        if (prev_cursor_row >= 0 && prev_cursor_row < term_rows)
-            dirty_rows[prev_cursor_row] = 1;
-        if (show_cursor)
-            dirty_rows[cursor_row] = 1;
-    }
-
-    /* Check whether anything actually needs rendering. */
-    int any_dirty = draw_full_refresh;
-    if (!any_dirty && dirty_rows) {
-        for (int r = 0; r < term_rows; r++) {
-            if (dirty_rows[r]) { any_dirty = 1; break; }
+static void xft_fill_rect(void *ctx, int x, int y, int w, int h, uint32_t color, int flags) {
+    XftTarget *t = ctx;
+    XftColor *xc = get_xft_color(t->display, t->window, color,
+                                 (flags & RENDER_COLOR_BG) != 0, (flags & RENDER_COLOR_FAINT) != 0);
+    XftDrawRect(t->draw, xc, x, y, (unsigned int)w, (unsigned int)h);
+    perf.xft_calls++;
+}
+
+/*
+ * Colour emoji, pre-scaled: the first draw of a sequence at a cell size
+ * renders it once into an ARGB Picture of exactly the clipped cell box;
+ * later draws composite that Picture instead of having XRender scale the
+ * font's bitmap strike again.  4-way set associative with LRU in each set;
+ * emptied on font reload and zoom.
+ */
+#define EMOJI_SETS 128
+#define EMOJI_WAYS 4
+
+typedef struct {
+    char key[MAX_UTF8_CHAR_SIZE + 1];
+    int w, h;
+    int dy;                 /* baseline - top */
+    Pixmap pixmap;
+    Picture pict;           /* ARGB32 */
+    unsigned long last_use;
+} EmojiEntry;
+
+static EmojiEntry emoji_cache[EMOJI_SETS][EMOJI_WAYS];
+static unsigned long emoji_clock;
+static int emoji_color_font = -1;   /* xft_font_emoji has colour glyphs; -1 unknown */
+
+static void clear_emoji_cache(Display *display) {
+    for (int s = 0; s < EMOJI_SETS; s++) {
+        for (int w = 0; w < EMOJI_WAYS; w++) {
+            EmojiEntry *e = &emoji_cache[s][w];
+
+            if (e->pict && display)
+                XRenderFreePicture(display, e->pict);
+            if (e->pixmap != None && display)
+                XFreePixmap(display, e->pixmap);
+            memset(e, 0, sizeof(*e));
         }
-    } else if (!dirty_rows) {
-        any_dirty = 1;
     }
+    emoji_color_font = -1;
+}
 
-    if (!any_dirty) {
-        /* Nothing changed — skip the entire render. */
-        return;
-    }
+static int emoji_font_is_color(void) {
+    if (emoji_color_font < 0) {
+        FcBool color = FcFalse;
 
-    /* On a full refresh, clear the entire back pixmap once (covers padding areas too). */
-    int full = draw_full_refresh;
-    draw_full_refresh = 0;
-    if (full) {
-        XftDrawRect(draw, &xft_color_bg, 0, 0, buf_w, buf_h);
+        emoji_color_font = xft_font_emoji && xft_font_emoji != xft_font &&
+                           FcPatternGetBool(xft_font_emoji->pattern, FC_COLOR, 0, &color) == FcResultMatch &&
+                           color;
     }
+    return emoji_color_font;
+}
+
+static EmojiEntry *emoji_render(XftTarget *t, EmojiEntry *e, const char *utf8, int w, int h, int dy) {
+    static const XRenderColor clear = { 0, 0, 0, 0 };
+    static const XRenderColor white = { 0xffff, 0xffff, 0xffff, 0xffff };
+    XRenderPictFormat *argb = XRenderFindStandardFormat(t->display, PictStandardARGB32);
+    Picture ink;
+
+    if (e->pict)
+        XRenderFreePicture(t->display, e->pict);
+    if (e->pixmap != None)
+        XFreePixmap(t->display, e->pixmap);
+    memset(e, 0, sizeof(*e));
+    if (!argb)
+        return NULL;
 
-    for (int r = 0; r < term_rows; r++) {
-        const TerminalCell *row_cells = terminal_get_visible_row(r);
+    e->pixmap = XCreatePixmap(t->display, t->window, (unsigned int)w, (unsigned int)h, 32);
+    if (e->pixmap == None)
+        return NULL;
+    e->pict = XRenderCreatePicture(t->display, e->pixmap, argb, 0, NULL);
+    ink = XRenderCreateSolidFill(t->display, &white);
+    XRenderFillRectangle(t->display, PictOpSrc, e->pict, &clear, 0, 0,
+                         (unsigned int)w, (unsigned int)h);
+    /* Colour glyphs ignore the ink; it only matters for a monochrome fallback. */
+    XftTextRenderUtf8(t->display, PictOpOver, ink, xft_font_emoji, e->pict, 0, 0, 0, dy,
+                      (const FcChar8 *)utf8, (int)strlen(utf8));
+    XRenderFreePicture(t->display, ink);
+    memcpy(e->key, utf8, strlen(utf8) + 1);
+    e->w = w;
+    e->h = h;
+    e->dy = dy;
+    perf.xft_calls += 3;
+    return e;
+}
 
-        /* Skip rows that haven't changed (incremental update only). */
-        if (!full && dirty_rows && !dirty_rows[r])
-            continue;
+/* Composite the cached emoji for utf8 into the cell; 0 if it cannot be cached. */
+static int emoji_draw_cached(XftTarget *t, const char *utf8, int x, int top, int w, int h,
+                             int baseline) {
+    uint32_t hash = 2166136261u;
+    EmojiEntry *set;
+    EmojiEntry *e = NULL;
+    Picture dst = XftDrawPicture(t->draw);
+    size_t len = strlen(utf8);
 
-        if (!row_cells) {
-            continue;
+    if (!dst || len > MAX_UTF8_CHAR_SIZE || w <= 0 || h <= 0)
+        return 0;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ (uint8_t)utf8[i]) * 16777619u;
+    set = emoji_cache[(hash ^ (uint32_t)w * 31u ^ (uint32_t)h) % EMOJI_SETS];
+
+    for (int i = 0; i < EMOJI_WAYS; i++) {
+        if (set[i].pict && set[i].w == w && set[i].h == h && set[i].dy == baseline - top &&
+            strcmp(set[i].key, utf8) == 0) {
+            e = &set[i];
+            perf.emoji_hits++;
+            break;
         }
+    }
+    if (!e) {
+        EmojiEntry *victim = &set[0];
 
-        int x = LEFT_PAD;
-        int y = baseline0 + r * (g_cell_h + line_gap);
-        int row_top = y - xft_font->ascent;
-
-        /* On incremental updates, clear just this row before redrawing it. */
-        if (!full) {
-            XftDrawRect(draw, &xft_color_bg, 0, row_top, buf_w, g_cell_h);
+        for (int i = 1; i < EMOJI_WAYS; i++) {
+            if (!victim->pict)
+                break;
+            if (!set[i].pict || set[i].last_use < victim->last_use)
+                victim = &set[i];
         }
+        perf.emoji_misses++;
+        e = emoji_render(t, victim, utf8, w, h, baseline - top);
+        if (!e)
+            return 0;
+    }
+    e->last_use = ++emoji_clock;
+    XRenderComposite(t->display, PictOpOver, e->pict, None, dst,
+                     0, 0, 0, 0, x, top, (unsigned int)w, (unsigned int)h);
+    perf.xft_calls++;
+    return 1;
+}
 
-        /*
-         * Pass 1: background run batching.
-         * Walk cells left→right, tracking current pixel x.  Consecutive cells
-         * that resolve to the same XftColor* pointer are merged into one rect.
-         * Continuation cells are skipped (their lead cell covers them).
-         */
-        {
-            int cur_px = LEFT_PAD;
-            int run_px = LEFT_PAD;
-            XftColor *run_bg_color = NULL;
-
-            for (int c = 0; c <= term_cols; c++) {
-                XftColor *bg_color = NULL;
-                int cell_w_px = step_w;
-
-                if (c < term_cols) {
-                    const TerminalCell *cell = &row_cells[c];
-                    if (cell->is_continuation) {
-                        cur_px += step_w;
-                        continue;
-                    }
-                    int cell_span = (cell->width == 2 && c + 1 < term_cols) ? 2 : 1;
-                    int selected = cell_selected(r, c) || (cell_span == 2 && cell_selected(r, c + 1));
-                    uint32_t fg_val, bg_val;
-                    resolve_cell_colors(cell->fg, cell->bg, cell->attrs, selected, blink_hidden, &fg_val, &bg_val);
-                    bg_color = get_xft_color(display, window, bg_val, 1, 0);
-                    cell_w_px = g_cell_w * cell_span + g_cell_gap * (cell_span - 1);
-                }
+/* Draw one glyph clipped to its cell box; the caller resets the clip. */
+static void xft_cell_glyph(XftTarget *t, XftColor *color, uint16_t attrs, int x, int top,
+                           int w, int h, int baseline, const char *utf8) {
+    utf8proc_int32_t cp;
+    XRectangle clip_rect;
+    XftFont *font;
 
-                /* Flush the current run when the color changes or we're past the last cell. */
-                if (run_bg_color != NULL && bg_color != run_bg_color) {
-                    XftDrawRect(draw, run_bg_color, run_px, row_top, cur_px - run_px, g_cell_h);
-                    run_px = cur_px;
-                    run_bg_color = NULL;
-                }
+    if (utf8proc_iterate((const uint8_t *)utf8, -1, &cp) <= 0)
+        return;
+    font = font_for_cell(attrs, cp, (top - DRAW_TOP_PAD) / (g_cell_h + LINE_GAP));
+    clip_rect.x = 0;
+    clip_rect.y = 0;
+    clip_rect.width = (unsigned short)w;
+    clip_rect.height = (unsigned short)h;
+    XftDrawSetClipRectangles(t->draw, x, top, &clip_rect, 1);
+    if (font == xft_font_emoji && emoji_font_is_color() &&
+        emoji_draw_cached(t, utf8, x, top, w, h, baseline))
+        return;
+    XftDrawStringUtf8(t->draw, color, font, x, baseline,
+                      (const FcChar8 *)utf8, (int)strlen(utf8));
+    perf.xft_calls += 2;
+}
 
-                if (c < term_cols) {
-                    if (run_bg_color == NULL) {
-                        run_px = cur_px;
-                        run_bg_color = bg_color;
-                    }
-                    cur_px += cell_w_px;
-                } else {
-                    /* End of row: flush final run. */
-                    if (run_bg_color != NULL && cur_px > run_px)
-                        XftDrawRect(draw, run_bg_color, run_px, row_top, cur_px - run_px, g_cell_h);
-                }
-            }
+/* One XRenderFillRectangles request per batch instead of one per rect. */
+static void xft_fill_rects(void *ctx, const RenderRect *r, int n, uint32_t color, int flags) {
+    XftTarget *t = ctx;
+    XftColor *xc = get_xft_color(t->display, t->window, color,
+                                 (flags & RENDER_COLOR_BG) != 0, (flags & RENDER_COLOR_FAINT) != 0);
+    Picture pict = XftDrawPicture(t->draw);
+    XRectangle xr[64];
+
+    if (!pict) {
+        for (int i = 0; i < n; i++)
+            XftDrawRect(t->draw, xc, r[i].x, r[i].y, (unsigned int)r[i].w, (unsigned int)r[i].h);
+        perf.xft_calls += (unsigned long long)n;
+        return;
+    }
+    while (n > 0) {
+        int k = n < 64 ? n : 64;
+
+        for (int i = 0; i < k; i++) {
+            xr[i].x = (short)r[i].x;
+            xr[i].y = (short)r[i].y;
+            xr[i].width = (unsigned short)r[i].w;
+            xr[i].height = (unsigned short)r[i].h;
         }
+        XRenderFillRectangles(t->display, PictOpSrc, pict, &xc->color, xr, k);
+        perf.xft_calls++;
+        r += k;
+        n -= k;
+    }
+}
 
-        /*
-         * Pass 2: foreground text run batching.
-         * Accumulate consecutive non-continuation cells sharing the same font
-         * and fg XftColor pointer into a UTF-8 string, draw one call per run.
-         * Decorations (underline, strikethrough) are drawn per cell since they
-         * are cheap (single pixel rect) and rarely span many cells.
-         */
-        {
-            x = LEFT_PAD;
-            for (int c = 0; c < term_cols; c++) {
-                const TerminalCell *cell = &row_cells[c];
-                int cell_span = 1;
-                int top = row_top;
-                int selected;
-                int draw_w;
-                uint32_t fg_val;
-                uint32_t bg_val;
-                XftColor *fg_color;
-
-                if (cell->is_continuation) {
-                    x += step_w;
-                    continue;
-                }
+static void xft_glyphs(void *ctx, const RenderGlyph *g, int n, int top, int h, int baseline,
+                       uint32_t fg, uint16_t attrs) {
+    XftTarget *t = ctx;
+    XftColor *color = get_xft_color(t->display, t->window, fg, 0, (attrs & ATTR_FAINT) != 0);
 
-                if (cell->width == 2 && c + 1 < term_cols)
-                    cell_span = 2;
-
-                selected = cell_selected(r, c) || (cell_span == 2 && cell_selected(r, c + 1));
-                resolve_cell_colors(cell->fg, cell->bg, cell->attrs, selected, blink_hidden, &fg_val, &bg_val);
-                draw_w = g_cell_w * cell_span;
-                fg_color = get_xft_color(display, window, fg_val, 0, (cell->attrs & ATTR_FAINT) != 0);
-
-                if (cell->c[0] != '\0') {
-                    utf8proc_int32_t cp;
-                    ssize_t rs = utf8proc_iterate((const uint8_t *)cell->c, -1, &cp);
-                    if (rs > 0) {
-                        XRectangle clip_rect;
-                        XftFont *font_to_use = font_for_cell(cell->attrs, cp);
-                        int glyph_len = (int)strlen(cell->c);
-                        /* Draw one cell at a time to preserve terminal cell boundaries
-                           and avoid cross-cell ligature/shaping effects. */
-
-                        clip_rect.x = 0;
-                        clip_rect.y = 0;
-                        clip_rect.width = (unsigned short)draw_w;
-                        clip_rect.height = (unsigned short)g_cell_h;
-                        XftDrawSetClipRectangles(draw, x, top, &clip_rect, 1);
-
-                        XftDrawStringUtf8(draw, fg_color, font_to_use, x, y,
-                                          (const FcChar8 *)cell->c, glyph_len);
-
-                        XftDrawSetClip(draw, NULL);
-                    }
-                }
+    for (int i = 0; i < n; i++)
+        xft_cell_glyph(t, color, attrs, g[i].x, top, g[i].width, h, baseline, g[i].utf8);
+    XftDrawSetClip(t->draw, NULL);
+    perf.xft_calls++;
+}
 
-                /* Decorations are cheap; draw per-cell. */
-                if (cell->attrs & ATTR_UNDERLINE)
-                    XftDrawRect(draw, fg_color, x, top + xft_font->ascent + 1, draw_w, 1);
-                if (cell->attrs & ATTR_STRUCK)
-                    XftDrawRect(draw, fg_color, x, top + (2 * xft_font->ascent) / 3, draw_w, 1);
+static void xft_cursor(void *ctx, const RenderCursor *cur) {
+    XftTarget *t = ctx;
+    XftColor *bg = get_xft_color(t->display, t->window, cur->bg, 1, 0);
 
-                x += step_w;
-            }
+    perf.xft_calls++;
+    if (cur->shape >= 3 && cur->shape <= 4) {
+        XftDrawRect(t->draw, bg, cur->x, cur->y + cur->h - cur->thickness,
+                    (unsigned int)cur->w, (unsigned int)cur->thickness);
+    } else if (cur->shape >= 5 && cur->shape <= 6) {
+        XftDrawRect(t->draw, bg, cur->x, cur->y, (unsigned int)cur->thickness, (unsigned int)cur->h);
+    } else {
+        XftColor *fg = get_xft_color(t->display, t->window, cur->fg, 0, 0);
+        const char *text = (cur->shape == 7) ? "\xE2\x98\x83" : cur->utf8;
+
+        XftDrawRect(t->draw, bg, cur->x, cur->y, (unsigned int)cur->w, (unsigned int)cur->h);
+        if (text[0] != '\0') {
+            xft_cell_glyph(t, fg, cur->attrs, cur->x, cur->y, cur->w, cur->h, cur->baseline, text);
+            XftDrawSetClip(t->draw, NULL);
+            perf.xft_calls++;
         }
     }
+}
 
-    /* Cursor: shape from DECSCUSR (0-2 block, 3-4 underline, 5-6 bar, 7 snowman) */
-    if (term_state.cursor_visible && show_cursor) {
-        int cur_row = term_state.row;
-        int cur_col = term_state.col;
-        int cur_span = 1;
-        int selected;
-        uint32_t cursor_fg_idx;
-        uint32_t cursor_bg_idx;
-        const TerminalCell *cursor_cell;
-        uint16_t cursor_attrs;
-        int cur_x;
-        int cur_w;
-        int cur_h = g_cell_h;
-        int cy_top;
-        int shape = (term_state.cursorshape >= 0 && term_state.cursorshape <= 7) ? term_state.cursorshape : 2;
-        XftColor *cursor_bg_color;
-
-        if (cur_row < 0) cur_row = 0;
-        if (cur_row >= term_rows) cur_row = term_rows - 1;
-        if (cur_col < 0) cur_col = 0;
-        if (cur_col >= term_cols) cur_col = term_cols - 1;
-
-        if (terminal_buffer[cur_row][cur_col].is_continuation && cur_col > 0) {
-            cur_col--;
-        }
+static void xft_copy_area(void *ctx, int x, int y, int w, int h) {
+    XftTarget *t = ctx;
 
-        cursor_cell = &terminal_buffer[cur_row][cur_col];
-        cursor_attrs = cursor_cell->attrs & (ATTR_BOLD | ATTR_ITALIC | ATTR_UNDERLINE | ATTR_STRUCK);
-        if (cursor_cell->width == 2 && cur_col + 1 < term_cols) {
-            cur_span = 2;
-        }
-        selected = cell_selected(cur_row, cur_col) || (cur_span == 2 && cell_selected(cur_row, cur_col + 1));
+    if (back_pixmap != None && t->gc) {
+        XCopyArea(t->display, back_pixmap, t->window, t->gc, x, y,
+                  (unsigned int)w, (unsigned int)h, x, y);
+        perf.xft_calls++;
+        frames_presented++;
+    }
+}
 
-        if (term_state.screen_reverse) {
-            cursor_bg_idx = selected ? defaultcs : defaultrcs;
-            cursor_fg_idx = selected ? defaultrcs : defaultcs;
-        } else {
-            if (selected) {
-                cursor_fg_idx = COLOR_DEFAULT_FG;
-                cursor_bg_idx = defaultrcs;
-            } else {
-                cursor_fg_idx = COLOR_DEFAULT_BG;
-                cursor_bg_idx = defaultcs;
-            }
-        }
+static uint32_t xft_resolve_rgb(void *ctx, uint32_t color, int is_bg) {
+    XRenderColor rc = get_xrender_color(color, is_bg, 0);
 
-        cur_x = left_pad + cur_col * step_w;
-        cur_w = g_cell_w * cur_span;
-        cy_top = baseline0 + cur_row * (g_cell_h + line_gap) - xft_font->ascent;
-        cursor_bg_color = get_xft_color(display, window, cursor_bg_idx, 1, 0);
-
-        if (shape >= 3 && shape <= 4) {
-            int uh = (int)cursorthickness;
-            if (uh < 1) uh = 1;
-            XftDrawRect(draw, cursor_bg_color, cur_x, cy_top + g_cell_h - uh, cur_w, uh);
-        } else if (shape >= 5 && shape <= 6) {
-            int bw = (int)cursorthickness;
-            if (bw < 1) bw = 1;
-            XftDrawRect(draw, cursor_bg_color, cur_x, cy_top, bw, g_cell_h);
-        } else {
-            XftColor *cursor_fg_color = get_xft_color(display, window, cursor_fg_idx, 0, 0);
-            XftDrawRect(draw, cursor_bg_color, cur_x, cy_top, cur_w, cur_h);
-
-            if (shape == 7) {
-                const char snowman[] = "\xE2\x98\x83";
-                XftFont *cursor_font = font_for_cell(cursor_attrs, 0x2603);
-                XRectangle clip_rect;
-
-                clip_rect.x = 0;
-                clip_rect.y = 0;
-                clip_rect.width = (unsigned short)cur_w;
-                clip_rect.height = (unsigned short)g_cell_h;
-                XftDrawSetClipRectangles(draw, cur_x, cy_top, &clip_rect, 1);
-                XftDrawStringUtf8(draw, cursor_fg_color, cursor_font,
-                                  cur_x, baseline0 + cur_row * (g_cell_h + line_gap),
-                                  (const FcChar8 *)snowman, 3);
-                XftDrawSetClip(draw, NULL);
-            } else if (cursor_cell->c[0] != '\0') {
-                utf8proc_int32_t cp;
-                ssize_t rs = utf8proc_iterate((const uint8_t *)cursor_cell->c, -1, &cp);
-                if (rs > 0) {
-                    XftFont *font_to_use = font_for_cell(cursor_attrs, cp);
-                    XRectangle clip_rect;
-
-                    clip_rect.x = 0;
-                    clip_rect.y = 0;
-                    clip_rect.width = (unsigned short)cur_w;
-                    clip_rect.height = (unsigned short)g_cell_h;
-                    XftDrawSetClipRectangles(draw, cur_x, cy_top, &clip_rect, 1);
-                    XftDrawStringUtf8(draw, cursor_fg_color, font_to_use,
-                                      cur_x, baseline0 + cur_row * (g_cell_h + line_gap),
-                                      (const FcChar8 *)cursor_cell->c,
-                                      (int)strlen(cursor_cell->c));
-                    XftDrawSetClip(draw, NULL);
-                }
-            }
-        }
+    (void)ctx;
+    return ((uint32_t)(rc.red >> 8) << 16) | ((uint32_t)(rc.green >> 8) << 8) |
+           (uint32_t)(rc.blue >> 8);
+}
+
+static const RenderBackend xft_backend = {
+    xft_begin, xft_fill_rect, xft_fill_rects, xft_glyphs, xft_cursor, xft_copy_area, xft_resolve_rgb,
+    &xft_target,
+};
+
+unsigned long draw_frames_presented(void) {
+    return frames_presented;
+}
+
+void draw_notify_expose(void) {
+    render_notify_expose();
+}
+
+static int hud_visible = 0;
+
+void draw_toggle_hud(void) {
+    hud_visible = !hud_visible;
+    /* Uncover the cells under the overlay */
+    if (!hud_visible)
+        terminal_mark_all_rows_dirty();
+}
+
+/* Counter overlay in the top-right corner, redrawn on top of every frame. */
+static void draw_hud(const RenderParams *p) {
+    char buf[2048];
+    char *line = buf;
+    int lines, cols = 0, w, h, x, y;
+    XftColor *fg, *bg;
+
+    if (!xft_target.draw)
+        return;
+    lines = perf_format(buf, sizeof(buf));
+    for (char *l = buf; *l; ) {
+        char *nl = strchr(l, '\n');
+        int n = nl ? (int)(nl - l) : (int)strlen(l);
+        if (n > cols) cols = n;
+        if (!nl) break;
+        l = nl + 1;
+    }
+    w = (cols + 2) * p->cell_w;
+    h = lines * p->cell_h + 2 * p->top_pad;
+    x = p->width - w;
+    y = 0;
+    if (x < 0) x = 0;
+    if (w > p->width) w = p->width;
+    if (h > p->height) h = p->height;
+
+    fg = get_xft_color(xft_target.display, xft_target.window, COLOR_DEFAULT_FG, 0, 0);
+    bg = get_xft_color(xft_target.display, xft_target.window, COLOR_DEFAULT_BG, 1, 0);
+    XftDrawRect(xft_target.draw, fg, x, y, (unsigned int)w, (unsigned int)h);
+    XftDrawRect(xft_target.draw, bg, x + 1, y, (unsigned int)(w - 1), (unsigned int)(h - 1));
+    for (int i = 0; i < lines && *line; i++) {
+        char *nl = strchr(line, '\n');
+        int n = nl ? (int)(nl - line) : (int)strlen(line);
+        XftDrawStringUtf8(xft_target.draw, fg, xft_font, x + p->cell_w,
+                          y + p->top_pad + p->ascent + i * p->cell_h, (const FcChar8 *)line, n);
+        if (!nl) break;
+        line = nl + 1;
+    }
+    xft_copy_area(&xft_target, x, y, w, h);
+}
+
+/* Search matches highlighted per frame (the rest still count in the prompt). */
+#define DRAW_MARKS_MAX 1024
+
+/* Search prompt across the bottom row, redrawn on top of every frame. */
+static void draw_search_prompt(const RenderParams *p) {
+    char line[SEARCH_QUERY_MAX + 96];
+    const char *query;
+    XftColor *fg, *bg;
+    size_t count;
+    int regex, n, w, h, y;
+
+    if (!xft_target.draw)
+        return;
+    query = search_query(&regex);
+    count = search_count();
+    n = snprintf(line, sizeof(line), "%s %s%s", regex ? "regex:" : "search:", query,
+                 input_search_editing() ? "_" : "");
+    if (n < 0 || n >= (int)sizeof(line))
+        n = (int)sizeof(line) - 1;
+    if (search_failed())
+        snprintf(line + n, sizeof(line) - (size_t)n, "   bad regex");
+    else if (search_busy_spilled())
+        snprintf(line + n, sizeof(line) - (size_t)n, "   searching older history (%zu so far)", count);
+    else if (search_busy())
+        snprintf(line + n, sizeof(line) - (size_t)n, "   searching (%zu so far)", count);
+    else if (search_incomplete())
+        snprintf(line + n, sizeof(line) - (size_t)n, "   %zu/%zu, search incomplete",
+                 search_current_index(), count);
+    else if (query[0] && count == 0)
+        snprintf(line + n, sizeof(line) - (size_t)n, "   no match");
+    else if (query[0])
+        snprintf(line + n, sizeof(line) - (size_t)n, "   %zu/%zu", search_current_index(), count);
+
+    w = p->width;
+    h = p->cell_h + 2;
+    y = p->height - h;
+    if (y < 0) y = 0;
+    fg = get_xft_color(xft_target.display, xft_target.window, COLOR_DEFAULT_FG, 0, 0);
+    bg = get_xft_color(xft_target.display, xft_target.window, COLOR_DEFAULT_BG, 1, 0);
+    XftDrawRect(xft_target.draw, fg, 0, y, (unsigned int)w, (unsigned int)h);
+    XftDrawRect(xft_target.draw, bg, 0, y + 1, (unsigned int)w, (unsigned int)(h - 1));
+    XftDrawStringUtf8(xft_target.draw, fg, xft_font, p->left_pad, y + 1 + p->ascent,
+                      (const FcChar8 *)line, (int)strlen(line));
+    xft_copy_area(&xft_target, 0, y, w, h);
+}
+
+// Draw text using TerminalState's current attr per character
+void draw_text(Display *display, Window window, GC gc) {
+    RenderParams p;
+    RenderMark marks[DRAW_MARKS_MAX];
+
+    if (!xft_draw) return;
+
+    draw_poll_fonts();
+    update_blink_state();
+
+    if (term_state.bell_rung) {
+        XBell(display, 0);
+        term_state.bell_rung = 0;
+    }
+
+    /* Fall back to XGetWindowAttributes only if dimensions not yet known. */
+    if (cached_win_w <= 0 || cached_win_h <= 0) {
+        XWindowAttributes wa;
+        if (!XGetWindowAttributes(display, window, &wa)) return;
+        cached_win_w = wa.width;
+        cached_win_h = wa.height;
     }
 
-    /* Copy back buffer to window to reduce flicker */
-    if (back_pixmap != None && gc) {
-        XCopyArea(display, back_pixmap, window, gc, 0, 0, back_w, back_h, 0, 0);
+    memset(&p, 0, sizeof(p));
+    p.width = cached_win_w;
+    p.height = cached_win_h;
+    p.left_pad = LEFT_PAD;
+    p.top_pad = DRAW_TOP_PAD;
+    p.cell_w = g_cell_w;
+    p.cell_h = g_cell_h;
+    p.cell_gap = g_cell_gap;
+    p.line_gap = LINE_GAP;
+    p.ascent = xft_font->ascent;
+    p.hide_blink = blink_hidden;
+    p.cursor_thickness = (int)cursorthickness;
+    p.boxdraw = boxdraw;
+    p.boxdraw_braille = boxdraw_braille;
+    p.cursor_color = defaultcs;
+    p.rcursor_color = defaultrcs;
+    p.sel_active = term_state.sel_active;
+    if (p.sel_active) {
+        selection_get_effective_bounds(&p.sel_sr, &p.sel_sc, &p.sel_er, &p.sel_ec);
+        p.sel_rect = (term_state.sel_type == SEL_RECTANGULAR);
+    }
+    if (search_active()) {
+        p.marks = marks;
+        p.nmarks = search_visible_marks(marks, DRAW_MARKS_MAX);
     }
 
-    /* Update cursor tracking and clear dirty flags for next frame. */
-    prev_cursor_row = show_cursor ? cursor_row : -1;
-    if (dirty_rows)
-        memset(dirty_rows, 0, (size_t)term_rows);
+    xft_target.display = display;
+    xft_target.window = window;
+    xft_target.gc = gc;
+    TRACE_BEGIN(t_draw);
+    render_frame(&xft_backend, &p);
+    if (search_active())
+        draw_search_prompt(&p);
+    if (hud_visible)
+        draw_hud(&p);
+    TRACE_END(t_draw, "draw_text", "draw", 0);
 }
 
 void xy_to_cell(int x, int y, int *row, int *col) {
@@ -1449,22 +1936,3 @@ void xy_to_cell(int x, int y, int *row, int *col) {
 
     *row = r; *col = c;
 }
-
-static int cell_selected(int r, int c) {
-    int sr, sc, er, ec;
-
-    if (!term_state.sel_active)
-        return 0;
-    selection_get_effective_bounds(&sr, &sc, &er, &ec);
-    if (r < sr || r > er)
-        return 0;
-    if (term_state.sel_type == SEL_RECTANGULAR)
-        return (c >= sc && c <= ec);
-    if (sr == er)
-        return (c >= sc && c <= ec);
-    if (r == sr)
-        return (c >= sc);
-    if (r == er)
-        return (c <= ec);
-    return 1;
-}
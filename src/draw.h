@@ -11,21 +11,35 @@
 // Declare global fonts
 extern XftColor xft_color;
 extern XftFont *xft_font;       // Normal font
-extern XftFont *xft_font_bold;  // Bold font
-extern XftFont *xft_font_emoji; // Emoji font
+extern XftFont *xft_font_bold;  // Bold font (NULL until first used)
+extern XftFont *xft_font_emoji; // Emoji font (NULL until first used)
 
 extern Window global_window; // Declare global window
 extern Display *global_display; // Ensure display is also declared
 
 void draw_text(Display *display, Window window, GC gc);
 void draw_notify_resize(int w, int h);
+void draw_notify_expose(void);
 void append_text(const char *text);
 void initialize_xft(Display *display, Window window);
+/* --daemon: load the fontconfig setup and match FONT before any window */
+void draw_prewarm_fonts(void);
+/* Input method setup, kept off the path to the first frame */
+void draw_open_im(Display *display);
+/* Frames copied to the window so far (--startup-bench waits for the first) */
+unsigned long draw_frames_presented(void);
 void cleanup_xft(void);
 void xy_to_cell(int x, int y, int *row, int *col);
 void xft_zoom(Display *display, Window window, float delta);
 void xft_zoom_reset(Display *display, Window window);
 void xft_set_font_change_hook(void (*hook)(Display *display, Window window));
+/* Fallback faces matched in the background (font_resolve.h): fd to select()
+ * on, and a poll that installs ready faces and re-dirties the rows that were
+ * drawn without them.  Returns the number of faces installed. */
+int draw_font_fd(void);
+int draw_poll_fonts(void);
+/* Performance counter overlay (perf.h), drawn over the top-right corner */
+void draw_toggle_hud(void);
 
 /* XIM input method support */
 extern XIC g_xic;
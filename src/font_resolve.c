@@ -0,0 +1,330 @@
+// font_resolve.c - fallback font matching on a background thread
+#define _POSIX_C_SOURCE 200809L
+#include "font_resolve.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    uint32_t cp;
+    uint8_t style;
+    unsigned gen;           /* pattern generation the request was made for */
+    FcPattern *match;
+} FontResolveItem;
+
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int running;
+    int stopping;
+    int wake[2];            /* resolver -> main loop */
+    FcPattern *pat[FONT_RESOLVE_STYLES];
+    unsigned gen;
+    FontResolveItem todo[FONT_RESOLVE_QUEUE];
+    size_t todo_head, todo_len;
+    FontResolveItem done[FONT_RESOLVE_QUEUE];
+    size_t done_len;
+    int busy;               /* the thread holds one request */
+} g_fr = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .wake = { -1, -1 },
+};
+
+FcPattern *font_resolve_match(FcPattern *base, FcFontSet *sorted, uint32_t cp) {
+    FcPattern *pat;
+    FcPattern *match;
+    FcCharSet *charset;
+    FcFontSet *sets[1];
+    FcResult res;
+
+    if (!base || !sorted)
+        return NULL;
+    pat = FcPatternDuplicate(base);
+    if (!pat)
+        return NULL;
+    charset = FcCharSetCreate();
+    if (!charset) {
+        FcPatternDestroy(pat);
+        return NULL;
+    }
+    FcCharSetAddChar(charset, (FcChar32)cp);
+    FcPatternAddCharSet(pat, FC_CHARSET, charset);
+    FcPatternAddBool(pat, FC_SCALABLE, FcTrue);
+    FcConfigSubstitute(NULL, pat, FcMatchPattern);
+    FcDefaultSubstitute(pat);
+
+    sets[0] = sorted;
+    match = FcFontSetMatch(NULL, sets, 1, pat, &res);
+    FcPatternDestroy(pat);
+    FcCharSetDestroy(charset);
+    return match;
+}
+
+/* Caller holds the lock. */
+static void set_patterns_locked(FcPattern *const pats[FONT_RESOLVE_STYLES]) {
+    for (int s = 0; s < FONT_RESOLVE_STYLES; s++) {
+        if (pats && pats[s])
+            FcPatternReference(pats[s]);
+        if (g_fr.pat[s])
+            FcPatternDestroy(g_fr.pat[s]);
+        g_fr.pat[s] = pats ? pats[s] : NULL;
+    }
+    g_fr.gen++;
+    g_fr.todo_len = 0;
+}
+
+static void wake_main(void) {
+    ssize_t n;
+
+    do {
+        n = write(g_fr.wake[1], "", 1);
+    } while (n < 0 && errno == EINTR);
+    /* EAGAIN: the pipe already holds a wake-up. */
+}
+
+static void *resolver_main(void *arg) {
+    FcFontSet *sorted[FONT_RESOLVE_STYLES] = { NULL };
+    unsigned have_gen = 0;
+    int prewarmed = 0;
+
+    (void)arg;
+    for (;;) {
+        FontResolveItem item;
+        FcPattern *base;
+        FcPattern *base0;
+        int sort_only = 0;
+        unsigned gen;
+
+        pthread_mutex_lock(&g_fr.lock);
+        for (;;) {
+            if (g_fr.stopping)
+                break;
+            if (have_gen != g_fr.gen) {
+                /* Sorted for the old size or family: start over. */
+                pthread_mutex_unlock(&g_fr.lock);
+                for (int s = 0; s < FONT_RESOLVE_STYLES; s++) {
+                    if (sorted[s])
+                        FcFontSetDestroy(sorted[s]);
+                    sorted[s] = NULL;
+                }
+                pthread_mutex_lock(&g_fr.lock);
+                have_gen = g_fr.gen;
+                prewarmed = 0;
+                continue;
+            }
+            if (g_fr.todo_len > 0) {
+                item = g_fr.todo[g_fr.todo_head];
+                g_fr.todo_head = (g_fr.todo_head + 1) % FONT_RESOLVE_QUEUE;
+                g_fr.todo_len--;
+                g_fr.busy = 1;
+                break;
+            }
+            if (prewarmed < FONT_RESOLVE_STYLES) {
+                memset(&item, 0, sizeof(item));
+                item.style = (uint8_t)prewarmed++;
+                sort_only = 1;
+                break;
+            }
+            pthread_cond_wait(&g_fr.cond, &g_fr.lock);
+        }
+        if (g_fr.stopping) {
+            pthread_mutex_unlock(&g_fr.lock);
+            break;
+        }
+        gen = g_fr.gen;
+        base = g_fr.pat[item.style < FONT_RESOLVE_STYLES ? item.style : 0];
+        base0 = g_fr.pat[0];
+        if (!base)
+            base = base0;
+        if (base)
+            FcPatternReference(base);
+        if (base0)
+            FcPatternReference(base0);
+        pthread_mutex_unlock(&g_fr.lock);
+
+        item.match = NULL;
+        if (base && item.style < FONT_RESOLVE_STYLES) {
+            FcFontSet **set = &sorted[item.style];
+
+            if (!*set) {
+                FcResult res;
+                TRACE_BEGIN(t_sort);
+
+                *set = FcFontSort(NULL, base, FcTrue, NULL, &res);
+                if (!*set && base0 && base != base0)
+                    *set = FcFontSort(NULL, base0, FcTrue, NULL, &res);
+                TRACE_END(t_sort, "font sort", "font", item.style);
+            }
+            if (!sort_only && *set) {
+                TRACE_BEGIN(t_match);
+                item.match = font_resolve_match(base, *set, item.cp);
+                TRACE_END(t_match, "font match", "font", item.cp);
+            }
+        }
+        if (base)
+            FcPatternDestroy(base);
+        if (base0)
+            FcPatternDestroy(base0);
+        if (sort_only)
+            continue;
+
+        pthread_mutex_lock(&g_fr.lock);
+        g_fr.busy = 0;
+        if (gen == g_fr.gen && g_fr.done_len < FONT_RESOLVE_QUEUE) {
+            item.gen = gen;
+            g_fr.done[g_fr.done_len++] = item;
+            wake_main();
+        } else if (item.match) {
+            FcPatternDestroy(item.match);
+        }
+        pthread_mutex_unlock(&g_fr.lock);
+    }
+
+    for (int s = 0; s < FONT_RESOLVE_STYLES; s++) {
+        if (sorted[s])
+            FcFontSetDestroy(sorted[s]);
+    }
+    return NULL;
+}
+
+static void close_wake(void) {
+    for (int i = 0; i < 2; i++) {
+        if (g_fr.wake[i] >= 0)
+            close(g_fr.wake[i]);
+        g_fr.wake[i] = -1;
+    }
+}
+
+int font_resolve_start(FcPattern *const pats[FONT_RESOLVE_STYLES]) {
+    sigset_t all, old;
+    int rc;
+
+    if (g_fr.running) {
+        font_resolve_set_patterns(pats);
+        return 0;
+    }
+    if (pipe(g_fr.wake) != 0) {
+        g_fr.wake[0] = g_fr.wake[1] = -1;
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(g_fr.wake[i], F_SETFL, fcntl(g_fr.wake[i], F_GETFL) | O_NONBLOCK);
+        fcntl(g_fr.wake[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    pthread_mutex_lock(&g_fr.lock);
+    set_patterns_locked(pats);
+    g_fr.done_len = 0;
+    g_fr.stopping = 0;
+    g_fr.busy = 0;
+    pthread_mutex_unlock(&g_fr.lock);
+
+    /* Signals stay on the main thread. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&g_fr.thread, NULL, resolver_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        pthread_mutex_lock(&g_fr.lock);
+        set_patterns_locked(NULL);
+        pthread_mutex_unlock(&g_fr.lock);
+        close_wake();
+        return -1;
+    }
+    g_fr.running = 1;
+    return 0;
+}
+
+void font_resolve_set_patterns(FcPattern *const pats[FONT_RESOLVE_STYLES]) {
+    if (!g_fr.running)
+        return;
+    pthread_mutex_lock(&g_fr.lock);
+    set_patterns_locked(pats);
+    pthread_cond_signal(&g_fr.cond);
+    pthread_mutex_unlock(&g_fr.lock);
+}
+
+void font_resolve_stop(void) {
+    if (!g_fr.running)
+        return;
+    pthread_mutex_lock(&g_fr.lock);
+    g_fr.stopping = 1;
+    pthread_cond_signal(&g_fr.cond);
+    pthread_mutex_unlock(&g_fr.lock);
+    pthread_join(g_fr.thread, NULL);
+    g_fr.running = 0;
+
+    for (size_t i = 0; i < g_fr.done_len; i++) {
+        if (g_fr.done[i].match)
+            FcPatternDestroy(g_fr.done[i].match);
+    }
+    g_fr.done_len = 0;
+    set_patterns_locked(NULL);
+    close_wake();
+}
+
+int font_resolve_running(void) {
+    return g_fr.running;
+}
+
+int font_resolve_request(uint32_t cp, uint8_t style) {
+    int ok = 0;
+
+    if (!g_fr.running || style >= FONT_RESOLVE_STYLES)
+        return 0;
+    pthread_mutex_lock(&g_fr.lock);
+    if (g_fr.todo_len + g_fr.done_len + (size_t)g_fr.busy < FONT_RESOLVE_QUEUE) {
+        FontResolveItem *it = &g_fr.todo[(g_fr.todo_head + g_fr.todo_len) % FONT_RESOLVE_QUEUE];
+
+        it->cp = cp;
+        it->style = style;
+        it->gen = g_fr.gen;
+        it->match = NULL;
+        g_fr.todo_len++;
+        pthread_cond_signal(&g_fr.cond);
+        ok = 1;
+    }
+    pthread_mutex_unlock(&g_fr.lock);
+    return ok;
+}
+
+int font_resolve_fd(void) {
+    return g_fr.running ? g_fr.wake[0] : -1;
+}
+
+int font_resolve_drain(font_resolve_fn fn, void *ctx) {
+    FontResolveItem batch[FONT_RESOLVE_QUEUE];
+    size_t n;
+    unsigned gen;
+    char sink[64];
+    int delivered = 0;
+
+    if (!g_fr.running)
+        return 0;
+    while (read(g_fr.wake[0], sink, sizeof(sink)) > 0)
+        ;
+    pthread_mutex_lock(&g_fr.lock);
+    n = g_fr.done_len;
+    memcpy(batch, g_fr.done, n * sizeof(batch[0]));
+    g_fr.done_len = 0;
+    gen = g_fr.gen;
+    pthread_mutex_unlock(&g_fr.lock);
+
+    for (size_t i = 0; i < n; i++) {
+        if (batch[i].gen != gen) {
+            if (batch[i].match)
+                FcPatternDestroy(batch[i].match);
+            continue;
+        }
+        fn(batch[i].cp, batch[i].style, batch[i].match, ctx);
+        delivered++;
+    }
+    return delivered;
+}
@@ -0,0 +1,52 @@
+#ifndef FONT_RESOLVE_H
+#define FONT_RESOLVE_H
+
+#include <stdint.h>
+#include <fontconfig/fontconfig.h>
+
+/*
+ * Background fallback-font matching.
+ *
+ * A glyph missing from the configured faces needs FcFontSort (once per
+ * style), FcConfigSubstitute and FcFontSetMatch, which can take 100+ ms for
+ * the first CJK or emoji cell.  The renderer queues such misses here and
+ * keeps drawing with the primary font; a resolver thread does the
+ * fontconfig work and hands back the matched pattern.  Opening the face
+ * (which needs the X display) stays on the main thread.
+ *
+ * Results are announced on a pipe so the main loop can select() on it.
+ * Patterns are replaced on font reload; results for the old ones are
+ * discarded by font_resolve_drain().
+ */
+
+/* Styles match font_style_key() in draw.c: bit 0 bold, bit 1 italic. */
+#define FONT_RESOLVE_STYLES 4
+/* Requests in flight (queued plus unread results). */
+#define FONT_RESOLVE_QUEUE 256
+
+/* The matched pattern for cp, or NULL.  Ownership passes to the callback. */
+typedef void (*font_resolve_fn)(uint32_t cp, uint8_t style, FcPattern *match, void *ctx);
+
+/* Start the thread and sort the fallback lists for all styles in the
+ * background.  pats[] are referenced, not copied.  Returns 0, or -1 if the
+ * thread could not be started (callers then match synchronously). */
+int font_resolve_start(FcPattern *const pats[FONT_RESOLVE_STYLES]);
+/* New base patterns after a font reload: drops queued requests and the
+ * sorted lists, and re-sorts in the background. */
+void font_resolve_set_patterns(FcPattern *const pats[FONT_RESOLVE_STYLES]);
+void font_resolve_stop(void);
+int font_resolve_running(void);
+/* Queue a lookup.  Returns 1 if queued, 0 if the queue is full or the
+ * thread is not running.  Callers must not queue the same pair twice. */
+int font_resolve_request(uint32_t cp, uint8_t style);
+/* Read end of the wake-up pipe, or -1 when not running. */
+int font_resolve_fd(void);
+/* Hand completed results to fn on the calling thread.  Never blocks.
+ * Returns the number delivered. */
+int font_resolve_drain(font_resolve_fn fn, void *ctx);
+
+/* The face in sorted (FcFontSort of base) that covers cp, as FcFontSetMatch
+ * picks it, or NULL.  Shared by the thread and the synchronous path. */
+FcPattern *font_resolve_match(FcPattern *base, FcFontSet *sorted, uint32_t cp);
+
+#endif /* FONT_RESOLVE_H */
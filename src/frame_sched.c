@@ -0,0 +1,302 @@
+#include "frame_sched.h"
+
+#include <string.h>
+
+/* Input-rate sampling window. */
+#define SCHED_WINDOW_MS 50.0
+/* Sustained output above this rate (bytes/ms, ~2 MB/s) is bulk output. */
+#define SCHED_BULK_RATE 2048.0
+/* Or the parser is busy for more than this fraction of wall time. */
+#define SCHED_BULK_LOAD 0.5
+/* A keystroke echo must arrive within this window to be drawn at once. */
+#define SCHED_ECHO_WINDOW_MS 100.0
+/* In bulk mode, drawing may not take more than 1/N of the wall time. */
+#define SCHED_BULK_DRAW_SHARE 8.0
+/* EWMA weight for new draw-cost samples. */
+#define SCHED_EWMA_ALPHA 0.25
+
+static double max_d(double a, double b) { return a > b ? a : b; }
+static double min_d(double a, double b) { return a < b ? a : b; }
+
+static double frame_interval(const FrameScheduler *s)
+{
+    double interval;
+
+    if (s->bulk) {
+        interval = max_d(s->bulk_interval_ms, s->draw_ms * SCHED_BULK_DRAW_SHARE);
+    } else if (s->refresh_interval_ms > 0.0) {
+        interval = min_d(s->refresh_interval_ms, s->max_latency_ms);
+    } else {
+        interval = s->max_latency_ms;
+    }
+    /* Never schedule frames closer together than they take to draw. */
+    return max_d(interval, s->draw_ms);
+}
+
+/* Quiet time after the last output before an idle frame is drawn.  It shrinks
+ * as the pending frame ages, so a trickle of output cannot starve drawing. */
+static double idle_threshold(const FrameScheduler *s, double now_ms)
+{
+    double interval, aged;
+
+    if (s->bulk)
+        return s->max_latency_ms;
+
+    interval = frame_interval(s);
+    aged = interval > 0.0 ? (now_ms - s->pending_since_ms) / interval : 1.0;
+    if (aged >= 1.0)
+        return 0.0;
+    return s->min_latency_ms * (1.0 - max_d(aged, 0.0));
+}
+
+/* Outside bulk mode frames are still held to the display refresh rate, and
+ * to the unfocused cap when the window is visible but not focused. */
+static double next_frame_allowed(const FrameScheduler *s)
+{
+    double gap = 0.0;
+
+    if (s->bulk)
+        gap = frame_interval(s);
+    else if (s->refresh_interval_ms > 0.0)
+        gap = s->refresh_interval_ms;
+    if (s->unfocused)
+        gap = max_d(gap, s->unfocused_interval_ms);
+    return s->last_frame_ms + gap;
+}
+
+static int echo_ready(const FrameScheduler *s, double now_ms)
+{
+    return s->key_pending && !s->bulk &&
+           s->last_output_ms >= s->last_key_ms &&
+           now_ms - s->last_key_ms <= SCHED_ECHO_WINDOW_MS;
+}
+
+static void mark_pending(FrameScheduler *s, double now_ms)
+{
+    if (!s->pending) {
+        s->pending = 1;
+        s->pending_since_ms = now_ms;
+    }
+}
+
+static void close_window(FrameScheduler *s, double now_ms)
+{
+    double span = now_ms - s->window_start_ms;
+    int was_bulk = s->bulk;
+
+    if (span <= 0.0)
+        return;
+    s->input_rate = (double)s->window_bytes / span;
+    s->parse_load = s->window_parse_ms / span;
+    s->bulk = s->input_rate >= SCHED_BULK_RATE || s->parse_load >= SCHED_BULK_LOAD;
+    if (s->bulk && !was_bulk)
+        s->bulk_entries++;
+    s->window_start_ms = now_ms;
+    s->window_bytes = 0;
+    s->window_parse_ms = 0.0;
+}
+
+void frame_sched_set_refresh(FrameScheduler *s, double refresh_hz)
+{
+    s->refresh_interval_ms = refresh_hz > 0.0 ? 1000.0 / refresh_hz : 0.0;
+}
+
+void frame_sched_set_unfocused_fps(FrameScheduler *s, double fps)
+{
+    s->unfocused_interval_ms = fps > 0.0 ? 1000.0 / fps : 0.0;
+}
+
+void frame_sched_set_visibility(FrameScheduler *s, int visible, int focused)
+{
+    s->hidden = !visible;
+    s->unfocused = !focused;
+}
+
+void frame_sched_set_sync_timeout(FrameScheduler *s, double timeout_ms)
+{
+    s->sync_timeout_ms = max_d(timeout_ms, 0.0);
+}
+
+void frame_sched_set_sync(FrameScheduler *s, int active, double now_ms)
+{
+    if (!active)
+        s->sync_expired = 0;
+    if (active && !s->sync_active && !s->sync_expired) {
+        s->sync_active = 1;
+        s->sync_deadline_ms = now_ms + s->sync_timeout_ms;
+    } else if (!active && s->sync_active) {
+        s->sync_active = 0;
+        s->sync_flush = 1;
+        mark_pending(s, now_ms);
+    }
+}
+
+void frame_sched_note_sync_end(FrameScheduler *s, double now_ms)
+{
+    s->sync_active = 0;
+    s->sync_expired = 0;
+    s->sync_flush = 1;
+    mark_pending(s, now_ms);
+}
+
+static int sync_holding(FrameScheduler *s, double now_ms)
+{
+    /* A finished update is owed its frame even if the next one has begun. */
+    if (!s->sync_active || s->sync_flush)
+        return 0;
+    if (now_ms < s->sync_deadline_ms)
+        return 1;
+    /* Safety timeout: the application never closed the update.  The mode
+     * stays set in the terminal; re-arming on every read would hold it to
+     * one frame per timeout, so wait for the update to close instead. */
+    s->sync_active = 0;
+    s->sync_expired = 1;
+    s->sync_timeouts++;
+    return 0;
+}
+
+void frame_sched_init(FrameScheduler *s, double min_latency_ms, double max_latency_ms,
+                      double bulk_fps, double refresh_hz)
+{
+    memset(s, 0, sizeof(*s));
+    s->min_latency_ms = max_d(min_latency_ms, 0.0);
+    s->max_latency_ms = max_d(max_latency_ms, s->min_latency_ms);
+    s->bulk_interval_ms = bulk_fps > 0.0 ? 1000.0 / bulk_fps : s->max_latency_ms;
+    s->sync_timeout_ms = 150.0;
+    frame_sched_set_refresh(s, refresh_hz);
+    s->last_key_ms = -1.0;
+    s->last_output_ms = -1.0;
+    s->last_frame_ms = -1e9;
+}
+
+void frame_sched_note_key(FrameScheduler *s, double now_ms)
+{
+    s->last_key_ms = now_ms;
+    s->key_pending = 1;
+    /* Keys may change the screen locally (scrollback, selection, zoom). */
+    mark_pending(s, now_ms);
+}
+
+void frame_sched_note_output(FrameScheduler *s, double now_ms, size_t bytes, double parse_ms)
+{
+    if (bytes == 0)
+        return;
+    if (s->window_bytes == 0 && now_ms - s->last_output_ms > SCHED_WINDOW_MS)
+        s->window_start_ms = now_ms;
+    s->window_bytes += bytes;
+    s->window_parse_ms += parse_ms;
+    if (now_ms - s->window_start_ms >= SCHED_WINDOW_MS)
+        close_window(s, now_ms);
+    s->last_output_ms = now_ms;
+    mark_pending(s, now_ms);
+}
+
+void frame_sched_note_damage(FrameScheduler *s, double now_ms)
+{
+    mark_pending(s, now_ms);
+}
+
+FrameReason frame_sched_due(FrameScheduler *s, double now_ms)
+{
+    /* Output stopped: leave bulk mode so the final screen is drawn promptly. */
+    if (s->bulk && now_ms - s->last_output_ms >= SCHED_WINDOW_MS) {
+        s->bulk = 0;
+        s->window_bytes = 0;
+        s->window_parse_ms = 0.0;
+    }
+    if (!s->pending)
+        return FRAME_REASON_NONE;
+    if (s->hidden) {
+        s->hidden_skips++;
+        return FRAME_REASON_NONE;
+    }
+    if (sync_holding(s, now_ms)) {
+        s->sync_holds++;
+        return FRAME_REASON_NONE;
+    }
+    if (echo_ready(s, now_ms))
+        return FRAME_REASON_ECHO;
+    if (now_ms < next_frame_allowed(s)) {
+        s->deferrals++;
+        return FRAME_REASON_NONE;
+    }
+    if (s->sync_flush)
+        return FRAME_REASON_SYNC;
+    if (s->bulk)
+        return FRAME_REASON_BULK;
+    if (now_ms - s->last_output_ms >= idle_threshold(s, now_ms))
+        return FRAME_REASON_IDLE;
+    if (now_ms - s->pending_since_ms >= frame_interval(s))
+        return FRAME_REASON_DEADLINE;
+    s->deferrals++;
+    return FRAME_REASON_NONE;
+}
+
+double frame_sched_timeout(const FrameScheduler *s, double now_ms)
+{
+    double wait, allowed;
+
+    if (!s->pending || s->hidden)
+        return s->bulk ? SCHED_WINDOW_MS : -1.0;
+    if (s->sync_active && !s->sync_flush && now_ms < s->sync_deadline_ms)
+        return s->sync_deadline_ms - now_ms;
+    if (echo_ready(s, now_ms))
+        return 0.0;
+
+    allowed = next_frame_allowed(s) - now_ms;
+    if (s->bulk || s->sync_flush) {
+        wait = allowed;
+    } else {
+        wait = min_d(s->last_output_ms + idle_threshold(s, now_ms) - now_ms,
+                     s->pending_since_ms + frame_interval(s) - now_ms);
+        wait = max_d(wait, allowed);
+    }
+    return max_d(wait, 0.0);
+}
+
+static unsigned long frames_drawn(const FrameScheduler *s)
+{
+    unsigned long total = 0;
+
+    for (int i = FRAME_REASON_NONE + 1; i < FRAME_REASON_COUNT; i++)
+        total += s->frames[i];
+    return total;
+}
+
+void frame_sched_note_frame(FrameScheduler *s, double now_ms, double draw_ms, FrameReason why)
+{
+    if (draw_ms >= 0.0) {
+        if (frames_drawn(s) == 0)
+            s->draw_ms = draw_ms;
+        else
+            s->draw_ms += SCHED_EWMA_ALPHA * (draw_ms - s->draw_ms);
+    }
+    if (why > FRAME_REASON_NONE && why < FRAME_REASON_COUNT)
+        s->frames[why]++;
+    if (why == FRAME_REASON_ECHO) {
+        double latency = now_ms - s->last_key_ms;
+
+        if (s->echo_samples++ == 0)
+            s->echo_latency_ms = latency;
+        else
+            s->echo_latency_ms += SCHED_EWMA_ALPHA * (latency - s->echo_latency_ms);
+        if (latency > s->echo_latency_max_ms)
+            s->echo_latency_max_ms = latency;
+        s->key_pending = 0;
+    }
+    s->pending = 0;
+    s->sync_flush = 0;
+    s->last_frame_ms = now_ms;
+}
+
+const char *frame_sched_reason_name(FrameReason why)
+{
+    switch (why) {
+    case FRAME_REASON_ECHO: return "echo";
+    case FRAME_REASON_IDLE: return "idle";
+    case FRAME_REASON_DEADLINE: return "deadline";
+    case FRAME_REASON_BULK: return "bulk";
+    case FRAME_REASON_SYNC: return "sync";
+    default: return "none";
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef FRAME_SCHED_H
+#define FRAME_SCHED_H
+
+#include <stddef.h>
+
+/*
+ * Adaptive frame scheduler.
+ *
+ * Replaces the fixed minlatency/maxlatency wait in the main loop.  The loop
+ * reports what happened (keystrokes, PTY output with its parse cost, other
+ * damage, finished frames with their draw cost) and asks when the next frame
+ * is due.  All times are CLOCK_MONOTONIC milliseconds supplied by the caller,
+ * so the policy is deterministic and testable without X.
+ */
+
+typedef enum {
+    FRAME_REASON_NONE = 0,
+    FRAME_REASON_ECHO,      /* output right after a keystroke: draw now */
+    FRAME_REASON_IDLE,      /* output went quiet for the idle threshold */
+    FRAME_REASON_DEADLINE,  /* frame interval elapsed under steady output */
+    FRAME_REASON_BULK,      /* jump-scroll frame during sustained bulk output */
+    FRAME_REASON_SYNC,      /* synchronized update (?2026) just ended */
+    FRAME_REASON_COUNT
+} FrameReason;
+
+typedef struct {
+    /* Policy (from config.h) */
+    double min_latency_ms;      /* idle threshold before drawing */
+    double max_latency_ms;      /* upper bound on batching when refresh unknown */
+    double bulk_interval_ms;    /* frame interval while in bulk mode */
+    double refresh_interval_ms; /* display refresh period, 0 = unknown */
+    double unfocused_interval_ms; /* frame cap while visible but unfocused */
+    double sync_timeout_ms;     /* longest a synchronized update may hold */
+
+    /* Measurements */
+    double window_start_ms;     /* current input-rate sampling window */
+    size_t window_bytes;
+    double window_parse_ms;
+    double input_rate;          /* bytes/ms over the last closed window */
+    double parse_load;          /* fraction of wall time spent parsing */
+    double draw_ms;             /* EWMA of draw_text() cost */
+
+    /* Scheduling state */
+    double last_key_ms;
+    double last_output_ms;
+    double last_frame_ms;
+    double pending_since_ms;
+    int pending;
+    int key_pending;
+    int bulk;
+    int hidden;                 /* unmapped or fully obscured: parse only */
+    int unfocused;
+    int sync_active;            /* ?2026 open: frames held until it ends */
+    int sync_flush;             /* ?2026 closed: present right away */
+    int sync_expired;           /* timed out: ?2026 ignored until it closes */
+    double sync_deadline_ms;
+
+    /* Decision counters */
+    unsigned long frames[FRAME_REASON_COUNT];
+    unsigned long bulk_entries;
+    unsigned long deferrals;
+    unsigned long hidden_skips; /* wakeups with output while hidden */
+    unsigned long sync_holds;   /* wakeups held by a synchronized update */
+    unsigned long sync_timeouts;
+
+    /* Key-to-photon latency of echo frames (keypress to XFlush) */
+    unsigned long echo_samples;
+    double echo_latency_ms;     /* EWMA */
+    double echo_latency_max_ms;
+} FrameScheduler;
+
+void frame_sched_init(FrameScheduler *s, double min_latency_ms, double max_latency_ms,
+                      double bulk_fps, double refresh_hz);
+void frame_sched_set_refresh(FrameScheduler *s, double refresh_hz);
+void frame_sched_set_unfocused_fps(FrameScheduler *s, double fps);
+/* Window visibility and focus; becoming visible again needs a full repaint,
+ * which the caller arranges. */
+void frame_sched_set_visibility(FrameScheduler *s, int visible, int focused);
+/* Report the terminal's ?2026 state after parsing; frames are held while it
+ * is set, for at most timeout_ms, and presented as soon as it is reset.  An
+ * update that timed out holds nothing more until it is closed. */
+void frame_sched_set_sync(FrameScheduler *s, int active, double now_ms);
+/* An update closed during the last read, possibly with another opened after
+ * it: the finished one is presented before the new one holds frames. */
+void frame_sched_note_sync_end(FrameScheduler *s, double now_ms);
+void frame_sched_set_sync_timeout(FrameScheduler *s, double timeout_ms);
+void frame_sched_note_key(FrameScheduler *s, double now_ms);
+void frame_sched_note_output(FrameScheduler *s, double now_ms, size_t bytes, double parse_ms);
+void frame_sched_note_damage(FrameScheduler *s, double now_ms);
+/* Returns the reason a frame should be drawn now, or FRAME_REASON_NONE. */
+FrameReason frame_sched_due(FrameScheduler *s, double now_ms);
+/* Milliseconds until the next frame could be due; -1 = nothing pending. */
+double frame_sched_timeout(const FrameScheduler *s, double now_ms);
+void frame_sched_note_frame(FrameScheduler *s, double now_ms, double draw_ms, FrameReason why);
+const char *frame_sched_reason_name(FrameReason why);
+
+#endif /* FRAME_SCHED_H */
@@ -12,6 +12,7 @@
 #include <wchar.h>
 #include <utf8proc.h>
 #include "input.h"
+#include "search.h"
 #include "terminal_state.h"
 #include "draw.h"
 #include "config.h"
@@ -26,19 +27,46 @@
 #define TIMEDIFF_MS(t1, t2) \
     (((t1).tv_sec - (t2).tv_sec) * 1000 + ((t1).tv_nsec - (t2).tv_nsec) / 1000000)
 
-extern TerminalState term_state;
-extern TerminalCell **terminal_buffer;
-extern int term_rows, term_cols;
 extern Display *global_display;
 extern Window global_window;
 
-static unsigned char *g_clip_data = NULL;
 static struct timespec g_tclick1;
 static struct timespec g_tclick2;
-static size_t g_clip_len = 0;
 static int g_pty_fd = -1;
 static int g_numlock = 0;
 
+/* Scrollback search prompt: typing edits the query, Return moves to the
+ * matches, where n / N step to older / newer ones. */
+enum { FIND_OFF, FIND_EDIT, FIND_BROWSE };
+static struct {
+    int mode;
+    int regex;
+    char query[SEARCH_QUERY_MAX];
+    size_t len;
+} g_find;
+
+/*
+ * Paste transfer.  Selection data is read from the XSEL_DATA property in
+ * chunks no larger than the free space in a fixed write queue, filtered
+ * through a PasteStream and written to the PTY as it accepts data.  With
+ * INCR the property is only deleted (asking the owner for the next chunk)
+ * once it has been consumed, so a slow reader throttles the owner and
+ * memory stays bounded by PASTE_QUEUE_SIZE.
+ */
+#define PASTE_QUEUE_SIZE (64 * 1024)
+#define PASTE_MIN_READ   4096
+
+static struct {
+    int active;         /* transfer in progress */
+    int incr;           /* INCR: chunks arrive as PropertyNotify NewValue */
+    int chunk_ready;    /* property holds data not yet consumed */
+    long offset;        /* 32-bit units of the property already consumed */
+    PasteStream stream;
+    uint8_t queue[PASTE_QUEUE_SIZE];
+    size_t q_head;
+    size_t q_len;
+} g_paste;
+
 void input_set_pty_fd(int fd) {
     g_pty_fd = fd;
 }
@@ -114,6 +142,85 @@ void numlock(const Arg *arg) {
     g_numlock ^= 1;
 }
 
+void perfhud(const Arg *arg) {
+    (void)arg;
+    draw_toggle_hud();
+}
+
+void searchstart(const Arg *arg) {
+    (void)arg;
+    if (g_find.mode == FIND_OFF) {
+        g_find.len = 0;
+        g_find.query[0] = '\0';
+        search_set_query("", g_find.regex);
+    }
+    g_find.mode = FIND_EDIT;
+    terminal_mark_all_rows_dirty();
+}
+
+int input_search_editing(void) {
+    return g_find.mode == FIND_EDIT;
+}
+
+static void find_end(void) {
+    g_find.mode = FIND_OFF;
+    search_stop();
+    terminal_scrollback_reset();
+}
+
+/* Keys while the search prompt is up.  Returns 1 if the key was used. */
+static int find_keypress(KeySym keysym, unsigned int state, const char *text, int len) {
+    if (IsModifierKey(keysym))
+        return 1;
+    /* Scrolling the history stays available. */
+    if ((state & ShiftMask) && (keysym == XK_Page_Up || keysym == XK_Page_Down))
+        return 0;
+    if (keysym == XK_Escape) {
+        find_end();
+        return 1;
+    }
+
+    if (g_find.mode == FIND_BROWSE) {
+        if (keysym == XK_n || keysym == XK_Return || keysym == XK_Up) {
+            search_next(-1);
+        } else if (keysym == XK_N || keysym == XK_Down) {
+            search_next(+1);
+        } else if (keysym == XK_slash) {
+            g_find.mode = FIND_EDIT;
+            terminal_mark_all_rows_dirty();
+        } else {
+            /* Anything else goes to the shell. */
+            find_end();
+            return 0;
+        }
+        return 1;
+    }
+
+    if (keysym == XK_Return || keysym == XK_KP_Enter) {
+        g_find.mode = FIND_BROWSE;
+        search_next(-1);
+        terminal_mark_all_rows_dirty();
+        return 1;
+    }
+    if (keysym == XK_Tab) {
+        g_find.regex = !g_find.regex;
+    } else if (keysym == XK_BackSpace) {
+        /* Drop one UTF-8 character. */
+        while (g_find.len > 0 && ((unsigned char)g_find.query[--g_find.len] & 0xC0) == 0x80)
+            ;
+        g_find.query[g_find.len] = '\0';
+    } else if (len > 0 && !(state & ControlMask) && (unsigned char)text[0] >= 0x20 && text[0] != 0x7F &&
+               g_find.len + (size_t)len < sizeof(g_find.query)) {
+        memcpy(g_find.query + g_find.len, text, (size_t)len);
+        g_find.len += (size_t)len;
+        g_find.query[g_find.len] = '\0';
+    } else {
+        return 1;
+    }
+    search_set_query(g_find.query, g_find.regex);
+    return 1;
+}
+
 static void tty_write_all_may_echo(int fd, const uint8_t *data, size_t len, int may_echo) {
     uint8_t expanded[512];
     const uint8_t *to_write = data;
@@ -300,37 +407,294 @@ void selection_release(Display *display, Window window, int col, int row) {
     terminal_mark_all_rows_dirty();
 }
 
+/* ------------------------------------------------------------------------
+ * Selection provider
+ *
+ * The copied text lives in one reference-counted ClipBuf shared by the
+ * CLIPBOARD and PRIMARY selections and by every transfer reading from it,
+ * so serving a request never copies the data (STRING requests get their
+ * own Latin-1 conversion).  Data larger than one request is served with
+ * INCR: a chunk is written each time the requestor deletes the property.
+ * ---------------------------------------------------------------------- */
+
+typedef struct {
+    unsigned int refs;
+    size_t len;
+    unsigned char data[];
+} ClipBuf;
+
+#define SEL_MAX_TRANSFERS 16
+#define SEL_CHUNK_MAX     (256 * 1024)
+#define SEL_INCR_TIMEOUT_MS 5000
+
+typedef struct {
+    Window requestor;
+    Window owner;           /* our window; its event mask is never touched */
+    Atom property;
+    Atom type;
+    ClipBuf *buf;
+    size_t offset;
+    int done;               /* zero-length terminator sent */
+    struct timespec last;   /* last activity, for abandoned transfers */
+} SelTransfer;
+
+static ClipBuf *g_clip = NULL;
+static int g_own_clipboard = 0;
+static int g_own_primary = 0;
+static SelTransfer g_transfers[SEL_MAX_TRANSFERS];
+
+static ClipBuf *clipbuf_new(size_t len) {
+    ClipBuf *buf = malloc(sizeof(ClipBuf) + len);
+    if (!buf) {
+        return NULL;
+    }
+    buf->refs = 1;
+    buf->len = len;
+    return buf;
+}
+
+static ClipBuf *clipbuf_ref(ClipBuf *buf) {
+    if (buf) buf->refs++;
+    return buf;
+}
+
+static void clipbuf_unref(ClipBuf *buf) {
+    if (buf && --buf->refs == 0) {
+        free(buf);
+    }
+}
+
 const unsigned char *clipboard_get_data(size_t *len_out) {
-    if (len_out) *len_out = g_clip_len;
-    return g_clip_data;
+    if (len_out) *len_out = g_clip ? g_clip->len : 0;
+    return g_clip ? g_clip->data : NULL;
+}
+
+/* Takes ownership of buf and claims both selections. */
+static void clipboard_set_buf(Display *display, Window window, ClipBuf *buf) {
+    clipbuf_unref(g_clip);
+    g_clip = buf;
+    g_own_clipboard = 0;
+    g_own_primary = 0;
+
+    if (!display || !window || !buf) {
+        return;
+    }
+
+    XSetSelectionOwner(display, XInternAtom(display, "CLIPBOARD", False), window, CurrentTime);
+    XSetSelectionOwner(display, XA_PRIMARY, window, CurrentTime);
+    g_own_clipboard = 1;
+    g_own_primary = 1;
 }
 
 void clipboard_set_data(Display *display, Window window, const uint8_t *data, size_t len) {
-    Atom clipboard;
-    Atom primary;
-    unsigned char *copy;
+    ClipBuf *buf = NULL;
+
+    if (display && window && data && len > 0) {
+        buf = clipbuf_new(len);
+        if (buf) {
+            memcpy(buf->data, data, len);
+        }
+    }
+    clipboard_set_buf(display, window, buf);
+}
 
-    free(g_clip_data);
-    g_clip_data = NULL;
-    g_clip_len = 0;
+/* Largest property chunk this server accepts in one request, capped so one
+ * chunk never stalls the event loop. */
+static size_t selection_chunk_size(Display *display) {
+    long max_req = XExtendedMaxRequestSize(display);
+    size_t bytes;
 
-    if (!display || !window || !data || len == 0) {
-        return;
+    if (max_req <= 0) {
+        max_req = XMaxRequestSize(display);
     }
+    bytes = (size_t)max_req * 4;
+    bytes = bytes > 1024 ? bytes - 1024 : bytes / 2;  /* request header room */
+    return bytes < SEL_CHUNK_MAX ? bytes : SEL_CHUNK_MAX;
+}
 
-    copy = malloc(len);
-    if (!copy) {
-        return;
+/* UTF-8 to Latin-1 for the STRING target; unrepresentable characters
+ * become '?'. */
+static ClipBuf *clipbuf_to_latin1(const ClipBuf *src) {
+    ClipBuf *dst = clipbuf_new(src->len);
+    size_t i = 0;
+    size_t out = 0;
+
+    if (!dst) {
+        return NULL;
+    }
+    while (i < src->len) {
+        utf8proc_int32_t cp;
+        utf8proc_ssize_t n = utf8proc_iterate(src->data + i, (utf8proc_ssize_t)(src->len - i), &cp);
+        if (n <= 0) {
+            n = 1;
+            cp = '?';
+        }
+        dst->data[out++] = (cp >= 0 && cp <= 0xFF) ? (unsigned char)cp : '?';
+        i += (size_t)n;
+    }
+    dst->len = out;
+    return dst;
+}
+
+static long timespec_ms_since(const struct timespec *t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)TIMEDIFF_MS(now, *t);
+}
+
+static int window_has_transfer(Window w, const SelTransfer *except) {
+    for (int i = 0; i < SEL_MAX_TRANSFERS; i++) {
+        if (&g_transfers[i] != except && g_transfers[i].buf && g_transfers[i].requestor == w) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void transfer_end(Display *display, SelTransfer *t) {
+    if (t->requestor != t->owner && !window_has_transfer(t->requestor, t)) {
+        XSelectInput(display, t->requestor, NoEventMask);
+    }
+    clipbuf_unref(t->buf);
+    memset(t, 0, sizeof(*t));
+}
+
+static SelTransfer *transfer_slot(Display *display) {
+    SelTransfer *free_slot = NULL;
+
+    for (int i = 0; i < SEL_MAX_TRANSFERS; i++) {
+        SelTransfer *t = &g_transfers[i];
+        /* Reap requestors that stopped reading */
+        if (t->buf && timespec_ms_since(&t->last) > SEL_INCR_TIMEOUT_MS) {
+            transfer_end(display, t);
+        }
+        if (!t->buf && !free_slot) {
+            free_slot = t;
+        }
+    }
+    return free_slot;
+}
+
+static int serve_data(Display *display, const XSelectionRequestEvent *req, Atom property,
+                      Atom type, ClipBuf *buf) {
+    size_t chunk = selection_chunk_size(display);
+    SelTransfer *t;
+
+    if (buf->len <= chunk) {
+        XChangeProperty(display, req->requestor, property, type, 8, PropModeReplace,
+                        buf->data, (int)buf->len);
+        return 1;
+    }
+
+    t = transfer_slot(display);
+    if (!t) {
+        return 0;  /* too many concurrent INCR transfers */
+    }
+    {
+        /* INCR: announce a lower bound on the size, then wait for deletes */
+        long size = buf->len > (size_t)0x7FFFFFFF ? 0x7FFFFFFF : (long)buf->len;
+        /* Pasting into ourselves already selects PropertyChangeMask */
+        if (req->requestor != req->owner)
+            XSelectInput(display, req->requestor, PropertyChangeMask);
+        XChangeProperty(display, req->requestor, property,
+                        XInternAtom(display, "INCR", False), 32, PropModeReplace,
+                        (unsigned char *)&size, 1);
+    }
+    t->requestor = req->requestor;
+    t->owner = req->owner;
+    t->property = property;
+    t->type = type;
+    t->buf = clipbuf_ref(buf);
+    t->offset = 0;
+    t->done = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t->last);
+    return 1;
+}
+
+void selection_handle_request(Display *display, XEvent *event) {
+    const XSelectionRequestEvent *req = &event->xselectionrequest;
+    Atom xa_utf8    = XInternAtom(display, "UTF8_STRING", False);
+    Atom xa_text    = XInternAtom(display, "TEXT", False);
+    Atom xa_targets = XInternAtom(display, "TARGETS", False);
+    Atom property   = (req->property != None) ? req->property : req->target; /* obsolete clients */
+    XSelectionEvent ev = {
+        .type      = SelectionNotify,
+        .display   = req->display,
+        .requestor = req->requestor,
+        .selection = req->selection,
+        .target    = req->target,
+        .property  = None,
+        .time      = req->time
+    };
+
+    if (g_clip) {
+        if (req->target == xa_targets) {
+            Atom targets[4] = { xa_utf8, xa_text, XA_STRING, xa_targets };
+            XChangeProperty(display, req->requestor, property, XA_ATOM, 32,
+                            PropModeReplace, (unsigned char *)targets, 4);
+            ev.property = property;
+        } else if (req->target == xa_utf8 || req->target == xa_text) {
+            if (serve_data(display, req, property, xa_utf8, g_clip))
+                ev.property = property;
+        } else if (req->target == XA_STRING) {
+            ClipBuf *latin1 = clipbuf_to_latin1(g_clip);
+            if (latin1 && serve_data(display, req, property, XA_STRING, latin1))
+                ev.property = property;
+            clipbuf_unref(latin1);
+        }
+    }
+
+    XSendEvent(display, req->requestor, True, 0, (XEvent *)&ev);
+    XFlush(display);
+}
+
+int selection_handle_property(Display *display, XEvent *event) {
+    const XPropertyEvent *pe = &event->xproperty;
+
+    if (event->type != PropertyNotify || pe->state != PropertyDelete) {
+        return 0;
+    }
+    for (int i = 0; i < SEL_MAX_TRANSFERS; i++) {
+        SelTransfer *t = &g_transfers[i];
+        size_t chunk;
+        size_t n;
+
+        if (!t->buf || t->requestor != pe->window || t->property != pe->atom) {
+            continue;
+        }
+        if (t->done) {
+            transfer_end(display, t);
+            return 1;
+        }
+        chunk = selection_chunk_size(display);
+        n = t->buf->len - t->offset;
+        if (n > chunk) n = chunk;
+        /* n == 0 writes the zero-length property that ends the transfer */
+        XChangeProperty(display, t->requestor, t->property, t->type, 8, PropModeReplace,
+                        t->buf->data + t->offset, (int)n);
+        t->offset += n;
+        if (n == 0) {
+            t->done = 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t->last);
+        return 1;
     }
-    memcpy(copy, data, len);
+    return 0;
+}
 
-    g_clip_data = copy;
-    g_clip_len = len;
+void selection_handle_clear(Display *display, XEvent *event) {
+    Atom sel = event->xselectionclear.selection;
 
-    clipboard = XInternAtom(display, "CLIPBOARD", False);
-    primary = XA_PRIMARY;
-    XSetSelectionOwner(display, clipboard, window, CurrentTime);
-    XSetSelectionOwner(display, primary, window, CurrentTime);
+    if (sel == XA_PRIMARY) {
+        g_own_primary = 0;
+    } else if (sel == XInternAtom(display, "CLIPBOARD", False)) {
+        g_own_clipboard = 0;
+    }
+    /* Running transfers hold their own reference. */
+    if (!g_own_primary && !g_own_clipboard) {
+        clipbuf_unref(g_clip);
+        g_clip = NULL;
+    }
 }
 
 void copy_to_clipboard(Display *display, Window window) {
@@ -342,8 +706,14 @@ void copy_to_clipboard(Display *display, Window window) {
     selection_get_effective_bounds(&sr, &sc, &er, &ec);
 
     size_t max_size = term_rows * term_cols * MAX_UTF8_CHAR_SIZE + term_rows + 1;
-    char *selection = malloc(max_size);
+    ClipBuf *buf = clipbuf_new(max_size);
+    char *selection;
     size_t pos = 0;
+
+    if (!buf) {
+        return;
+    }
+    selection = (char *)buf->data;
     selection[0] = '\0';
 
     for (int r = sr; r <= er; r++) {
@@ -373,8 +743,13 @@ void copy_to_clipboard(Display *display, Window window) {
         selection[pos] = '\0';
     }
 
-    clipboard_set_data(display, window, (const uint8_t *)selection, pos);
-    free(selection);
+    /* Hand the buffer over as is; the slack past pos is never sent. */
+    buf->len = pos;
+    if (pos == 0) {
+        clipbuf_unref(buf);
+        buf = NULL;
+    }
+    clipboard_set_buf(display, window, buf);
 }
 
 void paste_from_clipboard(Display *display, Window window) {
@@ -384,39 +759,162 @@ void paste_from_clipboard(Display *display, Window window) {
     XConvertSelection(display, clipboard, utf8_string, xsel_data, window, CurrentTime);
 }
 
-void handle_paste_event(Display *display, Window window, XEvent *event, int pty_fd) {
-    if (event->type != SelectionNotify) return;
+static uint8_t *paste_queue_tail(size_t need) {
+    if (g_paste.q_head + g_paste.q_len + need > PASTE_QUEUE_SIZE) {
+        memmove(g_paste.queue, g_paste.queue + g_paste.q_head, g_paste.q_len);
+        g_paste.q_head = 0;
+    }
+    return g_paste.queue + g_paste.q_head + g_paste.q_len;
+}
 
-    Atom utf8_string = XInternAtom(display, "UTF8_STRING", False);
-    Atom xsel_data   = XInternAtom(display, "XSEL_DATA", False);
+static void paste_queue_commit(const uint8_t *tail, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (term_state.echo_mode) {
+        terminal_consume_bytes(tail, len, &term_state, NULL, NULL);
+    }
+    g_paste.q_len += len;
+}
 
+static void paste_finish(void) {
+    uint8_t *tail = paste_queue_tail(PASTE_STREAM_SLACK);
+
+    paste_queue_commit(tail, terminal_paste_stream_end(&g_paste.stream, tail, PASTE_STREAM_SLACK));
+    g_paste.active = 0;
+    g_paste.incr = 0;
+    g_paste.chunk_ready = 0;
+    g_paste.offset = 0;
+}
+
+/* Move property data into the write queue while there is room.  Reads leave
+ * 2 * PASTE_STREAM_SLACK free so the closing marker always fits. */
+static void paste_pump(Display *display, Window window) {
+    Atom xsel_data = XInternAtom(display, "XSEL_DATA", False);
+
+    while (g_paste.active && g_paste.chunk_ready &&
+           PASTE_QUEUE_SIZE - g_paste.q_len >= PASTE_MIN_READ + 2 * PASTE_STREAM_SLACK) {
+        size_t room = PASTE_QUEUE_SIZE - g_paste.q_len - 2 * PASTE_STREAM_SLACK;
+        Atom actual_type;
+        int actual_format;
+        unsigned long nitems, bytes_after;
+        unsigned char *data = NULL;
+        size_t nbytes;
+        int empty;
+
+        if (XGetWindowProperty(display, window, xsel_data, g_paste.offset, (long)(room / 4),
+                               False, AnyPropertyType, &actual_type, &actual_format,
+                               &nitems, &bytes_after, &data) != Success) {
+            paste_finish();
+            return;
+        }
+        if (actual_format != 8) {
+            /* Not text (or the property vanished): end the paste cleanly. */
+            if (data) XFree(data);
+            XDeleteProperty(display, window, xsel_data);
+            paste_finish();
+            return;
+        }
+
+        nbytes = (size_t)nitems;
+        empty = (nbytes == 0 && g_paste.offset == 0);
+        if (data && nbytes > 0) {
+            uint8_t *tail = paste_queue_tail(nbytes + PASTE_STREAM_SLACK);
+            paste_queue_commit(tail, terminal_paste_stream_feed(&g_paste.stream, data, nbytes,
+                                                                tail, nbytes + PASTE_STREAM_SLACK));
+        }
+        if (data) XFree(data);
+        g_paste.offset += (long)(nbytes / 4);
+        if (bytes_after > 0) {
+            continue;
+        }
+
+        /* Property consumed.  With INCR, deleting it asks for the next chunk;
+         * a zero-length chunk ends the transfer. */
+        XDeleteProperty(display, window, xsel_data);
+        g_paste.chunk_ready = 0;
+        g_paste.offset = 0;
+        if (!g_paste.incr || empty) {
+            paste_finish();
+        }
+    }
+}
+
+void handle_paste_event(Display *display, Window window, XEvent *event, int pty_fd) {
+    Atom xsel_data;
+    Atom incr;
     Atom actual_type;
     int actual_format;
     unsigned long nitems, bytes_after;
     unsigned char *data = NULL;
 
-    XGetWindowProperty(display, window, xsel_data, 0, 1<<20, False, utf8_string,
-                       &actual_type, &actual_format, &nitems, &bytes_after, &data);
-
-    if (data && pty_fd >= 0) {
-        size_t payload_cap = (size_t)nitems + 16;
-        uint8_t *payload = malloc(payload_cap);
-        size_t payload_len = 0;
-
-        if (payload) {
-            payload_len = terminal_format_paste_payload(
-                (const uint8_t *)data,
-                (size_t)nitems,
-                term_state.bracketed_paste_mode,
-                payload,
-                payload_cap);
-            if (payload_len > 0) {
-                tty_write_all_may_echo(pty_fd, payload, payload_len, 1);
+    if (event->type != SelectionNotify || event->xselection.property == None) return;
+
+    xsel_data = XInternAtom(display, "XSEL_DATA", False);
+    incr      = XInternAtom(display, "INCR", False);
+
+    /* Peek at the type only; data is read in chunks by paste_pump(). */
+    if (XGetWindowProperty(display, window, xsel_data, 0, 0, False, AnyPropertyType,
+                           &actual_type, &actual_format, &nitems, &bytes_after, &data) != Success) {
+        return;
+    }
+    if (data) XFree(data);
+
+    if (g_paste.active) {
+        paste_finish();
+    }
+    terminal_scrollback_reset();
+    g_paste.active = 1;
+    g_paste.offset = 0;
+    terminal_paste_stream_begin(&g_paste.stream, term_state.bracketed_paste_mode);
+
+    if (actual_type == incr) {
+        g_paste.incr = 1;
+        g_paste.chunk_ready = 0;
+        XDeleteProperty(display, window, xsel_data);  /* start the transfer */
+    } else {
+        g_paste.incr = 0;
+        g_paste.chunk_ready = 1;
+    }
+    input_paste_flush(display, window, pty_fd);
+}
+
+int handle_paste_property(Display *display, Window window, XEvent *event) {
+    if (event->type != PropertyNotify || !g_paste.active || !g_paste.incr) return 0;
+    if (event->xproperty.state != PropertyNewValue ||
+        event->xproperty.atom != XInternAtom(display, "XSEL_DATA", False)) return 0;
+
+    g_paste.chunk_ready = 1;
+    g_paste.offset = 0;
+    paste_pump(display, window);
+    return 1;
+}
+
+int input_paste_pending(void) {
+    return g_paste.q_len > 0;
+}
+
+void input_paste_flush(Display *display, Window window, int pty_fd) {
+    paste_pump(display, window);
+    while (g_paste.q_len > 0 && pty_fd >= 0) {
+        ssize_t rc = write(pty_fd, g_paste.queue + g_paste.q_head, g_paste.q_len);
+        if (rc > 0) {
+            g_paste.q_head += (size_t)rc;
+            g_paste.q_len -= (size_t)rc;
+            if (g_paste.q_len == 0) {
+                g_paste.q_head = 0;
             }
-            free(payload);
+            paste_pump(display, window);
+            continue;
         }
-
-        XFree(data);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            g_paste.q_head = 0;   /* PTY gone: drop the rest */
+            g_paste.q_len = 0;
+        }
+        break;  /* PTY full: main loop selects for writability */
     }
 }
 
@@ -543,6 +1041,9 @@ void handle_keypress(Display *display, Window window, XEvent *event, int pty_fd)
 
     g_pty_fd = pty_fd;
 
+    if (g_find.mode != FIND_OFF && find_keypress(keysym, state, buffer, len))
+        return;
+
     /* 1. Check shortcuts */
     for (bp = shortcuts; bp < shortcuts + LEN(shortcuts); bp++) {
         if (keysym == bp->keysym && match(bp->mod, state)) {
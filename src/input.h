@@ -10,11 +10,23 @@ void handle_keypress(Display *display, Window window, XEvent *event, int pty_fd)
 /* Returns 1 if mouse shortcut was handled, 0 otherwise */
 int handle_mouse_shortcut(XEvent *event, int pty_fd);
 void handle_paste_event(Display *display, Window window, XEvent *event, int pty_fd);
+/* INCR paste chunks: returns 1 if the PropertyNotify belonged to a paste */
+int handle_paste_property(Display *display, Window window, XEvent *event);
+/* Queued paste bytes waiting for the PTY to become writable */
+int input_paste_pending(void);
+void input_paste_flush(Display *display, Window window, int pty_fd);
 void copy_to_clipboard(Display *display, Window window);
 void paste_from_clipboard(Display *display, Window window);
 const unsigned char *clipboard_get_data(size_t *len_out);
 void clipboard_set_data(Display *display, Window window, const uint8_t *data, size_t len);
 
+/* Selection owner: answer SelectionRequest (TARGETS, UTF8_STRING, TEXT,
+   STRING; INCR for large data), continue INCR transfers on PropertyDelete
+   (returns 1 if the event belonged to one) and drop data on SelectionClear */
+void selection_handle_request(Display *display, XEvent *event);
+int selection_handle_property(Display *display, XEvent *event);
+void selection_handle_clear(Display *display, XEvent *event);
+
 /* Mouse reporting: event_type 0=press 1=release 2=motion; button 0=left 1=mid 2=right;
    col,row are 1-based; modifiers from X event state; sgr_mode uses <b;x;y;M/m format */
 void send_mouse_report(int pty_fd, int event_type, int button, int col, int row,
@@ -26,4 +38,7 @@ void selection_extend(int col, int row);
 void selection_release(Display *display, Window window, int col, int row);
 void selection_get_effective_bounds(int *sr, int *sc, int *er, int *ec);
 
+/* Scrollback search (search.h): the prompt is taking text, not n/N */
+int input_search_editing(void);
+
 #endif // INPUT_H
@@ -0,0 +1,420 @@
+// iolog.c - bounded, non-blocking tee of PTY output to a file (-o / -O)
+#define _POSIX_C_SOURCE 200809L
+#include "iolog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Larger writes are split so the writer's scratch buffers stay fixed-size. */
+#define IOLOG_MAX_RECORD 65536
+/* Bytes carried between asciicast events when a UTF-8 sequence is split. */
+#define IOLOG_UTF8_CARRY 4
+
+typedef struct {
+    double t;          /* seconds since iolog_open */
+    uint32_t len;
+    uint8_t type;      /* 'o' output, 'r' resize */
+} IologRecord;
+
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *ring;
+    size_t size;
+    size_t head;       /* next byte to write */
+    size_t tail;       /* next byte to read */
+    size_t used;
+    int running;
+    int stopping;
+    int failed;
+    int opened;        /* writer is past open() */
+    char *path;
+    char term[64];
+    IologFormat format;
+    int rows, cols;    /* current size, for resize events */
+    int header_rows, header_cols;
+    struct timespec start;
+    IologStats stats;
+} g_log = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static double elapsed_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - g_log.start.tv_sec) +
+           (double)(now.tv_nsec - g_log.start.tv_nsec) / 1e9;
+}
+
+static void ring_put(const void *src, size_t n) {
+    size_t first = g_log.size - g_log.head;
+
+    if (first > n) first = n;
+    memcpy(g_log.ring + g_log.head, src, first);
+    memcpy(g_log.ring, (const uint8_t *)src + first, n - first);
+    g_log.head = (g_log.head + n) % g_log.size;
+    g_log.used += n;
+}
+
+static void ring_get(void *dst, size_t n) {
+    size_t first = g_log.size - g_log.tail;
+
+    if (first > n) first = n;
+    memcpy(dst, g_log.ring + g_log.tail, first);
+    memcpy((uint8_t *)dst + first, g_log.ring, n - first);
+    g_log.tail = (g_log.tail + n) % g_log.size;
+    g_log.used -= n;
+}
+
+/* Caller holds the lock. */
+static void push_record(uint8_t type, const uint8_t *bytes, size_t len) {
+    IologRecord rec;
+
+    if (g_log.failed || sizeof(rec) + len > g_log.size - g_log.used) {
+        if (type == 'o') {
+            g_log.stats.drops++;
+            g_log.stats.bytes_dropped += len;
+        }
+        return;
+    }
+    rec.t = elapsed_sec();
+    rec.len = (uint32_t)len;
+    rec.type = type;
+    ring_put(&rec, sizeof(rec));
+    ring_put(bytes, len);
+    if (type == 'o')
+        g_log.stats.bytes_in += len;
+    pthread_cond_signal(&g_log.cond);
+}
+
+static int write_all(int fd, const uint8_t *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Length of a complete, valid UTF-8 sequence at p, 0 if truncated by the end
+ * of the buffer, -1 if invalid.  Strict about overlongs and surrogates so the
+ * JSON output is always valid. */
+static int utf8_seq(const uint8_t *p, size_t avail) {
+    uint8_t lo = 0x80, hi = 0xBF;
+    int n;
+
+    if (p[0] >= 0xC2 && p[0] <= 0xDF) n = 2;
+    else if (p[0] >= 0xE0 && p[0] <= 0xEF) n = 3;
+    else if (p[0] >= 0xF0 && p[0] <= 0xF4) n = 4;
+    else return -1;
+    if (p[0] == 0xE0) lo = 0xA0;
+    else if (p[0] == 0xED) hi = 0x9F;
+    else if (p[0] == 0xF0) lo = 0x90;
+    else if (p[0] == 0xF4) hi = 0x8F;
+    for (int i = 1; i < n; i++) {
+        if ((size_t)i >= avail) return 0;
+        if (p[i] < lo || p[i] > hi) return -1;
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    return n;
+}
+
+/* Escape in[0..len) as a JSON string body.  A UTF-8 sequence cut off at the
+ * end is left unconsumed; returns the number of input bytes consumed. */
+static size_t json_escape(const uint8_t *in, size_t len, uint8_t *out, size_t *out_len) {
+    static const char hex[] = "0123456789abcdef";
+    size_t i = 0, o = 0;
+
+    while (i < len) {
+        uint8_t c = in[i];
+        if (c == '"' || c == '\\') {
+            out[o++] = '\\';
+            out[o++] = c;
+            i++;
+        } else if (c < 0x20 || c == 0x7F) {
+            out[o++] = '\\';
+            out[o++] = 'u';
+            out[o++] = '0';
+            out[o++] = '0';
+            out[o++] = (uint8_t)hex[c >> 4];
+            out[o++] = (uint8_t)hex[c & 0xF];
+            i++;
+        } else if (c < 0x80) {
+            out[o++] = c;
+            i++;
+        } else {
+            int n = utf8_seq(in + i, len - i);
+            if (n == 0)
+                break;
+            if (n < 0) {
+                memcpy(out + o, "\\ufffd", 6);
+                o += 6;
+                i++;
+            } else {
+                memcpy(out + o, in + i, (size_t)n);
+                o += (size_t)n;
+                i += (size_t)n;
+            }
+        }
+    }
+    *out_len = o;
+    return i;
+}
+
+static int open_target(void) {
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int fd;
+
+    if (strcmp(g_log.path, "-") == 0)
+        return STDOUT_FILENO;
+    fd = open(g_log.path, flags | O_NONBLOCK, 0666);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        return fd;
+    }
+    if (errno != ENXIO)
+        return -1;
+    /* FIFO without a reader: wait for one.  The ring absorbs (and then
+     * drops) output meanwhile; iolog_close() can release us. */
+    return open(g_log.path, flags, 0666);
+}
+
+static void writer_fail(const char *what) {
+    fprintf(stderr, "cupidterminal: %s '%s': %s\n", what, g_log.path, strerror(errno));
+    pthread_mutex_lock(&g_log.lock);
+    g_log.failed = 1;
+    g_log.stats.bytes_dropped += g_log.used;
+    g_log.head = g_log.tail = g_log.used = 0;
+    pthread_mutex_unlock(&g_log.lock);
+}
+
+static void *writer_main(void *arg) {
+    /* Room for the carried UTF-8 prefix in front of each record. */
+    static uint8_t rec_buf[IOLOG_UTF8_CARRY + IOLOG_MAX_RECORD];
+    /* Worst case: every byte becomes \u00XX, plus the event framing. */
+    static uint8_t out_buf[IOLOG_MAX_RECORD * 6 + 64];
+    size_t carry = 0;
+    int fd;
+
+    (void)arg;
+    fd = open_target();
+    pthread_mutex_lock(&g_log.lock);
+    g_log.opened = 1;
+    /* Closed while we waited for a FIFO reader: queued output was dropped. */
+    if (g_log.failed && fd >= 0) {
+        pthread_mutex_unlock(&g_log.lock);
+        goto out;
+    }
+    pthread_mutex_unlock(&g_log.lock);
+    if (fd < 0) {
+        writer_fail("cannot open");
+        return NULL;
+    }
+
+    if (g_log.format == IOLOG_ASCIICAST) {
+        char header[256];
+        int n = snprintf(header, sizeof(header),
+                         "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %ld, "
+                         "\"env\": {\"TERM\": \"%s\"}}\n",
+                         g_log.header_cols, g_log.header_rows, (long)time(NULL),
+                         g_log.term);
+        if (write_all(fd, (const uint8_t *)header, (size_t)n) < 0) {
+            writer_fail("cannot write");
+            goto out;
+        }
+    }
+
+    for (;;) {
+        IologRecord rec;
+        uint8_t *data = rec_buf + IOLOG_UTF8_CARRY;
+        const uint8_t *out;
+        size_t out_len;
+
+        pthread_mutex_lock(&g_log.lock);
+        while (g_log.used == 0 && !g_log.stopping)
+            pthread_cond_wait(&g_log.cond, &g_log.lock);
+        if (g_log.used == 0) {
+            pthread_mutex_unlock(&g_log.lock);
+            break;
+        }
+        ring_get(&rec, sizeof(rec));
+        ring_get(data, rec.len);
+        pthread_mutex_unlock(&g_log.lock);
+
+        if (g_log.format == IOLOG_RAW) {
+            if (rec.type != 'o')
+                continue;
+            out = data;
+            out_len = rec.len;
+        } else if (rec.type == 'r') {
+            out_len = (size_t)snprintf((char *)out_buf, sizeof(out_buf),
+                                       "[%.6f, \"r\", \"%.*s\"]\n", rec.t, (int)rec.len, data);
+            out = out_buf;
+        } else {
+            uint8_t *start = data - carry;
+            size_t total = carry + rec.len, used, body;
+            int n = snprintf((char *)out_buf, sizeof(out_buf), "[%.6f, \"o\", \"", rec.t);
+
+            used = json_escape(start, total, out_buf + n, &body);
+            /* Only a truncated sequence (< 4 bytes) is held back. */
+            carry = total - used;
+            memmove(rec_buf + IOLOG_UTF8_CARRY - carry, start + used, carry);
+            memcpy(out_buf + n + body, "\"]\n", 3);
+            out = out_buf;
+            out_len = (size_t)n + body + 3;
+        }
+        if (write_all(fd, out, out_len) < 0) {
+            writer_fail("cannot write");
+            break;
+        }
+        if (rec.type == 'o') {
+            pthread_mutex_lock(&g_log.lock);
+            g_log.stats.bytes_written += rec.len;
+            pthread_mutex_unlock(&g_log.lock);
+        }
+    }
+out:
+    if (fd != STDOUT_FILENO)
+        close(fd);
+    return NULL;
+}
+
+int iolog_open(const char *path, IologFormat format, size_t ring_size,
+               const char *term, int rows, int cols) {
+    sigset_t all, old;
+    int rc;
+
+    if (!path || g_log.running)
+        return -1;
+    /* Must at least hold one full-size record. */
+    if (ring_size < sizeof(IologRecord) + IOLOG_MAX_RECORD)
+        ring_size = sizeof(IologRecord) + IOLOG_MAX_RECORD;
+    g_log.ring = malloc(ring_size);
+    g_log.path = strdup(path);
+    if (!g_log.ring || !g_log.path) {
+        free(g_log.ring);
+        free(g_log.path);
+        g_log.ring = NULL;
+        g_log.path = NULL;
+        return -1;
+    }
+    g_log.size = ring_size;
+    g_log.head = g_log.tail = g_log.used = 0;
+    g_log.stopping = g_log.failed = g_log.opened = 0;
+    g_log.format = format;
+    /* TERM goes into the asciicast header verbatim: keep it JSON-safe. */
+    snprintf(g_log.term, sizeof(g_log.term), "%s",
+             term && !strpbrk(term, "\"\\") ? term : "xterm-256color");
+    g_log.rows = g_log.header_rows = rows;
+    g_log.cols = g_log.header_cols = cols;
+    memset(&g_log.stats, 0, sizeof(g_log.stats));
+    clock_gettime(CLOCK_MONOTONIC, &g_log.start);
+
+    /* Keep SIGCHLD & co. on the main thread; with SIGPIPE blocked a FIFO
+     * whose reader went away just fails the write with EPIPE. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&g_log.thread, NULL, writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        free(g_log.ring);
+        free(g_log.path);
+        g_log.ring = NULL;
+        g_log.path = NULL;
+        return -1;
+    }
+    g_log.running = 1;
+    return 0;
+}
+
+void iolog_write(const uint8_t *bytes, size_t len) {
+    if (!g_log.running || len == 0)
+        return;
+    pthread_mutex_lock(&g_log.lock);
+    while (len > 0) {
+        size_t n = len > IOLOG_MAX_RECORD ? IOLOG_MAX_RECORD : len;
+        push_record('o', bytes, n);
+        bytes += n;
+        len -= n;
+    }
+    pthread_mutex_unlock(&g_log.lock);
+}
+
+void iolog_resize(int rows, int cols) {
+    char size[32];
+    int n;
+
+    if (!g_log.running || g_log.format != IOLOG_ASCIICAST)
+        return;
+    n = snprintf(size, sizeof(size), "%dx%d", cols, rows);
+    pthread_mutex_lock(&g_log.lock);
+    if (rows == g_log.rows && cols == g_log.cols) {
+        pthread_mutex_unlock(&g_log.lock);
+        return;
+    }
+    g_log.rows = rows;
+    g_log.cols = cols;
+    push_record('r', (const uint8_t *)size, (size_t)n);
+    pthread_mutex_unlock(&g_log.lock);
+}
+
+void iolog_close(void) {
+    int reader = -1;
+    struct stat sb;
+
+    if (!g_log.running)
+        return;
+    pthread_mutex_lock(&g_log.lock);
+    g_log.stopping = 1;
+    if (!g_log.opened && stat(g_log.path, &sb) == 0 && S_ISFIFO(sb.st_mode)) {
+        /* The writer may be stuck waiting for a FIFO reader that never
+         * comes.  Drop what is queued and open the read end ourselves so its
+         * open() returns and it can exit. */
+        g_log.stats.bytes_dropped += g_log.used;
+        if (g_log.used > 0)
+            g_log.stats.drops++;
+        g_log.head = g_log.tail = g_log.used = 0;
+        g_log.failed = 1;
+        reader = open(g_log.path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    pthread_cond_signal(&g_log.cond);
+    pthread_mutex_unlock(&g_log.lock);
+    pthread_join(g_log.thread, NULL);
+    if (reader >= 0)
+        close(reader);
+    g_log.running = 0;
+    free(g_log.ring);
+    free(g_log.path);
+    g_log.ring = NULL;
+    g_log.path = NULL;
+}
+
+int iolog_active(void) {
+    int active;
+
+    pthread_mutex_lock(&g_log.lock);
+    active = g_log.running && !g_log.failed;
+    pthread_mutex_unlock(&g_log.lock);
+    return active;
+}
+
+void iolog_get_stats(IologStats *out) {
+    pthread_mutex_lock(&g_log.lock);
+    *out = g_log.stats;
+    pthread_mutex_unlock(&g_log.lock);
+}
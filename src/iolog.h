@@ -0,0 +1,44 @@
+#ifndef IOLOG_H
+#define IOLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * PTY output tee (-o / -O).
+ *
+ * The main loop copies each PTY read into a bounded ring; a writer thread
+ * opens the target (file, FIFO or "-" for stdout) and drains the ring, so a
+ * slow disk or an unread FIFO never stalls parsing.  When the ring is full
+ * the chunk is dropped and counted instead of blocking.  In asciicast mode
+ * each chunk is written as a timestamped asciicast v2 "o" event.
+ */
+
+typedef enum {
+    IOLOG_RAW = 0,
+    IOLOG_ASCIICAST
+} IologFormat;
+
+typedef struct {
+    unsigned long long bytes_in;      /* bytes accepted into the ring */
+    unsigned long long bytes_written; /* bytes of PTY output written out */
+    unsigned long long bytes_dropped; /* bytes discarded on overflow/error */
+    unsigned long drops;              /* chunks discarded */
+} IologStats;
+
+/* Start the writer thread.  ring_size bounds memory use; term and rows/cols
+ * go into the asciicast header.  Returns 0 on success, -1 if the thread
+ * could not be started.  Errors opening or writing the target are reported
+ * on stderr by the writer and disable the log. */
+int iolog_open(const char *path, IologFormat format, size_t ring_size,
+               const char *term, int rows, int cols);
+/* Queue PTY output; never blocks on I/O.  No-op when no log is open. */
+void iolog_write(const uint8_t *bytes, size_t len);
+/* Record a window size change (asciicast "r" event; ignored in raw mode). */
+void iolog_resize(int rows, int cols);
+/* Flush what is queued, stop the writer and close the target. */
+void iolog_close(void);
+int iolog_active(void);
+void iolog_get_stats(IologStats *out);
+
+#endif /* IOLOG_H */
@@ -17,9 +17,17 @@
 #include "arg.h"
 #include "draw.h"  /* DRAW_LEFT_PAD, DRAW_TOP_PAD for winsize */
 #include "input.h"
+#include "iolog.h"
+#include "perf.h"
 #include "config.h"
+#include "daemon.h"
+#include "frame_sched.h"
 #include "pty_session.h"
+#include "replay.h"
+#include "search.h"
+#include "seqprof.h"
 #include "terminal_state.h"
+#include "trace.h"
 
 #define BUF_SIZE 65536
 #define VERSION "0.1"
@@ -44,20 +52,33 @@ double defaultfontsize = 0;
 char **opt_cmd = NULL;
 char *opt_embed = NULL;
 char *opt_io = NULL;
+int opt_io_cast = 0;
 char *opt_line = NULL;
 char *opt_name = NULL;
 char *opt_title = NULL;
 int opt_fixed = 0;
+char *opt_replay = NULL;
+int opt_replay_timing = 0;
+int opt_startup_bench = 0;
+int opt_daemon = 0;
+int opt_client = 0;
+char *opt_socket = NULL;
+int opt_spill = 0;          /* 1 --spill, 2 --keep-spill */
 unsigned int cols = 80;
 unsigned int rows = 24;
 
 static void usage(void) {
     fprintf(stderr, "usage: cupidterminal [-aiv] [-c class] [-f font] [-g geometry] "
-        "[-n name] [-o file]\n"
+        "[-n name] [-o file | -O file]\n"
         "          [-T title] [-t title] [-w windowid] [[-e] command [args ...]]\n"
         "       cupidterminal [-aiv] [-c class] [-f font] [-g geometry] "
-        "[-n name] [-o file]\n"
-        "          [-T title] [-t title] [-w windowid] -l line [stty_args ...]\n");
+        "[-n name] [-o file | -O file]\n"
+        "          [-T title] [-t title] [-w windowid] -l line [stty_args ...]\n"
+        "       cupidterminal [-f font] [-g geometry] --replay file [--replay-timing]\n"
+        "       cupidterminal --startup-bench [options] [[-e] command [args ...]]\n"
+        "       cupidterminal --spill | --keep-spill [options] [[-e] command [args ...]]\n"
+        "       cupidterminal --daemon [--socket path]\n"
+        "       cupidterminal --client [--socket path] [options] [[-e] command [args ...]]\n");
     exit(1);
 }
 
@@ -67,11 +88,15 @@ static PtySession g_pty_session = {
     .child_exited = 0,
     .child_status = 0,
 };
+/* The window's terminal.  The renderer, input and search reach the same one
+   through the term_default names. */
+static Terminal *const g_term = &term_default;
+
 static volatile sig_atomic_t g_sigchld_pending = 0;
+static volatile sig_atomic_t g_perf_dump_pending = 0;
 
 extern int g_cell_w, g_cell_h; 
 extern int g_cell_gap;
-const unsigned char *clipboard_get_data(size_t *len_out);
 
 /* SIGWINCH: when run from another terminal, forwarding would use the parent
    terminal's size instead of our X11 window. We rely on ConfigureNotify for
@@ -85,6 +110,35 @@ static void handle_sigchld(int sig) {
     g_sigchld_pending = 1;
 }
 
+/* SIGUSR1: print the performance counters (perf.h) from the main loop. */
+static void handle_sigusr1(int sig) {
+    (void)sig;
+    g_perf_dump_pending = 1;
+}
+
+#ifdef CUPID_TRACE
+static volatile sig_atomic_t g_trace_dump_pending = 0;
+
+/* SIGUSR2: write the trace ring to tracefile from the main loop. */
+static void handle_sigusr2(int sig) {
+    (void)sig;
+    g_trace_dump_pending = 1;
+}
+
+static void write_trace(void) {
+    if (trace_dump(tracefile) < 0)
+        fprintf(stderr, "cupidterminal: cannot write trace '%s': %s\n", tracefile, strerror(errno));
+    else
+        fprintf(stderr, "cupidterminal: wrote %zu trace events to %s\n", trace_count(), tracefile);
+}
+#endif
+
+#ifdef CUPID_SEQPROF
+static void report_seqprof(void) {
+    seqprof_report(stderr);
+}
+#endif
+
 static void reap_child_processes(void) {
     int rc;
 
@@ -134,7 +188,28 @@ static void sync_pty_winsize_from_window(Display *display, Window window, PtySes
     }
 
     pty_session_set_winsize(session, ws_row, ws_col);
-    resize_terminal(ws_row, ws_col);
+    TRACE_BEGIN(t_resize);
+    terminal_resize(g_term, ws_row, ws_col);
+    TRACE_END(t_resize, "resize", "io", (uint64_t)ws_row * ws_col);
+    iolog_resize(ws_row, ws_col);
+}
+
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* Wait up to timeout_ms for fd to become readable. */
+static int wait_readable(int fd, double timeout_ms) {
+    fd_set rfds;
+    struct timeval tv;
+
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
+    tv.tv_sec = (long)(timeout_ms / 1000);
+    tv.tv_usec = (long)((timeout_ms - tv.tv_sec * 1000.0) * 1000);
+    return select(fd + 1, &rfds, NULL, NULL, &tv) > 0;
 }
 
 static void on_font_metrics_changed(Display *display, Window window) {
@@ -148,21 +223,32 @@ static void pty_response_cb(const uint8_t *bytes, size_t len, void *ctx) {
     }
 }
 
-int handle_pty_output(Display *display, Window window, GC gc, PtySession *session, TerminalState *state) {
+int handle_pty_output(Display *display, Window window, GC gc, PtySession *session,
+                      Terminal *term, size_t *bytes_read) {
     (void)gc;
+    TerminalState *state = &term->state;
     char buf[BUF_SIZE];
     int got_data = 0;
+    unsigned long sync_ends = state->sync_ends;
+
+    *bytes_read = 0;
 
     /* Drain all available PTY data before returning so that a single btop
      * redraw frame (10-30 KB) is fully parsed in one call rather than spread
      * across several select() iterations.  The master fd is O_NONBLOCK so
      * read() returns EAGAIN as soon as the kernel buffer is empty. */
     for (;;) {
+        TRACE_BEGIN(t_read);
         ssize_t num_read = pty_session_read(session, buf, BUF_SIZE - 1);
+        TRACE_END(t_read, "read", "io", num_read > 0 ? num_read : 0);
         if (num_read > 0) {
             got_data = 1;
-            terminal_consume_bytes((const uint8_t *)buf, (size_t)num_read,
-                                   state, pty_response_cb, session);
+            *bytes_read += (size_t)num_read;
+            perf.read_calls++;
+            perf.read_bytes += (size_t)num_read;
+            iolog_write((const uint8_t *)buf, (size_t)num_read);
+            terminal_feed(term, (const uint8_t *)buf, (size_t)num_read,
+                          pty_response_cb, session);
             if (state->title_dirty) {
                 XStoreName(display, window,
                            state->window_title[0] ? state->window_title
@@ -175,6 +261,10 @@ int handle_pty_output(Display *display, Window window, GC gc, PtySession *sessio
                 state->osc52_pending = 0;
                 state->osc52_len = 0;
             }
+            /* A synchronized update just finished: stop here so its frame
+             * goes out before the next one is parsed over it. */
+            if (state->sync_ends != sync_ends)
+                break;
         } else if (num_read == 0) {
             return 0; /* EOF / child exited */
         } else {
@@ -182,15 +272,191 @@ int handle_pty_output(Display *display, Window window, GC gc, PtySession *sessio
             break; /* EAGAIN / EWOULDBLOCK — kernel buffer empty */
         }
     }
-    /* draw deferred to main loop (latency batching) */
+    /* draw deferred to main loop (frame scheduler) */
     return got_data ? 1 : 0;
 }
 
-int main(int argc, char *argv[]) {
+/* Drain the PTY and report the bytes and parse time to the scheduler. */
+static int read_pty_output(Display *display, Window window, GC gc, FrameScheduler *sched) {
+    size_t nread = 0;
+    unsigned long sync_ends = terminal_get_state(g_term)->sync_ends;
+    double start = monotonic_ms();
+    int alive = handle_pty_output(display, window, gc, &g_pty_session, g_term, &nread);
+    double end = monotonic_ms();
+    const TerminalState *state = terminal_get_state(g_term);
+
+    frame_sched_note_output(sched, end, nread, end - start);
+    if (state->sync_ends != sync_ends)
+        frame_sched_note_sync_end(sched, end);
+    frame_sched_set_sync(sched, state->sync_update, end);
+    return alive;
+}
+
+/* Long options are not understood by arg.h: pull them out of argv first. */
+static void parse_long_options(int *argc, char *argv[]) {
+    int out = 1;
+
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--") == 0 || strcmp(argv[i], "-e") == 0) {
+            while (i < *argc)
+                argv[out++] = argv[i++];
+            break;
+        }
+        if (strcmp(argv[i], "--replay") == 0) {
+            if (i + 1 >= *argc)
+                usage();
+            opt_replay = argv[++i];
+        } else if (strcmp(argv[i], "--replay-timing") == 0) {
+            opt_replay_timing = 1;
+        } else if (strcmp(argv[i], "--startup-bench") == 0) {
+            opt_startup_bench = 1;
+        } else if (strcmp(argv[i], "--spill") == 0) {
+            opt_spill = 1;
+        } else if (strcmp(argv[i], "--keep-spill") == 0) {
+            opt_spill = 2;
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            opt_daemon = 1;
+        } else if (strcmp(argv[i], "--client") == 0) {
+            opt_client = 1;
+        } else if (strcmp(argv[i], "--socket") == 0) {
+            if (i + 1 >= *argc)
+                usage();
+            opt_socket = argv[++i];
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argv[out] = NULL;
+    *argc = out;
+}
+
+/* --startup-bench: milestones on the way to the first frame, in ms from
+ * the start of main() (the dynamic loader's share is not included). */
+typedef struct {
+    double start;
+    double display;     /* X connection open */
+    double window;      /* window created and mapped */
+    double pty;         /* child spawned */
+    double fonts;       /* regular face, colours, cell metrics */
+} StartupTimes;
+
+static void report_startup(Display *display, const StartupTimes *st) {
+    double end;
+
+    /* Round trip: the server has executed the XCopyArea. */
+    XSync(display, False);
+    end = monotonic_ms();
+    printf("startup: %.2f ms to first frame (display %.2f, window %.2f, pty %.2f, "
+           "fonts %.2f, frame %.2f)\n",
+           end - st->start, st->display - st->start, st->window - st->display,
+           st->pty - st->window, st->fonts - st->pty, end - st->fonts);
+    fflush(stdout);
+}
+
+static void replay_handle_events(Display *display, Window window, int *quit) {
+    XEvent event;
+
+    while (XPending(display)) {
+        XNextEvent(display, &event);
+        if (event.type == Expose) {
+            draw_notify_expose();
+        } else if (event.type == ConfigureNotify) {
+            draw_notify_resize(event.xconfigure.width, event.xconfigure.height);
+            sync_pty_winsize_from_window(display, window, &g_pty_session);
+        } else if (event.type == ClientMessage) {
+            *quit = 1;
+        }
+    }
+}
+
+/* --replay: feed a recorded stream through the parser and renderer with no
+ * child process, one frame per recorded read, then report timings.  Frames
+ * end with XSync so server-side rendering is included in the frame time. */
+static int run_replay(Display *display, Window window, GC gc) {
+    Replay rp;
+    ReplayStats st = { 0 };
+    XEvent event;
+    double start;
+    int quit = 0;
+
+    if (replay_load(opt_replay, BUF_SIZE - 1, &rp) < 0) {
+        fprintf(stderr, "cupidterminal: cannot replay '%s': %s\n", opt_replay, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (opt_replay_timing && !rp.timed)
+        fprintf(stderr, "cupidterminal: '%s' has no timing, replaying at full speed\n", opt_replay);
+
+    /* Don't start the clock before the window can show anything. */
+    do {
+        XNextEvent(display, &event);
+        if (event.type == ConfigureNotify) {
+            draw_notify_resize(event.xconfigure.width, event.xconfigure.height);
+            sync_pty_winsize_from_window(display, window, &g_pty_session);
+        }
+    } while (event.type != Expose);
+    draw_notify_expose();
+
+    start = monotonic_ms();
+    for (size_t i = 0; i < rp.count && !quit; i++) {
+        const ReplayChunk *c = &rp.chunks[i];
+        double t;
+
+        replay_handle_events(display, window, &quit);
+        if (opt_replay_timing && rp.timed) {
+            double wait = start + c->t * 1000.0 - monotonic_ms();
+            if (wait > 0)
+                (void)wait_readable(ConnectionNumber(display), wait);
+        }
+
+        t = monotonic_ms();
+        terminal_feed(g_term, c->data, c->len, NULL, NULL);
+        st.parse_ms += monotonic_ms() - t;
+        st.bytes += c->len;
+
+        t = monotonic_ms();
+        draw_text(display, window, gc);
+        XSync(display, False);
+        t = monotonic_ms() - t;
+        replay_stats_note_frame(&st, t);
+        perf_note_frame(t);
+    }
+    st.wall_ms = monotonic_ms() - start;
+
+    replay_stats_report(&st, stdout);
+    replay_stats_free(&st);
+    replay_free(&rp);
+    return EXIT_SUCCESS;
+}
+
+/* Stop the -o/-O writer, flushing what is queued, and say if output was lost. */
+static void close_io_log(void) {
+    IologStats st;
+
+    if (!opt_io)
+        return;
+    iolog_close();
+    iolog_get_stats(&st);
+    if (st.drops > 0) {
+        fprintf(stderr, "cupidterminal: %s: dropped %llu bytes in %lu chunks (writer too slow)\n",
+                opt_io, st.bytes_dropped, st.drops);
+    }
+}
+
+/* Close the scrollback spill file, saying where it was kept if it was. */
+static void close_spill(void) {
+    const char *kept = terminal_spill_path();
+
+    if (kept)
+        fprintf(stderr, "cupidterminal: scrollback kept in %s\n", kept);
+    terminal_spill_close();
+}
+
+/* One terminal window; start is when the process (or daemon child) began. */
+static int run_terminal(int argc, char *argv[], double start) {
     struct sigaction sa;
+    StartupTimes startup;
 
-    setlocale(LC_CTYPE, "");
-    XSetLocaleModifiers("");
+    startup.start = start;
 
     ARGBEGIN {
     case 'a':
@@ -216,6 +482,11 @@ int main(int argc, char *argv[]) {
         break;
     case 'o':
         opt_io = EARGF(usage());
+        opt_io_cast = 0;
+        break;
+    case 'O':
+        opt_io = EARGF(usage());
+        opt_io_cast = 1;
         break;
     case 'l':
         opt_line = EARGF(usage());
@@ -252,17 +523,39 @@ run:
 
     signal(SIGWINCH, handle_resize); // Handle window resize signals
 
+    sa.sa_handler = handle_sigusr1;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    if (sigaction(SIGUSR1, &sa, NULL) == -1) {
+        perror("sigaction SIGUSR1 failed");
+    }
+#ifdef CUPID_TRACE
+    sa.sa_handler = handle_sigusr2;
+    if (sigaction(SIGUSR2, &sa, NULL) == -1) {
+        perror("sigaction SIGUSR2 failed");
+    }
+    if (trace_init(tracesize) == 0)
+        atexit(write_trace);
+    else
+        fprintf(stderr, "cupidterminal: no memory for %u trace events\n", tracesize);
+#endif
+#ifdef CUPID_SEQPROF
+    atexit(report_seqprof);
+#endif
+
     Display *display;
     Window window;
     GC gc;
     XEvent event;
     fd_set fds;
+    fd_set wfds;
 
     display = XOpenDisplay(NULL);
     if (!display) {
         fprintf(stderr, "Failed to open X display\n");
         return EXIT_FAILURE;
     }
+    startup.display = monotonic_ms();
 
     int screen = DefaultScreen(display);
     window = XCreateSimpleWindow(display, RootWindow(display, screen),
@@ -280,20 +573,24 @@ run:
     }
     XSelectInput(display, window,
         ExposureMask | KeyPressMask | KeyReleaseMask | PropertyChangeMask |
-        StructureNotifyMask | FocusChangeMask |
+        StructureNotifyMask | FocusChangeMask | VisibilityChangeMask |
         ButtonPressMask | ButtonReleaseMask | PointerMotionMask);
     XMapWindow(display, window);
 
     gc = XCreateGC(display, window, 0, NULL);
+    startup.window = monotonic_ms();
 
-    /* Start shell / serial-line process */
-    if (pty_session_spawn(&g_pty_session, opt_line, SHELL, opt_cmd, TERM) == -1) {
+    /* Start shell / serial-line process (nothing to run when replaying) */
+    if (!opt_replay && pty_session_spawn(&g_pty_session, opt_line, SHELL, opt_cmd, TERM) == -1) {
         XCloseDisplay(display);
         return EXIT_FAILURE;
     }
+    startup.pty = monotonic_ms();
+    search_set_threads(searchthreads);
 
     initialize_xft(display, window);
     xft_set_font_change_hook(on_font_metrics_changed);
+    startup.fonts = monotonic_ms();
     {
         XWindowAttributes wa_init;
         if (XGetWindowAttributes(display, window, &wa_init)) {
@@ -301,54 +598,98 @@ run:
         }
     }
     sync_pty_winsize_from_window(display, window, &g_pty_session);
-    
-    // Intern atoms once
-    Atom XA_UTF8      = XInternAtom(display, "UTF8_STRING", False);
-    Atom XA_TEXT      = XInternAtom(display, "TEXT", False);
-    Atom XA_TARGETS   = XInternAtom(display, "TARGETS", False);
+    if (opt_replay) {
+        int rc = run_replay(display, window, gc);
+        cleanup_xft();
+        XCloseDisplay(display);
+        return rc;
+    }
+    if ((scrollspill || opt_spill) && terminal_spill_open(spilldir, spillkeep || opt_spill == 2) != 0) {
+        fprintf(stderr, "cupidterminal: no scrollback spill file in %s: %s\n",
+                spilldir ? spilldir : "$XDG_RUNTIME_DIR", strerror(errno));
+    }
+    if (opt_io && iolog_open(opt_io, opt_io_cast ? IOLOG_ASCIICAST : IOLOG_RAW,
+                             iologsize, termname, term_rows, term_cols) != 0) {
+        fprintf(stderr, "cupidterminal: cannot start output log for '%s'\n", opt_io);
+        opt_io = NULL;
+    }
 
-    /* Draw latency: wait minlatency for idle, cap at maxlatency */
-    int drawing = 0;
-    struct timespec trigger = {0, 0};
-    struct timespec now;
+    /* Frame scheduling: echo drawn at once, bulk output throttled */
+    FrameScheduler sched;
+    frame_sched_init(&sched, minlatency, maxlatency, bulkfps, refreshrate);
+    frame_sched_set_unfocused_fps(&sched, unfocusedfps);
+    frame_sched_set_sync_timeout(&sched, synctimeout);
+    perf_set_scheduler(&sched);
+    /* Window visibility: parse only while nobody can see the pixels */
+    int win_mapped = 1;
+    int win_obscured = 0;
+    int win_focused = 1;
+    int im_open = 0;
 
     /* Main event loop (handles both PTY output and X11 events) */
     while (1) {
         int x11_fd;
         int nfds;
+        int font_fd;
+        int search_wake;
         int ready;
         struct timeval *tv_ptr = NULL;
         struct timeval tv;
-        double timeout_ms = -1;
-        double elapsed;
+        double timeout_ms;
+        double now;
+        FrameReason why;
+        int key_seen;
 
         reap_child_processes();
         if (!pty_session_child_alive(&g_pty_session)) {
             break;
         }
+        if (g_perf_dump_pending) {
+            g_perf_dump_pending = 0;
+            perf_dump(stderr);
+        }
+#ifdef CUPID_TRACE
+        if (g_trace_dump_pending) {
+            g_trace_dump_pending = 0;
+            write_trace();
+        }
+#endif
 
         FD_ZERO(&fds);
+        FD_ZERO(&wfds);
         x11_fd = ConnectionNumber(display);
         FD_SET(x11_fd, &fds);
         nfds = x11_fd + 1;
 
         if (g_pty_session.master_fd >= 0) {
             FD_SET(g_pty_session.master_fd, &fds);
+            /* Paste data queued behind a full PTY: wake when it drains */
+            if (input_paste_pending())
+                FD_SET(g_pty_session.master_fd, &wfds);
             if (g_pty_session.master_fd >= nfds) {
                 nfds = g_pty_session.master_fd + 1;
             }
         }
 
+        /* Fallback fonts matched in the background */
+        font_fd = draw_font_fd();
+        if (font_fd >= 0) {
+            FD_SET(font_fd, &fds);
+            if (font_fd >= nfds)
+                nfds = font_fd + 1;
+        }
+        /* Scrollback search shards finishing */
+        search_wake = search_fd();
+        if (search_wake >= 0) {
+            FD_SET(search_wake, &fds);
+            if (search_wake >= nfds)
+                nfds = search_wake + 1;
+        }
+
         if (XPending(display)) {
             timeout_ms = 0;
-        } else if (drawing && minlatency > 0 && maxlatency > 0) {
-            clock_gettime(CLOCK_MONOTONIC, &now);
-            elapsed = (now.tv_sec - trigger.tv_sec) * 1000.0 +
-                (now.tv_nsec - trigger.tv_nsec) / 1e6;
-            timeout_ms = (maxlatency - elapsed) / maxlatency * minlatency;
-            if (timeout_ms <= 0) {
-                timeout_ms = 0;
-            }
+        } else {
+            timeout_ms = frame_sched_timeout(&sched, monotonic_ms());
         }
 
         if (timeout_ms >= 0) {
@@ -359,7 +700,7 @@ run:
             tv_ptr = &tv;
         }
 
-        ready = select(nfds, &fds, NULL, NULL, tv_ptr);
+        ready = select(nfds, &fds, &wfds, NULL, tv_ptr);
         if (ready < 0) {
             if (errno == EINTR) {
                 continue;
@@ -368,30 +709,50 @@ run:
             break;
         }
 
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        int had_input = 0;
+        if (ready > 0 && g_pty_session.master_fd >= 0 && FD_ISSET(g_pty_session.master_fd, &wfds)) {
+            input_paste_flush(display, window, g_pty_session.master_fd);
+        }
 
         if (ready > 0 && g_pty_session.master_fd >= 0 && FD_ISSET(g_pty_session.master_fd, &fds)) {
-            had_input = 1;
-            if (!handle_pty_output(display, window, gc, &g_pty_session, &term_state)) {
+            if (!read_pty_output(display, window, gc, &sched)) {
                 reap_child_processes();
                 break; // PTY closed, exit main loop
             }
         }
 
+        if (ready > 0 && font_fd >= 0 && FD_ISSET(font_fd, &fds)) {
+            if (draw_poll_fonts() > 0)
+                frame_sched_note_damage(&sched, monotonic_ms());
+        }
+        if (ready > 0 && search_wake >= 0 && FD_ISSET(search_wake, &fds)) {
+            if (search_poll())
+                frame_sched_note_damage(&sched, monotonic_ms());
+        }
+
         /* X events may already be queued client-side even when select() times out. */
+        key_seen = 0;
         while (XPending(display)) {
-            had_input = 1;
             XNextEvent(display, &event);
 
             /* XIM: let the input method filter events before we process them */
             if (XFilterEvent(&event, None))
                 continue;
 
+            if (event.type == KeyPress) {
+                frame_sched_note_key(&sched, monotonic_ms());
+                key_seen = 1;
+            } else {
+                frame_sched_note_damage(&sched, monotonic_ms());
+            }
+
             if (event.type == KeyPress) {
                 handle_keypress(display, window, &event, g_pty_session.master_fd);
             } else if (event.type == Expose) {
-                /* draw deferred */
+                draw_notify_expose(); /* draw deferred */
+            } else if (event.type == PropertyNotify) {
+                if (!selection_handle_property(display, &event))
+                    (void)handle_paste_property(display, window, &event);
+                input_paste_flush(display, window, g_pty_session.master_fd);
             } else if (event.type == SelectionNotify) {
                 handle_paste_event(display, window, &event, g_pty_session.master_fd);
             } else if (event.type == ConfigureNotify) {
@@ -403,8 +764,8 @@ run:
                 if (handle_mouse_shortcut(&event, g_pty_session.master_fd)) {
                     /* Mouse shortcut handled (e.g. middle-click paste, scroll) */
                 } else {
-                int mouse_active = term_state.mouse_reporting_basic ||
-                    term_state.mouse_reporting_button || term_state.mouse_reporting_any;
+                int mouse_active = g_term->state.mouse_reporting_basic ||
+                    g_term->state.mouse_reporting_button || g_term->state.mouse_reporting_any;
                 if (mouse_active && g_pty_session.master_fd >= 0 &&
                     !(event.xbutton.state & ShiftMask)) {
                     int r = 0, c = 0, btn = 0, evt = -1;
@@ -423,10 +784,10 @@ run:
                     } else {
                         xy_to_cell(event.xmotion.x, event.xmotion.y, &r, &c);
                         mods = event.xmotion.state;
-                        if (term_state.mouse_reporting_any) {
+                        if (g_term->state.mouse_reporting_any) {
                             evt = 2;
                             btn = 12;
-                        } else if (term_state.mouse_reporting_button &&
+                        } else if (g_term->state.mouse_reporting_button &&
                                 (mods & (Button1Mask | Button2Mask | Button3Mask))) {
                             evt = 2;
                             btn = (mods & Button1Mask) ? 1 : (mods & Button2Mask) ? 2 : 3;
@@ -434,9 +795,9 @@ run:
                     }
                     if (evt >= 0 && btn >= 1 && btn <= 12) {
                         send_mouse_report(g_pty_session.master_fd, evt, btn,
-                            c + 1, r + 1, mods, term_state.mouse_sgr_mode);
+                            c + 1, r + 1, mods, g_term->state.mouse_sgr_mode);
                     }
-                } else if (event.type == ButtonPress && !term_state.alt_screen_active &&
+                } else if (event.type == ButtonPress && !g_term->state.alt_screen_active &&
                            (event.xbutton.button == Button4 || event.xbutton.button == Button5)) {
                     if (event.xbutton.button == Button4) {
                         terminal_scrollback_up(1);
@@ -447,7 +808,7 @@ run:
                     int r, c;
                     xy_to_cell(event.xbutton.x, event.xbutton.y, &r, &c);
                     selection_start(c, r, event.xbutton.state);
-                } else if (event.type == MotionNotify && term_state.sel_active &&
+                } else if (event.type == MotionNotify && g_term->state.sel_active &&
                          (event.xmotion.state & Button1Mask)) {
                     int r, c;
                     xy_to_cell(event.xmotion.x, event.xmotion.y, &r, &c);
@@ -458,14 +819,32 @@ run:
                     selection_release(display, window, c, r);
                 }
                 }
+            } else if (event.type == MapNotify || event.type == UnmapNotify ||
+                       event.type == VisibilityNotify) {
+                int was_visible = win_mapped && !win_obscured;
+
+                if (event.type == VisibilityNotify)
+                    win_obscured = (event.xvisibility.state == VisibilityFullyObscured);
+                else
+                    win_mapped = (event.type == MapNotify);
+                if (!was_visible && win_mapped && !win_obscured) {
+                    /* Output was parsed but not drawn: one full repaint */
+                    terminal_mark_all_rows_dirty();
+                    draw_notify_expose();
+                }
+                frame_sched_set_visibility(&sched, win_mapped && !win_obscured, win_focused);
             } else if (event.type == FocusIn) {
+                win_focused = 1;
+                frame_sched_set_visibility(&sched, win_mapped && !win_obscured, win_focused);
                 /* XIM: notify input context of focus */
                 xim_focus_in();
-                if (term_state.focus_mode && g_pty_session.master_fd >= 0)
+                if (g_term->state.focus_mode && g_pty_session.master_fd >= 0)
                     (void)pty_session_write(&g_pty_session, "\033[I", 3);
             } else if (event.type == FocusOut) {
+                win_focused = 0;
+                frame_sched_set_visibility(&sched, win_mapped && !win_obscured, win_focused);
                 xim_focus_out();
-                if (term_state.focus_mode && g_pty_session.master_fd >= 0)
+                if (g_term->state.focus_mode && g_pty_session.master_fd >= 0)
                     (void)pty_session_write(&g_pty_session, "\033[O", 3);
             } else if (event.type == ClientMessage) {
                 Atom wm_protocols = XInternAtom(display, "WM_PROTOCOLS", False);
@@ -473,76 +852,102 @@ run:
                 if (event.xclient.message_type == wm_protocols &&
                     (Atom)event.xclient.data.l[0] == wm_delete) {
                     pty_session_close(&g_pty_session);
+                    close_io_log();
+                    close_spill();
+                    search_stop();
                     cleanup_xft();
                     XCloseDisplay(display);
                     return 0;
                 }
             } else if (event.type == SelectionRequest) {
-                XSelectionRequestEvent *req = &event.xselectionrequest;
-                XSelectionEvent ev = {
-                    .type      = SelectionNotify,
-                    .display   = req->display,
-                    .requestor = req->requestor,
-                    .selection = req->selection,
-                    .target    = req->target,
-                    .property  = req->property,
-                    .time      = req->time
-                };
-            
-                size_t len = 0;
-                const unsigned char *data = clipboard_get_data(&len);
-            
-                if (!data) {
-                    ev.property = None; // we have nothing to offer
-                    XSendEvent(display, req->requestor, True, 0, (XEvent*)&ev);
-                    XFlush(display);
-                    continue;
-                }
-            
-                if (req->target == XA_TARGETS) {
-                    Atom targets[4] = { XA_UTF8, XA_TEXT, XA_STRING, XA_TARGETS };
-                    XChangeProperty(display, req->requestor,
-                                    req->property, XA_ATOM, 32, PropModeReplace,
-                                    (unsigned char*)targets, 4);
-                } else if (req->target == XA_UTF8 || req->target == XA_TEXT || req->target == XA_STRING) {
-                    // Serve UTF-8 bytes
-                    Atom type = (req->target == XA_STRING) ? XA_STRING : XA_UTF8;
-                    XChangeProperty(display, req->requestor,
-                                    req->property, type, 8, PropModeReplace,
-                                    (unsigned char*)data, (int)len);
-                } else {
-                    // unsupported target
-                    ev.property = None;
-                }
-            
-                XSendEvent(display, req->requestor, True, 0, (XEvent*)&ev);
-                XFlush(display);
+                selection_handle_request(display, &event);
+            } else if (event.type == SelectionClear) {
+                selection_handle_clear(display, &event);
             }
         }
 
-        /* Draw latency: wait for idle (minlatency) or cap at maxlatency */
-        if (had_input) {
-            if (!drawing) {
-                trigger = now;
-                drawing = 1;
-            }
-            if (minlatency > 0 && maxlatency > 0) {
-                elapsed = (now.tv_sec - trigger.tv_sec) * 1000.0 +
-                    (now.tv_nsec - trigger.tv_nsec) / 1e6;
-                timeout_ms = (maxlatency - elapsed) / maxlatency * minlatency;
-                if (timeout_ms > 0)
-                    continue;  /* wait for idle */
+        /* Instant echo: give the child up to echowait ms to echo the keystroke
+         * so it is drawn (and flushed) in this iteration, not after another
+         * select() round trip plus the idle wait. */
+        if (key_seen && echowait > 0 && g_pty_session.master_fd >= 0 &&
+            wait_readable(g_pty_session.master_fd, echowait)) {
+            if (!read_pty_output(display, window, gc, &sched)) {
+                reap_child_processes();
+                break;
             }
         }
 
+        now = monotonic_ms();
+        why = frame_sched_due(&sched, now);
+        if (why == FRAME_REASON_NONE)
+            continue;
+
         draw_text(display, window, gc);
         xximspot(display, window);
-        XFlush(display);
-        drawing = 0;
+        {
+            TRACE_BEGIN(t_flush);
+            XFlush(display);
+            TRACE_END(t_flush, "XFlush", "io", 0);
+        }
+        {
+            double end = monotonic_ms();
+
+            frame_sched_note_frame(&sched, end, end - now, why);
+            perf_note_frame(end - now);
+        }
+        if (!im_open && draw_frames_presented() > 0) {
+            daemon_window_ready();
+            if (opt_startup_bench) {
+                report_startup(display, &startup);
+                break;
+            }
+            draw_open_im(display);
+            im_open = 1;
+        }
     }
 
     pty_session_close(&g_pty_session);
+    close_io_log();
+    close_spill();
+    search_stop();
     cleanup_xft();
     XCloseDisplay(display);
     return 0;
 }
+
+/* --daemon: a forked child turns into the requested window. */
+static int daemon_window(int argc, char *argv[]) {
+    /* The environment is now the client's: pick up its locale. */
+    setlocale(LC_CTYPE, "");
+    XSetLocaleModifiers("");
+    opt_daemon = opt_client = 0;
+    parse_long_options(&argc, argv);
+    return run_terminal(argc, argv, monotonic_ms());
+}
+
+int main(int argc, char *argv[]) {
+    double start = monotonic_ms();
+    char sock[256];
+
+    setlocale(LC_CTYPE, "");
+    XSetLocaleModifiers("");
+    parse_long_options(&argc, argv);
+
+    if (!opt_daemon && !opt_client)
+        return run_terminal(argc, argv, start);
+
+    if (opt_socket) {
+        snprintf(sock, sizeof(sock), "%s", opt_socket);
+    } else if (daemon_socket_path(sock, sizeof(sock), getenv("DISPLAY")) != 0) {
+        fprintf(stderr, "cupidterminal: daemon socket path too long\n");
+        return EXIT_FAILURE;
+    }
+    if (opt_client)
+        return daemon_client(sock, argc, argv);
+
+    draw_prewarm_fonts();
+    fprintf(stderr, "cupidterminal: daemon listening on %s\n", sock);
+    daemon_serve(sock, daemon_window);
+    fprintf(stderr, "cupidterminal: daemon on %s: %s\n", sock, strerror(errno));
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,147 @@
+// perf.c - built-in performance counters (SIGUSR1 dump and HUD text)
+#include "perf.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "render.h"
+#include "terminal_state.h"
+
+PerfCounters perf;
+
+static const FrameScheduler *perf_sched;
+
+static const double hist_bounds[PERF_HIST_BUCKETS] = { 1, 2, 4, 8, 16, 33, 66, 0 };
+
+void perf_note_frame(double ms) {
+    int b = 0;
+
+    while (b < PERF_HIST_BUCKETS - 1 && ms >= hist_bounds[b])
+        b++;
+    perf.frame_hist[b]++;
+    perf.frames++;
+    perf.frame_ms_total += ms;
+    if (ms > perf.frame_ms_max)
+        perf.frame_ms_max = ms;
+}
+
+void perf_set_scheduler(const FrameScheduler *s) {
+    perf_sched = s;
+}
+
+double perf_hist_bound(int i) {
+    return (i >= 0 && i < PERF_HIST_BUCKETS) ? hist_bounds[i] : 0;
+}
+
+static double ratio(unsigned long long hits, unsigned long long misses) {
+    unsigned long long n = hits + misses;
+    return n ? 100.0 * (double)hits / (double)n : 100.0;
+}
+
+/* Append one formatted line; keeps buf NUL-terminated when it fills up. */
+static void add_line(char *buf, size_t cap, size_t *len, int *lines, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    if (*len + 1 >= cap)
+        return;
+    va_start(ap, fmt);
+    n = vsnprintf(buf + *len, cap - *len, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    *len += (size_t)n;
+    if (*len + 1 >= cap) {
+        *len = cap - 1;
+        buf[*len] = '\0';
+        return;
+    }
+    buf[(*len)++] = '\n';
+    buf[*len] = '\0';
+    (*lines)++;
+}
+
+int perf_format(char *buf, size_t cap) {
+    const RenderStats *rs = render_stats();
+    const TermParseStats *ps = &term_parse_stats;
+    size_t len = 0;
+    int lines = 0;
+    char hist[160];
+    size_t h = 0;
+
+    if (!buf || cap == 0)
+        return 0;
+    buf[0] = '\0';
+
+    add_line(buf, cap, &len, &lines, "io: %llu reads, %.1f MiB, %llu B/read",
+             perf.read_calls, (double)perf.read_bytes / 1048576.0,
+             perf.read_calls ? perf.read_bytes / perf.read_calls : 0ULL);
+    add_line(buf, cap, &len, &lines, "parse: %.1f MiB, esc %llu csi %llu osc %llu str %llu",
+             (double)ps->bytes / 1048576.0, ps->esc, ps->csi, ps->osc, ps->str);
+    add_line(buf, cap, &len, &lines, "draw: %lu frames, %lu rows, %lu cells, %llu xft calls",
+             rs->frames, rs->rows, rs->cells, perf.xft_calls);
+    add_line(buf, cap, &len, &lines, "ops: %lu rects, %lu glyph runs (%lu glyphs), %lu copies",
+             rs->rects, rs->glyph_calls, rs->glyphs, rs->copies);
+
+    for (int i = 0; i < PERF_HIST_BUCKETS && h < sizeof(hist); i++) {
+        int n = hist_bounds[i] > 0
+            ? snprintf(hist + h, sizeof(hist) - h, " <%g:%lu", hist_bounds[i], perf.frame_hist[i])
+            : snprintf(hist + h, sizeof(hist) - h, " %g+:%lu", hist_bounds[i - 1], perf.frame_hist[i]);
+        if (n < 0)
+            break;
+        h += (size_t)n;
+    }
+    hist[sizeof(hist) - 1] = '\0';
+    add_line(buf, cap, &len, &lines, "frame ms: avg %.2f max %.2f |%s",
+             perf.frames ? perf.frame_ms_total / (double)perf.frames : 0.0,
+             perf.frame_ms_max, hist);
+    add_line(buf, cap, &len, &lines,
+             "cache: glyph %.1f%% (%llu miss, %lu faces), colour %.1f%% (%llu miss)",
+             ratio(perf.glyph_hits, perf.glyph_misses), perf.glyph_misses, perf.fallback_faces,
+             ratio(perf.color_hits, perf.color_misses), perf.color_misses);
+    add_line(buf, cap, &len, &lines, "cache: emoji %.1f%% (%llu miss)",
+             ratio(perf.emoji_hits, perf.emoji_misses), perf.emoji_misses);
+    add_line(buf, cap, &len, &lines, "history: %d lines, %.1f MiB (%.1f MiB spilled to disk)",
+             terminal_history_lines(), (double)terminal_history_bytes() / 1048576.0,
+             (double)terminal_spill_bytes() / 1048576.0);
+
+    if (perf_sched) {
+        const FrameScheduler *s = perf_sched;
+        char why[160];
+        size_t w = 0;
+
+        why[0] = '\0';
+        for (int r = FRAME_REASON_NONE + 1; r < FRAME_REASON_COUNT && w < sizeof(why); r++) {
+            int n = snprintf(why + w, sizeof(why) - w, " %s %lu",
+                             frame_sched_reason_name((FrameReason)r), s->frames[r]);
+            if (n < 0)
+                break;
+            w += (size_t)n;
+        }
+        why[sizeof(why) - 1] = '\0';
+        add_line(buf, cap, &len, &lines, "sched:%s", why);
+        add_line(buf, cap, &len, &lines,
+                 "sched: %lu bulk, %lu deferred, %lu hidden, %lu sync holds (%lu timeouts)",
+                 s->bulk_entries, s->deferrals, s->hidden_skips, s->sync_holds, s->sync_timeouts);
+        add_line(buf, cap, &len, &lines, "echo: avg %.2f max %.2f ms (%lu samples)",
+                 s->echo_latency_ms, s->echo_latency_max_ms, s->echo_samples);
+    }
+    return lines;
+}
+
+void perf_dump(FILE *out) {
+    char buf[2048];
+    char *line = buf;
+
+    perf_format(buf, sizeof(buf));
+    while (*line) {
+        char *nl = strchr(line, '\n');
+        if (nl)
+            *nl = '\0';
+        fprintf(out, "cupidterminal: %s\n", line);
+        if (!nl)
+            break;
+        line = nl + 1;
+    }
+    fflush(out);
+}
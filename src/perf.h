@@ -0,0 +1,54 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "frame_sched.h"
+
+/*
+ * Built-in performance counters.
+ *
+ * Collected all the time: each is a plain add per read(), per frame or per
+ * Xft call, far below measurement noise, so a slow terminal can be looked at
+ * as it is without restarting it.  perf_format() gathers these together with
+ * the parser (term_parse_stats), renderer (render_stats()) and scheduler
+ * counters; main.c prints that on SIGUSR1 and draw.c shows it as an overlay
+ * when the HUD shortcut is toggled on.
+ */
+
+/* Frame time histogram upper bounds in ms; the last bucket is open. */
+#define PERF_HIST_BUCKETS 8
+
+typedef struct {
+    unsigned long long read_calls;    /* PTY read()s that returned data */
+    unsigned long long read_bytes;
+    unsigned long long xft_calls;     /* Xft/Xlib drawing requests issued */
+    unsigned long long glyph_hits;    /* fallback font cache */
+    unsigned long long glyph_misses;
+    unsigned long fallback_faces;     /* fallback XftFonts open now */
+    unsigned long long emoji_hits;    /* pre-scaled colour emoji */
+    unsigned long long emoji_misses;
+    unsigned long long color_hits;    /* XftColor caches */
+    unsigned long long color_misses;
+    unsigned long frames;
+    unsigned long frame_hist[PERF_HIST_BUCKETS];
+    double frame_ms_total;
+    double frame_ms_max;
+} PerfCounters;
+
+extern PerfCounters perf;
+
+/* Record one drawn frame and its draw+flush time. */
+void perf_note_frame(double ms);
+/* Scheduler whose counters perf_format() includes (may be NULL). */
+void perf_set_scheduler(const FrameScheduler *s);
+/* Upper bound of histogram bucket i in ms (0 for the open last bucket). */
+double perf_hist_bound(int i);
+/* Format all counters as newline-separated lines into buf (always
+ * NUL-terminated).  Returns the number of lines. */
+int perf_format(char *buf, size_t cap);
+/* perf_format() to out, each line prefixed with "cupidterminal: ". */
+void perf_dump(FILE *out);
+
+#endif /* PERF_H */
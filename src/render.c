@@ -0,0 +1,638 @@
+// render.c - renderer frontend: cell walk, colours, runs and damage
+#include "render.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "boxdraw.h"
+#include "terminal_state.h"
+#include "trace.h"
+
+/* Glyphs batched into one backend call. */
+#define RENDER_RUN_MAX 256
+
+/* Triggers a full clear+redraw on next frame (set after resize). */
+static int full_refresh = 1;
+/* Tracks previous cursor cell to erase it when the cursor moves. */
+static int prev_cursor_row = -1;
+static int prev_cursor_col = -1;
+/* Set by Expose: the window lost contents, copy the whole back buffer. */
+static int copy_full = 1;
+static RenderStats stats;
+
+void render_invalidate(void) {
+    full_refresh = 1;
+}
+
+void render_notify_expose(void) {
+    copy_full = 1;
+}
+
+const RenderStats *render_stats(void) {
+    return &stats;
+}
+
+static int cell_selected(const RenderParams *p, int r, int c) {
+    if (!p->sel_active)
+        return 0;
+    if (r < p->sel_sr || r > p->sel_er)
+        return 0;
+    if (p->sel_rect || p->sel_sr == p->sel_er)
+        return (c >= p->sel_sc && c <= p->sel_ec);
+    if (r == p->sel_sr)
+        return (c >= p->sel_sc);
+    if (r == p->sel_er)
+        return (c <= p->sel_ec);
+    return 1;
+}
+
+/* The marks of one row, walked left to right along with the cells. */
+typedef struct {
+    const RenderMark *m;
+    int n, i;
+} RowMarks;
+
+/* Marks of row r, starting the search at *next; marks are ordered by row,
+ * so the frame finds every row's marks in one pass. */
+static RowMarks row_marks(const RenderParams *p, int r, int *next) {
+    RowMarks rm = { NULL, 0, 0 };
+
+    while (*next < p->nmarks && p->marks[*next].row < r)
+        (*next)++;
+    rm.m = p->marks + *next;
+    while (*next + rm.n < p->nmarks && p->marks[*next + rm.n].row == r)
+        rm.n++;
+    return rm;
+}
+
+/* 0 none, 1 highlighted, 2 the current highlight.  c must not decrease
+ * between calls on the same rm. */
+static int cell_mark(RowMarks *rm, int c) {
+    while (rm->i < rm->n && rm->m[rm->i].c1 < c)
+        rm->i++;
+    if (rm->i < rm->n && c >= rm->m[rm->i].c0)
+        return rm->m[rm->i].current ? 2 : 1;
+    return 0;
+}
+
+static void apply_mark(const RenderParams *p, int mark, int selected, uint32_t *fg, uint32_t *bg) {
+    if (mark == 2) {
+        *fg = p->rcursor_color;
+        *bg = p->cursor_color;
+    } else if (mark && !selected) {
+        uint32_t tmp = *fg;
+        *fg = *bg;
+        *bg = tmp;
+    }
+}
+
+static uint32_t invert_color(const RenderBackend *be, uint32_t color, int is_bg) {
+    uint32_t rgb = be->resolve_rgb(be->ctx, color, is_bg);
+    return COLOR_TRUE_RGB_BASE | ((~rgb) & 0x00FFFFFFu);
+}
+
+static void resolve_cell_colors(const RenderBackend *be, const TerminalCell *cell, int selected,
+                                int hide_blink, uint32_t *out_fg, uint32_t *out_bg) {
+    uint32_t fg = cell->fg;
+    uint32_t bg = cell->bg;
+    uint16_t attrs = cell->attrs;
+
+    /* st behavior: bold brightens basic ANSI colors 0-7 when faint is not active. */
+    if ((attrs & ATTR_BOLD) && !(attrs & ATTR_FAINT) && fg <= 7) {
+        fg += 8;
+    }
+
+    /* DECSCNM: mirror st behavior.
+       - swap defaults
+       - invert resolved RGB value for all non-default colors */
+    if (term_state.screen_reverse) {
+        fg = (fg == COLOR_DEFAULT_FG) ? COLOR_DEFAULT_BG : invert_color(be, fg, 0);
+        bg = (bg == COLOR_DEFAULT_BG) ? COLOR_DEFAULT_FG : invert_color(be, bg, 1);
+    }
+
+    if (attrs & ATTR_REVERSE) {
+        uint32_t tmp = fg;
+        fg = bg;
+        bg = tmp;
+    }
+    if (selected) {
+        uint32_t tmp = fg;
+        fg = bg;
+        bg = tmp;
+    }
+    if ((attrs & ATTR_BLINK) && hide_blink) {
+        fg = bg;
+    }
+    if (attrs & ATTR_INVISIBLE) {
+        fg = bg;
+    }
+
+    *out_fg = fg;
+    *out_bg = bg;
+}
+
+static void damage_add(int *box, int x0, int y0, int x1, int y1) {
+    if (x0 < box[0]) box[0] = x0;
+    if (y0 < box[1]) box[1] = y0;
+    if (x1 > box[2]) box[2] = x1;
+    if (y1 > box[3]) box[3] = y1;
+}
+
+static void fill(const RenderBackend *be, int x, int y, int w, int h, uint32_t color, int flags) {
+    be->fill_rect(be->ctx, x, y, w, h, color, flags);
+    stats.rects++;
+}
+
+typedef struct {
+    RenderGlyph g[RENDER_RUN_MAX];
+    int n;
+    uint32_t fg;
+    uint16_t attrs;
+} GlyphRun;
+
+static void flush_run(const RenderBackend *be, GlyphRun *run, int top, int h, int baseline) {
+    if (run->n == 0)
+        return;
+    be->glyphs(be->ctx, run->g, run->n, top, h, baseline, run->fg, run->attrs);
+    stats.glyph_calls++;
+    stats.glyphs += (unsigned long)run->n;
+    run->n = 0;
+}
+
+typedef struct {
+    RenderRect r[RENDER_RUN_MAX];
+    int n;
+    uint32_t color;
+    int flags;
+} RectBatch;
+
+static void flush_rects(const RenderBackend *be, RectBatch *batch) {
+    if (batch->n == 0)
+        return;
+    be->fill_rects(be->ctx, batch->r, batch->n, batch->color, batch->flags);
+    stats.rects += (unsigned long)batch->n;
+    batch->n = 0;
+}
+
+/* fg over bg at level quarters, for the shade characters. */
+static uint32_t shade_color(const RenderBackend *be, uint32_t fg, uint32_t bg, int level) {
+    uint32_t a = be->resolve_rgb(be->ctx, fg, 0);
+    uint32_t b = be->resolve_rgb(be->ctx, bg, 1);
+    uint32_t out = 0;
+
+    for (int sh = 0; sh < 24; sh += 8) {
+        uint32_t ca = (a >> sh) & 0xFF, cb = (b >> sh) & 0xFF;
+        out |= ((ca * (uint32_t)level + cb * (uint32_t)(4 - level)) / 4) << sh;
+    }
+    return COLOR_TRUE_RGB_BASE | out;
+}
+
+/* Queue the rects of a procedurally drawn cell; 0 if cp is left to the font. */
+static int draw_boxdraw_cell(const RenderBackend *be, const RenderParams *p, RectBatch *batch,
+                             uint32_t cp, int x, int row_top, int w, uint32_t fg, uint32_t bg,
+                             int flags) {
+    RenderRect rects[BOXDRAW_MAX_RECTS];
+    int shade;
+    int n;
+
+    if (!boxdraw_handles(cp, p->boxdraw_braille))
+        return 0;
+    n = boxdraw_rects(cp, x, row_top, w, p->cell_h, rects, &shade);
+    if (shade)
+        fg = shade_color(be, fg, bg, shade);
+    if (batch->n > 0 && (batch->color != fg || batch->flags != flags ||
+                         batch->n + n > RENDER_RUN_MAX))
+        flush_rects(be, batch);
+    batch->color = fg;
+    batch->flags = flags;
+    memcpy(&batch->r[batch->n], rects, (size_t)n * sizeof(rects[0]));
+    batch->n += n;
+    return 1;
+}
+
+/* Background pass: consecutive cells with the same resolved background are
+ * merged into one rect.  Continuation cells are covered by their lead cell. */
+static void draw_row_backgrounds(const RenderBackend *be, const RenderParams *p,
+                                 const TerminalCell *row_cells, int r, RowMarks marks,
+                                 int c0, int c1, int x, int row_top) {
+    const int step_w = p->cell_w + p->cell_gap;
+    int cur_px = x;
+    int run_px = x;
+    int have_run = 0;
+    uint32_t run_bg = 0;
+
+    for (int c = c0; c <= c1; c++) {
+        const TerminalCell *cell = &row_cells[c];
+        uint32_t fg_val, bg_val;
+        int cell_span, selected;
+
+        if (cell->is_continuation) {
+            cur_px += step_w;
+            continue;
+        }
+        cell_span = (cell->width == 2 && c + 1 < term_cols) ? 2 : 1;
+        selected = cell_selected(p, r, c) || (cell_span == 2 && cell_selected(p, r, c + 1));
+        resolve_cell_colors(be, cell, selected, p->hide_blink, &fg_val, &bg_val);
+        if (marks.n)
+            apply_mark(p, cell_mark(&marks, c), selected, &fg_val, &bg_val);
+
+        if (have_run && bg_val != run_bg) {
+            fill(be, run_px, row_top, cur_px - run_px, p->cell_h, run_bg, RENDER_COLOR_BG);
+            have_run = 0;
+        }
+        if (!have_run) {
+            run_px = cur_px;
+            run_bg = bg_val;
+            have_run = 1;
+        }
+        cur_px += p->cell_w * cell_span + p->cell_gap * (cell_span - 1);
+    }
+    if (have_run && cur_px > run_px)
+        fill(be, run_px, row_top, cur_px - run_px, p->cell_h, run_bg, RENDER_COLOR_BG);
+}
+
+/* Foreground pass: consecutive glyphs sharing colour and font style go to
+ * the backend in one call.  Each glyph is still clipped to its own cell, so
+ * there are no cross-cell ligature/shaping effects.  Decorations are drawn
+ * after the glyphs they belong to. */
+static void draw_row_glyphs(const RenderBackend *be, const RenderParams *p,
+                            const TerminalCell *row_cells, int r, RowMarks marks,
+                            int c0, int c1, int x, int row_top, int baseline) {
+    const int step_w = p->cell_w + p->cell_gap;
+    GlyphRun run;
+    RectBatch batch;
+
+    run.n = 0;
+    batch.n = 0;
+    for (int c = c0; c <= c1; c++, x += step_w) {
+        const TerminalCell *cell = &row_cells[c];
+        int cell_span = 1;
+        int selected, draw_w, faint;
+        uint16_t style;
+        uint32_t fg_val, bg_val;
+
+        if (cell->is_continuation)
+            continue;
+        if (cell->width == 2 && c + 1 < term_cols)
+            cell_span = 2;
+
+        selected = cell_selected(p, r, c) || (cell_span == 2 && cell_selected(p, r, c + 1));
+        resolve_cell_colors(be, cell, selected, p->hide_blink, &fg_val, &bg_val);
+        if (marks.n)
+            apply_mark(p, cell_mark(&marks, c), selected, &fg_val, &bg_val);
+        draw_w = p->cell_w * cell_span;
+        faint = (cell->attrs & ATTR_FAINT) != 0;
+        style = cell->attrs & (ATTR_BOLD | ATTR_ITALIC | ATTR_FAINT);
+
+        /* Blank cells need no glyph: the background pass already drew them.
+         * Lines, blocks and Braille are rects batched per colour. */
+        if (cell->c[0] != '\0' && !(cell->c[0] == ' ' && cell->c[1] == '\0') &&
+            !(p->boxdraw && draw_boxdraw_cell(be, p, &batch, boxdraw_cell_cp(cell->c), x, row_top,
+                                              draw_w, fg_val, bg_val,
+                                              faint ? RENDER_COLOR_FAINT : 0))) {
+            if (run.n > 0 && (run.fg != fg_val || run.attrs != style || run.n == RENDER_RUN_MAX))
+                flush_run(be, &run, row_top, p->cell_h, baseline);
+            if (run.n == 0) {
+                run.fg = fg_val;
+                run.attrs = style;
+            }
+            run.g[run.n].x = x;
+            run.g[run.n].width = draw_w;
+            run.g[run.n].utf8 = cell->c;
+            run.n++;
+        }
+
+        if (cell->attrs & (ATTR_UNDERLINE | ATTR_STRUCK)) {
+            int flags = faint ? RENDER_COLOR_FAINT : 0;
+            flush_run(be, &run, row_top, p->cell_h, baseline);
+            flush_rects(be, &batch);
+            if (cell->attrs & ATTR_UNDERLINE)
+                fill(be, x, row_top + p->ascent + 1, draw_w, 1, fg_val, flags);
+            if (cell->attrs & ATTR_STRUCK)
+                fill(be, x, row_top + (2 * p->ascent) / 3, draw_w, 1, fg_val, flags);
+        }
+    }
+    flush_run(be, &run, row_top, p->cell_h, baseline);
+    flush_rects(be, &batch);
+}
+
+/* Cursor: shape from DECSCUSR (0-2 block, 3-4 underline, 5-6 bar, 7 snowman) */
+static void draw_cursor(const RenderBackend *be, const RenderParams *p, int *damage) {
+    int cur_row = term_state.row;
+    int cur_col = term_state.col;
+    int cur_span = 1;
+    int selected;
+    const int step_w = p->cell_w + p->cell_gap;
+    const TerminalCell *cell;
+    RenderCursor cur;
+
+    if (cur_row < 0) cur_row = 0;
+    if (cur_row >= term_rows) cur_row = term_rows - 1;
+    if (cur_col < 0) cur_col = 0;
+    if (cur_col >= term_cols) cur_col = term_cols - 1;
+
+    if (terminal_buffer[cur_row][cur_col].is_continuation && cur_col > 0) {
+        cur_col--;
+    }
+
+    cell = &terminal_buffer[cur_row][cur_col];
+    if (cell->width == 2 && cur_col + 1 < term_cols) {
+        cur_span = 2;
+    }
+    selected = cell_selected(p, cur_row, cur_col) ||
+               (cur_span == 2 && cell_selected(p, cur_row, cur_col + 1));
+
+    if (term_state.screen_reverse) {
+        cur.bg = selected ? p->cursor_color : p->rcursor_color;
+        cur.fg = selected ? p->rcursor_color : p->cursor_color;
+    } else if (selected) {
+        cur.fg = COLOR_DEFAULT_FG;
+        cur.bg = p->rcursor_color;
+    } else {
+        cur.fg = COLOR_DEFAULT_BG;
+        cur.bg = p->cursor_color;
+    }
+
+    cur.x = p->left_pad + cur_col * step_w;
+    cur.w = p->cell_w * cur_span;
+    cur.h = p->cell_h;
+    cur.baseline = p->ascent + p->top_pad + cur_row * (p->cell_h + p->line_gap);
+    cur.y = cur.baseline - p->ascent;
+    cur.shape = (term_state.cursorshape >= 0 && term_state.cursorshape <= 7) ? term_state.cursorshape : 2;
+    cur.thickness = p->cursor_thickness < 1 ? 1 : p->cursor_thickness;
+    cur.attrs = cell->attrs & (ATTR_BOLD | ATTR_ITALIC | ATTR_UNDERLINE | ATTR_STRUCK);
+    cur.utf8 = cell->c;
+
+    damage_add(damage, cur.x, cur.y, cur.x + cur.w, cur.y + cur.h);
+    be->cursor(be->ctx, &cur);
+    stats.cursors++;
+}
+
+int render_frame(const RenderBackend *be, const RenderParams *p) {
+    const int step_w = p->cell_w + p->cell_gap;
+    const int baseline0 = p->ascent + p->top_pad;
+    const int buf_w = p->width;
+    const int buf_h = p->height;
+    /* No cursor while scrolled back or hidden (DECTCEM). */
+    const int show_cursor = term_state.cursor_visible && terminal_get_scrollback_offset() == 0;
+    int cursor_row = term_state.row;
+    int cursor_col = term_state.col;
+    int any_dirty, full, moved;
+    int next_mark = 0;
+    /* Damaged area of the back buffer: x0, y0, x1, y1 (exclusive). */
+    int damage[4] = { buf_w, buf_h, 0, 0 };
+
+    if (!be->begin_frame(be->ctx, buf_w, buf_h))
+        return 0;
+
+    if (cursor_row < 0) cursor_row = 0;
+    if (cursor_row >= term_rows) cursor_row = term_rows - 1;
+    if (cursor_col < 0) cursor_col = 0;
+    if (cursor_col >= term_cols) cursor_col = term_cols - 1;
+
+    /* Check whether anything actually needs rendering. */
+    any_dirty = full_refresh;
+    if (!any_dirty && dirty_rows) {
+        for (int r = 0; r < term_rows; r++) {
+            if (dirty_rows[r]) { any_dirty = 1; break; }
+        }
+    } else if (!dirty_rows) {
+        any_dirty = 1;
+    }
+
+    /* Dirty the cells occupied by the cursor (old position + new position)
+       when it moved, appeared or disappeared, or when anything else is drawn
+       anyway; an unchanged screen with a parked cursor draws nothing. */
+    moved = (show_cursor ? cursor_row : -1) != prev_cursor_row ||
+            (show_cursor && cursor_col != prev_cursor_col);
+    if (moved || any_dirty) {
+        if (prev_cursor_row >= 0)
+            terminal_mark_cells_dirty(prev_cursor_row, prev_cursor_col, prev_cursor_col);
+        if (show_cursor)
+            terminal_mark_cells_dirty(cursor_row, cursor_col, cursor_col);
+        any_dirty = 1;
+    }
+    if (!any_dirty && !copy_full) {
+        /* Nothing changed — skip the entire render. */
+        return 0;
+    }
+
+    /* On a full refresh, clear the entire back buffer once (covers padding areas too). */
+    full = full_refresh;
+    full_refresh = 0;
+    stats.frames++;
+    TRACE_BEGIN(t_rows);
+    if (full) {
+        fill(be, 0, 0, buf_w, buf_h, COLOR_DEFAULT_BG, RENDER_COLOR_BG);
+        damage_add(damage, 0, 0, buf_w, buf_h);
+    }
+
+    for (int r = 0; r < term_rows; r++) {
+        const TerminalCell *row_cells = terminal_get_visible_row(r);
+        RowMarks marks = row_marks(p, r, &next_mark);
+        int c0 = 0;
+        int c1 = term_cols - 1;
+
+        /* Skip rows that haven't changed (incremental update only). */
+        if (!full && dirty_rows) {
+            if (dirty_rows[r] == DIRTY_ROW_CLEAN)
+                continue;
+            if (dirty_rows[r] == DIRTY_ROW_SPAN && dirty_col_lo && dirty_col_hi) {
+                c0 = dirty_col_lo[r];
+                c1 = dirty_col_hi[r];
+            }
+        }
+        if (!row_cells)
+            continue;
+
+        /* Never split a wide glyph at the edge of the damaged span. */
+        if (c0 > 0 && row_cells[c0].is_continuation)
+            c0--;
+        if (c1 + 1 < term_cols && row_cells[c1].width == 2)
+            c1++;
+
+        int x = p->left_pad + c0 * step_w;
+        int y = baseline0 + r * (p->cell_h + p->line_gap);
+        int row_top = y - p->ascent;
+        int span_x0 = (c0 == 0) ? 0 : x;
+        int span_x1 = (c1 == term_cols - 1) ? buf_w : p->left_pad + (c1 + 1) * step_w;
+
+        stats.rows++;
+        stats.cells += (unsigned long)(c1 - c0 + 1);
+
+        /* On incremental updates, clear just the damaged cells before redrawing them. */
+        if (!full) {
+            fill(be, span_x0, row_top, span_x1 - span_x0, p->cell_h, COLOR_DEFAULT_BG, RENDER_COLOR_BG);
+            damage_add(damage, span_x0, row_top, span_x1, row_top + p->cell_h);
+        }
+        draw_row_backgrounds(be, p, row_cells, r, marks, c0, c1, x, row_top);
+        draw_row_glyphs(be, p, row_cells, r, marks, c0, c1, x, row_top, y);
+    }
+    TRACE_END(t_rows, "render rows", "draw", full);
+
+    if (show_cursor)
+        draw_cursor(be, p, damage);
+
+    /* Copy the damaged part of the back buffer to the target. */
+    if (copy_full) {
+        damage_add(damage, 0, 0, buf_w, buf_h);
+        copy_full = 0;
+    }
+    if (damage[0] < 0) damage[0] = 0;
+    if (damage[1] < 0) damage[1] = 0;
+    if (damage[2] > buf_w) damage[2] = buf_w;
+    if (damage[3] > buf_h) damage[3] = buf_h;
+    if (damage[2] > damage[0] && damage[3] > damage[1]) {
+        TRACE_BEGIN(t_copy);
+        be->copy_area(be->ctx, damage[0], damage[1], damage[2] - damage[0], damage[3] - damage[1]);
+        stats.copies++;
+        TRACE_END(t_copy, "present", "draw", (damage[2] - damage[0]) * (damage[3] - damage[1]));
+    }
+
+    /* Update cursor tracking and clear dirty flags for next frame. */
+    prev_cursor_row = show_cursor ? cursor_row : -1;
+    prev_cursor_col = cursor_col;
+    if (dirty_rows)
+        memset(dirty_rows, 0, (size_t)term_rows);
+    return 1;
+}
+
+/* ---- Null backend ---- */
+
+static int null_begin(void *ctx, int w, int h) { (void)ctx; return w > 0 && h > 0; }
+static void null_rect(void *ctx, int x, int y, int w, int h, uint32_t color, int flags) {
+    (void)ctx; (void)x; (void)y; (void)w; (void)h; (void)color; (void)flags;
+}
+static void null_rects(void *ctx, const RenderRect *r, int n, uint32_t color, int flags) {
+    (void)ctx; (void)r; (void)n; (void)color; (void)flags;
+}
+static void null_glyphs(void *ctx, const RenderGlyph *g, int n, int top, int h, int baseline,
+                        uint32_t fg, uint16_t attrs) {
+    (void)ctx; (void)g; (void)n; (void)top; (void)h; (void)baseline; (void)fg; (void)attrs;
+}
+static void null_cursor(void *ctx, const RenderCursor *cur) { (void)ctx; (void)cur; }
+static void null_copy(void *ctx, int x, int y, int w, int h) {
+    (void)ctx; (void)x; (void)y; (void)w; (void)h;
+}
+
+/* Without a display, palette colours resolve to a fixed grey ramp; only
+ * DECSCNM uses this and the exact values do not matter headless. */
+static uint32_t null_rgb(void *ctx, uint32_t color, int is_bg) {
+    (void)ctx;
+    if (COLOR_IS_TRUE_RGB(color))
+        return color & 0x00FFFFFFu;
+    if (color == COLOR_DEFAULT_BG || (color > COLOR_DEFAULT_BG && is_bg))
+        return 0x000000;
+    if (color == COLOR_DEFAULT_FG || color > COLOR_DEFAULT_BG)
+        return 0xE5E5E5;
+    return (color & 0xFF) * 0x010101u;
+}
+
+const RenderBackend render_null_backend = {
+    null_begin, null_rect, null_rects, null_glyphs, null_cursor, null_copy, null_rgb, NULL,
+};
+
+/* ---- Recording backend ---- */
+
+static RenderOp *rec_push(RenderRecorder *rec, RenderOpKind kind) {
+    RenderOp *op;
+
+    rec->totals[kind]++;
+    if (rec->count == rec->cap) {
+        size_t cap = rec->cap ? rec->cap * 2 : 256;
+        RenderOp *grown = realloc(rec->ops, cap * sizeof(*grown));
+        if (!grown)
+            return NULL;
+        rec->ops = grown;
+        rec->cap = cap;
+    }
+    op = &rec->ops[rec->count++];
+    memset(op, 0, sizeof(*op));
+    op->kind = kind;
+    return op;
+}
+
+static void rec_rect(void *ctx, int x, int y, int w, int h, uint32_t color, int flags) {
+    RenderOp *op = rec_push(ctx, RENDER_OP_RECT);
+    (void)flags;
+    if (!op) return;
+    op->x = x; op->y = y; op->w = w; op->h = h;
+    op->color = color;
+}
+
+static void rec_rects(void *ctx, const RenderRect *r, int n, uint32_t color, int flags) {
+    RenderOp *op = rec_push(ctx, RENDER_OP_RECTS);
+    int x1, y1;
+
+    (void)flags;
+    if (!op || n <= 0) return;
+    op->x = r[0].x; op->y = r[0].y;
+    x1 = r[0].x + r[0].w; y1 = r[0].y + r[0].h;
+    for (int i = 1; i < n; i++) {
+        if (r[i].x < op->x) op->x = r[i].x;
+        if (r[i].y < op->y) op->y = r[i].y;
+        if (r[i].x + r[i].w > x1) x1 = r[i].x + r[i].w;
+        if (r[i].y + r[i].h > y1) y1 = r[i].y + r[i].h;
+    }
+    op->w = x1 - op->x;
+    op->h = y1 - op->y;
+    op->color = color;
+    op->count = n;
+}
+
+static void rec_glyphs(void *ctx, const RenderGlyph *g, int n, int top, int h, int baseline,
+                       uint32_t fg, uint16_t attrs) {
+    RenderOp *op = rec_push(ctx, RENDER_OP_GLYPHS);
+    size_t len = 0;
+
+    (void)baseline; (void)attrs;
+    if (!op || n <= 0) return;
+    op->x = g[0].x;
+    op->y = top;
+    op->w = g[n - 1].x + g[n - 1].width - g[0].x;
+    op->h = h;
+    op->color = fg;
+    op->count = n;
+    for (int i = 0; i < n; i++) {
+        size_t l = strlen(g[i].utf8);
+        if (len + l >= sizeof(op->text))
+            break;
+        memcpy(op->text + len, g[i].utf8, l);
+        len += l;
+    }
+    op->text[len] = '\0';
+}
+
+static void rec_cursor(void *ctx, const RenderCursor *cur) {
+    RenderOp *op = rec_push(ctx, RENDER_OP_CURSOR);
+    if (!op) return;
+    op->x = cur->x; op->y = cur->y; op->w = cur->w; op->h = cur->h;
+    op->color = cur->bg;
+    op->count = cur->shape;
+}
+
+static void rec_copy(void *ctx, int x, int y, int w, int h) {
+    RenderOp *op = rec_push(ctx, RENDER_OP_COPY);
+    if (!op) return;
+    op->x = x; op->y = y; op->w = w; op->h = h;
+}
+
+void render_recorder_init(RenderBackend *be, RenderRecorder *rec) {
+    memset(rec, 0, sizeof(*rec));
+    *be = render_null_backend;
+    be->fill_rect = rec_rect;
+    be->fill_rects = rec_rects;
+    be->glyphs = rec_glyphs;
+    be->cursor = rec_cursor;
+    be->copy_area = rec_copy;
+    be->ctx = rec;
+}
+
+void render_recorder_reset(RenderRecorder *rec) {
+    rec->count = 0;
+}
+
+void render_recorder_free(RenderRecorder *rec) {
+    free(rec->ops);
+    memset(rec, 0, sizeof(*rec));
+}
@@ -0,0 +1,137 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Renderer frontend/backend split.
+ *
+ * render_frame() walks the dirty cells of the visible screen, resolves
+ * colours, batches runs and tracks damage, and emits a small set of
+ * primitive operations through a RenderBackend.  The Xft backend lives in
+ * draw.c; the null and recording backends below need no X server, so the
+ * CPU cost of the frontend can be benchmarked and its output asserted on in
+ * tests.  Colours are logical (palette index, COLOR_DEFAULT_*, or
+ * COLOR_TRUE_RGB_BASE | rgb); backends map them to pixels.
+ */
+
+/* fill_rect flags */
+#define RENDER_COLOR_BG    0x1  /* background colour (fallbacks differ) */
+#define RENDER_COLOR_FAINT 0x2  /* halved foreground (ATTR_FAINT decorations) */
+
+typedef struct {
+    int x, y, w, h;
+} RenderRect;
+
+typedef struct {
+    int x;                  /* left edge of the cell */
+    int width;              /* clip width: one or two cells */
+    const char *utf8;       /* NUL-terminated cell text */
+} RenderGlyph;
+
+typedef struct {
+    int x, y, w, h;         /* cell box */
+    int baseline;
+    int shape;              /* DECSCUSR: 0-2 block, 3-4 underline, 5-6 bar, 7 snowman */
+    int thickness;          /* underline/bar thickness */
+    uint32_t fg, bg;        /* glyph colour (block shapes) and cursor colour */
+    uint16_t attrs;         /* font style for the glyph under a block cursor */
+    const char *utf8;       /* glyph under the cursor, "" if none */
+} RenderCursor;
+
+typedef struct {
+    /* Start of a frame onto a w x h target.  Returns 0 if nothing can be
+     * drawn (no target); the frontend then skips the frame. */
+    int (*begin_frame)(void *ctx, int w, int h);
+    void (*fill_rect)(void *ctx, int x, int y, int w, int h, uint32_t color, int flags);
+    /* n rects in one colour (procedural box drawing, boxdraw.h). */
+    void (*fill_rects)(void *ctx, const RenderRect *r, int n, uint32_t color, int flags);
+    /* n glyphs sharing one colour and style, each clipped to its cell box
+     * (top .. top + h); all drawn on the same baseline. */
+    void (*glyphs)(void *ctx, const RenderGlyph *g, int n, int top, int h, int baseline,
+                   uint32_t fg, uint16_t attrs);
+    void (*cursor)(void *ctx, const RenderCursor *cur);
+    /* Present the damaged rectangle (back buffer -> window). */
+    void (*copy_area)(void *ctx, int x, int y, int w, int h);
+    /* Resolve a logical colour to 0xRRGGBB (DECSCNM inverts real RGB). */
+    uint32_t (*resolve_rgb)(void *ctx, uint32_t color, int is_bg);
+    void *ctx;
+} RenderBackend;
+
+/* Highlighted cells c0..c1 of a visible row (search matches, search.h). */
+typedef struct {
+    int row, c0, c1;
+    int current;            /* drawn in the cursor colours */
+} RenderMark;
+
+/* Everything the frontend needs that is not terminal state. */
+typedef struct {
+    int width, height;      /* target size in pixels */
+    int left_pad, top_pad;
+    int cell_w, cell_h, cell_gap, line_gap;
+    int ascent;
+    int hide_blink;         /* blink phase: hide ATTR_BLINK text */
+    int cursor_thickness;
+    int boxdraw;            /* draw U+2500-U+259F from the cell geometry */
+    int boxdraw_braille;    /* ... and U+2800-U+28FF */
+    uint32_t cursor_color, rcursor_color;
+    /* Selection, already normalised (start <= end). */
+    int sel_active, sel_rect;
+    int sel_sr, sel_sc, sel_er, sel_ec;
+    /* Highlights, ordered by row; drawn inverted like the selection. */
+    const RenderMark *marks;
+    int nmarks;
+} RenderParams;
+
+typedef struct {
+    unsigned long frames;
+    unsigned long rows;         /* rows walked */
+    unsigned long cells;        /* cells walked */
+    unsigned long rects;
+    unsigned long glyph_calls;
+    unsigned long glyphs;
+    unsigned long cursors;
+    unsigned long copies;
+} RenderStats;
+
+/* Draw what changed since the last frame.  Returns 1 if anything was drawn. */
+int render_frame(const RenderBackend *be, const RenderParams *p);
+/* Redraw everything next frame (new target, font change). */
+void render_invalidate(void);
+/* Target contents lost (Expose): present the whole buffer next frame. */
+void render_notify_expose(void);
+const RenderStats *render_stats(void);
+
+/* Null backend: accepts and discards everything. */
+extern const RenderBackend render_null_backend;
+
+/* Recording backend: keeps a list of the primitives of the last frame. */
+typedef enum {
+    RENDER_OP_RECT,
+    RENDER_OP_RECTS,
+    RENDER_OP_GLYPHS,
+    RENDER_OP_CURSOR,
+    RENDER_OP_COPY,
+    RENDER_OP_COUNT
+} RenderOpKind;
+
+typedef struct {
+    RenderOpKind kind;
+    int x, y, w, h;         /* rect, copy, cursor box; glyphs, rects: bounding box */
+    uint32_t color;         /* rect colour, glyph fg, cursor bg */
+    int count;              /* glyphs in the run, rects in the batch */
+    char text[64];          /* run text (truncated) */
+} RenderOp;
+
+typedef struct {
+    RenderOp *ops;
+    size_t count, cap;
+    unsigned long totals[RENDER_OP_COUNT];
+} RenderRecorder;
+
+void render_recorder_init(RenderBackend *be, RenderRecorder *rec);
+void render_recorder_reset(RenderRecorder *rec);   /* forget recorded ops */
+void render_recorder_free(RenderRecorder *rec);
+
+#endif /* RENDER_H */
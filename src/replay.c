@@ -0,0 +1,292 @@
+// replay.c - recorded-stream loader and frame statistics for --replay
+#define _POSIX_C_SOURCE 200809L
+#include "replay.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int read_file(const char *path, uint8_t **out, size_t *out_len) {
+    FILE *fp = fopen(path, "rb");
+    uint8_t *buf = NULL;
+    size_t len = 0, cap = 0, n;
+
+    if (!fp)
+        return -1;
+    do {
+        if (cap - len < 65536) {
+            uint8_t *grown;
+            cap = cap ? cap * 2 : 1 << 20;
+            grown = realloc(buf, cap);
+            if (!grown) {
+                free(buf);
+                fclose(fp);
+                errno = ENOMEM;
+                return -1;
+            }
+            buf = grown;
+        }
+        n = fread(buf + len, 1, cap - len, fp);
+        len += n;
+    } while (n > 0);
+    fclose(fp);
+    *out = buf;
+    *out_len = len;
+    return 0;
+}
+
+static int add_chunk(Replay *r, size_t *cap, size_t off, size_t len, double t) {
+    if (r->count == *cap) {
+        ReplayChunk *grown;
+        *cap = *cap ? *cap * 2 : 1024;
+        grown = realloc(r->chunks, *cap * sizeof(*grown));
+        if (!grown) {
+            errno = ENOMEM;
+            return -1;
+        }
+        r->chunks = grown;
+    }
+    /* Offset for now; turned into a pointer once the payload is final. */
+    r->chunks[r->count].data = (const uint8_t *)(uintptr_t)off;
+    r->chunks[r->count].len = len;
+    r->chunks[r->count].t = t;
+    r->count++;
+    r->total += len;
+    return 0;
+}
+
+static int hexval(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int parse_u16(const uint8_t *p, const uint8_t *end, unsigned *out) {
+    unsigned v = 0;
+
+    if (end - p < 4)
+        return -1;
+    for (int i = 0; i < 4; i++) {
+        int h = hexval(p[i]);
+        if (h < 0)
+            return -1;
+        v = (v << 4) | (unsigned)h;
+    }
+    *out = v;
+    return 0;
+}
+
+static size_t put_utf8(uint8_t *out, unsigned cp) {
+    if (cp < 0x80) {
+        out[0] = (uint8_t)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (uint8_t)(0xC0 | (cp >> 6));
+        out[1] = (uint8_t)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (uint8_t)(0xE0 | (cp >> 12));
+        out[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (uint8_t)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (uint8_t)(0xF0 | (cp >> 18));
+    out[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (uint8_t)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* Decode the JSON string starting after the opening quote at *pp into out.
+ * The decoded form is never longer than the encoded one, so decoding in
+ * place over the source buffer is safe.  Returns decoded length or -1. */
+static long json_string(const uint8_t **pp, const uint8_t *end, uint8_t *out) {
+    const uint8_t *p = *pp;
+    size_t o = 0;
+
+    while (p < end && *p != '"') {
+        unsigned cp, lo;
+
+        if (*p != '\\') {
+            out[o++] = *p++;
+            continue;
+        }
+        if (++p >= end)
+            return -1;
+        switch (*p++) {
+        case '"': out[o++] = '"'; break;
+        case '\\': out[o++] = '\\'; break;
+        case '/': out[o++] = '/'; break;
+        case 'b': out[o++] = '\b'; break;
+        case 'f': out[o++] = '\f'; break;
+        case 'n': out[o++] = '\n'; break;
+        case 'r': out[o++] = '\r'; break;
+        case 't': out[o++] = '\t'; break;
+        case 'u':
+            if (parse_u16(p, end, &cp) < 0)
+                return -1;
+            p += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+                parse_u16(p + 2, end, &lo) == 0 && lo >= 0xDC00 && lo <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                p += 6;
+            } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                cp = 0xFFFD;
+            }
+            o += put_utf8(out + o, cp);
+            break;
+        default:
+            return -1;
+        }
+    }
+    if (p >= end)
+        return -1;
+    *pp = p + 1;
+    return (long)o;
+}
+
+static const uint8_t *skip_ws(const uint8_t *p, const uint8_t *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+/* Event lines look like: [1.234567, "o", "text"].  Only "o" events are kept;
+ * resizes and input are skipped (the window size is the replay's own). */
+static int load_asciicast(Replay *r, uint8_t *buf, size_t len) {
+    const uint8_t *end = buf + len;
+    const uint8_t *line = memchr(buf, '\n', len);
+    size_t out = 0, cap = 0;
+
+    r->timed = 1;
+    while (line && ++line < end) {
+        const uint8_t *p = skip_ws(line, end);
+        const uint8_t *eol = memchr(line, '\n', (size_t)(end - line));
+        char num[64];
+        size_t nlen = 0;
+        double t;
+        long n;
+        int is_output;
+
+        if (!eol)
+            eol = end;
+        line = eol < end ? eol : NULL;
+        if (p >= eol || *p != '[')
+            continue;
+        p = skip_ws(p + 1, eol);
+        while (p < eol && nlen < sizeof(num) - 1 && *p != ',')
+            num[nlen++] = (char)*p++;
+        num[nlen] = '\0';
+        t = strtod(num, NULL);
+        p = skip_ws(p + 1, eol);
+        if (p >= eol || *p != '"')
+            continue;
+        is_output = eol - p > 3 && p[1] == 'o' && p[2] == '"';
+        p = memchr(p + 1, '"', (size_t)(eol - p - 1));
+        if (!p)
+            continue;
+        p = skip_ws(p + 1, eol);
+        if (p >= eol || *p != ',')
+            continue;
+        p = skip_ws(p + 1, eol);
+        if (!is_output || p >= eol || *p != '"')
+            continue;
+        p++;
+        n = json_string(&p, eol, buf + out);
+        if (n < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (n > 0 && add_chunk(r, &cap, out, (size_t)n, t) < 0)
+            return -1;
+        out += (size_t)n;
+    }
+    return 0;
+}
+
+int replay_load(const char *path, size_t chunk_size, Replay *r) {
+    uint8_t *buf;
+    size_t len, cap = 0;
+    const uint8_t *first;
+    char head[256] = "";
+
+    memset(r, 0, sizeof(*r));
+    if (chunk_size == 0)
+        chunk_size = 4096;
+    if (read_file(path, &buf, &len) < 0)
+        return -1;
+    r->bytes = buf;
+
+    first = skip_ws(buf, buf + len);
+    if (first < buf + len && *first == '{') {
+        size_t n = (size_t)(buf + len - first);
+        memcpy(head, first, n < sizeof(head) - 1 ? n : sizeof(head) - 1);
+        head[n < sizeof(head) - 1 ? n : sizeof(head) - 1] = '\0';
+    }
+    if (strstr(head, "\"version\"")) {
+        if (load_asciicast(r, buf, len) < 0) {
+            replay_free(r);
+            return -1;
+        }
+    } else {
+        for (size_t off = 0; off < len; off += chunk_size) {
+            if (add_chunk(r, &cap, off, len - off < chunk_size ? len - off : chunk_size, 0) < 0) {
+                replay_free(r);
+                return -1;
+            }
+        }
+    }
+    for (size_t i = 0; i < r->count; i++)
+        r->chunks[i].data = r->bytes + (uintptr_t)r->chunks[i].data;
+    return 0;
+}
+
+void replay_free(Replay *r) {
+    free(r->bytes);
+    free(r->chunks);
+    memset(r, 0, sizeof(*r));
+}
+
+void replay_stats_note_frame(ReplayStats *s, double ms) {
+    if (s->frames == s->cap) {
+        double *grown;
+        size_t cap = s->cap ? s->cap * 2 : 1024;
+        grown = realloc(s->frame_ms, cap * sizeof(*grown));
+        if (!grown)
+            return;
+        s->frame_ms = grown;
+        s->cap = cap;
+    }
+    s->frame_ms[s->frames++] = ms;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void replay_stats_report(ReplayStats *s, FILE *out) {
+    double sum = 0.0, p99 = 0.0, max = 0.0;
+
+    if (s->frames > 0) {
+        for (size_t i = 0; i < s->frames; i++)
+            sum += s->frame_ms[i];
+        qsort(s->frame_ms, s->frames, sizeof(double), cmp_double);
+        p99 = s->frame_ms[(s->frames * 99) / 100 < s->frames ? (s->frames * 99) / 100 : s->frames - 1];
+        max = s->frame_ms[s->frames - 1];
+    }
+    fprintf(out, "replay: %zu bytes, %zu frames\n", s->bytes, s->frames);
+    fprintf(out, "replay: frame avg %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            s->frames ? sum / (double)s->frames : 0.0, p99, max);
+    fprintf(out, "replay: parse %.1f ms, draw %.1f ms, wall %.1f ms (%.2f MB/s)\n",
+            s->parse_ms, sum, s->wall_ms,
+            s->wall_ms > 0.0 ? (double)s->bytes / s->wall_ms / 1000.0 : 0.0);
+}
+
+void replay_stats_free(ReplayStats *s) {
+    free(s->frame_ms);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,47 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * --replay: feed a recorded stream through the parser and renderer in place
+ * of a PTY child.  Accepts raw captures (-o, script(1)) and asciicast v2
+ * recordings (-O, asciinema); only the latter carry timing.
+ */
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    double t;          /* seconds from start of recording (0 for raw) */
+} ReplayChunk;
+
+typedef struct {
+    uint8_t *bytes;    /* all chunk payloads, back to back */
+    ReplayChunk *chunks;
+    size_t count;
+    size_t total;      /* payload bytes */
+    int timed;         /* chunks carry real timestamps */
+} Replay;
+
+/* Raw files are split into chunks of at most chunk_size bytes, the size of
+ * one PTY read.  Returns 0 on success, -1 with errno set on failure. */
+int replay_load(const char *path, size_t chunk_size, Replay *r);
+void replay_free(Replay *r);
+
+typedef struct {
+    double *frame_ms;  /* per-frame draw+flush time */
+    size_t frames;
+    size_t cap;
+    double parse_ms;
+    double wall_ms;
+    size_t bytes;
+} ReplayStats;
+
+void replay_stats_note_frame(ReplayStats *s, double ms);
+/* Print frames, average/p99 frame time, parse time, wall time and MB/s. */
+void replay_stats_report(ReplayStats *s, FILE *out);
+void replay_stats_free(ReplayStats *s);
+
+#endif /* REPLAY_H */
@@ -0,0 +1,884 @@
+// search.c - scrollback search: sharded scans on worker threads, incremental index
+#define _POSIX_C_SOURCE 200809L
+#include "search.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <regex.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "spill.h"
+#include "trace.h"
+
+#define SEARCH_MAX_THREADS 4
+/* Below this many lines a scan runs inline: threads would cost more. */
+#define SEARCH_THREAD_MIN 512
+/* Workers look at the cancel flag this often (lines). */
+#define SEARCH_CANCEL_EVERY 256
+/* Lines per unit of work the workers claim. */
+#define SEARCH_CHUNK 2048
+
+typedef struct {
+    int regex, icase;
+    regex_t re;
+    char needle[SEARCH_QUERY_MAX];  /* folded to lower case with icase */
+    size_t len;
+} Matcher;
+
+typedef struct {
+    SearchMatch *v;
+    size_t n, cap;
+} MatchVec;
+
+/* History lines first .. first + n - 1.  The first spilled of them are
+ * read from the spill file by the scan itself; the rest, from the ring, are
+ * copied text, each NUL-terminated. */
+typedef struct {
+    unsigned long long first;
+    size_t n;
+    int cols;
+    SpillView *spill;
+    size_t spilled;
+    char *text;
+    size_t *off;        /* n - spilled + 1 offsets into text */
+} Snapshot;
+
+typedef struct {
+    pthread_t thread;
+    int failed;         /* out of memory or regex error: results incomplete */
+} Worker;
+
+static struct {
+    int active;
+    int threads;
+    char query[SEARCH_QUERY_MAX];
+    int regex;
+    int bad;            /* query does not compile */
+    Matcher m;          /* main thread: incremental lines and the screen */
+    int have_m;
+    Snapshot snap;
+    unsigned long long seen_total;  /* terminal_history_total() when last checked */
+    int stale;          /* a line id went backwards: the history was reset */
+    int incomplete;     /* results were lost (out of memory, regex error) */
+    MatchVec scan;      /* snapshot results, valid once the scan is done */
+    MatchVec live;      /* lines pushed since the snapshot */
+    MatchVec *chunks;   /* running scan: results per SEARCH_CHUNK lines */
+    size_t nchunks;
+    size_t next_chunk;  /* next one to claim (atomic) */
+    Worker workers[SEARCH_MAX_THREADS];
+    int nworkers;       /* running scan */
+    int done;           /* workers finished (atomic) */
+    int cancel;         /* atomic */
+    int wake[2];
+    int have_cur;
+    SearchMatch cur;
+    size_t cur_index;   /* 1-based position of cur, as of cur_stamp */
+    unsigned long long cur_stamp[4];
+    int want_jump;      /* search_next(-1) once the scan completes */
+    char *linebuf;
+    size_t linebuf_cap;
+} g_search = { .wake = { -1, -1 } };
+
+static int vec_push(MatchVec *vec, unsigned long long line, int b0, int b1) {
+    if (vec->n == vec->cap) {
+        size_t cap = vec->cap ? vec->cap * 2 : 64;
+        SearchMatch *v = realloc(vec->v, cap * sizeof(*v));
+
+        if (!v)
+            return -1;
+        vec->v = v;
+        vec->cap = cap;
+    }
+    vec->v[vec->n].line = line;
+    vec->v[vec->n].b0 = b0;
+    vec->v[vec->n].b1 = b1;
+    vec->n++;
+    return 0;
+}
+
+static void vec_free(MatchVec *vec) {
+    free(vec->v);
+    vec->v = NULL;
+    vec->n = vec->cap = 0;
+}
+
+static unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : c;
+}
+
+static int has_upper(const char *s) {
+    for (; *s; s++) {
+        if (*s >= 'A' && *s <= 'Z')
+            return 1;
+    }
+    return 0;
+}
+
+static int matcher_init(Matcher *m, const char *query, int regex) {
+    memset(m, 0, sizeof(*m));
+    m->regex = regex;
+    m->icase = !has_upper(query);
+    if (regex) {
+        return regcomp(&m->re, query, REG_EXTENDED | REG_NEWLINE | (m->icase ? REG_ICASE : 0)) == 0
+                   ? 0 : -1;
+    }
+    m->len = strlen(query);
+    for (size_t i = 0; i < m->len; i++)
+        m->needle[i] = (char)(m->icase ? fold((unsigned char)query[i]) : (unsigned char)query[i]);
+    return 0;
+}
+
+static void matcher_free(Matcher *m) {
+    if (m->regex)
+        regfree(&m->re);
+}
+
+static int same_bytes(const char *a, const char *needle, size_t n, int icase) {
+    if (!icase)
+        return memcmp(a, needle, n) == 0;
+    for (size_t i = 0; i < n; i++) {
+        if (fold((unsigned char)a[i]) != (unsigned char)needle[i])
+            return 0;
+    }
+    return 1;
+}
+
+/* First offset >= from where the needle starts, or -1.  SSE2: compare 16
+ * candidate positions at once against the needle's first and last byte
+ * (both cases with icase) and only verify where both agree. */
+static long find_plain(const Matcher *m, const char *hay, size_t n, size_t from) {
+    const size_t len = m->len;
+    const unsigned char first = (unsigned char)m->needle[0];
+    const unsigned char last = (unsigned char)m->needle[len - 1];
+    size_t i = from;
+
+    if (len == 0 || n < len)
+        return -1;
+#ifdef __SSE2__
+    {
+        const unsigned char ufirst = (m->icase && first >= 'a' && first <= 'z') ? first - 32 : first;
+        const unsigned char ulast = (m->icase && last >= 'a' && last <= 'z') ? last - 32 : last;
+        const __m128i f_lo = _mm_set1_epi8((char)first), f_up = _mm_set1_epi8((char)ufirst);
+        const __m128i l_lo = _mm_set1_epi8((char)last), l_up = _mm_set1_epi8((char)ulast);
+
+        for (; i + len - 1 + 16 <= n; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + len - 1));
+            __m128i fa = _mm_or_si128(_mm_cmpeq_epi8(a, f_lo), _mm_cmpeq_epi8(a, f_up));
+            __m128i lb = _mm_or_si128(_mm_cmpeq_epi8(b, l_lo), _mm_cmpeq_epi8(b, l_up));
+            unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(fa, lb));
+
+            while (mask) {
+                unsigned bit = (unsigned)__builtin_ctz(mask);
+
+                if (same_bytes(hay + i + bit, m->needle, len, m->icase))
+                    return (long)(i + bit);
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+    for (; i + len <= n; i++) {
+        if (same_bytes(hay + i, m->needle, len, m->icase))
+            return (long)i;
+    }
+    return -1;
+}
+
+/* Append the matches in one line of text (NUL-terminated, n bytes). */
+static int match_line(const Matcher *m, const char *text, size_t n, unsigned long long line,
+                      MatchVec *out) {
+    if (!m->regex) {
+        long at = 0;
+
+        while ((at = find_plain(m, text, n, (size_t)at)) >= 0) {
+            if (vec_push(out, line, (int)at, (int)(at + (long)m->len)) != 0)
+                return -1;
+            at += (long)m->len;
+        }
+        return 0;
+    }
+    for (size_t at = 0; at <= n; ) {
+        regmatch_t rm;
+
+        if (regexec(&m->re, text + at, 1, &rm, at ? REG_NOTBOL : 0) != 0)
+            break;
+        if (rm.rm_eo > rm.rm_so &&
+            vec_push(out, line, (int)(at + (size_t)rm.rm_so), (int)(at + (size_t)rm.rm_eo)) != 0)
+            return -1;
+        at += (size_t)(rm.rm_eo > rm.rm_so ? rm.rm_eo : rm.rm_so + 1);
+    }
+    return 0;
+}
+
+size_t search_line_text(const TerminalCell *row, int cols, char *out) {
+    size_t len = 0, keep = 0;
+
+    for (int c = 0; c < cols; c++) {
+        const TerminalCell *cell = &row[c];
+        size_t n;
+
+        if (cell->is_continuation)
+            continue;
+        if (cell->c[0] == '\0') {
+            out[len++] = ' ';
+            continue;
+        }
+        n = strlen(cell->c);
+        memcpy(out + len, cell->c, n);
+        len += n;
+        if (!(n == 1 && cell->c[0] == ' '))
+            keep = len;
+    }
+    out[keep] = '\0';
+    return keep;
+}
+
+void search_match_cols(const TerminalCell *row, int cols, int b0, int b1, int *c0, int *c1) {
+    int pos = 0;
+
+    *c0 = -1;
+    *c1 = -1;
+    for (int c = 0; c < cols && pos < b1; c++) {
+        const TerminalCell *cell = &row[c];
+        int n;
+
+        if (cell->is_continuation)
+            continue;
+        n = cell->c[0] ? (int)strlen(cell->c) : 1;
+        if (pos + n > b0) {
+            if (*c0 < 0)
+                *c0 = c;
+            *c1 = (cell->width == 2 && c + 1 < cols) ? c + 1 : c;
+        }
+        pos += n;
+    }
+    if (*c0 < 0)
+        *c0 = *c1 = cols - 1;
+}
+
+static char *line_buffer(void) {
+    size_t need = (size_t)term_cols * MAX_UTF8_CHAR_SIZE + 1;
+
+    if (need > g_search.linebuf_cap) {
+        char *p = realloc(g_search.linebuf, need);
+
+        if (!p)
+            return NULL;
+        g_search.linebuf = p;
+        g_search.linebuf_cap = need;
+    }
+    return g_search.linebuf;
+}
+
+static void snapshot_free(Snapshot *s) {
+    spill_view_close(s->spill);
+    free(s->text);
+    free(s->off);
+    memset(s, 0, sizeof(*s));
+}
+
+/* Take the history as it is now: the ring's text is copied, spilled lines
+ * stay on disk behind a view, so this costs at most the ring whatever the
+ * length of the history. */
+static int snapshot_take(Snapshot *s) {
+    unsigned long long total = terminal_history_total();
+    unsigned long long first = total - (unsigned long long)terminal_history_lines();
+    size_t n = (size_t)(total - first);
+    size_t ring, cap, len = 0;
+    char *buf = line_buffer();
+    TRACE_BEGIN(t_snap);
+
+    snapshot_free(s);
+    s->first = first;
+    s->n = n;
+    s->cols = term_cols;
+    s->spill = terminal_spill_view();
+    s->spilled = spill_view_lines(s->spill);
+    if (s->spilled > n)
+        s->spilled = n;
+    /* Without a view (out of memory) the spilled lines are copied too. */
+    ring = n - s->spilled;
+    cap = ring * 64 + 1;
+    s->off = malloc((ring + 1) * sizeof(size_t));
+    s->text = malloc(cap);
+    if (!buf || !s->off || !s->text) {
+        snapshot_free(s);
+        return -1;
+    }
+    for (size_t i = 0; i < ring; i++) {
+        const TerminalCell *row = terminal_line(first + s->spilled + i);
+        size_t t = row ? search_line_text(row, s->cols, buf) : 0;
+
+        if (len + t + 1 > cap) {
+            char *p;
+
+            while (len + t + 1 > cap)
+                cap *= 2;
+            p = realloc(s->text, cap);
+            if (!p) {
+                snapshot_free(s);
+                return -1;
+            }
+            s->text = p;
+        }
+        s->off[i] = len;
+        memcpy(s->text + len, buf, t);
+        s->text[len + t] = '\0';
+        len += t + 1;
+    }
+    s->off[ring] = len;
+    TRACE_END(t_snap, "search snapshot", "search", ring);
+    return 0;
+}
+
+/* Where a scan reads spilled lines: its own cursor and buffers. */
+typedef struct {
+    SpillCursor cur;
+    TerminalCell *cells;
+    char *text;
+} SpillReader;
+
+static int reader_init(SpillReader *r, const Snapshot *s) {
+    memset(r, 0, sizeof(*r));
+    if (s->spilled == 0)
+        return 0;
+    r->cells = malloc((size_t)s->cols * sizeof(TerminalCell));
+    r->text = malloc((size_t)s->cols * MAX_UTF8_CHAR_SIZE + 1);
+    return (r->cells && r->text) ? 0 : -1;
+}
+
+static void reader_free(SpillReader *r) {
+    free(r->cells);
+    free(r->text);
+}
+
+/* Text of snapshot line i and its length. */
+static const char *snapshot_line(const Snapshot *s, SpillReader *r, size_t i, size_t *len) {
+    if (i < s->spilled) {
+        spill_view_row(s->spill, &r->cur, i, r->cells, s->cols);
+        *len = search_line_text(r->cells, s->cols, r->text);
+        return r->text;
+    }
+    i -= s->spilled;
+    *len = s->off[i + 1] - s->off[i] - 1;
+    return s->text + s->off[i];
+}
+
+/* Claim chunks of the snapshot and match them until none are left. */
+static void scan_chunks(const Matcher *m, const Snapshot *s, Worker *w) {
+    SpillReader r;
+    size_t c;
+
+    if (reader_init(&r, s) != 0) {
+        reader_free(&r);
+        w->failed = 1;
+        return;
+    }
+    while ((c = __atomic_fetch_add(&g_search.next_chunk, 1, __ATOMIC_RELAXED)) < g_search.nchunks) {
+        size_t lo = c * SEARCH_CHUNK;
+        size_t hi = lo + SEARCH_CHUNK < s->n ? lo + SEARCH_CHUNK : s->n;
+
+        for (size_t i = lo; i < hi; i++) {
+            const char *text;
+            size_t len;
+
+            if ((i - lo) % SEARCH_CANCEL_EVERY == 0 &&
+                __atomic_load_n(&g_search.cancel, __ATOMIC_RELAXED))
+                goto out;
+            text = snapshot_line(s, &r, i, &len);
+            if (match_line(m, text, len, s->first + i, &g_search.chunks[c]) != 0) {
+                w->failed = 1;
+                goto out;
+            }
+        }
+    }
+out:
+    reader_free(&r);
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    Matcher m;
+    ssize_t rc;
+    TRACE_BEGIN(t_scan);
+
+    /* A compiled regex_t is not shared between threads. */
+    if (matcher_init(&m, g_search.query, g_search.regex) == 0) {
+        scan_chunks(&m, &g_search.snap, w);
+        matcher_free(&m);
+    } else {
+        w->failed = 1;
+    }
+    TRACE_END(t_scan, "search worker", "search", g_search.snap.n);
+    __atomic_add_fetch(&g_search.done, 1, __ATOMIC_RELEASE);
+    do {
+        rc = write(g_search.wake[1], "", 1);
+    } while (rc < 0 && errno == EINTR);
+    return NULL;
+}
+
+static int open_wake(void) {
+    if (g_search.wake[0] >= 0)
+        return 0;
+    if (pipe(g_search.wake) != 0) {
+        g_search.wake[0] = g_search.wake[1] = -1;
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(g_search.wake[i], F_SETFL, fcntl(g_search.wake[i], F_GETFL) | O_NONBLOCK);
+        fcntl(g_search.wake[i], F_SETFD, FD_CLOEXEC);
+    }
+    return 0;
+}
+
+static int thread_count(void) {
+    long cpus;
+
+    if (g_search.threads > 0)
+        return g_search.threads < SEARCH_MAX_THREADS ? g_search.threads : SEARCH_MAX_THREADS;
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    return cpus < SEARCH_MAX_THREADS ? (int)cpus : SEARCH_MAX_THREADS;
+}
+
+/* Concatenate the chunk results (in line order) unless cancelled. */
+static void take_chunks(int keep) {
+    for (size_t c = 0; c < g_search.nchunks; c++) {
+        const MatchVec *found = &g_search.chunks[c];
+
+        for (size_t j = 0; keep && j < found->n; j++) {
+            if (vec_push(&g_search.scan, found->v[j].line, found->v[j].b0, found->v[j].b1) != 0) {
+                g_search.incomplete = 1;
+                keep = 0;
+            }
+        }
+        vec_free(&g_search.chunks[c]);
+    }
+    free(g_search.chunks);
+    g_search.chunks = NULL;
+    g_search.nchunks = 0;
+}
+
+/* Join the workers and keep their results unless cancelled. */
+static void collect(int keep) {
+    int n = g_search.nworkers;
+
+    g_search.nworkers = 0;
+    for (int i = 0; i < n; i++) {
+        pthread_join(g_search.workers[i].thread, NULL);
+        if (keep && g_search.workers[i].failed)
+            g_search.incomplete = 1;
+    }
+    take_chunks(keep);
+}
+
+static void cancel_scan(void) {
+    if (g_search.nworkers == 0)
+        return;
+    __atomic_store_n(&g_search.cancel, 1, __ATOMIC_RELAXED);
+    collect(0);
+    __atomic_store_n(&g_search.cancel, 0, __ATOMIC_RELAXED);
+}
+
+static void start_scan(void) {
+    const Snapshot *s = &g_search.snap;
+    int n = thread_count();
+    sigset_t all, old;
+
+    g_search.nchunks = (s->n + SEARCH_CHUNK - 1) / SEARCH_CHUNK;
+    g_search.next_chunk = 0;
+    g_search.chunks = calloc(g_search.nchunks ? g_search.nchunks : 1, sizeof(MatchVec));
+    if (!g_search.chunks) {
+        g_search.nchunks = 0;
+        g_search.incomplete = 1;
+        return;
+    }
+    /* Short histories scan inline; spilled lines always go to a thread,
+     * even on one CPU, so the main loop never decodes the file. */
+    if (s->n < SEARCH_THREAD_MIN || (n <= 1 && s->spilled == 0) || open_wake() != 0) {
+        Worker w;
+
+        memset(&w, 0, sizeof(w));
+        scan_chunks(&g_search.m, s, &w);
+        g_search.incomplete |= w.failed;
+        take_chunks(1);
+        return;
+    }
+
+    __atomic_store_n(&g_search.done, 0, __ATOMIC_RELAXED);
+    /* Signals stay on the main thread. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (int i = 0; i < n; i++) {
+        Worker *w = &g_search.workers[g_search.nworkers];
+
+        memset(w, 0, sizeof(w[0]));
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0)
+            break;
+        g_search.nworkers++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (g_search.nworkers == 0) {
+        /* No thread at all: scan here. */
+        Worker w;
+
+        memset(&w, 0, sizeof(w));
+        scan_chunks(&g_search.m, s, &w);
+        g_search.incomplete |= w.failed;
+        take_chunks(1);
+    }
+}
+
+static void history_pushed(unsigned long long id, const TerminalCell *row, int cols, void *ctx) {
+    char *buf = line_buffer();
+    size_t n;
+
+    (void)ctx;
+    if (id < g_search.seen_total)
+        g_search.stale = 1;
+    if (!g_search.have_m || !buf || id < g_search.snap.first + g_search.snap.n)
+        return;
+    n = search_line_text(row, cols, buf);
+    if (match_line(&g_search.m, buf, n, id, &g_search.live) != 0)
+        g_search.incomplete = 1;
+}
+
+static void clear_results(void) {
+    cancel_scan();
+    vec_free(&g_search.scan);
+    vec_free(&g_search.live);
+    if (g_search.have_m)
+        matcher_free(&g_search.m);
+    g_search.have_m = 0;
+    g_search.have_cur = 0;
+    g_search.want_jump = 0;
+    g_search.stale = 0;
+    g_search.incomplete = 0;
+}
+
+void search_set_threads(int n) {
+    g_search.threads = n;
+}
+
+int search_set_query(const char *query, int regex) {
+    clear_results();
+    g_search.active = 1;
+    g_search.bad = 0;
+    g_search.regex = regex;
+    snprintf(g_search.query, sizeof(g_search.query), "%s", query);
+    terminal_set_history_hook(history_pushed, NULL);
+    terminal_mark_all_rows_dirty();
+    if (!g_search.query[0])
+        return 0;
+    if (matcher_init(&g_search.m, g_search.query, regex) != 0) {
+        g_search.bad = 1;
+        return -1;
+    }
+    g_search.have_m = 1;
+
+    /* The snapshot is reused while the query is edited, unless output
+     * arrived (or the history was reset) since it was taken. */
+    if (!g_search.snap.off || terminal_history_total() != g_search.snap.first + g_search.snap.n ||
+        terminal_history_total() - (unsigned long long)terminal_history_lines() != g_search.snap.first) {
+        if (snapshot_take(&g_search.snap) != 0) {
+            g_search.incomplete = 1;
+            return 0;
+        }
+    }
+    g_search.seen_total = terminal_history_total();
+    start_scan();
+    return 0;
+}
+
+void search_stop(void) {
+    if (!g_search.active)
+        return;
+    clear_results();
+    snapshot_free(&g_search.snap);
+    terminal_set_history_hook(NULL, NULL);
+    g_search.active = 0;
+    g_search.bad = 0;
+    g_search.query[0] = '\0';
+    terminal_mark_all_rows_dirty();
+}
+
+int search_active(void) {
+    return g_search.active;
+}
+
+const char *search_query(int *regex) {
+    if (regex)
+        *regex = g_search.regex;
+    return g_search.query;
+}
+
+int search_failed(void) {
+    return g_search.bad;
+}
+
+int search_incomplete(void) {
+    return g_search.incomplete;
+}
+
+int search_busy(void) {
+    return g_search.nworkers > 0;
+}
+
+int search_busy_spilled(void) {
+    return g_search.nworkers > 0 && g_search.snap.spilled > 0 &&
+           __atomic_load_n(&g_search.next_chunk, __ATOMIC_RELAXED) * SEARCH_CHUNK < g_search.snap.spilled;
+}
+
+void search_wait(void) {
+    if (g_search.nworkers > 0)
+        collect(1);
+    if (g_search.want_jump) {
+        g_search.want_jump = 0;
+        search_next(-1);
+    }
+}
+
+int search_fd(void) {
+    return g_search.wake[0];
+}
+
+/* The history was reset (a new terminal, a failed resize): ids start over
+ * and the results point at lines that are gone, so the query is run again.
+ * Checked wherever results are used, not only when a scan reports in. */
+static int check_reset(void) {
+    if (g_search.active && (g_search.stale || terminal_history_total() < g_search.seen_total)) {
+        char query[SEARCH_QUERY_MAX];
+
+        memcpy(query, g_search.query, sizeof(query));
+        search_set_query(query, g_search.regex);
+        return 1;
+    }
+    g_search.seen_total = terminal_history_total();
+    return 0;
+}
+
+int search_poll(void) {
+    char sink[64];
+
+    if (g_search.wake[0] >= 0) {
+        while (read(g_search.wake[0], sink, sizeof(sink)) > 0)
+            ;
+    }
+    if (check_reset())
+        return 1;
+    if (g_search.nworkers == 0 ||
+        __atomic_load_n(&g_search.done, __ATOMIC_ACQUIRE) < g_search.nworkers)
+        return 0;
+    search_wait();
+    terminal_mark_all_rows_dirty();
+    return 1;
+}
+
+/* Index of the first match still in history. */
+static size_t first_valid(const MatchVec *vec) {
+    unsigned long long oldest = terminal_history_total() - (unsigned long long)terminal_history_lines();
+    size_t lo = 0, hi = vec->n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (vec->v[mid].line < oldest)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void screen_matches(MatchVec *out) {
+    char *buf = line_buffer();
+    unsigned long long total = terminal_history_total();
+
+    if (!g_search.have_m || !buf)
+        return;
+    for (int r = 0; r < term_rows; r++) {
+        const TerminalCell *row = terminal_line(total + (unsigned long long)r);
+
+        if (row)
+            match_line(&g_search.m, buf, search_line_text(row, term_cols, buf), total + (unsigned long long)r, out);
+    }
+}
+
+/* All current matches in order: history scan, live lines, screen. */
+static void all_matches(MatchVec *out) {
+    const MatchVec *parts[2] = { &g_search.scan, &g_search.live };
+
+    memset(out, 0, sizeof(*out));
+    for (int p = 0; p < 2; p++) {
+        for (size_t i = first_valid(parts[p]); i < parts[p]->n; i++) {
+            if (vec_push(out, parts[p]->v[i].line, parts[p]->v[i].b0, parts[p]->v[i].b1) != 0)
+                return;
+        }
+    }
+    screen_matches(out);
+}
+
+static int match_before(const SearchMatch *a, const SearchMatch *b) {
+    return a->line < b->line || (a->line == b->line && a->b0 < b->b0);
+}
+
+size_t search_count(void) {
+    MatchVec screen = { 0 };
+    size_t n = 0;
+
+    check_reset();
+    if (!g_search.have_m)
+        return 0;
+    screen_matches(&screen);
+    n = screen.n;
+    vec_free(&screen);
+    if (g_search.nworkers == 0)
+        n += g_search.scan.n - first_valid(&g_search.scan);
+    return n + g_search.live.n - first_valid(&g_search.live);
+}
+
+/* Entries of vec still in history that sort before m; *found is set if m
+ * itself is one of them. */
+static size_t rank_in(const MatchVec *vec, const SearchMatch *m, int *found) {
+    size_t start = first_valid(vec);
+    size_t lo = start, hi = vec->n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (match_before(&vec->v[mid], m))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < vec->n && vec->v[lo].line == m->line && vec->v[lo].b0 == m->b0)
+        *found = 1;
+    return lo - start;
+}
+
+/* What cur_index depends on while the current match is in history. */
+static void stamp(unsigned long long out[4]) {
+    out[0] = terminal_history_total();
+    out[1] = out[0] - (unsigned long long)terminal_history_lines();
+    out[2] = g_search.scan.n;
+    out[3] = g_search.live.n;
+}
+
+size_t search_current_index(void) {
+    unsigned long long now[4];
+    int found = 0;
+    size_t idx;
+
+    check_reset();
+    if (!g_search.have_cur)
+        return 0;
+    stamp(now);
+    if (g_search.cur.line < now[0] && memcmp(now, g_search.cur_stamp, sizeof(now)) == 0)
+        return g_search.cur_index;
+
+    /* Output moved the history: count what sorts before cur again, by
+     * binary search in the history results and on the screen rows. */
+    idx = rank_in(&g_search.scan, &g_search.cur, &found) + rank_in(&g_search.live, &g_search.cur, &found);
+    if (g_search.cur.line >= now[0]) {
+        MatchVec screen = { 0 };
+
+        screen_matches(&screen);
+        for (size_t i = 0; i < screen.n && !found; i++) {
+            if (match_before(&screen.v[i], &g_search.cur))
+                idx++;
+            else if (screen.v[i].line == g_search.cur.line && screen.v[i].b0 == g_search.cur.b0)
+                found = 1;
+            else
+                break;
+        }
+        vec_free(&screen);
+    }
+    g_search.cur_index = found ? idx + 1 : 0;
+    memcpy(g_search.cur_stamp, now, sizeof(now));
+    return g_search.cur_index;
+}
+
+int search_next(int dir) {
+    MatchVec all;
+    long pick = -1;
+
+    check_reset();
+    if (!g_search.have_m)
+        return -1;
+    if (g_search.nworkers > 0 && !g_search.have_cur && dir < 0) {
+        /* Results still coming: jump once the scan is in. */
+        g_search.want_jump = 1;
+        return 0;
+    }
+    all_matches(&all);
+    if (!g_search.have_cur) {
+        if (all.n > 0)
+            pick = (dir < 0) ? (long)all.n - 1 : 0;
+    } else if (dir < 0) {
+        for (size_t i = all.n; i-- > 0; ) {
+            if (match_before(&all.v[i], &g_search.cur)) {
+                pick = (long)i;
+                break;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < all.n; i++) {
+            if (match_before(&g_search.cur, &all.v[i])) {
+                pick = (long)i;
+                break;
+            }
+        }
+    }
+    if (pick >= 0) {
+        g_search.cur = all.v[pick];
+        g_search.have_cur = 1;
+        g_search.cur_index = (size_t)pick + 1;
+        stamp(g_search.cur_stamp);
+        terminal_scroll_to_line(g_search.cur.line);
+        terminal_mark_all_rows_dirty();
+    }
+    vec_free(&all);
+    return pick >= 0 ? 0 : -1;
+}
+
+int search_visible_marks(RenderMark *out, int max) {
+    unsigned long long top;
+    char *buf = line_buffer();
+    MatchVec row_matches = { 0 };
+    int n = 0;
+
+    check_reset();
+    if (!g_search.have_m || !buf)
+        return 0;
+    top = terminal_history_total() - (unsigned long long)terminal_get_scrollback_offset();
+    for (int r = 0; r < term_rows && n < max; r++) {
+        const TerminalCell *row = terminal_get_visible_row(r);
+
+        if (!row)
+            continue;
+        row_matches.n = 0;
+        match_line(&g_search.m, buf, search_line_text(row, term_cols, buf), top + (unsigned long long)r,
+                   &row_matches);
+        for (size_t i = 0; i < row_matches.n && n < max; i++) {
+            const SearchMatch *sm = &row_matches.v[i];
+
+            out[n].row = r;
+            search_match_cols(row, term_cols, sm->b0, sm->b1, &out[n].c0, &out[n].c1);
+            out[n].current = g_search.have_cur && sm->line == g_search.cur.line && sm->b0 == g_search.cur.b0;
+            n++;
+        }
+    }
+    vec_free(&row_matches);
+    return n;
+}
@@ -0,0 +1,82 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+
+#include "render.h"
+#include "terminal_state.h"
+
+/*
+ * Scrollback search.
+ *
+ * Lines are addressed by the ids of terminal_line() (terminal_state.h), so
+ * a match keeps pointing at the same text while output scrolls.  Starting
+ * a query copies the text of the in-memory history into a snapshot, which
+ * worker threads scan in chunks while the main loop keeps drawing.  Lines
+ * in the spill file are not copied: the workers decode them from a view of
+ * the file, so starting a query costs at most the ring.  Results are
+ * announced on a pipe like the font resolver's.  Lines pushed into history
+ * afterwards are matched as they arrive (the history hook), and the
+ * screen, which still changes, is matched when asked.
+ *
+ * Plain queries use a SIMD first/last byte prefilter; with regex set the
+ * query is a POSIX extended regular expression.  Both are smart-case: a
+ * query without upper case letters ignores (ASCII) case.  Matches are byte
+ * ranges in the line text, which is the cells' text with blank cells as
+ * spaces and trailing blanks dropped.
+ */
+
+#define SEARCH_QUERY_MAX 256
+
+typedef struct {
+    unsigned long long line;    /* terminal_line() id */
+    int b0, b1;                 /* byte range [b0, b1) in the line text */
+} SearchMatch;
+
+/* Worker threads per scan; 0 picks one per CPU, up to 4. */
+void search_set_threads(int n);
+/* Search for query (regex: POSIX ERE), replacing any previous query.  An
+ * empty query clears the results.  Returns 0, or -1 if the regex does not
+ * compile (the search stays active with no results). */
+int search_set_query(const char *query, int regex);
+/* Leave search: stop the scan, forget the results and the history hook. */
+void search_stop(void);
+int search_active(void);
+/* The query as last set, and whether it failed to compile. */
+const char *search_query(int *regex);
+int search_failed(void);
+/* Some results were dropped (out of memory, or a scan thread could not
+ * compile the query): the count is a lower bound. */
+int search_incomplete(void);
+/* Scan still running in the background. */
+int search_busy(void);
+/* The running scan still has lines from the spill file to read. */
+int search_busy_spilled(void);
+/* Block until the running scan has finished (tests, benchmarks). */
+void search_wait(void);
+/* Read end of the wake-up pipe, or -1 when no scan has been started. */
+int search_fd(void);
+/* Collect a finished scan.  Never blocks.  Returns 1 if the results changed
+ * (the caller redraws). */
+int search_poll(void);
+
+/* Matches in history and on screen, and the position of the current one
+ * (1-based, 0 if none is selected). */
+size_t search_count(void);
+size_t search_current_index(void);
+/* Select the next older (dir < 0) or newer (dir > 0) match and scroll it
+ * into view.  Without a current match, dir < 0 starts from the newest.
+ * Returns 0, or -1 if there is no match in that direction. */
+int search_next(int dir);
+
+/* Matches on the visible rows, as cell spans for the renderer.  Returns the
+ * number written to out. */
+int search_visible_marks(RenderMark *out, int max);
+
+/* Line text of cols cells (see above) into out, NUL-terminated.  out needs
+ * room for cols * MAX_UTF8_CHAR_SIZE + 1 bytes.  Returns its length. */
+size_t search_line_text(const TerminalCell *row, int cols, char *out);
+/* Cells covering the byte range [b0, b1) of the line text of row. */
+void search_match_cols(const TerminalCell *row, int cols, int b0, int b1, int *c0, int *c1);
+
+#endif /* SEARCH_H */
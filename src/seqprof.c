@@ -0,0 +1,170 @@
+// seqprof.c - per-sequence counts and time (make SEQPROF=1)
+#define _POSIX_C_SOURCE 199309L
+#include "seqprof.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SEQPROF_KEYS 256
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TICK_UNIT "cyc"
+#else
+#define TICK_UNIT "ns"
+#endif
+
+static SeqProfEntry table[SEQPROF_CLASS_COUNT][SEQPROF_KEYS];
+
+static const char *const class_prefix[SEQPROF_CLASS_COUNT] = {
+    "CSI", "CSI ?", "CSI >", "CSI <", "CSI =", "OSC",
+};
+
+SeqProfClass seqprof_csi_class(char first) {
+    switch (first) {
+    case '?': return SEQPROF_CSI_Q;
+    case '>': return SEQPROF_CSI_GT;
+    case '<': return SEQPROF_CSI_LT;
+    case '=': return SEQPROF_CSI_EQ;
+    default:  return SEQPROF_CSI;
+    }
+}
+
+unsigned seqprof_osc_key(const char *payload, size_t len) {
+    unsigned v = 0;
+    size_t i = 0;
+
+    while (i < len && payload[i] >= '0' && payload[i] <= '9' && v < SEQPROF_KEYS)
+        v = v * 10 + (unsigned)(payload[i++] - '0');
+    return (i == 0 || v >= SEQPROF_KEYS - 1) ? SEQPROF_KEYS - 1 : v;
+}
+
+uint64_t seqprof_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void seqprof_note(SeqProfClass cls, unsigned key, size_t bytes, uint64_t ticks) {
+    SeqProfEntry *e;
+
+    if ((unsigned)cls >= SEQPROF_CLASS_COUNT)
+        return;
+    e = &table[cls][key < SEQPROF_KEYS ? key : SEQPROF_KEYS - 1];
+    /* Terminal instances on other threads note into the same table. */
+    __atomic_fetch_add(&e->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&e->bytes, (unsigned long long)bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&e->ticks, (unsigned long long)ticks, __ATOMIC_RELAXED);
+}
+
+const SeqProfEntry *seqprof_entry(SeqProfClass cls, unsigned key) {
+    if ((unsigned)cls >= SEQPROF_CLASS_COUNT || key >= SEQPROF_KEYS)
+        return NULL;
+    return &table[cls][key];
+}
+
+void seqprof_reset(void) {
+    memset(table, 0, sizeof(table));
+}
+
+/* Mnemonic for the common handlers; private modes share final bytes. */
+static const char *csi_name(SeqProfClass cls, unsigned final) {
+    if (cls == SEQPROF_CSI_Q) {
+        switch (final) {
+        case 'h': return "DECSET";
+        case 'l': return "DECRST";
+        case 'p': return "DECRQM";
+        default:  return "";
+        }
+    }
+    if (cls != SEQPROF_CSI)
+        return final == 'c' ? "DA" : "";
+    switch (final) {
+    case 'm': return "SGR";
+    case 'H': return "CUP";
+    case 'f': return "HVP";
+    case 'A': return "CUU";
+    case 'B': return "CUD";
+    case 'C': return "CUF";
+    case 'D': return "CUB";
+    case 'G': return "CHA";
+    case 'd': return "VPA";
+    case 'J': return "ED";
+    case 'K': return "EL";
+    case 'X': return "ECH";
+    case 'P': return "DCH";
+    case '@': return "ICH";
+    case 'L': return "IL";
+    case 'M': return "DL";
+    case 'S': return "SU";
+    case 'T': return "SD";
+    case 'r': return "DECSTBM";
+    case 'b': return "REP";
+    case 'h': return "SM";
+    case 'l': return "RM";
+    case 'n': return "DSR";
+    case 'c': return "DA";
+    case 'q': return "DECSCUSR";
+    case 't': return "XTWINOPS";
+    case 'g': return "TBC";
+    default:  return "";
+    }
+}
+
+typedef struct {
+    SeqProfClass cls;
+    unsigned key;
+    const SeqProfEntry *e;
+} SeqProfRow;
+
+static int cmp_rows(const void *a, const void *b) {
+    const SeqProfRow *x = a, *y = b;
+    return (x->e->ticks < y->e->ticks) - (x->e->ticks > y->e->ticks);
+}
+
+void seqprof_report(FILE *out) {
+    static SeqProfRow rows[SEQPROF_CLASS_COUNT * SEQPROF_KEYS];
+    size_t n = 0;
+    unsigned long long total = 0;
+
+    for (int c = 0; c < SEQPROF_CLASS_COUNT; c++) {
+        for (unsigned k = 0; k < SEQPROF_KEYS; k++) {
+            if (table[c][k].count == 0)
+                continue;
+            rows[n].cls = (SeqProfClass)c;
+            rows[n].key = k;
+            rows[n].e = &table[c][k];
+            total += table[c][k].ticks;
+            n++;
+        }
+    }
+    if (n == 0)
+        return;
+    qsort(rows, n, sizeof(rows[0]), cmp_rows);
+
+    fprintf(out, "seqprof: %-12s %-15s %10s %12s %14s %10s %6s\n",
+            "sequence", "handler", "count", "bytes", TICK_UNIT, TICK_UNIT "/call", "share");
+    for (size_t i = 0; i < n; i++) {
+        const SeqProfEntry *e = rows[i].e;
+        char seq[16];
+
+        if (rows[i].cls == SEQPROF_OSC) {
+            if (rows[i].key == SEQPROF_KEYS - 1)
+                snprintf(seq, sizeof(seq), "OSC other");
+            else
+                snprintf(seq, sizeof(seq), "OSC %u", rows[i].key);
+        } else {
+            snprintf(seq, sizeof(seq), "%s %c", class_prefix[rows[i].cls],
+                     rows[i].key >= 0x20 && rows[i].key < 0x7F ? (char)rows[i].key : '?');
+        }
+        fprintf(out, "seqprof: %-12s %-15s %10llu %12llu %14llu %10.0f %5.1f%%\n",
+                seq, rows[i].cls == SEQPROF_OSC ? "" : csi_name(rows[i].cls, rows[i].key),
+                e->count, e->bytes, e->ticks, (double)e->ticks / (double)e->count,
+                total ? 100.0 * (double)e->ticks / (double)total : 0.0);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef SEQPROF_H
+#define SEQPROF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Control sequence profiler (make SEQPROF=1).
+ *
+ * Counts invocations, bytes and ticks spent in each CSI handler, keyed by
+ * private-marker class and final byte, and in each OSC command.  Ticks are
+ * TSC cycles on x86 and nanoseconds elsewhere.  seqprof_report() prints
+ * the table sorted by total time; cupidterminal does so at exit, so running
+ * a capture through --replay profiles a real workload.
+ *
+ * The SEQPROF_* macros compile to nothing unless CUPID_SEQPROF is defined.
+ */
+
+typedef enum {
+    SEQPROF_CSI = 0,        /* CSI Ps ... F */
+    SEQPROF_CSI_Q,          /* CSI ? Ps ... F (DEC private) */
+    SEQPROF_CSI_GT,         /* CSI > ... */
+    SEQPROF_CSI_LT,         /* CSI < ... */
+    SEQPROF_CSI_EQ,         /* CSI = ... */
+    SEQPROF_OSC,            /* key is the OSC command number (255 = other) */
+    SEQPROF_CLASS_COUNT
+} SeqProfClass;
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long bytes;
+    unsigned long long ticks;
+} SeqProfEntry;
+
+/* Class of a CSI sequence from the first byte after ESC [. */
+SeqProfClass seqprof_csi_class(char first);
+/* OSC key: the leading command number of the payload, 255 if none/large. */
+unsigned seqprof_osc_key(const char *payload, size_t len);
+uint64_t seqprof_ticks(void);
+/* Lock-free: any thread may note; a report or reset should not race with
+ * writers. */
+void seqprof_note(SeqProfClass cls, unsigned key, size_t bytes, uint64_t ticks);
+const SeqProfEntry *seqprof_entry(SeqProfClass cls, unsigned key);
+void seqprof_reset(void);
+/* Sorted by total ticks, largest first.  Prints nothing if nothing ran. */
+void seqprof_report(FILE *out);
+
+#ifdef CUPID_SEQPROF
+#define SEQPROF_BEGIN(t)                     uint64_t t = seqprof_ticks()
+#define SEQPROF_END(t, cls, key, bytes)      seqprof_note((cls), (key), (size_t)(bytes), seqprof_ticks() - (t))
+#else
+#define SEQPROF_BEGIN(t)                     do { } while (0)
+#define SEQPROF_END(t, cls, key, bytes)      do { } while (0)
+#endif
+
+#endif /* SEQPROF_H */
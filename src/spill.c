@@ -0,0 +1,523 @@
+// spill.c - scrollback spill file: old history lines on disk, read back through mmap
+#define _POSIX_C_SOURCE 200809L
+#include "spill.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SPILL_MAGIC "CUPIDSB1"
+#define SPILL_HEADER 8
+#define SPILL_WBUF (64 * 1024)
+/* The mapping is sized ahead of the file and replaced when it grows past. */
+#define SPILL_MAP_MIN ((size_t)1 << 24)
+#define SPILL_WIDTH_CONT 3
+
+typedef struct {
+    size_t index;
+    int cols;               /* 0: empty slot */
+    TerminalCell *cells;
+} SpillCacheRow;
+
+struct Spill {
+    int fd;
+    int keep;
+    int failed;
+    int viewed;             /* a SpillView may still map the file */
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    uint64_t flushed;       /* bytes written to the file */
+    uint8_t wbuf[SPILL_WBUF];
+    size_t wlen;
+    const uint8_t *map;
+    size_t map_len;
+    uint64_t *index;        /* offset of lines 0, SPILL_INDEX_EVERY, ... */
+    size_t index_cap;
+    size_t lines;
+    /* Last line located: the next one is found from here, so reading the
+     * history in order does not rescan from the index. */
+    size_t seq_line;
+    uint64_t seq_off;
+    int seq_valid;
+    SpillCacheRow cache[SPILL_CACHE_ROWS];
+    uint8_t *enc;
+    size_t enc_cap;
+};
+
+struct SpillView {
+    const uint8_t *map;     /* the file as it was when the view was opened */
+    size_t map_len;
+    uint64_t *index;
+    size_t lines;
+};
+
+static int write_all(int fd, const uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int flush_wbuf(Spill *s) {
+    if (s->wlen == 0)
+        return 0;
+    if (write_all(s->fd, s->wbuf, s->wlen) != 0) {
+        s->failed = 1;
+        return -1;
+    }
+    s->flushed += s->wlen;
+    s->wlen = 0;
+    return 0;
+}
+
+/* A new file in s->dir, unlinked at once unless kept, with the header
+ * queued in the write buffer. */
+static int create_file(Spill *s) {
+    int n = snprintf(s->path, sizeof(s->path), "%s/cupidterminal-scrollback-XXXXXX", s->dir);
+
+    if (n < 0 || (size_t)n >= sizeof(s->path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    s->fd = mkstemp(s->path);
+    if (s->fd < 0)
+        return -1;
+    fcntl(s->fd, F_SETFD, FD_CLOEXEC);
+    if (!s->keep) {
+        unlink(s->path);
+        s->path[0] = '\0';
+    }
+    s->flushed = 0;
+    memcpy(s->wbuf, SPILL_MAGIC, SPILL_HEADER);
+    s->wlen = SPILL_HEADER;
+    return 0;
+}
+
+Spill *spill_open(const char *dir, int keep) {
+    Spill *s;
+
+    if (!dir || !dir[0])
+        dir = getenv("XDG_RUNTIME_DIR");
+    if (!dir || !dir[0])
+        dir = "/tmp";
+    if (strlen(dir) >= sizeof(s->dir)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    s = calloc(1, sizeof(*s));
+    if (!s)
+        return NULL;
+    memcpy(s->dir, dir, strlen(dir) + 1);
+    s->keep = keep;
+    if (create_file(s) != 0) {
+        int err = errno;
+
+        free(s);
+        errno = err;
+        return NULL;
+    }
+    return s;
+}
+
+void spill_close(Spill *s) {
+    if (!s)
+        return;
+    if (s->keep)
+        flush_wbuf(s);
+    if (s->map)
+        munmap((void *)s->map, s->map_len);
+    close(s->fd);
+    for (int i = 0; i < SPILL_CACHE_ROWS; i++)
+        free(s->cache[i].cells);
+    free(s->index);
+    free(s->enc);
+    free(s);
+}
+
+void spill_clear(Spill *s) {
+    if (!s)
+        return;
+    if (s->map) {
+        munmap((void *)s->map, s->map_len);
+        s->map = NULL;
+        s->map_len = 0;
+    }
+    if (s->viewed) {
+        /* Truncating would fault a view's mapping: start a new file and
+         * leave the old one to the views. */
+        int old = s->fd;
+
+        if (s->path[0])
+            unlink(s->path);
+        s->failed = create_file(s) != 0;
+        if (s->failed) {
+            s->fd = old;
+            s->path[0] = '\0';
+        } else
+            close(old);
+        s->viewed = 0;
+    } else if (ftruncate(s->fd, 0) == 0) {
+        s->failed = 0;
+        if (lseek(s->fd, 0, SEEK_SET) != 0)
+            s->failed = 1;
+    } else {
+        s->failed = 1;
+    }
+    s->flushed = 0;
+    memcpy(s->wbuf, SPILL_MAGIC, SPILL_HEADER);
+    s->wlen = SPILL_HEADER;
+    s->lines = 0;
+    s->seq_valid = 0;
+    for (int i = 0; i < SPILL_CACHE_ROWS; i++)
+        s->cache[i].cols = 0;
+}
+
+static int cell_is_blank(const TerminalCell *c) {
+    return c->c[0] == '\0' && c->fg == COLOR_DEFAULT_FG && c->bg == COLOR_DEFAULT_BG &&
+           c->attrs == 0 && c->width == 1 && !c->is_continuation;
+}
+
+static void put16(uint8_t **p, uint16_t v) { memcpy(*p, &v, 2); *p += 2; }
+static void put32(uint8_t **p, uint32_t v) { memcpy(*p, &v, 4); *p += 4; }
+
+/* Encode a record (length prefix included) into s->enc; returns its size. */
+static size_t encode(Spill *s, const TerminalCell *row, int cols) {
+    /* Worst case: one run per cell. */
+    size_t need = 4 + 2 + (size_t)cols * (12 + 1 + MAX_UTF8_CHAR_SIZE);
+    uint8_t *p;
+    int n = cols;
+
+    if (need > s->enc_cap) {
+        uint8_t *grown = realloc(s->enc, need);
+
+        if (!grown)
+            return 0;
+        s->enc = grown;
+        s->enc_cap = need;
+    }
+    while (n > 0 && cell_is_blank(&row[n - 1]))
+        n--;
+    if (n > UINT16_MAX)
+        n = UINT16_MAX;
+
+    p = s->enc + 4;
+    put16(&p, (uint16_t)n);
+    for (int i = 0; i < n; ) {
+        const TerminalCell *first = &row[i];
+        int j = i;
+
+        while (j < n && j - i < UINT16_MAX && row[j].fg == first->fg && row[j].bg == first->bg &&
+               row[j].attrs == first->attrs)
+            j++;
+        put32(&p, first->fg);
+        put32(&p, first->bg);
+        put16(&p, first->attrs);
+        put16(&p, (uint16_t)(j - i));
+        for (; i < j; i++) {
+            size_t len = strnlen(row[i].c, MAX_UTF8_CHAR_SIZE);
+            unsigned width = row[i].is_continuation ? SPILL_WIDTH_CONT : (row[i].width & 3u);
+
+            *p++ = (uint8_t)(len | (width << 6));
+            memcpy(p, row[i].c, len);
+            p += len;
+        }
+    }
+    {
+        uint32_t plen = (uint32_t)(p - s->enc - 4);
+
+        memcpy(s->enc, &plen, 4);
+    }
+    return (size_t)(p - s->enc);
+}
+
+int spill_append(Spill *s, const TerminalCell *row, int cols) {
+    size_t n;
+    uint64_t off;
+
+    if (!s || s->failed || cols <= 0)
+        return -1;
+    n = encode(s, row, cols);
+    if (n == 0)
+        return -1;
+    if (s->lines % SPILL_INDEX_EVERY == 0 && s->lines / SPILL_INDEX_EVERY >= s->index_cap) {
+        size_t cap = s->index_cap ? s->index_cap * 2 : 256;
+        uint64_t *grown = realloc(s->index, cap * sizeof(*grown));
+
+        if (!grown)
+            return -1;
+        s->index = grown;
+        s->index_cap = cap;
+    }
+    if (s->wlen + n > SPILL_WBUF && flush_wbuf(s) != 0)
+        return -1;
+    off = s->flushed + s->wlen;
+    if (n > SPILL_WBUF) {
+        /* Wider than the buffer (very long lines): straight to the file. */
+        if (write_all(s->fd, s->enc, n) != 0) {
+            s->failed = 1;
+            return -1;
+        }
+        s->flushed += n;
+    } else {
+        memcpy(s->wbuf + s->wlen, s->enc, n);
+        s->wlen += n;
+    }
+    if (s->lines % SPILL_INDEX_EVERY == 0)
+        s->index[s->lines / SPILL_INDEX_EVERY] = off;
+    s->lines++;
+    return 0;
+}
+
+size_t spill_lines(const Spill *s) {
+    return s ? s->lines : 0;
+}
+
+/* len bytes at file offset off, from the mapping or the write buffer. */
+static const uint8_t *bytes_at(Spill *s, uint64_t off, size_t len) {
+    if (off >= s->flushed) {
+        uint64_t rel = off - s->flushed;
+
+        return (rel + len <= s->wlen) ? s->wbuf + rel : NULL;
+    }
+    if (off + len > s->flushed)
+        return NULL;
+    if (off + len > s->map_len) {
+        size_t want = s->map_len ? s->map_len : SPILL_MAP_MIN;
+        void *map;
+
+        while (want < s->flushed)
+            want *= 2;
+        if (s->map)
+            munmap((void *)s->map, s->map_len);
+        s->map = NULL;
+        s->map_len = 0;
+        /* Pages past the end of the file are never touched. */
+        map = mmap(NULL, want, PROT_READ, MAP_SHARED, s->fd, 0);
+        if (map == MAP_FAILED)
+            return NULL;
+        s->map = map;
+        s->map_len = want;
+    }
+    return s->map + off;
+}
+
+static int record_len(Spill *s, uint64_t off, uint32_t *len) {
+    const uint8_t *p = bytes_at(s, off, 4);
+
+    if (!p)
+        return -1;
+    memcpy(len, p, 4);
+    return 0;
+}
+
+static int locate(Spill *s, size_t line, uint64_t *off) {
+    size_t at;
+    uint64_t o;
+
+    if (s->seq_valid && s->seq_line <= line && line - s->seq_line <= line % SPILL_INDEX_EVERY) {
+        at = s->seq_line;
+        o = s->seq_off;
+    } else {
+        at = line - line % SPILL_INDEX_EVERY;
+        o = s->index[line / SPILL_INDEX_EVERY];
+    }
+    for (; at < line; at++) {
+        uint32_t len;
+
+        if (record_len(s, o, &len) != 0)
+            return -1;
+        o += 4 + (uint64_t)len;
+    }
+    s->seq_line = line;
+    s->seq_off = o;
+    s->seq_valid = 1;
+    *off = o;
+    return 0;
+}
+
+static void blank_cells(TerminalCell *cells, int cols) {
+    memset(cells, 0, (size_t)cols * sizeof(*cells));
+    for (int c = 0; c < cols; c++) {
+        cells[c].fg = COLOR_DEFAULT_FG;
+        cells[c].bg = COLOR_DEFAULT_BG;
+        cells[c].width = 1;
+    }
+}
+
+static void decode(const uint8_t *p, size_t len, TerminalCell *cells, int cols) {
+    const uint8_t *end = p + len;
+    uint16_t n;
+    int c = 0;
+
+    blank_cells(cells, cols);
+    if (len < 2)
+        return;
+    memcpy(&n, p, 2);
+    p += 2;
+    while (c < n && end - p >= 12) {
+        uint32_t fg, bg;
+        uint16_t attrs, run;
+
+        memcpy(&fg, p, 4);
+        memcpy(&bg, p + 4, 4);
+        memcpy(&attrs, p + 8, 2);
+        memcpy(&run, p + 10, 2);
+        p += 12;
+        for (int i = 0; i < run && p < end; i++, c++) {
+            size_t tlen = *p & 0x3F;
+            unsigned width = *p >> 6;
+
+            p++;
+            if (tlen > MAX_UTF8_CHAR_SIZE || (size_t)(end - p) < tlen)
+                return;
+            if (c < cols) {
+                memcpy(cells[c].c, p, tlen);
+                cells[c].fg = fg;
+                cells[c].bg = bg;
+                cells[c].attrs = attrs;
+                cells[c].width = (uint8_t)(width == SPILL_WIDTH_CONT ? 0 : width);
+                cells[c].is_continuation = (width == SPILL_WIDTH_CONT);
+            }
+            p += tlen;
+        }
+    }
+}
+
+const TerminalCell *spill_row(Spill *s, size_t index, int cols) {
+    SpillCacheRow *slot;
+    uint64_t off;
+    uint32_t len;
+    const uint8_t *p;
+
+    if (!s || index >= s->lines || cols <= 0)
+        return NULL;
+    slot = &s->cache[index % SPILL_CACHE_ROWS];
+    if (slot->cols == cols && slot->index == index)
+        return slot->cells;
+    if (slot->cols != cols) {
+        TerminalCell *cells = realloc(slot->cells, (size_t)cols * sizeof(TerminalCell));
+
+        if (!cells)
+            return NULL;
+        slot->cells = cells;
+    }
+    slot->cols = cols;
+    slot->index = index;
+    if (locate(s, index, &off) != 0 || record_len(s, off, &len) != 0 ||
+        !(p = bytes_at(s, off + 4, len))) {
+        blank_cells(slot->cells, cols);
+        return slot->cells;
+    }
+    decode(p, len, slot->cells, cols);
+    return slot->cells;
+}
+
+SpillView *spill_view_open(Spill *s) {
+    SpillView *v;
+    size_t entries;
+
+    if (!s || s->failed || flush_wbuf(s) != 0)
+        return NULL;
+    v = calloc(1, sizeof(*v));
+    if (!v)
+        return NULL;
+    entries = (s->lines + SPILL_INDEX_EVERY - 1) / SPILL_INDEX_EVERY;
+    if (entries > 0) {
+        void *map = mmap(NULL, (size_t)s->flushed, PROT_READ, MAP_SHARED, s->fd, 0);
+
+        v->index = malloc(entries * sizeof(*v->index));
+        if (map == MAP_FAILED || !v->index) {
+            if (map != MAP_FAILED)
+                munmap(map, (size_t)s->flushed);
+            free(v->index);
+            free(v);
+            return NULL;
+        }
+        memcpy(v->index, s->index, entries * sizeof(*v->index));
+        v->map = map;
+        v->map_len = (size_t)s->flushed;
+        v->lines = s->lines;
+        s->viewed = 1;
+    }
+    return v;
+}
+
+void spill_view_close(SpillView *v) {
+    if (!v)
+        return;
+    if (v->map)
+        munmap((void *)v->map, v->map_len);
+    free(v->index);
+    free(v);
+}
+
+size_t spill_view_lines(const SpillView *v) {
+    return v ? v->lines : 0;
+}
+
+int spill_view_row(const SpillView *v, SpillCursor *cur, size_t index, TerminalCell *cells, int cols) {
+    size_t at;
+    uint64_t off;
+    uint32_t len;
+
+    if (cols <= 0)
+        return -1;
+    blank_cells(cells, cols);
+    if (!v || index >= v->lines)
+        return -1;
+    /* As locate(), but the view is shared: the position lives in cur. */
+    if (cur->valid && cur->line <= index && index - cur->line <= index % SPILL_INDEX_EVERY) {
+        at = cur->line;
+        off = cur->off;
+    } else {
+        at = index - index % SPILL_INDEX_EVERY;
+        off = v->index[index / SPILL_INDEX_EVERY];
+    }
+    for (;; at++) {
+        if (off + 4 > v->map_len)
+            return -1;
+        memcpy(&len, v->map + off, 4);
+        if (at == index)
+            break;
+        off += 4 + (uint64_t)len;
+    }
+    if (off + 4 + len > v->map_len)
+        return -1;
+    decode(v->map + off + 4, len, cells, cols);
+    cur->line = index + 1;
+    cur->off = off + 4 + len;
+    cur->valid = 1;
+    return 0;
+}
+
+const char *spill_path(const Spill *s) {
+    return (s && s->path[0]) ? s->path : NULL;
+}
+
+uint64_t spill_disk_bytes(const Spill *s) {
+    return s ? s->flushed + s->wlen : 0;
+}
+
+size_t spill_ram_bytes(const Spill *s) {
+    size_t n;
+
+    if (!s)
+        return 0;
+    n = sizeof(*s) + s->index_cap * sizeof(uint64_t) + s->enc_cap;
+    for (int i = 0; i < SPILL_CACHE_ROWS; i++)
+        n += (size_t)s->cache[i].cols * sizeof(TerminalCell);
+    return n;
+}
@@ -0,0 +1,75 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "terminal_state.h"
+
+/*
+ * Scrollback spill file: history lines older than the in-memory ring,
+ * stored on disk and paged back on demand.
+ *
+ * Lines are appended through a write buffer and read back through a
+ * read-only mmap of the file, so RAM holds only the write buffer, one
+ * offset per SPILL_INDEX_EVERY lines and a small cache of decoded rows.
+ *
+ * File layout (host byte order): the 8-byte magic "CUPIDSB1", then one
+ * record per line: u32 payload length, u16 cell count (trailing blank
+ * cells dropped), then runs of cells sharing a style: u32 fg, u32 bg,
+ * u16 attrs, u16 cells, and per cell a byte holding the text length in
+ * bits 0-5 and the width in bits 6-7 (3 = continuation of a wide cell)
+ * followed by the text.  A line of plain text costs about two bytes per
+ * character instead of sizeof(TerminalCell).
+ */
+
+#define SPILL_INDEX_EVERY 64
+#define SPILL_CACHE_ROWS 64
+
+typedef struct Spill Spill;
+
+/* Create the spill file in dir ($XDG_RUNTIME_DIR, else /tmp, when NULL or
+ * empty).  Unless keep is set it is unlinked at once, so it goes away with
+ * the process even after a crash.  Returns NULL with errno set on failure. */
+Spill *spill_open(const char *dir, int keep);
+/* Flush (when kept), unmap and close. */
+void spill_close(Spill *s);
+/* Forget every line (history reset).  Once a view has been opened the file
+ * is replaced by a new one instead of truncated, so views stay readable. */
+void spill_clear(Spill *s);
+/* Append a row of cols cells as the newest line.  Returns 0, or -1 once
+ * the file cannot be written (the line is dropped). */
+int spill_append(Spill *s, const TerminalCell *row, int cols);
+size_t spill_lines(const Spill *s);
+/* Line index (0 = oldest) decoded to cols cells, padded with blanks or cut.
+ * The row lives in cache slot index % SPILL_CACHE_ROWS and stays valid until
+ * a lookup lands in the same slot with another line or another width: any
+ * run of at most SPILL_CACHE_ROWS consecutive lines can be held at once.
+ * NULL if index is out of range. */
+const TerminalCell *spill_row(Spill *s, size_t index, int cols);
+/*
+ * A read-only view of the lines written so far, for reading them on other
+ * threads: it maps the file and copies the line index when opened (which
+ * writes out the write buffer), so the owner may go on appending, clearing
+ * or closing meanwhile.  Lines appended later are not in the view.  Any
+ * number of threads may read one view, each with its own cursor.
+ */
+typedef struct SpillView SpillView;
+typedef struct {
+    size_t line;            /* next line, so reading in order is cheap */
+    uint64_t off;
+    int valid;              /* zero-initialise before the first read */
+} SpillCursor;
+
+SpillView *spill_view_open(Spill *s);
+void spill_view_close(SpillView *v);
+size_t spill_view_lines(const SpillView *v);
+/* Line index decoded into cols cells like spill_row().  Returns 0, or -1
+ * (cells left blank) if index is out of range or the record is damaged. */
+int spill_view_row(const SpillView *v, SpillCursor *cur, size_t index, TerminalCell *cells, int cols);
+/* Path of a kept file, NULL when it was unlinked. */
+const char *spill_path(const Spill *s);
+uint64_t spill_disk_bytes(const Spill *s);
+size_t spill_ram_bytes(const Spill *s);
+
+#endif /* SPILL_H */
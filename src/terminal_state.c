@@ -1,5 +1,6 @@
 #define _XOPEN_SOURCE 700
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,6 +13,9 @@
 
 #include "terminal_state.h"
 #include "config.h"
+#include "seqprof.h"
+#include "spill.h"
+#include "trace.h"
 
 /* DEC Special Graphics (VT100 ACS): maps 0x41-0x7E to box-drawing etc. (st/rxvt table) */
 static const char *const vt100_acs[62] = {
@@ -25,21 +29,15 @@ static const char *const vt100_acs[62] = {
     "\xe2\x94\x82", "\xe2\x89\xa4", "\xe2\x89\xa5", "\xcf\x80", "\xe2\x89\xa0", "\xc2\xa3", "\xc2\xb7", /* x-~ */
 };
 
-int term_rows = 24;
-int term_cols = 80;
+/* Defaults for the st-style settings the host normally defines (main.c);
+   they let libcupidterm link on its own. */
+__attribute__((weak)) unsigned int tabspaces = 8;
+__attribute__((weak)) char *vtiden = "\033[?6c";
+__attribute__((weak)) int allowwindowops = 0;
 
-TerminalState term_state;
-TerminalCell **terminal_buffer = NULL;
-uint8_t *dirty_rows = NULL;
-
-static TerminalCell **primary_buffer = NULL;
-static TerminalCell **alternate_buffer = NULL;
-static unsigned char *tab_stops = NULL;
+Terminal term_default = { .rows = 24, .cols = 80 };
 
 #define HISTORY_SIZE 2000
-static TerminalCell **history_buffer = NULL;
-static int history_head = 0;   /* next insertion slot */
-static int history_count = 0;  /* number of valid rows in history */
 
 static void init_default_tab_stops(unsigned char *tabs, int cols) {
     unsigned int ts = (tabspaces > 0) ? tabspaces : 8;
@@ -54,80 +52,109 @@ static void init_default_tab_stops(unsigned char *tabs, int cols) {
     }
 }
 
-static int has_tab_stop_at(int col) {
+static int has_tab_stop_at(Terminal *t, int col) {
     unsigned int ts = (tabspaces > 0) ? tabspaces : 8;
 
-    if (col <= 0 || col >= term_cols) {
+    if (col <= 0 || col >= t->cols) {
         return 0;
     }
-    if (tab_stops) {
-        return tab_stops[col] ? 1 : 0;
+    if (t->tabs) {
+        return t->tabs[col] ? 1 : 0;
     }
     return ((unsigned int)col % ts) == 0;
 }
 
-static int next_tab_stop_col(int col) {
-    for (int c = col + 1; c < term_cols; c++) {
-        if (has_tab_stop_at(c)) {
+static int next_tab_stop_col(Terminal *t, int col) {
+    for (int c = col + 1; c < t->cols; c++) {
+        if (has_tab_stop_at(t, c)) {
             return c;
         }
     }
-    return term_cols - 1;
+    return t->cols - 1;
 }
 
-static int prev_tab_stop_col(int col) {
+static int prev_tab_stop_col(Terminal *t, int col) {
     for (int c = col - 1; c > 0; c--) {
-        if (has_tab_stop_at(c)) {
+        if (has_tab_stop_at(t, c)) {
             return c;
         }
     }
     return 0;
 }
 
-static void init_default_cell(TerminalCell *cell) {
-    if (!cell) {
+/*
+ * Span primitives.  Erasing copies from a row of blank cells built once per
+ * (fg, bg, attrs) and kept in the Terminal (blank_row) rather than
+ * initialising each cell; shifting is a single memmove.  Both end up in
+ * libc's vectorised memcpy/memmove.
+ */
+
+/*
+ * Fill n cells with copies of the pattern_len cells at pattern (one cell, or
+ * a wide glyph and its continuation), doubling the copied run each pass.
+ */
+static void cells_fill(TerminalCell *dst, const TerminalCell *pattern, int pattern_len, int n) {
+    int done;
+
+    if (n <= 0) {
         return;
     }
-
-    memset(cell->c, 0, sizeof(cell->c));
-    cell->fg = COLOR_DEFAULT_FG;
-    cell->bg = COLOR_DEFAULT_BG;
-    cell->attrs = 0;
-    cell->width = 1;
-    cell->is_continuation = 0;
+    done = (pattern_len < n) ? pattern_len : n;
+    memcpy(dst, pattern, (size_t)done * sizeof(TerminalCell));
+    for (; done < n; done *= 2) {
+        int chunk = (done < n - done) ? done : n - done;
+        memcpy(dst + done, dst, (size_t)chunk * sizeof(TerminalCell));
+    }
 }
 
-static TerminalCell **alloc_buffer(int rows, int cols) {
-    TerminalCell **buffer = calloc((size_t)rows, sizeof(TerminalCell *));
-    if (!buffer) {
-        return NULL;
-    }
+static void cells_blank(Terminal *t, TerminalCell *dst, int n, uint32_t fg, uint32_t bg, uint16_t attrs) {
+    TerminalCell blank;
 
-    for (int r = 0; r < rows; r++) {
-        buffer[r] = calloc((size_t)cols, sizeof(TerminalCell));
-        if (!buffer[r]) {
-            for (int rr = 0; rr < r; rr++) {
-                free(buffer[rr]);
+    if (n <= 0) {
+        return;
+    }
+    if (t->blank_len > 0 && (fg != t->blank_fg || bg != t->blank_bg || attrs != t->blank_attrs)) {
+        t->blank_len = 0;
+    }
+    if (n > t->blank_len) {
+        memset(&blank, 0, sizeof(blank));
+        blank.fg = fg;
+        blank.bg = bg;
+        blank.attrs = attrs;
+        blank.width = 1;
+        if (n > t->blank_cap) {
+            TerminalCell *grown = realloc(t->blank_row, (size_t)n * sizeof(TerminalCell));
+            if (!grown) {
+                cells_fill(dst, &blank, 1, n);
+                return;
             }
-            free(buffer);
-            return NULL;
-        }
-        for (int c = 0; c < cols; c++) {
-            init_default_cell(&buffer[r][c]);
+            t->blank_row = grown;
+            t->blank_cap = n;
         }
+        cells_fill(t->blank_row, &blank, 1, n);
+        t->blank_len = n;
+        t->blank_fg = fg;
+        t->blank_bg = bg;
+        t->blank_attrs = attrs;
     }
+    memcpy(dst, t->blank_row, (size_t)n * sizeof(TerminalCell));
+}
 
-    return buffer;
+/* Move n cells within a row; the ranges may overlap. */
+static void cells_move(TerminalCell *row, int dst_col, int src_col, int n) {
+    if (n > 0) {
+        memmove(&row[dst_col], &row[src_col], (size_t)n * sizeof(TerminalCell));
+    }
 }
 
-static TerminalCell **alloc_history_buffer(int cols) {
-    TerminalCell **buffer = calloc((size_t)HISTORY_SIZE, sizeof(TerminalCell *));
+static TerminalCell **alloc_buffer(Terminal *t, int rows, int cols) {
+    TerminalCell **buffer = calloc((size_t)rows, sizeof(TerminalCell *));
     if (!buffer) {
         return NULL;
     }
 
-    for (int r = 0; r < HISTORY_SIZE; r++) {
-        buffer[r] = calloc((size_t)cols, sizeof(TerminalCell));
+    for (int r = 0; r < rows; r++) {
+        buffer[r] = malloc((size_t)cols * sizeof(TerminalCell));
         if (!buffer[r]) {
             for (int rr = 0; rr < r; rr++) {
                 free(buffer[rr]);
@@ -135,14 +162,13 @@ static TerminalCell **alloc_history_buffer(int cols) {
             free(buffer);
             return NULL;
         }
-        for (int c = 0; c < cols; c++) {
-            init_default_cell(&buffer[r][c]);
-        }
+        cells_blank(t, buffer[r], cols, COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
     }
 
     return buffer;
 }
 
+
 static void free_buffer(TerminalCell **buffer, int rows) {
     if (!buffer) {
         return;
@@ -164,70 +190,129 @@ static void free_history_buffer(TerminalCell **buffer) {
     free(buffer);
 }
 
-static TerminalCell **resize_history_buffer(TerminalCell **old_buffer, int old_cols, int new_cols) {
-    TerminalCell **new_buffer = alloc_history_buffer(new_cols);
-
-    if (!new_buffer) {
-        return NULL;
+/*
+ * The ring starts empty and each slot is allocated the first time a line
+ * scrolls into it, so a terminal that never scrolls pays nothing for
+ * scrollback.  Returns 0 if history is unavailable.
+ */
+static int ensure_history_slot(Terminal *t, int slot) {
+    if (!t->history) {
+        t->history = calloc((size_t)HISTORY_SIZE, sizeof(TerminalCell *));
+        if (!t->history) {
+            return 0;
+        }
     }
-
-    if (old_buffer && old_cols > 0) {
-        int copy_cols = (old_cols < new_cols) ? old_cols : new_cols;
-        if (copy_cols > 0) {
-            for (int r = 0; r < HISTORY_SIZE; r++) {
-                memcpy(new_buffer[r], old_buffer[r], (size_t)copy_cols * sizeof(TerminalCell));
-            }
+    if (!t->history[slot]) {
+        t->history[slot] = malloc((size_t)t->cols * sizeof(TerminalCell));
+        if (!t->history[slot]) {
+            return 0;
         }
-        free_history_buffer(old_buffer);
+        t->history_rows++;
     }
+    return 1;
+}
 
-    return new_buffer;
+/* Resize the allocated rows in place; returns 0 (history dropped) on failure. */
+static int resize_history_buffer(Terminal *t, int old_cols, int new_cols) {
+    for (int r = 0; r < HISTORY_SIZE; r++) {
+        TerminalCell *row;
+
+        if (!t->history[r]) {
+            continue;
+        }
+        row = realloc(t->history[r], (size_t)new_cols * sizeof(TerminalCell));
+        if (!row) {
+            return 0;
+        }
+        if (new_cols > old_cols) {
+            cells_blank(t, row + old_cols, new_cols - old_cols, COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+        }
+        t->history[r] = row;
+    }
+    return 1;
 }
 
-static void __attribute__((unused)) clear_history_row(int slot) {
-    if (!history_buffer || slot < 0 || slot >= HISTORY_SIZE || term_cols <= 0) {
+static void __attribute__((unused)) clear_history_row(Terminal *t, int slot) {
+    if (!t->history || slot < 0 || slot >= HISTORY_SIZE || t->cols <= 0 || !t->history[slot]) {
         return;
     }
-    for (int c = 0; c < term_cols; c++) {
-        init_default_cell(&history_buffer[slot][c]);
+    cells_blank(t, t->history[slot], t->cols, COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+}
+
+static void mark_all_rows_dirty(Terminal *t);
+
+/* In the ring plus in the spill file. */
+static int history_lines(Terminal *t) {
+    size_t spilled = spill_lines(t->spill);
+
+    if (spilled > (size_t)(INT_MAX - HISTORY_SIZE)) {
+        spilled = (size_t)(INT_MAX - HISTORY_SIZE);
     }
+    return t->history_count + (int)spilled;
 }
 
-static void push_history_line(const TerminalCell *row, TerminalState *state) {
-    if (!history_buffer || !row || !state || state->alt_screen_active || term_cols <= 0) {
+static void push_history_line(Terminal *t, const TerminalCell *row) {
+    TerminalState *state = &t->state;
+
+    if (!row || state->alt_screen_active || t->cols <= 0) {
+        return;
+    }
+    if (!ensure_history_slot(t, t->history_head)) {
         return;
     }
 
-    memcpy(history_buffer[history_head], row, (size_t)term_cols * sizeof(TerminalCell));
-    history_head = (history_head + 1) % HISTORY_SIZE;
-    if (history_count < HISTORY_SIZE) {
-        history_count++;
+    /* The ring is full: its oldest line moves to the spill file. */
+    if (t->spill && t->history_count == HISTORY_SIZE &&
+        spill_append(t->spill, t->history[t->history_head], t->cols) != 0) {
+        /* Disk full or gone: fall back to the ring alone. */
+        spill_close(t->spill);
+        t->spill = NULL;
+        if (state->scrollback_offset > t->history_count) {
+            state->scrollback_offset = t->history_count;
+        }
+        mark_all_rows_dirty(t);
     }
+    memcpy(t->history[t->history_head], row, (size_t)t->cols * sizeof(TerminalCell));
+    t->history_head = (t->history_head + 1) % HISTORY_SIZE;
+    if (t->history_count < HISTORY_SIZE) {
+        t->history_count++;
+    }
+    if (t->history_hook) {
+        t->history_hook(t->history_total, row, t->cols, t->history_hook_ctx);
+    }
+    t->history_total++;
 
     if (state->scrollback_offset > 0) {
-        if (state->scrollback_offset < history_count) {
+        if (state->scrollback_offset < history_lines(t)) {
             state->scrollback_offset++;
         } else {
-            state->scrollback_offset = history_count;
+            state->scrollback_offset = history_lines(t);
         }
     }
 }
 
-static const TerminalCell *history_row_by_relative_index(int rel) {
+/* Lines of history, spilled ones first: rel 0 is the oldest. */
+static const TerminalCell *history_row_by_relative_index(Terminal *t, int rel) {
+    int spilled = (int)spill_lines(t->spill);
     int oldest;
     int slot;
 
-    if (!history_buffer || rel < 0 || rel >= history_count) {
+    if (rel >= 0 && rel < spilled) {
+        return spill_row(t->spill, (size_t)rel, t->cols);
+    }
+    rel -= spilled;
+    if (!t->history || rel < 0 || rel >= t->history_count) {
         return NULL;
     }
 
-    oldest = (history_head - history_count + HISTORY_SIZE) % HISTORY_SIZE;
+    oldest = (t->history_head - t->history_count + HISTORY_SIZE) % HISTORY_SIZE;
     slot = (oldest + rel) % HISTORY_SIZE;
-    return history_buffer[slot];
+    return t->history[slot];
 }
 
-static TerminalCell **resize_buffer(TerminalCell **old_buffer, int old_rows, int old_cols, int new_rows, int new_cols) {
-    TerminalCell **new_buffer = alloc_buffer(new_rows, new_cols);
+static TerminalCell **resize_buffer(Terminal *t, TerminalCell **old_buffer, int old_rows, int old_cols,
+    int new_rows, int new_cols) {
+    TerminalCell **new_buffer = alloc_buffer(t, new_rows, new_cols);
 
     if (!new_buffer) {
         return NULL;
@@ -245,15 +330,13 @@ static TerminalCell **resize_buffer(TerminalCell **old_buffer, int old_rows, int
     return new_buffer;
 }
 
-static void clear_buffer_defaults(TerminalCell **buffer) {
+static void clear_buffer_defaults(Terminal *t, TerminalCell **buffer) {
     if (!buffer) {
         return;
     }
 
-    for (int r = 0; r < term_rows; r++) {
-        for (int c = 0; c < term_cols; c++) {
-            init_default_cell(&buffer[r][c]);
-        }
+    for (int r = 0; r < t->rows; r++) {
+        cells_blank(t, buffer[r], t->cols, COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
     }
 }
 
@@ -270,189 +353,303 @@ static void clear_cell(TerminalCell *cell, const TerminalState *state) {
     cell->is_continuation = 0;
 }
 
-static int scroll_region_top(const TerminalState *state) {
+static int scroll_region_top(Terminal *t) {
+    const TerminalState *state = &t->state;
     int top;
 
-    if (!state) {
-        return 0;
-    }
-
     top = state->scroll_top;
-    if (top < 0 || top >= term_rows) {
+    if (top < 0 || top >= t->rows) {
         top = 0;
     }
     return top;
 }
 
-static int scroll_region_bottom(const TerminalState *state) {
+static int scroll_region_bottom(Terminal *t) {
+    const TerminalState *state = &t->state;
     int bottom;
     int top;
 
-    if (!state) {
-        return term_rows - 1;
-    }
-
-    top = scroll_region_top(state);
+    top = scroll_region_top(t);
     bottom = state->scroll_bottom;
-    if (bottom < 0 || bottom >= term_rows) {
-        bottom = term_rows - 1;
+    if (bottom < 0 || bottom >= t->rows) {
+        bottom = t->rows - 1;
     }
     if (bottom < top) {
-        bottom = term_rows - 1;
+        bottom = t->rows - 1;
     }
     return bottom;
 }
 
-static int cursor_min_row(const TerminalState *state) {
-    if (state && state->origin_mode) {
-        return scroll_region_top(state);
+static int cursor_min_row(Terminal *t) {
+    const TerminalState *state = &t->state;
+
+    if (state->origin_mode) {
+        return scroll_region_top(t);
     }
     return 0;
 }
 
-static int cursor_max_row(const TerminalState *state) {
-    if (state && state->origin_mode) {
-        return scroll_region_bottom(state);
+static int cursor_max_row(Terminal *t) {
+    const TerminalState *state = &t->state;
+
+    if (state->origin_mode) {
+        return scroll_region_bottom(t);
     }
-    return term_rows - 1;
+    return t->rows - 1;
 }
 
-static void cursor_home(TerminalState *state) {
-    if (!state) {
-        return;
-    }
+static void cursor_home(Terminal *t) {
+    TerminalState *state = &t->state;
+
     state->wrap_next = 0;
-    state->row = cursor_min_row(state);
+    state->row = cursor_min_row(t);
     state->col = 0;
 }
 
-static void cancel_pending_wrap(TerminalState *state);
+static void cancel_pending_wrap(Terminal *t);
 
-static void mark_row_dirty(int row) {
-    if (dirty_rows && row >= 0 && row < term_rows)
-        dirty_rows[row] = 1;
+/* Damage only columns [c0, c1] of a row.  A row already dirty in full stays
+ * full; a partially dirty row widens its span. */
+static void mark_cells_dirty(Terminal *t, int row, int c0, int c1) {
+    if (!t->dirty || row < 0 || row >= t->rows)
+        return;
+    if (!t->dirty_lo || !t->dirty_hi) {
+        t->dirty[row] = DIRTY_ROW_FULL;
+        return;
+    }
+    if (c0 < 0) c0 = 0;
+    if (c1 >= t->cols) c1 = t->cols - 1;
+    if (c0 > c1)
+        return;
+    if (t->dirty[row] == DIRTY_ROW_CLEAN) {
+        t->dirty[row] = DIRTY_ROW_SPAN;
+        t->dirty_lo[row] = c0;
+        t->dirty_hi[row] = c1;
+    } else if (t->dirty[row] == DIRTY_ROW_SPAN) {
+        if (c0 < t->dirty_lo[row]) t->dirty_lo[row] = c0;
+        if (c1 > t->dirty_hi[row]) t->dirty_hi[row] = c1;
+    }
+}
+
+void terminal_mark_cells_dirty(int row, int c0, int c1) {
+    mark_cells_dirty(&term_default, row, c0, c1);
 }
 
-static void mark_rows_dirty(int top, int bottom) {
-    if (!dirty_rows) return;
+static void mark_rows_dirty(Terminal *t, int top, int bottom) {
+    if (!t->dirty) return;
     if (top < 0) top = 0;
-    if (bottom >= term_rows) bottom = term_rows - 1;
+    if (bottom >= t->rows) bottom = t->rows - 1;
     for (int r = top; r <= bottom; r++)
-        dirty_rows[r] = 1;
+        t->dirty[r] = DIRTY_ROW_FULL;
 }
 
-static void mark_all_rows_dirty(void) {
-    if (dirty_rows)
-        memset(dirty_rows, 1, (size_t)term_rows);
+static void mark_all_rows_dirty(Terminal *t) {
+    if (t->dirty)
+        memset(t->dirty, DIRTY_ROW_FULL, (size_t)t->rows);
 }
 
 void terminal_mark_all_rows_dirty(void) {
-    mark_all_rows_dirty();
+    mark_all_rows_dirty(&term_default);
 }
 
+/* Scrollback view and history of term_default, for the renderer, input and
+   search. */
 void terminal_scrollback_up(int n) {
-    if (n <= 0 || term_state.alt_screen_active) {
+    Terminal *t = &term_default;
+
+    if (n <= 0 || t->state.alt_screen_active) {
         return;
     }
-    if (history_count <= 0) {
+    if (history_lines(t) <= 0) {
         return;
     }
-    term_state.scrollback_offset += n;
-    if (term_state.scrollback_offset > history_count) {
-        term_state.scrollback_offset = history_count;
+    if (n > history_lines(t) - t->state.scrollback_offset) {
+        n = history_lines(t) - t->state.scrollback_offset;
     }
-    mark_all_rows_dirty();
+    t->state.scrollback_offset += n;
+    mark_all_rows_dirty(t);
 }
 
 void terminal_scrollback_down(int n) {
-    if (n <= 0 || term_state.alt_screen_active) {
+    Terminal *t = &term_default;
+
+    if (n <= 0 || t->state.alt_screen_active) {
         return;
     }
-    term_state.scrollback_offset -= n;
-    if (term_state.scrollback_offset < 0) {
-        term_state.scrollback_offset = 0;
+    t->state.scrollback_offset -= n;
+    if (t->state.scrollback_offset < 0) {
+        t->state.scrollback_offset = 0;
     }
-    mark_all_rows_dirty();
+    mark_all_rows_dirty(t);
 }
 
 void terminal_scrollback_reset(void) {
-    if (term_state.scrollback_offset != 0) {
-        term_state.scrollback_offset = 0;
-        mark_all_rows_dirty();
+    Terminal *t = &term_default;
+
+    if (t->state.scrollback_offset != 0) {
+        t->state.scrollback_offset = 0;
+        mark_all_rows_dirty(t);
     }
 }
 
 int terminal_get_scrollback_offset(void) {
-    return term_state.scrollback_offset;
+    return term_default.state.scrollback_offset;
+}
+
+int terminal_history_lines(void) {
+    return history_lines(&term_default);
+}
+
+unsigned long long terminal_history_total(void) {
+    return term_default.history_total;
+}
+
+const TerminalCell *terminal_line(unsigned long long id) {
+    Terminal *t = &term_default;
+    unsigned long long oldest = t->history_total - (unsigned long long)history_lines(t);
+
+    if (id >= t->history_total) {
+        unsigned long long r = id - t->history_total;
+        return (t->screen && r < (unsigned long long)t->rows) ? t->screen[r] : NULL;
+    }
+    if (id < oldest) {
+        return NULL;
+    }
+    return history_row_by_relative_index(t, (int)(id - oldest));
+}
+
+void terminal_scroll_to_line(unsigned long long id) {
+    Terminal *t = &term_default;
+    unsigned long long target;
+    int offset;
+
+    if (t->state.alt_screen_active || id >= t->history_total) {
+        terminal_scrollback_reset();
+        return;
+    }
+    /* Centre the line when the history allows it. */
+    target = t->history_total - id + (unsigned long long)(t->rows / 2);
+    offset = (target > (unsigned long long)history_lines(t)) ? history_lines(t) : (int)target;
+    if (offset != t->state.scrollback_offset) {
+        t->state.scrollback_offset = offset;
+        mark_all_rows_dirty(t);
+    }
+}
+
+void terminal_set_history_hook(terminal_history_fn fn, void *ctx) {
+    term_default.history_hook = fn;
+    term_default.history_hook_ctx = ctx;
+}
+
+size_t terminal_history_bytes(void) {
+    Terminal *t = &term_default;
+    size_t bytes = spill_ram_bytes(t->spill);
+
+    if (!t->history || t->cols <= 0) {
+        return bytes;
+    }
+    return bytes + (size_t)HISTORY_SIZE * sizeof(TerminalCell *) +
+           (size_t)t->history_rows * (size_t)t->cols * sizeof(TerminalCell);
+}
+
+int terminal_spill_open(const char *dir, int keep) {
+    Terminal *t = &term_default;
+    Spill *spill = spill_open(dir, keep);
+
+    if (!spill) {
+        return -1;
+    }
+    spill_close(t->spill);
+    t->spill = spill;
+    return 0;
+}
+
+void terminal_spill_close(void) {
+    spill_close(term_default.spill);
+    term_default.spill = NULL;
+}
+
+const char *terminal_spill_path(void) {
+    return spill_path(term_default.spill);
+}
+
+unsigned long long terminal_spill_bytes(void) {
+    return spill_disk_bytes(term_default.spill);
+}
+
+struct SpillView *terminal_spill_view(void) {
+    return spill_view_open(term_default.spill);
 }
 
 const TerminalCell *terminal_get_visible_row(int visual_row) {
-    int offset = term_state.scrollback_offset;
+    Terminal *t = &term_default;
+    int offset = t->state.scrollback_offset;
     int live_row;
     int rel;
 
-    if (visual_row < 0 || visual_row >= term_rows || term_cols <= 0 || !terminal_buffer) {
+    if (visual_row < 0 || visual_row >= t->rows || t->cols <= 0 || !t->screen) {
         return NULL;
     }
 
-    if (term_state.alt_screen_active || offset <= 0) {
-        return terminal_buffer[visual_row];
+    if (t->state.alt_screen_active || offset <= 0) {
+        return t->screen[visual_row];
     }
 
-    if (offset > history_count) {
-        offset = history_count;
+    if (offset > history_lines(t)) {
+        offset = history_lines(t);
     }
 
     if (visual_row < offset) {
-        rel = history_count - offset + visual_row;
-        return history_row_by_relative_index(rel);
+        rel = history_lines(t) - offset + visual_row;
+        return history_row_by_relative_index(t, rel);
     }
 
     live_row = visual_row - offset;
-    if (live_row < 0 || live_row >= term_rows) {
+    if (live_row < 0 || live_row >= t->rows) {
         return NULL;
     }
-    return terminal_buffer[live_row];
+    return t->screen[live_row];
 }
 
-static void clear_row_range(int row, int start_col, int end_col, const TerminalState *state) {
-    if (!state || !terminal_buffer || row < 0 || row >= term_rows) {
+static void clear_row_range(Terminal *t, int row, int start_col, int end_col) {
+    const TerminalState *state = &t->state;
+
+    if (!t->screen || row < 0 || row >= t->rows) {
         return;
     }
 
     if (start_col < 0) {
         start_col = 0;
     }
-    if (end_col >= term_cols) {
-        end_col = term_cols - 1;
+    if (end_col >= t->cols) {
+        end_col = t->cols - 1;
     }
     if (start_col > end_col) {
         return;
     }
 
-    if (start_col > 0 && terminal_buffer[row][start_col].is_continuation) {
+    if (start_col > 0 && t->screen[row][start_col].is_continuation) {
         start_col--;
     }
-    if (end_col + 1 < term_cols && terminal_buffer[row][end_col].width == 2) {
+    if (end_col + 1 < t->cols && t->screen[row][end_col].width == 2) {
         end_col++;
     }
 
-    for (int c = start_col; c <= end_col; c++) {
-        clear_cell(&terminal_buffer[row][c], state);
-    }
-    mark_row_dirty(row);
+    cells_blank(t, &t->screen[row][start_col], end_col - start_col + 1,
+                state->current_fg, state->current_bg, state->current_attrs);
+    mark_cells_dirty(t, row, start_col, end_col);
 }
 
-static void clear_screen_range(int start_row, int start_col, int end_row, int end_col, const TerminalState *state) {
-    if (!state || !terminal_buffer || term_rows <= 0 || term_cols <= 0) {
+static void clear_screen_range(Terminal *t, int start_row, int start_col, int end_row, int end_col) {
+    if (!t->screen || t->rows <= 0 || t->cols <= 0) {
         return;
     }
 
     if (start_row < 0) {
         start_row = 0;
     }
-    if (end_row >= term_rows) {
-        end_row = term_rows - 1;
+    if (end_row >= t->rows) {
+        end_row = t->rows - 1;
     }
     if (start_row > end_row) {
         return;
@@ -460,8 +657,8 @@ static void clear_screen_range(int start_row, int start_col, int end_row, int en
 
     for (int r = start_row; r <= end_row; r++) {
         int row_start = (r == start_row) ? start_col : 0;
-        int row_end = (r == end_row) ? end_col : term_cols - 1;
-        clear_row_range(r, row_start, row_end, state);
+        int row_end = (r == end_row) ? end_col : t->cols - 1;
+        clear_row_range(t, r, row_start, row_end);
     }
 }
 
@@ -493,90 +690,100 @@ static void selscroll_adjust(TerminalState *state, int orig, int n) {
     }
 }
 
-static void scroll_up_one_line(TerminalState *state) {
-    int top;
-    int bottom;
+static void reverse_rows(Terminal *t, int from, int to) {
+    while (from < to) {
+        TerminalCell *tmp = t->screen[from];
+        t->screen[from++] = t->screen[to];
+        t->screen[to--] = tmp;
+    }
+}
 
-    if (!state || !terminal_buffer || term_rows <= 0 || term_cols <= 0) {
+/*
+ * Rotate the row pointers of [top, bottom] up by n (content moves to lower
+ * row numbers; the n rows that fall off the top reappear at the bottom).
+ * O(rows) pointer swaps however many columns the lines have; callers clear
+ * the exposed rows.
+ */
+static void rotate_rows_up(Terminal *t, int top, int bottom, int n) {
+    int height = bottom - top + 1;
+
+    if (height <= 1 || n <= 0 || n >= height) {
         return;
     }
+    reverse_rows(t, top, top + n - 1);
+    reverse_rows(t, top + n, bottom);
+    reverse_rows(t, top, bottom);
+}
 
-    top = scroll_region_top(state);
-    bottom = scroll_region_bottom(state);
-    if (top > bottom) {
+static void scroll_up_n_lines(Terminal *t, int n) {
+    TerminalState *state = &t->state;
+    int top;
+    int bottom;
+
+    if (!t->screen || t->rows <= 0 || t->cols <= 0) {
         return;
     }
 
-    if (!state->alt_screen_active && top == 0 && bottom == term_rows - 1) {
-        push_history_line(terminal_buffer[top], state);
+    top = scroll_region_top(t);
+    bottom = scroll_region_bottom(t);
+    if (n <= 0 || top > bottom) return;
+    if (n > bottom - top + 1) n = bottom - top + 1;
+
+    if (!state->alt_screen_active && top == 0 && bottom == t->rows - 1) {
+        for (int r = top; r < top + n; r++) {
+            push_history_line(t, t->screen[r]);
+        }
     }
 
-    selscroll_adjust(state, top, 1);
+    selscroll_adjust(state, top, n);
 
-    for (int r = top + 1; r <= bottom; r++) {
-        memcpy(terminal_buffer[r - 1], terminal_buffer[r], (size_t)term_cols * sizeof(TerminalCell));
+    rotate_rows_up(t, top, bottom, n);
+    for (int r = bottom - n + 1; r <= bottom; r++) {
+        clear_row_range(t, r, 0, t->cols - 1);
     }
-    clear_row_range(bottom, 0, term_cols - 1, state);
-    mark_rows_dirty(top, bottom);
+    mark_rows_dirty(t, top, bottom);
 }
 
-static void scroll_down_one_line(TerminalState *state) {
+static void scroll_down_n_lines(Terminal *t, int n) {
+    TerminalState *state = &t->state;
     int top;
     int bottom;
 
-    if (!state || !terminal_buffer || term_rows <= 0 || term_cols <= 0) {
+    if (!t->screen || t->rows <= 0 || t->cols <= 0) {
         return;
     }
 
-    top = scroll_region_top(state);
-    bottom = scroll_region_bottom(state);
-    if (top > bottom) {
-        return;
-    }
+    top = scroll_region_top(t);
+    bottom = scroll_region_bottom(t);
+    if (n <= 0 || top > bottom) return;
+    if (n > bottom - top + 1) n = bottom - top + 1;
 
-    /* Shift selection down (n = -1 → move rows up by -1 = down by 1) */
-    selscroll_adjust(state, top, -1);
+    /* Shift selection down (negative n moves rows to higher numbers) */
+    selscroll_adjust(state, top, -n);
 
-    for (int r = bottom - 1; r >= top; r--) {
-        memcpy(terminal_buffer[r + 1], terminal_buffer[r], (size_t)term_cols * sizeof(TerminalCell));
+    rotate_rows_up(t, top, bottom, bottom - top + 1 - n);
+    for (int r = top; r < top + n; r++) {
+        clear_row_range(t, r, 0, t->cols - 1);
     }
-    clear_row_range(top, 0, term_cols - 1, state);
-    mark_rows_dirty(top, bottom);
+    mark_rows_dirty(t, top, bottom);
 }
 
-static void scroll_up_n_lines(TerminalState *state, int n) {
-    int top = scroll_region_top(state);
-    int bottom = scroll_region_bottom(state);
-
-    if (n <= 0 || top > bottom) return;
-    if (n > bottom - top + 1) n = bottom - top + 1;
-    while (n-- > 0) {
-        scroll_up_one_line(state);
-    }
+static void scroll_up_one_line(Terminal *t) {
+    scroll_up_n_lines(t, 1);
 }
 
-static void scroll_down_n_lines(TerminalState *state, int n) {
-    int top = scroll_region_top(state);
-    int bottom = scroll_region_bottom(state);
-
-    if (n <= 0 || top > bottom) return;
-    if (n > bottom - top + 1) n = bottom - top + 1;
-    while (n-- > 0) {
-        scroll_down_one_line(state);
-    }
+static void scroll_down_one_line(Terminal *t) {
+    scroll_down_n_lines(t, 1);
 }
 
-static void reverse_index(TerminalState *state) {
+static void reverse_index(Terminal *t) {
+    TerminalState *state = &t->state;
     int top;
     int bottom;
 
-    if (!state) {
-        return;
-    }
-
-    cancel_pending_wrap(state);
-    top = scroll_region_top(state);
-    bottom = scroll_region_bottom(state);
+    cancel_pending_wrap(t);
+    top = scroll_region_top(t);
+    bottom = scroll_region_bottom(t);
 
     if (state->row < top || state->row > bottom) {
         if (state->row > 0) {
@@ -586,63 +793,57 @@ static void reverse_index(TerminalState *state) {
     }
 
     if (state->row == top) {
-        scroll_down_one_line(state);
+        scroll_down_one_line(t);
     } else {
         state->row--;
     }
 }
 
-static void clamp_cursor(TerminalState *state) {
+static void clamp_cursor(Terminal *t) {
+    TerminalState *state = &t->state;
     int min_row;
     int max_row;
 
-    if (!state) {
-        return;
-    }
-
-    min_row = cursor_min_row(state);
-    max_row = cursor_max_row(state);
+    min_row = cursor_min_row(t);
+    max_row = cursor_max_row(t);
 
     if (max_row < min_row) {
         min_row = 0;
-        max_row = term_rows - 1;
+        max_row = t->rows - 1;
     }
 
     if (state->row < min_row) state->row = min_row;
     if (state->row > max_row) state->row = max_row;
     if (state->col < 0) state->col = 0;
-    if (state->col >= term_cols) {
-        if (!(state->wrap_next && state->autowrap_mode && state->col == term_cols)) {
-            state->col = term_cols - 1;
+    if (state->col >= t->cols) {
+        if (!(state->wrap_next && state->autowrap_mode && state->col == t->cols)) {
+            state->col = t->cols - 1;
         }
     }
     if (state->col < 0) state->col = 0;
     if (!state->autowrap_mode) {
         state->wrap_next = 0;
-        if (state->col >= term_cols) {
-            state->col = term_cols - 1;
+        if (state->col >= t->cols) {
+            state->col = t->cols - 1;
         }
     }
 }
 
-static void cancel_pending_wrap(TerminalState *state) {
-    if (!state) {
-        return;
-    }
+static void cancel_pending_wrap(Terminal *t) {
+    TerminalState *state = &t->state;
+
     state->wrap_next = 0;
     state->wrap_overwrite_next = 0;
-    /* Virtual cursor past last column (col == term_cols) folds to last cell. */
-    if (state->col >= term_cols) {
-        state->col = term_cols - 1;
+    /* Virtual cursor past last column (col == t->cols) folds to last cell. */
+    if (state->col >= t->cols) {
+        state->col = t->cols - 1;
     }
 }
 
-static void save_cursor_state(TerminalState *state) {
-    if (!state) {
-        return;
-    }
+static void save_cursor_state(Terminal *t) {
+    TerminalState *state = &t->state;
 
-    cancel_pending_wrap(state);
+    cancel_pending_wrap(t);
     state->saved_row = state->row;
     state->saved_col = state->col;
     state->saved_fg = state->current_fg;
@@ -650,22 +851,22 @@ static void save_cursor_state(TerminalState *state) {
     state->saved_attrs = state->current_attrs;
 }
 
-static void restore_cursor_state(TerminalState *state) {
-    if (!state) {
-        return;
-    }
+static void restore_cursor_state(Terminal *t) {
+    TerminalState *state = &t->state;
 
-    cancel_pending_wrap(state);
+    cancel_pending_wrap(t);
     state->row = state->saved_row;
     state->col = state->saved_col;
     state->current_fg = state->saved_fg;
     state->current_bg = state->saved_bg;
     state->current_attrs = state->saved_attrs;
-    clamp_cursor(state);
+    clamp_cursor(t);
 }
 
-static void activate_alternate_screen(TerminalState *state) {
-    if (!state || state->alt_screen_active) {
+static void activate_alternate_screen(Terminal *t) {
+    TerminalState *state = &t->state;
+
+    if (state->alt_screen_active) {
         return;
     }
 
@@ -677,17 +878,17 @@ static void activate_alternate_screen(TerminalState *state) {
     state->alt_saved_scroll_top = state->scroll_top;
     state->alt_saved_scroll_bottom = state->scroll_bottom;
 
-    if (!alternate_buffer) {
-        alternate_buffer = alloc_buffer(term_rows, term_cols);
-        if (!alternate_buffer) {
+    if (!t->alternate) {
+        t->alternate = alloc_buffer(t, t->rows, t->cols);
+        if (!t->alternate) {
             return;
         }
     }
 
-    clear_buffer_defaults(alternate_buffer);
-    terminal_buffer = alternate_buffer;
+    clear_buffer_defaults(t, t->alternate);
+    t->screen = t->alternate;
     state->alt_screen_active = 1;
-    mark_all_rows_dirty();
+    mark_all_rows_dirty(t);
     state->row = 0;
     state->col = 0;
     state->scroll_top = -1;
@@ -697,12 +898,14 @@ static void activate_alternate_screen(TerminalState *state) {
     state->scrollback_offset = 0;
 }
 
-static void deactivate_alternate_screen(TerminalState *state) {
-    if (!state || !state->alt_screen_active) {
+static void deactivate_alternate_screen(Terminal *t) {
+    TerminalState *state = &t->state;
+
+    if (!state->alt_screen_active) {
         return;
     }
 
-    terminal_buffer = primary_buffer;
+    t->screen = t->primary;
     state->alt_screen_active = 0;
     state->row = state->alt_saved_row;
     state->col = state->alt_saved_col;
@@ -714,8 +917,8 @@ static void deactivate_alternate_screen(TerminalState *state) {
     state->utf8_len = 0;
     state->wrap_next = 0;
     state->scrollback_offset = 0;
-    clamp_cursor(state);
-    mark_all_rows_dirty();
+    clamp_cursor(t);
+    mark_all_rows_dirty(t);
 }
 
 static int parse_csi_params(const char *body, int body_len, int *params, int max_params) {
@@ -802,22 +1005,80 @@ static int csi_has_param(const int *params, int count, int value) {
     return 0;
 }
 
-static void put_codepoint(utf8proc_int32_t codepoint, TerminalState *state) {
-    utf8proc_uint8_t encoded[4];
-    utf8proc_ssize_t encoded_len;
-
-    if (!state) {
-        return;
+/* DECRPM mode values: 0 unknown, 1 set, 2 reset. */
+static int decrqm_private_value(const TerminalState *state, int mode) {
+    int set;
+
+    switch (mode) {
+    case 1: set = state->application_cursor_keys; break;
+    case 5: set = state->screen_reverse; break;
+    case 6: set = state->origin_mode; break;
+    case 7: set = state->autowrap_mode; break;
+    case 25: set = state->cursor_visible; break;
+    case 47:
+    case 1047:
+    case 1049: set = state->alt_screen_active; break;
+    case 1000: set = state->mouse_reporting_basic; break;
+    case 1002: set = state->mouse_reporting_button; break;
+    case 1003: set = state->mouse_reporting_any; break;
+    case 1004: set = state->focus_mode; break;
+    case 1006: set = state->mouse_sgr_mode; break;
+    case 2004: set = state->bracketed_paste_mode; break;
+    case 2026: set = state->sync_update; break;
+    default: return 0;
+    }
+    return set ? 1 : 2;
+}
+
+static int decrqm_ansi_value(const TerminalState *state, int mode) {
+    switch (mode) {
+    case 4: return state->insert_mode ? 1 : 2;
+    case 12: return state->echo_mode ? 2 : 1;  /* SRM set = echo off */
+    case 20: return state->lnm_mode ? 1 : 2;
+    default: return 0;
+    }
+}
+
+/* Cell width of a printable codepoint: 0 (combining), 1 or 2. */
+static int glyph_width(utf8proc_int32_t codepoint) {
+    int width = wcwidth((wchar_t)codepoint);
+
+    if (width < 0 && codepoint >= 0x80) {
+        int fallback_width = utf8proc_charwidth(codepoint);
+        if (fallback_width >= 0) {
+            width = fallback_width;
+        }
     }
-
-    encoded_len = utf8proc_encode_char(codepoint, encoded);
-    if (encoded_len <= 0) {
-        return;
+    if (width < 0 || width > 2) {
+        width = 1;
     }
+    return width;
+}
+
+/*
+ * Number of REP copies that can still change the screen.  Past the point
+ * where the glyph has filled the rest of the display and one more screen
+ * of lines, every further line is an identical scroll: the state repeats
+ * with a period of one line, so only the count modulo that period matters.
+ * Without autowrap the cursor sticks at the margin after one line.
+ */
+static int rep_visible_count(Terminal *t, int n, int width) {
+    const TerminalState *state = &t->state;
+    int per_line;
+    int limit;
 
-    for (utf8proc_ssize_t i = 0; i < encoded_len; i++) {
-        put_char((char)encoded[i], state);
+    if (t->cols <= 0 || t->rows <= 0) {
+        return 0;
+    }
+    if (!state->autowrap_mode) {
+        return n < t->cols + 1 ? n : t->cols + 1;
     }
+    per_line = (width == 2 && t->cols > 1) ? t->cols / 2 : t->cols;
+    limit = per_line * (t->rows + 2);
+    if (n <= limit) {
+        return n;
+    }
+    return limit + (n - limit) % per_line;
 }
 
 static int utf8_expected_len(uint8_t lead) {
@@ -836,18 +1097,18 @@ static int utf8_expected_len(uint8_t lead) {
     return 0;
 }
 
-static int append_combining_mark(int row, int col, const uint8_t *bytes, int byte_len) {
+static int append_combining_mark(Terminal *t, int row, int col, const uint8_t *bytes, int byte_len) {
     TerminalCell *cell;
     size_t cur_len;
 
-    if (!terminal_buffer || !bytes || byte_len <= 0 || row < 0 || row >= term_rows || col < 0 || col >= term_cols) {
+    if (!t->screen || !bytes || byte_len <= 0 || row < 0 || row >= t->rows || col < 0 || col >= t->cols) {
         return 0;
     }
 
-    if (terminal_buffer[row][col].is_continuation && col > 0) {
+    if (t->screen[row][col].is_continuation && col > 0) {
         col--;
     }
-    cell = &terminal_buffer[row][col];
+    cell = &t->screen[row][col];
     if (cell->c[0] == '\0' || cell->is_continuation) {
         return 0;
     }
@@ -859,66 +1120,63 @@ static int append_combining_mark(int row, int col, const uint8_t *bytes, int byt
 
     memcpy(cell->c + cur_len, bytes, (size_t)byte_len);
     cell->c[cur_len + (size_t)byte_len] = '\0';
-    mark_row_dirty(row);
+    mark_cells_dirty(t, row, col, col);
     return 1;
 }
 
-static void normalize_cell_for_write(int row, int col, const TerminalState *state) {
-    if (!state || !terminal_buffer || row < 0 || row >= term_rows || col < 0 || col >= term_cols) {
+static void normalize_cell_for_write(Terminal *t, int row, int col) {
+    const TerminalState *state = &t->state;
+
+    if (!t->screen || row < 0 || row >= t->rows || col < 0 || col >= t->cols) {
         return;
     }
 
-    if (terminal_buffer[row][col].is_continuation) {
-        if (col > 0 && terminal_buffer[row][col - 1].width == 2) {
-            clear_cell(&terminal_buffer[row][col - 1], state);
+    if (t->screen[row][col].is_continuation) {
+        if (col > 0 && t->screen[row][col - 1].width == 2) {
+            clear_cell(&t->screen[row][col - 1], state);
         }
-        clear_cell(&terminal_buffer[row][col], state);
+        clear_cell(&t->screen[row][col], state);
     }
 
-    if (terminal_buffer[row][col].width == 2) {
-        if (col + 1 < term_cols && terminal_buffer[row][col + 1].is_continuation) {
-            clear_cell(&terminal_buffer[row][col + 1], state);
+    if (t->screen[row][col].width == 2) {
+        if (col + 1 < t->cols && t->screen[row][col + 1].is_continuation) {
+            clear_cell(&t->screen[row][col + 1], state);
         }
-        clear_cell(&terminal_buffer[row][col], state);
+        clear_cell(&t->screen[row][col], state);
     }
 }
 
-static void advance_row_with_scroll(TerminalState *state) {
+static void advance_row_with_scroll(Terminal *t) {
+    TerminalState *state = &t->state;
     int top;
     int bottom;
     int was_in_region;
 
-    if (!state) {
-        return;
-    }
-
-    top = scroll_region_top(state);
-    bottom = scroll_region_bottom(state);
+    top = scroll_region_top(t);
+    bottom = scroll_region_bottom(t);
     was_in_region = (state->row >= top && state->row <= bottom);
 
     state->row++;
 
     if (was_in_region && state->row > bottom) {
-        scroll_up_one_line(state);
+        scroll_up_one_line(t);
         state->row = bottom;
-    } else if (state->row >= term_rows) {
-        state->row = term_rows - 1;
+    } else if (state->row >= t->rows) {
+        state->row = t->rows - 1;
     }
 }
 
-static void wrap_to_next_line(TerminalState *state) {
-    if (!state) {
-        return;
-    }
+static void wrap_to_next_line(Terminal *t) {
+    TerminalState *state = &t->state;
 
     /* Mark the last glyph on this line as soft-wrapped (st's ATTR_WRAP) */
-    if (terminal_buffer && state->row >= 0 && state->row < term_rows && term_cols > 0) {
-        terminal_buffer[state->row][term_cols - 1].attrs |= ATTR_WRAP;
+    if (t->screen && state->row >= 0 && state->row < t->rows && t->cols > 0) {
+        t->screen[state->row][t->cols - 1].attrs |= ATTR_WRAP;
     }
 
     state->wrap_next = 0;
     state->col = 0;
-    advance_row_with_scroll(state);
+    advance_row_with_scroll(t);
 }
 
 static void osc_reset(TerminalState *state) {
@@ -1063,7 +1321,8 @@ static uint32_t parse_x11_color(const char *spec) {
     return 0;
 }
 
-static void osc_finalize(TerminalState *state) {
+static void osc_dispatch(Terminal *t) {
+    TerminalState *state = &t->state;
     const char *payload;
     const char *semi;
     const char *arg1;
@@ -1071,9 +1330,7 @@ static void osc_finalize(TerminalState *state) {
     size_t title_len;
     int cmd;
 
-    if (!state) {
-        return;
-    }
+    t->stats.osc++;
 
     state->osc_buf[state->osc_len] = '\0';
     payload = state->osc_buf;
@@ -1108,7 +1365,7 @@ static void osc_finalize(TerminalState *state) {
                 if (col) {
                     state->palette_override[idx] = col;
                     state->palette_overridden[idx] = 1;
-                    mark_all_rows_dirty();
+                    mark_all_rows_dirty(t);
                 }
             }
         }
@@ -1120,7 +1377,7 @@ static void osc_finalize(TerminalState *state) {
                 if (cmd == 10)      state->osc_fg_color = col;
                 else if (cmd == 11) state->osc_bg_color = col;
                 else                state->osc_cs_color = col;
-                mark_all_rows_dirty();
+                mark_all_rows_dirty(t);
             }
         }
     } else if (cmd == 52 && allowwindowops) {
@@ -1140,7 +1397,7 @@ static void osc_finalize(TerminalState *state) {
         const char *p = arg1;
         if (!*p) {
             memset(state->palette_overridden, 0, sizeof(state->palette_overridden));
-            mark_all_rows_dirty();
+            mark_all_rows_dirty(t);
         } else {
             while (*p) {
                 int idx = (int)strtol(p, (char **)&p, 10);
@@ -1150,35 +1407,46 @@ static void osc_finalize(TerminalState *state) {
                 }
                 if (*p == ';') p++;
             }
-            mark_all_rows_dirty();
+            mark_all_rows_dirty(t);
         }
     } else if (cmd == 110) {
         state->osc_fg_color = 0;
-        mark_all_rows_dirty();
+        mark_all_rows_dirty(t);
     } else if (cmd == 111) {
         state->osc_bg_color = 0;
-        mark_all_rows_dirty();
+        mark_all_rows_dirty(t);
     } else if (cmd == 112) {
         state->osc_cs_color = 0;
-        mark_all_rows_dirty();
+        mark_all_rows_dirty(t);
     }
 
     osc_reset(state);
 }
 
-static void terminal_soft_reset(TerminalState *state) {
-    if (!state) {
-        return;
-    }
+/* Kept apart from osc_dispatch() so each OSC is one trace span. */
+static void osc_finalize(Terminal *t) {
+    TRACE_BEGIN(t_osc);
+    SEQPROF_BEGIN(p_osc);
+#ifdef CUPID_SEQPROF
+    unsigned osc_key = seqprof_osc_key(t->state.osc_buf, (size_t)t->state.osc_len);
+    size_t osc_bytes = (size_t)t->state.osc_len;
+#endif
+    osc_dispatch(t);
+    SEQPROF_END(p_osc, SEQPROF_OSC, osc_key, osc_bytes);
+    TRACE_END(t_osc, "OSC", "seq", 0);
+}
+
+static void terminal_soft_reset(Terminal *t) {
+    TerminalState *state = &t->state;
 
-    if (primary_buffer) {
-        clear_buffer_defaults(primary_buffer);
+    if (t->primary) {
+        clear_buffer_defaults(t, t->primary);
     }
-    if (alternate_buffer) {
-        clear_buffer_defaults(alternate_buffer);
+    if (t->alternate) {
+        clear_buffer_defaults(t, t->alternate);
     }
 
-    terminal_buffer = primary_buffer ? primary_buffer : terminal_buffer;
+    t->screen = t->primary ? t->primary : t->screen;
     state->alt_screen_active = 0;
 
     state->row = 0;
@@ -1205,6 +1473,7 @@ static void terminal_soft_reset(TerminalState *state) {
     state->mouse_reporting_any = 0;
     state->mouse_sgr_mode = 0;
     state->application_cursor_keys = 0;
+    state->sync_update = 0;
 
     state->charset_g0 = 0;
     state->charset_g1 = 0;
@@ -1212,6 +1481,7 @@ static void terminal_soft_reset(TerminalState *state) {
 
     state->utf8_len = 0;
     state->csi_pending_len = 0;
+    state->csi_skip = 0;
     state->str_ignore_active = 0;
     state->str_ignore_esc_pending = 0;
     state->scrollback_offset = 0;
@@ -1219,151 +1489,158 @@ static void terminal_soft_reset(TerminalState *state) {
     state->osc52_pending = 0;
     osc_reset(state);
 
-    if (tab_stops) {
-        init_default_tab_stops(tab_stops, term_cols);
+    if (t->tabs) {
+        init_default_tab_stops(t->tabs, t->cols);
     }
-    mark_all_rows_dirty();
+    mark_all_rows_dirty(t);
 }
 
-void resize_terminal(int new_rows, int new_cols) {
+static void resize_screen(Terminal *t, int new_rows, int new_cols) {
     TerminalCell **new_primary;
     TerminalCell **new_alt = NULL;
-    TerminalCell **new_history = NULL;
     unsigned char *new_tabs = NULL;
-    int old_rows = term_rows;
-    int old_cols = term_cols;
+    int old_rows = t->rows;
+    int old_cols = t->cols;
 
     if (new_rows <= 0) new_rows = 1;
     if (new_cols <= 0) new_cols = 1;
 
-    if (primary_buffer != NULL && new_rows == term_rows && new_cols == term_cols) {
-        terminal_buffer = (term_state.alt_screen_active && alternate_buffer) ? alternate_buffer : primary_buffer;
+    if (t->primary != NULL && new_rows == t->rows && new_cols == t->cols) {
+        t->screen = (t->state.alt_screen_active && t->alternate) ? t->alternate : t->primary;
         return;
     }
 
-    new_primary = resize_buffer(primary_buffer, old_rows, old_cols, new_rows, new_cols);
+    new_primary = resize_buffer(t, t->primary, old_rows, old_cols, new_rows, new_cols);
     if (!new_primary) {
         return;
     }
 
-    if (alternate_buffer) {
-        new_alt = resize_buffer(alternate_buffer, old_rows, old_cols, new_rows, new_cols);
+    if (t->alternate) {
+        new_alt = resize_buffer(t, t->alternate, old_rows, old_cols, new_rows, new_cols);
         if (!new_alt) {
-            primary_buffer = new_primary;
-            alternate_buffer = NULL;
-            term_state.alt_screen_active = 0;
-            term_rows = new_rows;
-            term_cols = new_cols;
-            terminal_buffer = primary_buffer;
-            clamp_cursor(&term_state);
+            t->primary = new_primary;
+            t->alternate = NULL;
+            t->state.alt_screen_active = 0;
+            t->rows = new_rows;
+            t->cols = new_cols;
+            t->screen = t->primary;
+            clamp_cursor(t);
             return;
         }
     }
 
-    if (history_buffer) {
-        new_history = resize_history_buffer(history_buffer, old_cols, new_cols);
-        if (!new_history) {
-            free_history_buffer(history_buffer);
-            history_buffer = NULL;
-            history_count = 0;
-            history_head = 0;
-        }
-    } else {
-        new_history = alloc_history_buffer(new_cols);
-        if (new_history) {
-            history_count = 0;
-            history_head = 0;
-        }
+    if (t->history && !resize_history_buffer(t, old_cols, new_cols)) {
+        free_history_buffer(t->history);
+        t->history = NULL;
+        t->history_rows = 0;
+        t->history_count = 0;
+        t->history_head = 0;
+        spill_clear(t->spill);
     }
 
-    primary_buffer = new_primary;
-    alternate_buffer = new_alt;
-    if (new_history) {
-        history_buffer = new_history;
-    }
-    term_rows = new_rows;
-    term_cols = new_cols;
+    t->primary = new_primary;
+    t->alternate = new_alt;
+    t->rows = new_rows;
+    t->cols = new_cols;
 
-    /* Reallocate dirty_rows; mark all rows dirty after resize. */
-    free(dirty_rows);
-    dirty_rows = calloc((size_t)new_rows, sizeof(uint8_t));
-    if (dirty_rows) memset(dirty_rows, 1, (size_t)new_rows);
+    /* Reallocate t->dirty; mark all rows dirty after resize. */
+    free(t->dirty);
+    free(t->dirty_lo);
+    free(t->dirty_hi);
+    t->dirty = calloc((size_t)new_rows, sizeof(uint8_t));
+    t->dirty_lo = calloc((size_t)new_rows, sizeof(int));
+    t->dirty_hi = calloc((size_t)new_rows, sizeof(int));
+    if (t->dirty) memset(t->dirty, DIRTY_ROW_FULL, (size_t)new_rows);
 
     new_tabs = calloc((size_t)new_cols, sizeof(unsigned char));
     if (new_tabs) {
-        if (tab_stops) {
+        if (t->tabs) {
             int copy_cols = (old_cols < new_cols) ? old_cols : new_cols;
             if (copy_cols > 0) {
-                memcpy(new_tabs, tab_stops, (size_t)copy_cols);
+                memcpy(new_tabs, t->tabs, (size_t)copy_cols);
             }
             for (int c = copy_cols; c < new_cols; c++) {
                 new_tabs[c] = (unsigned char)(((c % 8) == 0) ? 1 : 0);
             }
-            free(tab_stops);
+            free(t->tabs);
         } else {
             init_default_tab_stops(new_tabs, new_cols);
         }
-        tab_stops = new_tabs;
-    } else if (tab_stops) {
-        free(tab_stops);
-        tab_stops = NULL;
+        t->tabs = new_tabs;
+    } else if (t->tabs) {
+        free(t->tabs);
+        t->tabs = NULL;
     }
 
-    if (term_state.alt_screen_active) {
-        if (!alternate_buffer) {
-            alternate_buffer = alloc_buffer(term_rows, term_cols);
+    if (t->state.alt_screen_active) {
+        if (!t->alternate) {
+            t->alternate = alloc_buffer(t, t->rows, t->cols);
         }
-        terminal_buffer = alternate_buffer ? alternate_buffer : primary_buffer;
+        t->screen = t->alternate ? t->alternate : t->primary;
     } else {
-        terminal_buffer = primary_buffer;
-    }
-
-    term_state.scroll_top = -1;
-    term_state.scroll_bottom = -1;
-    if (term_state.scrollback_offset > history_count) {
-        term_state.scrollback_offset = history_count;
-    }
-
-    clamp_cursor(&term_state);
-    if (term_state.saved_row < 0) term_state.saved_row = 0;
-    if (term_state.saved_row >= term_rows) term_state.saved_row = term_rows - 1;
-    if (term_state.saved_col < 0) term_state.saved_col = 0;
-    if (term_state.saved_col >= term_cols) term_state.saved_col = term_cols - 1;
-    if (term_state.alt_saved_row < 0) term_state.alt_saved_row = 0;
-    if (term_state.alt_saved_row >= term_rows) term_state.alt_saved_row = term_rows - 1;
-    if (term_state.alt_saved_col < 0) term_state.alt_saved_col = 0;
-    if (term_state.alt_saved_col >= term_cols) term_state.alt_saved_col = term_cols - 1;
-}
-
-void initialize_terminal_state(TerminalState *state) {
-    if (!state) {
+        t->screen = t->primary;
+    }
+
+    t->state.scroll_top = -1;
+    t->state.scroll_bottom = -1;
+    if (t->state.scrollback_offset > history_lines(t)) {
+        t->state.scrollback_offset = history_lines(t);
+    }
+
+    clamp_cursor(t);
+    if (t->state.saved_row < 0) t->state.saved_row = 0;
+    if (t->state.saved_row >= t->rows) t->state.saved_row = t->rows - 1;
+    if (t->state.saved_col < 0) t->state.saved_col = 0;
+    if (t->state.saved_col >= t->cols) t->state.saved_col = t->cols - 1;
+    if (t->state.alt_saved_row < 0) t->state.alt_saved_row = 0;
+    if (t->state.alt_saved_row >= t->rows) t->state.alt_saved_row = t->rows - 1;
+    if (t->state.alt_saved_col < 0) t->state.alt_saved_col = 0;
+    if (t->state.alt_saved_col >= t->cols) t->state.alt_saved_col = t->cols - 1;
+}
+
+/* Free t's screens, tab stops, dirty rows and history; an open spill file
+   is emptied but stays open. */
+static void free_working_set(Terminal *t) {
+    if (t->primary) {
+        free_buffer(t->primary, t->rows);
+        t->primary = NULL;
+    }
+    if (t->alternate) {
+        free_buffer(t->alternate, t->rows);
+        t->alternate = NULL;
+    }
+    if (t->tabs) {
+        free(t->tabs);
+        t->tabs = NULL;
+    }
+    if (t->history) {
+        free_history_buffer(t->history);
+        t->history = NULL;
+    }
+    t->history_rows = 0;
+    t->history_count = 0;
+    t->history_head = 0;
+    t->history_total = 0;
+    spill_clear(t->spill);
+    free(t->dirty);
+    t->dirty = NULL;
+    free(t->dirty_lo);
+    t->dirty_lo = NULL;
+    free(t->dirty_hi);
+    t->dirty_hi = NULL;
+    t->screen = NULL;
+}
+
+void terminal_reset(Terminal *t) {
+    TerminalState *state = &t->state;
+
+    if (!t) {
         return;
     }
 
-    if (primary_buffer) {
-        free_buffer(primary_buffer, term_rows);
-        primary_buffer = NULL;
-    }
-    if (alternate_buffer) {
-        free_buffer(alternate_buffer, term_rows);
-        alternate_buffer = NULL;
-    }
-    if (tab_stops) {
-        free(tab_stops);
-        tab_stops = NULL;
-    }
-    if (history_buffer) {
-        free_history_buffer(history_buffer);
-        history_buffer = NULL;
-    }
-    history_count = 0;
-    history_head = 0;
-    free(dirty_rows);
-    dirty_rows = NULL;
-    terminal_buffer = NULL;
-
-    term_rows = 24;
-    term_cols = 80;
+    free_working_set(t);
+    t->rows = 24;
+    t->cols = 80;
 
     memset(state, 0, sizeof(*state));
     state->csi_pending_len = 0;
@@ -1387,7 +1664,7 @@ void initialize_terminal_state(TerminalState *state) {
     state->str_ignore_esc_pending = 0;
     strncpy(state->window_title, "cupidterminal", sizeof(state->window_title) - 1);
 
-    resize_terminal(24, 80);
+    resize_screen(t, 24, 80);
 }
 
 void reset_attributes(TerminalState *s) {
@@ -1399,14 +1676,83 @@ void reset_attributes(TerminalState *s) {
     s->current_attrs = 0;
 }
 
-void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
+#ifdef CUPID_TRACE
+/* Trace span name for a CSI sequence, by final byte. */
+static const char *csi_trace_name(char final) {
+    switch (final) {
+    case 'm': return "CSI SGR";
+    case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G':
+    case 'H': case 'f': case 'd': case 'e': case 'a': case '`':
+        return "CSI cursor";
+    case 'J': case 'K': case 'X': case 'P': case '@':
+        return "CSI erase";
+    case 'L': case 'M': case 'S': case 'T': case 'r':
+        return "CSI scroll";
+    case 'h': case 'l':
+        return "CSI mode";
+    case 'b':
+        return "CSI REP";
+    default:
+        return "CSI other";
+    }
+}
+#endif
+
+static void print_char(Terminal *t, char c);
+
+/*
+ * REP.  The first copy on each line goes through print_char() for wrapping,
+ * insert mode and charsets (lastc is already UTF-8, so nothing is
+ * re-encoded); the rest of the line is a span fill from the cells it wrote.
+ */
+static void repeat_last_glyph(Terminal *t, int n, int width) {
+    TerminalState *state = &t->state;
+    int len = (int)strlen(state->lastc);
+
+    while (n > 0) {
+        int row;
+        int col;
+        int run;
+
+        for (int k = 0; k < len; k++) {
+            print_char(t, state->lastc[k]);
+        }
+        n--;
+
+        row = state->row;
+        col = state->col;
+        if (n == 0 || state->insert_mode || state->wrap_next ||
+            row < 0 || row >= t->rows || col < width || col >= t->cols) {
+            continue;
+        }
+        run = (t->cols - col) / width;
+        if (run > n) run = n;
+        if (run == 0) {
+            continue;
+        }
+        n -= run;
+        run *= width;
+        normalize_cell_for_write(t, row, col + run - 1);
+        cells_fill(&t->screen[row][col], &t->screen[row][col - width], width, run);
+        mark_cells_dirty(t, row, col, col + run);
+        if (col + run < t->cols) {
+            state->col = col + run;
+        } else {
+            state->col = state->autowrap_mode ? t->cols : t->cols - 1;
+            state->wrap_next = state->autowrap_mode ? 1 : 0;
+        }
+    }
+}
+
+static void csi_dispatch(Terminal *t, const char *seq, int len,
     terminal_response_fn response_fn, void *response_ctx) {
+    TerminalState *state = &t->state;
     int param_values[16] = {0};
     int param_count;
     int is_private = 0;
     char cmd;
 
-    if (!seq || !state || len < 3 || seq[0] != '\033' || seq[1] != '[') {
+    if (!seq || len < 3 || seq[0] != '\033' || seq[1] != '[') {
         return;
     }
 
@@ -1414,18 +1760,31 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
     param_count = parse_csi_params_dec(&seq[2], len - 3, param_values, 16, &is_private);
 
     {
-        int min_row = cursor_min_row(state);
-        int max_row = cursor_max_row(state);
+        int min_row = cursor_min_row(t);
+        int max_row = cursor_max_row(t);
         if (state->row < min_row) state->row = min_row;
         if (state->row > max_row) state->row = max_row;
     }
     if (state->col < 0) state->col = 0;
 
+    /* DECRQM: CSI [?] Ps $ p -> DECRPM CSI [?] Ps ; Pm $ y */
+    if (cmd == 'p' && len >= 4 && seq[len - 2] == '$') {
+        int mode = param_count > 0 ? param_values[0] : 0;
+        int value = is_private ? decrqm_private_value(state, mode)
+                               : decrqm_ansi_value(state, mode);
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "\033[%s%d;%d$y", is_private ? "?" : "", mode, value);
+        if (response_fn && n > 0 && (size_t)n < sizeof(buf)) {
+            response_fn((const uint8_t *)buf, (size_t)n, response_ctx);
+        }
+        return;
+    }
+
     if (is_private) {
         if (cmd == 'h') {
             if (csi_has_param(param_values, param_count, 6)) {
                 state->origin_mode = 1;
-                cursor_home(state);
+                cursor_home(t);
             }
             if (csi_has_param(param_values, param_count, 7)) {
                 state->autowrap_mode = 1;
@@ -1436,10 +1795,10 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             if (csi_has_param(param_values, param_count, 47) ||
                 csi_has_param(param_values, param_count, 1047) ||
                 csi_has_param(param_values, param_count, 1049)) {
-                activate_alternate_screen(state);
+                activate_alternate_screen(t);
             }
             if (csi_has_param(param_values, param_count, 1048)) {
-                save_cursor_state(state);
+                save_cursor_state(t);
             }
             if (csi_has_param(param_values, param_count, 2004)) {
                 state->bracketed_paste_mode = 1;
@@ -1468,12 +1827,15 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             if (csi_has_param(param_values, param_count, 5)) {
                 if (!state->screen_reverse) {
                     state->screen_reverse = 1;
-                    mark_all_rows_dirty();
+                    mark_all_rows_dirty(t);
                 }
             }
             if (csi_has_param(param_values, param_count, 1004)) {
                 state->focus_mode = 1;
             }
+            if (csi_has_param(param_values, param_count, 2026)) {
+                state->sync_update = 1;
+            }
         } else if (cmd == 'q') {
             int p = (param_count && param_values[0] >= 0) ? param_values[0] : 0;
             if (p >= 0 && p <= 7) {
@@ -1482,14 +1844,14 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
         } else if (cmd == 'l') {
             if (csi_has_param(param_values, param_count, 6)) {
                 state->origin_mode = 0;
-                cursor_home(state);
+                cursor_home(t);
             }
             if (csi_has_param(param_values, param_count, 7)) {
                 state->autowrap_mode = 0;
                 state->wrap_next = 0;
                 state->wrap_overwrite_next = 0;
-                if (state->col >= term_cols) {
-                    state->col = term_cols - 1;
+                if (state->col >= t->cols) {
+                    state->col = t->cols - 1;
                 }
             }
             if (csi_has_param(param_values, param_count, 25)) {
@@ -1498,10 +1860,10 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             if (csi_has_param(param_values, param_count, 47) ||
                 csi_has_param(param_values, param_count, 1047) ||
                 csi_has_param(param_values, param_count, 1049)) {
-                deactivate_alternate_screen(state);
+                deactivate_alternate_screen(t);
             }
             if (csi_has_param(param_values, param_count, 1048)) {
-                restore_cursor_state(state);
+                restore_cursor_state(t);
             }
             if (csi_has_param(param_values, param_count, 2004)) {
                 state->bracketed_paste_mode = 0;
@@ -1524,12 +1886,18 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             if (csi_has_param(param_values, param_count, 5)) {
                 if (state->screen_reverse) {
                     state->screen_reverse = 0;
-                    mark_all_rows_dirty();
+                    mark_all_rows_dirty(t);
                 }
             }
             if (csi_has_param(param_values, param_count, 1004)) {
                 state->focus_mode = 0;
             }
+            if (csi_has_param(param_values, param_count, 2026)) {
+                if (state->sync_update) {
+                    state->sync_ends++;
+                }
+                state->sync_update = 0;
+            }
         }
         return;
     }
@@ -1547,11 +1915,11 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             int n;
 
             if (report_row < 0) report_row = 0;
-            if (report_row >= term_rows) report_row = term_rows - 1;
+            if (report_row >= t->rows) report_row = t->rows - 1;
             if (report_col < 0) report_col = 0;
-            /* CPR uses 1-based columns; virtual margin (col==term_cols) reports last column+1 */
-            if (report_col >= term_cols) {
-                report_col = term_cols - 1;
+            /* CPR uses 1-based columns; virtual margin (col==t->cols) reports last column+1 */
+            if (report_col >= t->cols) {
+                report_col = t->cols - 1;
             }
 
             n = snprintf(buf, sizeof(buf), "\033[%d;%dR", report_row + 1, report_col + 1);
@@ -1571,11 +1939,12 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
     switch (cmd) {
         case 'H':
         case 'f': {
-            int min_row = cursor_min_row(state);
-            int max_row = cursor_max_row(state);
+            int min_row = cursor_min_row(t);
+            int max_row = cursor_max_row(t);
             int r = csi_param_default(param_values, param_count, 0, 1);
             int c = csi_param_default(param_values, param_count, 1, 1);
 
+            if (r > t->rows) r = t->rows;
             if (state->origin_mode) {
                 r = min_row + r - 1;
             } else {
@@ -1585,17 +1954,18 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             if (r < min_row) r = min_row;
             if (r > max_row) r = max_row;
             if (c < 0) c = 0;
-            if (c >= term_cols) c = term_cols - 1;
-            cancel_pending_wrap(state);
+            if (c >= t->cols) c = t->cols - 1;
+            cancel_pending_wrap(t);
             state->row = r;
             state->col = c;
         } break;
 
         case 'E': {
-            int min_row = cursor_min_row(state);
-            int max_row = cursor_max_row(state);
+            int min_row = cursor_min_row(t);
+            int max_row = cursor_max_row(t);
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
+            if (n > t->rows) n = t->rows;
             state->row += n;
             if (state->row < min_row) state->row = min_row;
             if (state->row > max_row) state->row = max_row;
@@ -1603,10 +1973,11 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
         } break;
 
         case 'F': {
-            int min_row = cursor_min_row(state);
-            int max_row = cursor_max_row(state);
+            int min_row = cursor_min_row(t);
+            int max_row = cursor_max_row(t);
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
+            if (n > t->rows) n = t->rows;
             state->row -= n;
             if (state->row < min_row) state->row = min_row;
             if (state->row > max_row) state->row = max_row;
@@ -1616,112 +1987,117 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
         case 'G':
         case '`': {
             int c = csi_param_default(param_values, param_count, 0, 1) - 1;
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
             if (c < 0) c = 0;
-            if (c >= term_cols) c = term_cols - 1;
+            if (c >= t->cols) c = t->cols - 1;
             state->col = c;
         } break;
 
         case 'J': {
             int n = (param_count ? param_values[0] : 0);
 
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
             if (n == 2 || n == 3) {
-                clear_screen_range(0, 0, term_rows - 1, term_cols - 1, state);
+                clear_screen_range(t, 0, 0, t->rows - 1, t->cols - 1);
             } else if (n == 0) {
-                clear_screen_range(state->row, state->col, term_rows - 1, term_cols - 1, state);
+                clear_screen_range(t, state->row, state->col, t->rows - 1, t->cols - 1);
             } else if (n == 1) {
-                clear_screen_range(0, 0, state->row, state->col, state);
+                clear_screen_range(t, 0, 0, state->row, state->col);
             }
         } break;
 
         case 'K': {
             int n = (param_count ? param_values[0] : 0);
 
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
             if (n == 2) {
-                clear_row_range(state->row, 0, term_cols - 1, state);
+                clear_row_range(t, state->row, 0, t->cols - 1);
             } else if (n == 0) {
-                clear_row_range(state->row, state->col, term_cols - 1, state);
+                clear_row_range(t, state->row, state->col, t->cols - 1);
             } else if (n == 1) {
-                clear_row_range(state->row, 0, state->col, state);
+                clear_row_range(t, state->row, 0, state->col);
             }
         } break;
 
         case 'A': {
-            int min_row = cursor_min_row(state);
+            int min_row = cursor_min_row(t);
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
+            if (n > t->rows) n = t->rows;
             state->row -= n;
             if (state->row < min_row) state->row = min_row;
         } break;
 
         case 'B': {
-            int max_row = cursor_max_row(state);
+            int max_row = cursor_max_row(t);
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
+            if (n > t->rows) n = t->rows;
             state->row += n;
             if (state->row > max_row) state->row = max_row;
         } break;
 
         case 'C': {
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
+            if (n > t->cols) n = t->cols;
             state->col += n;
-            if (state->col >= term_cols) {
-                if (state->autowrap_mode && state->col == term_cols) {
+            if (state->col >= t->cols) {
+                if (state->autowrap_mode && state->col == t->cols) {
                     state->wrap_next = 1;
                 } else {
-                    state->col = term_cols - 1;
+                    state->col = t->cols - 1;
                 }
             }
         } break;
 
         case 'D': {
             int n = csi_param_default(param_values, param_count, 0, 1);
-            int was_margin = state->wrap_next && state->col >= term_cols;
-            cancel_pending_wrap(state);
+            int was_margin = state->wrap_next && state->col >= t->cols;
+            cancel_pending_wrap(t);
             if (was_margin && n > 0) {
                 n--;
             }
+            if (n > t->cols) n = t->cols;
             state->col -= n;
             if (state->col < 0) state->col = 0;
         } break;
 
         case 'I': {
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
-            while (n-- > 0) {
-                state->col = next_tab_stop_col(state->col);
+            cancel_pending_wrap(t);
+            while (n-- > 0 && state->col < t->cols - 1) {
+                state->col = next_tab_stop_col(t, state->col);
             }
         } break;
 
         case 'Z': {
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
-            while (n-- > 0) {
-                state->col = prev_tab_stop_col(state->col);
+            cancel_pending_wrap(t);
+            while (n-- > 0 && state->col > 0) {
+                state->col = prev_tab_stop_col(t, state->col);
             }
         } break;
 
         case 'g': {
             int n = (param_count ? param_values[0] : 0);
             if (n == 0) {
-                if (tab_stops && state->col >= 0 && state->col < term_cols) {
-                    tab_stops[state->col] = 0;
+                if (t->tabs && state->col >= 0 && state->col < t->cols) {
+                    t->tabs[state->col] = 0;
                 }
             } else if (n == 3) {
-                if (tab_stops) {
-                    memset(tab_stops, 0, (size_t)term_cols);
+                if (t->tabs) {
+                    memset(t->tabs, 0, (size_t)t->cols);
                 }
             }
         } break;
 
         case 'd': {
-            int min_row = cursor_min_row(state);
-            int max_row = cursor_max_row(state);
+            int min_row = cursor_min_row(t);
+            int max_row = cursor_max_row(t);
             int r = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
+            if (r > t->rows) r = t->rows;
             if (state->origin_mode) {
                 r = min_row + r - 1;
             } else {
@@ -1734,9 +2110,10 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
 
         case 'a': {
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
+            cancel_pending_wrap(t);
+            if (n > t->cols) n = t->cols;
             state->col += n;
-            if (state->col >= term_cols) state->col = term_cols - 1;
+            if (state->col >= t->cols) state->col = t->cols - 1;
         } break;
 
         case 'h': {
@@ -1767,17 +2144,17 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             if (param_count == 0) {
                 state->scroll_top = -1;
                 state->scroll_bottom = -1;
-                cursor_home(state);
+                cursor_home(t);
                 break;
             }
 
             int top = csi_param_default(param_values, param_count, 0, 1);
-            int bottom = csi_param_default(param_values, param_count, 1, term_rows);
+            int bottom = csi_param_default(param_values, param_count, 1, t->rows);
 
             if (top < 1) top = 1;
-            if (bottom < 1) bottom = term_rows;
-            if (top > term_rows) top = term_rows;
-            if (bottom > term_rows) bottom = term_rows;
+            if (bottom < 1) bottom = t->rows;
+            if (top > t->rows) top = t->rows;
+            if (bottom > t->rows) bottom = t->rows;
 
             if (top >= bottom) {
                 break;
@@ -1785,15 +2162,15 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
 
             state->scroll_top = top - 1;
             state->scroll_bottom = bottom - 1;
-            cursor_home(state);
+            cursor_home(t);
         } break;
 
         case 's':
-            save_cursor_state(state);
+            save_cursor_state(t);
             break;
 
         case 'u':
-            restore_cursor_state(state);
+            restore_cursor_state(t);
             break;
 
         case 'm': {
@@ -1884,19 +2261,16 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             int from;
             int shift;
 
-            cancel_pending_wrap(state);
-            if (n <= 0 || state->row < 0 || state->row >= term_rows) break;
+            cancel_pending_wrap(t);
+            if (n <= 0 || state->row < 0 || state->row >= t->rows) break;
             from = state->col;
             if (from < 0) from = 0;
-            shift = (from + n < term_cols) ? n : (term_cols - from);
+            shift = (n < t->cols - from) ? n : (t->cols - from);
             if (shift <= 0) break;
-            for (int c = term_cols - 1; c >= from + shift; c--) {
-                terminal_buffer[state->row][c] = terminal_buffer[state->row][c - shift];
-            }
-            for (int c = from; c < from + shift && c < term_cols; c++) {
-                clear_cell(&terminal_buffer[state->row][c], state);
-            }
-            mark_row_dirty(state->row);
+            cells_move(t->screen[state->row], from + shift, from, t->cols - from - shift);
+            cells_blank(t, &t->screen[state->row][from], shift,
+                        state->current_fg, state->current_bg, state->current_attrs);
+            mark_cells_dirty(t, state->row, from, t->cols - 1);
         } break;
 
         case 'P': {
@@ -1904,19 +2278,16 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             int from;
             int shift;
 
-            cancel_pending_wrap(state);
-            if (n <= 0 || state->row < 0 || state->row >= term_rows) break;
+            cancel_pending_wrap(t);
+            if (n <= 0 || state->row < 0 || state->row >= t->rows) break;
             from = state->col;
             if (from < 0) from = 0;
-            shift = (from + n < term_cols) ? n : (term_cols - from);
+            shift = (n < t->cols - from) ? n : (t->cols - from);
             if (shift <= 0) break;
-            for (int c = from; c < term_cols - shift; c++) {
-                terminal_buffer[state->row][c] = terminal_buffer[state->row][c + shift];
-            }
-            for (int c = term_cols - shift; c < term_cols; c++) {
-                clear_cell(&terminal_buffer[state->row][c], state);
-            }
-            mark_row_dirty(state->row);
+            cells_move(t->screen[state->row], from, from + shift, t->cols - from - shift);
+            cells_blank(t, &t->screen[state->row][t->cols - shift], shift,
+                        state->current_fg, state->current_bg, state->current_attrs);
+            mark_cells_dirty(t, state->row, from, t->cols - 1);
         } break;
 
         case 'L': {
@@ -1926,20 +2297,18 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             int r;
             int max_insert;
 
-            cancel_pending_wrap(state);
-            top = scroll_region_top(state);
-            bottom = scroll_region_bottom(state);
+            cancel_pending_wrap(t);
+            top = scroll_region_top(t);
+            bottom = scroll_region_bottom(t);
             if (state->row < top || state->row > bottom || n <= 0) break;
             r = state->row;
             max_insert = bottom - r + 1;
             if (n > max_insert) n = max_insert;
-            for (int row = bottom; row >= r + n; row--) {
-                memcpy(terminal_buffer[row], terminal_buffer[row - n], (size_t)term_cols * sizeof(TerminalCell));
-            }
+            rotate_rows_up(t, r, bottom, bottom - r + 1 - n);
             for (int row = r; row < r + n && row <= bottom; row++) {
-                clear_row_range(row, 0, term_cols - 1, state);
+                clear_row_range(t, row, 0, t->cols - 1);
             }
-            mark_rows_dirty(r, bottom);
+            mark_rows_dirty(t, r, bottom);
         } break;
 
         case 'M': {
@@ -1949,20 +2318,18 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             int r;
             int max_del;
 
-            cancel_pending_wrap(state);
-            top = scroll_region_top(state);
-            bottom = scroll_region_bottom(state);
+            cancel_pending_wrap(t);
+            top = scroll_region_top(t);
+            bottom = scroll_region_bottom(t);
             if (state->row < top || state->row > bottom || n <= 0) break;
             r = state->row;
             max_del = bottom - r + 1;
             if (n > max_del) n = max_del;
-            for (int row = r; row <= bottom - n; row++) {
-                memcpy(terminal_buffer[row], terminal_buffer[row + n], (size_t)term_cols * sizeof(TerminalCell));
-            }
+            rotate_rows_up(t, r, bottom, n);
             for (int row = bottom - n + 1; row <= bottom; row++) {
-                clear_row_range(row, 0, term_cols - 1, state);
+                clear_row_range(t, row, 0, t->cols - 1);
             }
-            mark_rows_dirty(r, bottom);
+            mark_rows_dirty(t, r, bottom);
         } break;
 
         case 'X': {
@@ -1970,41 +2337,40 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
             int from;
             int to;
 
-            cancel_pending_wrap(state);
-            if (n <= 0 || state->row < 0 || state->row >= term_rows) break;
+            cancel_pending_wrap(t);
+            if (n <= 0 || state->row < 0 || state->row >= t->rows) break;
             from = state->col;
             if (from < 0) from = 0;
-            to = from + n;
-            if (to > term_cols) to = term_cols;
-            clear_row_range(state->row, from, to - 1, state);
+            to = (n < t->cols - from) ? from + n : t->cols;
+            clear_row_range(t, state->row, from, to - 1);
         } break;
 
         case 'b': {
             int n = csi_param_default(param_values, param_count, 0, 1);
             utf8proc_int32_t codepoint;
             ssize_t parsed;
+            int width;
 
-            if (n <= 0 || n > 65535) break;
+            if (n <= 0) break;
             if (state->lastc[0] == '\0') break;
 
             parsed = utf8proc_iterate((const utf8proc_uint8_t *)state->lastc, -1, &codepoint);
             if (parsed <= 0) break;
 
-            for (int i = 0; i < n; i++) {
-                put_codepoint(codepoint, state);
-            }
+            width = glyph_width(codepoint);
+            repeat_last_glyph(t, rep_visible_count(t, n, width), width);
         } break;
 
         case 'S': {
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
-            scroll_up_n_lines(state, n);
+            cancel_pending_wrap(t);
+            scroll_up_n_lines(t, n);
         } break;
 
         case 'T': {
             int n = csi_param_default(param_values, param_count, 0, 1);
-            cancel_pending_wrap(state);
-            scroll_down_n_lines(state, n);
+            cancel_pending_wrap(t);
+            scroll_down_n_lines(t, n);
         } break;
 
         default:
@@ -2012,26 +2378,37 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
     }
 }
 
-void put_char(char c, TerminalState *state) {
-    if (!state || !terminal_buffer || term_rows <= 0 || term_cols <= 0) {
+/* Kept apart from csi_dispatch() so SEQPROF builds can time each handler. */
+static void dispatch_sequence(Terminal *t, const char *seq, int len,
+    terminal_response_fn response_fn, void *response_ctx) {
+    SEQPROF_BEGIN(p_csi);
+    csi_dispatch(t, seq, len, response_fn, response_ctx);
+    if (seq && len >= 3)
+        SEQPROF_END(p_csi, seqprof_csi_class(seq[2]), (unsigned char)seq[len - 1], len);
+}
+
+static void print_char(Terminal *t, char c) {
+    TerminalState *state = &t->state;
+
+    if (!t->screen || t->rows <= 0 || t->cols <= 0) {
         return;
     }
 
     if (state->row < 0) state->row = 0;
-    if (state->row >= term_rows) state->row = term_rows - 1;
+    if (state->row >= t->rows) state->row = t->rows - 1;
     if (state->col < 0) state->col = 0;
-    if (state->col > term_cols) {
-        state->col = term_cols;
+    if (state->col > t->cols) {
+        state->col = t->cols;
     }
-    if (state->col >= term_cols && !(state->wrap_next && state->col == term_cols && state->autowrap_mode)) {
-        state->col = term_cols - 1;
+    if (state->col >= t->cols && !(state->wrap_next && state->col == t->cols && state->autowrap_mode)) {
+        state->col = t->cols - 1;
     }
 
     if (c == '\b') {
         state->utf8_len = 0;
         if (state->wrap_next) {
             state->wrap_next = 0;
-            state->col = term_cols - 1;
+            state->col = t->cols - 1;
         } else if (state->col > 0) {
             state->col--;
         }
@@ -2047,11 +2424,11 @@ void put_char(char c, TerminalState *state) {
         state->utf8_len = 0;
         if (state->wrap_next) {
             /* Stay on virtual margin; next printable overwrites last column (xterm-style). */
-            state->col = term_cols;
+            state->col = t->cols;
             state->wrap_overwrite_next = 1;
             return;
         }
-        state->col = next_tab_stop_col(state->col);
+        state->col = next_tab_stop_col(t, state->col);
         return;
     }
 
@@ -2063,14 +2440,14 @@ void put_char(char c, TerminalState *state) {
 
     if (c == '\n' || c == '\v' || c == '\f') {
         state->utf8_len = 0;
-        cancel_pending_wrap(state);
-        advance_row_with_scroll(state);
+        cancel_pending_wrap(t);
+        advance_row_with_scroll(t);
         return;
     }
 
     if (c == '\r') {
         state->utf8_len = 0;
-        cancel_pending_wrap(state);
+        cancel_pending_wrap(t);
         state->col = 0;
         return;
     }
@@ -2127,114 +2504,102 @@ void put_char(char c, TerminalState *state) {
             }
             }
 
-            int width = wcwidth((wchar_t)codepoint);
+            int width = glyph_width(codepoint);
             int row;
             int col;
 
-            if (width < 0 && codepoint >= 0x80) {
-                int fallback_width = utf8proc_charwidth(codepoint);
-                if (fallback_width >= 0) {
-                    width = fallback_width;
-                }
-            }
-            if (width < 0) {
-                width = 1;
-            }
-            if (width > 2) {
-                width = 1;
-            }
-
             if (width == 0) {
                 int target_col;
 
                 if (state->wrap_next) {
-                    target_col = term_cols - 1;
+                    target_col = t->cols - 1;
                 } else {
                     target_col = state->col - 1;
                 }
 
-                (void)append_combining_mark(state->row, target_col, state->utf8_buf, state->utf8_len);
+                (void)append_combining_mark(t, state->row, target_col, state->utf8_buf, state->utf8_len);
                 state->utf8_len = 0;
                 return;
             }
 
             if (state->wrap_next) {
                 if (state->autowrap_mode) {
-                    if (state->col == term_cols && state->wrap_overwrite_next) {
+                    if (state->col == t->cols && state->wrap_overwrite_next) {
                         state->wrap_overwrite_next = 0;
                         state->wrap_next = 0;
-                        state->col = term_cols - 1;
+                        state->col = t->cols - 1;
                     } else {
                         state->wrap_next = 0;
                         state->wrap_overwrite_next = 0;
                         state->col = 0;
-                        advance_row_with_scroll(state);
+                        advance_row_with_scroll(t);
                     }
                 } else {
                     state->wrap_next = 0;
                     state->wrap_overwrite_next = 0;
-                    if (state->col >= term_cols) {
-                        state->col = term_cols - 1;
+                    if (state->col >= t->cols) {
+                        state->col = t->cols - 1;
                     }
                 }
             }
 
-            if (width == 2 && term_cols == 1) {
+            if (width == 2 && t->cols == 1) {
                 width = 1;
             }
-            if (width == 2 && state->col >= term_cols - 1) {
+            if (width == 2 && state->col >= t->cols - 1) {
                 if (state->autowrap_mode) {
-                    wrap_to_next_line(state);
+                    wrap_to_next_line(t);
                 } else {
-                    state->col = term_cols - width;
+                    state->col = t->cols - width;
                 }
             }
 
             row = state->row;
             col = state->col;
-            if (row < 0 || row >= term_rows || col < 0 || col >= term_cols) {
+            if (row < 0 || row >= t->rows || col < 0 || col >= t->cols) {
                 state->utf8_len = 0;
                 return;
             }
 
             if (state->insert_mode) {
-                int shift = width;
-                if (col + shift < term_cols) {
-                    for (int cc = term_cols - 1; cc >= col + shift; cc--) {
-                        terminal_buffer[row][cc] = terminal_buffer[row][cc - shift];
-                    }
-                }
-                for (int cc = col; cc < col + shift && cc < term_cols; cc++) {
-                    clear_cell(&terminal_buffer[row][cc], state);
-                }
+                int shift = (width < t->cols - col) ? width : t->cols - col;
+
+                cells_move(t->screen[row], col + shift, col, t->cols - col - shift);
+                cells_blank(t, &t->screen[row][col], shift,
+                            state->current_fg, state->current_bg, state->current_attrs);
             }
 
-            normalize_cell_for_write(row, col, state);
-            memcpy(terminal_buffer[row][col].c, state->utf8_buf, (size_t)state->utf8_len);
-            terminal_buffer[row][col].c[state->utf8_len] = '\0';
-            terminal_buffer[row][col].fg = state->current_fg;
-            terminal_buffer[row][col].bg = state->current_bg;
-            terminal_buffer[row][col].attrs = state->current_attrs;
-            terminal_buffer[row][col].width = (uint8_t)width;
-            terminal_buffer[row][col].is_continuation = 0;
+            normalize_cell_for_write(t, row, col);
+            memcpy(t->screen[row][col].c, state->utf8_buf, (size_t)state->utf8_len);
+            t->screen[row][col].c[state->utf8_len] = '\0';
+            t->screen[row][col].fg = state->current_fg;
+            t->screen[row][col].bg = state->current_bg;
+            t->screen[row][col].attrs = state->current_attrs;
+            t->screen[row][col].width = (uint8_t)width;
+            t->screen[row][col].is_continuation = 0;
 
-            mark_row_dirty(row);
+            /* normalize_cell_for_write() may have cleared a wide neighbour on
+             * either side; insert mode shifted the rest of the line. */
+            if (state->insert_mode)
+                mark_cells_dirty(t, row, col, t->cols - 1);
+            else
+                mark_cells_dirty(t, row, col - 1, col + width + 1);
 
             memcpy(state->lastc, state->utf8_buf, (size_t)state->utf8_len);
             state->lastc[state->utf8_len] = '\0';
 
-            if (width == 2 && col + 1 < term_cols) {
-                normalize_cell_for_write(row, col + 1, state);
-                clear_cell(&terminal_buffer[row][col + 1], state);
-                terminal_buffer[row][col + 1].width = 0;
-                terminal_buffer[row][col + 1].is_continuation = 1;
+            if (width == 2 && col + 1 < t->cols) {
+                normalize_cell_for_write(t, row, col + 1);
+                clear_cell(&t->screen[row][col + 1], state);
+                t->screen[row][col + 1].width = 0;
+                t->screen[row][col + 1].is_continuation = 1;
             }
 
-            if (col + width < term_cols) {
+            if (col + width < t->cols) {
                 state->col = col + width;
                 state->wrap_next = 0;
             } else {
-                state->col = state->autowrap_mode ? term_cols : term_cols - 1;
+                state->col = state->autowrap_mode ? t->cols : t->cols - 1;
                 state->wrap_next = state->autowrap_mode ? 1 : 0;
             }
             state->utf8_len = 0;
@@ -2245,21 +2610,38 @@ void put_char(char c, TerminalState *state) {
 }
 
 #define CSI_PENDING_MAX 1024
-/* Must be at least CSI_PENDING_MAX + BUF_SIZE (65536) so that a pending
- * partial CSI never causes bytes from the subsequent read to be silently
- * dropped when the two are merged before parsing. */
-#define COMBINED_MAX (CSI_PENDING_MAX + 65536 + 16)
+/* Longer input is parsed in pieces of this size (one PTY read). */
+#define FEED_CHUNK 65536
+/* Must be at least CSI_PENDING_MAX + FEED_CHUNK so that a pending partial
+ * CSI never causes bytes from the next piece to be silently dropped when
+ * the two are merged before parsing. */
+#define COMBINED_MAX (CSI_PENDING_MAX + FEED_CHUNK + 16)
 
-void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *state,
-    terminal_response_fn response_fn, void *response_ctx) {
-    if (!bytes || !state) {
+/*
+ * Keep an unterminated CSI for the next read.  One too long to buffer is
+ * not legitimate: swallow the rest of it rather than print its parameters.
+ */
+static void csi_save_partial(TerminalState *state, const uint8_t *seq, size_t len) {
+    if (len > CSI_PENDING_MAX) {
+        state->csi_skip = 1;
         return;
     }
+    memcpy(state->csi_pending, seq, len);
+    state->csi_pending_len = (int)len;
+}
+
+static void consume_chunk(Terminal *t, const uint8_t *bytes, size_t len,
+    terminal_response_fn response_fn, void *response_ctx) {
+    TerminalState *state = &t->state;
+
+    t->stats.bytes += len;
 
     /* Prepend any partial CSI from previous read */
     uint8_t combined_buf[COMBINED_MAX];
     const uint8_t *buf = bytes;
     size_t buflen = len;
+    /* The pending bytes hold no final byte: resume the CSI scan after them */
+    size_t csi_resume = (size_t)state->csi_pending_len;
     if (state->csi_pending_len > 0) {
         size_t total = (size_t)state->csi_pending_len + len;
         if (total > COMBINED_MAX) total = COMBINED_MAX;
@@ -2270,9 +2652,19 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
         state->csi_pending_len = 0;
     }
     if (buflen == 0) return;
+    TRACE_BEGIN(t_parse);
 
     size_t i = 0;
     while (i < buflen) {
+        if (state->csi_skip) {
+            uint8_t b = buf[i++];
+
+            if ((b >= '@' && b <= '~') || b == 0x18 || b == 0x1A) {
+                state->csi_skip = 0;
+            }
+            continue;
+        }
+
         if (state->str_ignore_active) {
             uint8_t b = buf[i++];
 
@@ -2301,7 +2693,7 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
 
             if (state->osc_esc_pending) {
                 if (b == '\\') {
-                    osc_finalize(state);
+                    osc_finalize(t);
                     continue;
                 }
                 osc_append_byte(state, 0x1B);
@@ -2309,7 +2701,7 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
             }
 
             if (b == 0x07 || b == 0x9C || b == 0x18 || b == 0x1A) {
-                osc_finalize(state);
+                osc_finalize(t);
                 continue;
             }
             if (b == 0x1B) {
@@ -2325,6 +2717,7 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
             size_t start = i;
             i++;
             state->utf8_len = 0;
+            t->stats.esc++;
 
             if (i >= buflen) {
                 size_t tail = buflen - start;
@@ -2336,42 +2729,42 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
             }
 
             if (buf[i] == '7') {
-                save_cursor_state(state);
+                save_cursor_state(t);
                 i++;
                 continue;
             }
             if (buf[i] == '8') {
-                restore_cursor_state(state);
+                restore_cursor_state(t);
                 i++;
                 continue;
             }
             if (buf[i] == 'D') {
-                cancel_pending_wrap(state);
-                advance_row_with_scroll(state);
+                cancel_pending_wrap(t);
+                advance_row_with_scroll(t);
                 i++;
                 continue;
             }
             if (buf[i] == 'E') {
-                cancel_pending_wrap(state);
-                advance_row_with_scroll(state);
+                cancel_pending_wrap(t);
+                advance_row_with_scroll(t);
                 state->col = 0;
                 i++;
                 continue;
             }
             if (buf[i] == 'M') {
-                reverse_index(state);
+                reverse_index(t);
                 i++;
                 continue;
             }
             if (buf[i] == 'H') {
-                if (tab_stops && state->col > 0 && state->col < term_cols) {
-                    tab_stops[state->col] = 1;
+                if (t->tabs && state->col > 0 && state->col < t->cols) {
+                    t->tabs[state->col] = 1;
                 }
                 i++;
                 continue;
             }
             if (buf[i] == 'c') {
-                terminal_soft_reset(state);
+                terminal_soft_reset(t);
                 i++;
                 continue;
             }
@@ -2428,24 +2821,28 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
                 size_t q;
 
                 i++;
-                q = i;
+                q = (start == 0 && csi_resume > i) ? csi_resume : i;
                 while (q < buflen && !(buf[q] >= '@' && buf[q] <= '~')) {
                     q++;
                 }
 
                 if (q < buflen) {
                     int seq_len = (int)(q - start + 1);
-                    handle_ansi_sequence((const char *)&buf[start], seq_len, state, response_fn, response_ctx);
+                    if (seq_len > CSI_PENDING_MAX) {
+                        /* Same fate as one split across reads: ignored */
+                        i = q + 1;
+                        continue;
+                    }
+                    TRACE_BEGIN(t_csi);
+                    t->stats.csi++;
+                    dispatch_sequence(t, (const char *)&buf[start], seq_len, response_fn, response_ctx);
+                    TRACE_END(t_csi, csi_trace_name((char)buf[q]), "seq", seq_len);
                     i = q + 1;
                     continue;
                 }
 
                 /* Partial CSI: save for next read */
-                size_t tail = buflen - start;
-                if (tail > 0 && tail <= CSI_PENDING_MAX) {
-                    memcpy(state->csi_pending, buf + start, tail);
-                    state->csi_pending_len = (int)tail;
-                }
+                csi_save_partial(state, buf + start, buflen - start);
                 break;
             }
 
@@ -2460,20 +2857,21 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
             if (buf[i] == 'P' || buf[i] == '_' || buf[i] == '^') {
                 i++;
                 state->str_ignore_active = 1;
+                t->stats.str++;
                 state->str_ignore_esc_pending = 0;
                 continue;
             }
 
             /* DECKPAM (ESC =) and DECKPNM (ESC >) – keypad mode switches.
              * Must be consumed here; without this the '=' or '>' byte falls
-             * through to put_char() and is printed literally in the prompt. */
+             * through to print_char() and is printed literally in the prompt. */
             if (buf[i] == '=' || buf[i] == '>') {
                 i++;
                 continue;
             }
 
             /* Unknown ESC X: consume the second byte as a no-op so it is not
-             * fed to put_char() as a printable character. */
+             * fed to print_char() as a printable character. */
             i++;
             continue;
         }
@@ -2481,8 +2879,8 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
         {
             uint8_t b = buf[i++];
             if (state->utf8_len == 0 && b == 0x84) {
-                cancel_pending_wrap(state);
-                advance_row_with_scroll(state);
+                cancel_pending_wrap(t);
+                advance_row_with_scroll(t);
                 continue;
             }
             if (b == 0x0E) {  /* SO: invoke G1 into GL */
@@ -2507,32 +2905,33 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
             }
             if (state->utf8_len == 0 && b == 0x85) {
                 state->utf8_len = 0;
-                cancel_pending_wrap(state);
+                cancel_pending_wrap(t);
                 state->col = 0;
-                advance_row_with_scroll(state);
+                advance_row_with_scroll(t);
                 continue;
             }
             if (state->utf8_len == 0 && b == 0x88) {
                 state->utf8_len = 0;
-                if (tab_stops && state->col >= 0 && state->col < term_cols) {
-                    tab_stops[state->col] = 1;
+                if (t->tabs && state->col >= 0 && state->col < t->cols) {
+                    t->tabs[state->col] = 1;
                 }
                 continue;
             }
             if (state->utf8_len == 0 && b == 0x8D) {
                 state->utf8_len = 0;
-                reverse_index(state);
+                reverse_index(t);
                 continue;
             }
             if (state->utf8_len == 0 && b == 0x90) {
                 state->utf8_len = 0;
                 state->str_ignore_active = 1;
+                t->stats.str++;
                 state->str_ignore_esc_pending = 0;
                 continue;
             }
             if (state->utf8_len == 0 && b == 0x9B) {
                 size_t start = i - 1;
-                size_t q = i;
+                size_t q = (start == 0 && csi_resume > i) ? csi_resume : i;
 
                 while (q < buflen && !(buf[q] >= '@' && buf[q] <= '~')) {
                     q++;
@@ -2542,31 +2941,29 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
                     char seq_buf[CSI_PENDING_MAX + 4];
 
                     if (seq_len > CSI_PENDING_MAX) {
-                        seq_len = CSI_PENDING_MAX;
+                        i = q + 1;
+                        continue;
                     }
                     seq_buf[0] = '\033';
                     seq_buf[1] = '[';
                     if (seq_len > 1) {
                         memcpy(seq_buf + 2, buf + start + 1, seq_len - 1);
                     }
-                    handle_ansi_sequence(seq_buf, (int)(seq_len + 1), state, response_fn, response_ctx);
+                    TRACE_BEGIN(t_csi);
+                    t->stats.csi++;
+                    dispatch_sequence(t, seq_buf, (int)(seq_len + 1), response_fn, response_ctx);
+                    TRACE_END(t_csi, csi_trace_name((char)buf[q]), "seq", seq_len);
                     i = q + 1;
                     continue;
                 }
 
-                {
-                    size_t tail = buflen - start;
-                    if (tail > 0 && tail <= CSI_PENDING_MAX) {
-                        memcpy(state->csi_pending, buf + start, tail);
-                        state->csi_pending_len = (int)tail;
-                    }
-                }
+                csi_save_partial(state, buf + start, buflen - start);
                 break;
             }
             if (state->utf8_len == 0 && b == 0x9C) {
                 state->utf8_len = 0;
                 if (state->osc_active) {
-                    osc_finalize(state);
+                    osc_finalize(t);
                 }
                 state->str_ignore_active = 0;
                 state->str_ignore_esc_pending = 0;
@@ -2582,6 +2979,7 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
             if (state->utf8_len == 0 && (b == 0x9E || b == 0x9F)) {
                 state->utf8_len = 0;
                 state->str_ignore_active = 1;
+                t->stats.str++;
                 state->str_ignore_esc_pending = 0;
                 continue;
             }
@@ -2590,9 +2988,108 @@ void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *sta
                 response_fn((const uint8_t *)vtiden, strlen(vtiden), response_ctx);
                 continue;
             }
-            put_char((char)b, state);
+            print_char(t, (char)b);
         }
     }
+    TRACE_END(t_parse, "terminal_consume_bytes", "parse", len);
+}
+
+/*
+ * Input of any length (a replayed event, a paste) is parsed at most
+ * FEED_CHUNK bytes at a time, like separate reads, so a partial sequence
+ * carried between pieces always fits in the merge buffer.
+ */
+static void consume_bytes(Terminal *t, const uint8_t *bytes, size_t len,
+    terminal_response_fn response_fn, void *response_ctx) {
+    if (!bytes) {
+        return;
+    }
+    do {
+        size_t n = len < FEED_CHUNK ? len : FEED_CHUNK;
+
+        consume_chunk(t, bytes, n, response_fn, response_ctx);
+        bytes += n;
+        len -= n;
+    } while (len > 0);
+}
+
+static const uint8_t paste_start_marker[] = "\033[200~";
+static const uint8_t paste_end_marker[] = "\033[201~";
+#define PASTE_MARKER_LEN (sizeof(paste_end_marker) - 1)
+
+void terminal_paste_stream_begin(PasteStream *ps, int bracketed_mode) {
+    if (!ps) {
+        return;
+    }
+    ps->bracketed = bracketed_mode ? 1 : 0;
+    ps->started = 0;
+    ps->match = 0;
+}
+
+size_t terminal_paste_stream_feed(PasteStream *ps, const uint8_t *input, size_t input_len,
+    uint8_t *output, size_t output_cap) {
+    size_t offset = 0;
+
+    if (!ps || !output || (!input && input_len > 0)) {
+        return 0;
+    }
+    if (output_cap < input_len + PASTE_STREAM_SLACK) {
+        return 0;
+    }
+
+    if (!ps->bracketed) {
+        memcpy(output, input, input_len);
+        return input_len;
+    }
+
+    if (!ps->started) {
+        memcpy(output, paste_start_marker, PASTE_MARKER_LEN);
+        offset = PASTE_MARKER_LEN;
+        ps->started = 1;
+    }
+
+    for (size_t i = 0; i < input_len; i++) {
+        uint8_t b = input[i];
+
+        if (b == paste_end_marker[ps->match]) {
+            if (++ps->match == (int)PASTE_MARKER_LEN) {
+                ps->match = 0;  /* drop the embedded end marker */
+            }
+            continue;
+        }
+        /* Mismatch: release the held prefix, then retry b as a new start. */
+        if (ps->match > 0) {
+            memcpy(output + offset, paste_end_marker, (size_t)ps->match);
+            offset += (size_t)ps->match;
+            ps->match = 0;
+            if (b == paste_end_marker[0]) {
+                ps->match = 1;
+                continue;
+            }
+        }
+        output[offset++] = b;
+    }
+    return offset;
+}
+
+size_t terminal_paste_stream_end(PasteStream *ps, uint8_t *output, size_t output_cap) {
+    size_t offset = 0;
+
+    if (!ps || !output || output_cap < PASTE_STREAM_SLACK || !ps->bracketed) {
+        return 0;
+    }
+    if (!ps->started) {
+        memcpy(output, paste_start_marker, PASTE_MARKER_LEN);
+        offset = PASTE_MARKER_LEN;
+        ps->started = 1;
+    }
+    if (ps->match > 0) {
+        memcpy(output + offset, paste_end_marker, (size_t)ps->match);
+        offset += (size_t)ps->match;
+        ps->match = 0;
+    }
+    memcpy(output + offset, paste_end_marker, PASTE_MARKER_LEN);
+    return offset + PASTE_MARKER_LEN;
 }
 
 size_t terminal_format_paste_payload(const uint8_t *input, size_t input_len, int bracketed_mode,
@@ -2631,3 +3128,92 @@ size_t terminal_format_paste_payload(const uint8_t *input, size_t input_len, int
 
     return offset;
 }
+
+/* The Terminal a TerminalState is embedded in. */
+static Terminal *terminal_of(TerminalState *state) {
+    return (Terminal *)(void *)((char *)state - offsetof(Terminal, state));
+}
+
+void resize_terminal(int new_rows, int new_cols) {
+    resize_screen(&term_default, new_rows, new_cols);
+}
+
+void initialize_terminal_state(TerminalState *state) {
+    if (state) {
+        terminal_reset(terminal_of(state));
+    }
+}
+
+void terminal_consume_bytes(const uint8_t *bytes, size_t len, TerminalState *state,
+    terminal_response_fn response_fn, void *response_ctx) {
+    if (state) {
+        consume_bytes(terminal_of(state), bytes, len, response_fn, response_ctx);
+    }
+}
+
+void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
+    terminal_response_fn response_fn, void *response_ctx) {
+    if (state) {
+        dispatch_sequence(terminal_of(state), seq, len, response_fn, response_ctx);
+    }
+}
+
+void put_char(char c, TerminalState *state) {
+    if (state) {
+        print_char(terminal_of(state), c);
+    }
+}
+
+Terminal *terminal_create(int rows, int cols) {
+    Terminal *t = calloc(1, sizeof(*t));
+
+    if (!t) {
+        return NULL;
+    }
+    terminal_reset(t);
+    resize_screen(t, rows, cols);
+    if (!t->primary) {
+        terminal_destroy(t);
+        return NULL;
+    }
+    return t;
+}
+
+void terminal_destroy(Terminal *t) {
+    if (!t || t == &term_default) {
+        return;
+    }
+    free_working_set(t);
+    spill_close(t->spill);
+    free(t->blank_row);
+    free(t);
+}
+
+void terminal_feed(Terminal *t, const uint8_t *bytes, size_t len,
+    terminal_response_fn response_fn, void *response_ctx) {
+    consume_bytes(t, bytes, len, response_fn, response_ctx);
+}
+
+void terminal_resize(Terminal *t, int rows, int cols) {
+    resize_screen(t, rows, cols);
+}
+
+void terminal_size(Terminal *t, int *rows, int *cols) {
+    if (rows) *rows = t->rows;
+    if (cols) *cols = t->cols;
+}
+
+const TerminalCell *terminal_row(Terminal *t, int row) {
+    if (!t->screen || row < 0 || row >= t->rows) {
+        return NULL;
+    }
+    return t->screen[row];
+}
+
+const TerminalState *terminal_get_state(Terminal *t) {
+    return &t->state;
+}
+
+void terminal_get_parse_stats(Terminal *t, TermParseStats *out) {
+    *out = t->stats;
+}
@@ -6,8 +6,6 @@
 #include <stddef.h>
 #include <stdint.h>
 
-extern int term_rows;
-extern int term_cols;
 #define MAX_CHARS 4096
 
 #define MAX_UTF8_CHAR_SIZE 32  // UTF-8 bytes stored per cell cluster (base + combining marks)
@@ -93,6 +91,8 @@ typedef struct {
     /* Partial CSI across reads (e.g. 38;2;204;204;204m split) */
     uint8_t csi_pending[1024];
     int csi_pending_len;
+    /* Discarding a CSI too long to buffer, up to its final byte */
+    int csi_skip;
 
     // Selection tracking
     int sel_active;
@@ -117,6 +117,12 @@ typedef struct {
     /* DECSCNM (DEC private mode 5): global reverse video */
     int screen_reverse;
 
+    /* DECSET 2026: synchronized update open (BSU), drawing held until ESU */
+    int sync_update;
+    /* Updates closed by ESU so far, so the host sees an ESU even when a BSU
+     * follows it in the same read */
+    unsigned long sync_ends;
+
     /* Dynamic default colors set via OSC 10/11/12 (0=use palette default) */
     uint32_t osc_fg_color;  /* 0 = use default */
     uint32_t osc_bg_color;  /* 0 = use default */
@@ -138,17 +144,79 @@ typedef struct {
 } TerminalState;
 
 
-// Declare the global TerminalState variable
-extern TerminalState term_state;
+/* Per-row dirty flags: dirty_rows[r] = DIRTY_ROW_FULL means row r must be
+   redrawn; DIRTY_ROW_SPAN means only columns dirty_col_lo[r]..dirty_col_hi[r]
+   changed.  Allocated/resized alongside terminal_buffer in resize_terminal(). */
+#define DIRTY_ROW_CLEAN 0
+#define DIRTY_ROW_FULL  1
+#define DIRTY_ROW_SPAN  2
+
+/* Parser counters.  Always on: one add per call or per sequence.  esc counts
+   every ESC-introduced sequence (CSI/OSC/string ones too); a sequence split
+   across two reads is counted again when it is re-parsed. */
+typedef struct {
+    unsigned long long bytes;
+    unsigned long long esc;
+    unsigned long long csi;
+    unsigned long long osc;
+    unsigned long long str;   /* DCS/APC/PM/SOS (consumed and ignored) */
+} TermParseStats;
+
+/* Called for each line as it enters history (search indexing). */
+typedef void (*terminal_history_fn)(unsigned long long id, const TerminalCell *row, int cols, void *ctx);
 
-// Declare the terminal buffer with attributes
-extern TerminalCell **terminal_buffer;
+struct Spill;
+struct SpillView;
 
-/* Per-row dirty flags: dirty_rows[r] = 1 means row r must be redrawn.
-   Allocated/resized alongside terminal_buffer in resize_terminal(). */
-extern uint8_t *dirty_rows;
+/*
+ * One terminal: parser state, screens, scrollback, dirty spans and
+ * counters.  Every parser and screen function works on a Terminal passed
+ * to it, so separate instances share nothing and may be driven from
+ * different threads.  The host reads state (modes, cursor, title) and
+ * clears its notification flags (title_dirty, osc52_pending); the other
+ * fields belong to terminal_state.c.
+ */
+typedef struct Terminal {
+    TerminalState state;
+    int rows, cols;
+    TerminalCell **screen;      /* primary or alternate */
+    TerminalCell **primary;
+    TerminalCell **alternate;
+    unsigned char *tabs;
+    uint8_t *dirty;             /* DIRTY_ROW_* per row */
+    int *dirty_lo, *dirty_hi;
+    TerminalCell **history;     /* scrollback ring, rows allocated as they fill */
+    int history_rows;           /* rows allocated in history */
+    int history_head;           /* next insertion slot */
+    int history_count;          /* number of valid rows in history */
+    unsigned long long history_total;  /* lines ever pushed: id of screen row 0 */
+    terminal_history_fn history_hook;
+    void *history_hook_ctx;
+    struct Spill *spill;        /* lines older than the ring, on disk */
+    TermParseStats stats;
+    TerminalCell *blank_row;    /* erase template, see cells_blank() */
+    int blank_len, blank_cap;
+    uint32_t blank_fg, blank_bg;
+    uint16_t blank_attrs;
+} Terminal;
+
+/*
+ * The process's own terminal.  The renderer, input and search work on it
+ * through the names below; everything else takes a Terminal *.
+ */
+extern Terminal term_default;
+#define term_state       (term_default.state)
+#define term_rows        (term_default.rows)
+#define term_cols        (term_default.cols)
+#define terminal_buffer  (term_default.screen)
+#define dirty_rows       (term_default.dirty)
+#define dirty_col_lo     (term_default.dirty_lo)
+#define dirty_col_hi     (term_default.dirty_hi)
+#define term_parse_stats (term_default.stats)
 
 // Function prototypes
+/* The calls that predate Terminal.  resize_terminal() works on term_default;
+   the others on the Terminal holding state (normally &term_state). */
 void resize_terminal(int new_rows, int new_cols);
 void initialize_terminal_state(TerminalState *state);
 void reset_attributes(TerminalState *state);
@@ -159,11 +227,79 @@ void handle_ansi_sequence(const char *seq, int len, TerminalState *state,
 void put_char(char c, TerminalState *state);
 size_t terminal_format_paste_payload(const uint8_t *input, size_t input_len, int bracketed_mode,
     uint8_t *output, size_t output_cap);
+
+/* Streaming paste filter: wraps a paste delivered in chunks in bracketed
+   paste markers and strips any embedded end marker, even one split across
+   chunks.  Each feed emits at most len + PASTE_STREAM_SLACK bytes. */
+#define PASTE_STREAM_SLACK 32
+typedef struct {
+    int bracketed;
+    int started;
+    int match;      /* bytes of the end marker matched and held back */
+} PasteStream;
+void terminal_paste_stream_begin(PasteStream *ps, int bracketed_mode);
+size_t terminal_paste_stream_feed(PasteStream *ps, const uint8_t *input, size_t input_len,
+    uint8_t *output, size_t output_cap);
+size_t terminal_paste_stream_end(PasteStream *ps, uint8_t *output, size_t output_cap);
 void terminal_mark_all_rows_dirty(void);
+void terminal_mark_cells_dirty(int row, int c0, int c1);
 void terminal_scrollback_up(int n);
 void terminal_scrollback_down(int n);
 void terminal_scrollback_reset(void);
 int terminal_get_scrollback_offset(void);
+int terminal_history_lines(void);
+size_t terminal_history_bytes(void);   /* scrollback ring, allocated */
 const TerminalCell *terminal_get_visible_row(int visual_row);
 
+/* Lines are numbered from the first one ever scrolled off: history holds
+   ids terminal_history_total() - terminal_history_lines() up to
+   terminal_history_total() - 1, and screen row r is terminal_history_total() + r.
+   Visual row v shows line terminal_history_total() - scrollback offset + v. */
+unsigned long long terminal_history_total(void);
+/* The cells of line id (term_cols wide), or NULL if it has left history.
+   A spilled line is a spill_row() cache entry; see there for its lifetime. */
+const TerminalCell *terminal_line(unsigned long long id);
+/* Scroll back so line id is in view, centred where possible. */
+void terminal_scroll_to_line(unsigned long long id);
+void terminal_set_history_hook(terminal_history_fn fn, void *ctx);
+
+/* Unlimited scrollback: lines leaving the in-memory ring are kept in a
+   spill file in dir ($XDG_RUNTIME_DIR, else /tmp, when NULL) and paged back
+   on demand (spill.h).  The file is deleted on close unless keep is set.
+   Returns 0, or -1 with errno set. */
+int terminal_spill_open(const char *dir, int keep);
+void terminal_spill_close(void);
+/* Path of a kept spill file, else NULL. */
+const char *terminal_spill_path(void);
+/* Size of the spill file, including lines not yet written out. */
+unsigned long long terminal_spill_bytes(void);
+/* A view of the spilled lines for other threads (spill_view_open()); its
+   line 0 is the oldest history line.  NULL without a spill file. */
+struct SpillView *terminal_spill_view(void);
+
+/*
+ * Instance API (libcupidterm).  A Terminal owns everything it works on, so
+ * calls on different instances may run on different threads at once; calls
+ * on one instance must not overlap.  term_default is an instance too.
+ */
+
+/* NULL if out of memory. */
+Terminal *terminal_create(int rows, int cols);
+void terminal_destroy(Terminal *t);
+/* Back to a new 24x80 terminal: modes, screens and history are dropped (the
+   spill file and history hook stay). */
+void terminal_reset(Terminal *t);
+/* Parse output from the application, of any length; replies (DA, DSR, ...)
+   go to response_fn. */
+void terminal_feed(Terminal *t, const uint8_t *bytes, size_t len,
+    terminal_response_fn response_fn, void *response_ctx);
+void terminal_resize(Terminal *t, int rows, int cols);
+void terminal_size(Terminal *t, int *rows, int *cols);
+/* Screen row (0-based, scrollback not applied) or NULL when out of range.
+   Valid until the next feed, resize or destroy on t. */
+const TerminalCell *terminal_row(Terminal *t, int row);
+/* Modes, cursor, title; valid while t lives. */
+const TerminalState *terminal_get_state(Terminal *t);
+void terminal_get_parse_stats(Terminal *t, TermParseStats *out);
+
 #endif // TERMINAL_STATE_H
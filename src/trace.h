@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Timeline trace (make TRACE=1).
+ *
+ * Spans around PTY reads, parsing, escape sequence handling, drawing, font
+ * fallback loads and XFlush go into a fixed ring of events; the newest
+ * tracesize events are kept.  trace_dump() writes them as Chrome trace
+ * JSON, which chrome://tracing and ui.perfetto.dev open directly.
+ *
+ * The TRACE_* macros compile to nothing unless CUPID_TRACE is defined, so
+ * a normal build has no trace code on the hot path.  The ring itself is
+ * always built (it is small and the tests use it directly).
+ */
+
+typedef struct {
+    const char *name;       /* static strings only: stored by pointer */
+    const char *cat;
+    uint64_t ts_ns;         /* CLOCK_MONOTONIC start */
+    uint64_t dur_ns;
+    uint64_t arg;           /* bytes, codepoint, ... (shown as args.n) */
+    uint32_t tid;
+} TraceEvent;
+
+/* Allocate a ring of capacity events.  Returns 0, or -1 if out of memory. */
+int trace_init(size_t capacity);
+void trace_free(void);
+uint64_t trace_now(void);
+/* Record a span that started at start_ns and ends now.  Lock-free: any
+ * thread may record; a dump should not race with writers. */
+void trace_span(const char *name, const char *cat, uint64_t start_ns, uint64_t arg);
+/* Number of events held (at most the capacity) and the total recorded. */
+size_t trace_count(void);
+uint64_t trace_recorded(void);
+/* Write the held events, oldest first, as Chrome trace JSON.  Returns 0 on
+ * success, -1 with errno set on failure. */
+int trace_dump(const char *path);
+
+#ifdef CUPID_TRACE
+#define TRACE_BEGIN(t)                uint64_t t = trace_now()
+#define TRACE_END(t, name, cat, arg)  trace_span((name), (cat), (t), (uint64_t)(arg))
+#else
+#define TRACE_BEGIN(t)                do { } while (0)
+#define TRACE_END(t, name, cat, arg)  do { } while (0)
+#endif
+
+#endif /* TRACE_H */
@@ -9,34 +9,37 @@ unsigned int tabspaces = 8;
 char *vtiden = "\033[?6c";
 int allowwindowops = 1;  /* enable OSC 52 for unit tests */
 
+/* The terminal the tests drive; assertions read it as term_default. */
+static Terminal *const term = &term_default;
+
 static void failf(const char *message) {
     fprintf(stderr, "TEST FAILURE: %s\n", message);
     exit(EXIT_FAILURE);
 }
 
 void test_reset_terminal(int rows, int cols) {
-    initialize_terminal_state(&term_state);
+    terminal_reset(term);
     if (rows > 0 && cols > 0) {
-        resize_terminal(rows, cols);
+        terminal_resize(term, rows, cols);
     }
     term_state.row = 0;
     term_state.col = 0;
     /* Clear screen so tests don't see leftover from previous test (same-size resize skips realloc) */
     static const char ed2[] = "\x1b[2J";
-    terminal_consume_bytes((const uint8_t *)ed2, sizeof(ed2) - 1, &term_state, NULL, NULL);
+    terminal_feed(term, (const uint8_t *)ed2, sizeof(ed2) - 1, NULL, NULL);
     term_state.row = 0;
     term_state.col = 0;
 }
 
 void test_feed_bytes(const uint8_t *bytes, size_t len) {
-    terminal_consume_bytes(bytes, len, &term_state, NULL, NULL);
+    terminal_feed(term, bytes, len, NULL, NULL);
 }
 
 void test_feed_string(const char *s) {
     if (!s) {
         return;
     }
-    terminal_consume_bytes((const uint8_t *)s, strlen(s), &term_state, NULL, NULL);
+    terminal_feed(term, (const uint8_t *)s, strlen(s), NULL, NULL);
 }
 
 void test_assert_true(int condition, const char *message) {
@@ -0,0 +1,79 @@
+/*
+ * Streaming bracketed paste: markers are added once around the whole paste
+ * and embedded end markers are stripped even when split across chunks.
+ */
+#include <string.h>
+
+#include "../common/test_common.h"
+
+typedef struct {
+    uint8_t bytes[256];
+    size_t len;
+} PasteOut;
+
+static void feed(PasteStream *ps, PasteOut *out, const char *chunk) {
+    out->len += terminal_paste_stream_feed(ps, (const uint8_t *)chunk, strlen(chunk),
+                                           out->bytes + out->len, sizeof(out->bytes) - out->len);
+}
+
+static void finish(PasteStream *ps, PasteOut *out) {
+    out->len += terminal_paste_stream_end(ps, out->bytes + out->len, sizeof(out->bytes) - out->len);
+}
+
+static void assert_out(const PasteOut *out, const char *expected, const char *message) {
+    test_assert_true(out->len == strlen(expected), message);
+    test_assert_true(memcmp(out->bytes, expected, out->len) == 0, message);
+}
+
+int main(void) {
+    PasteStream ps;
+    PasteOut out;
+
+    /* Plain mode passes bytes through untouched */
+    memset(&out, 0, sizeof(out));
+    terminal_paste_stream_begin(&ps, 0);
+    feed(&ps, &out, "ls\x1b[201~");
+    finish(&ps, &out);
+    assert_out(&out, "ls\x1b[201~", "unbracketed paste is not filtered");
+
+    /* Bracketed: one prefix, one suffix across many chunks */
+    memset(&out, 0, sizeof(out));
+    terminal_paste_stream_begin(&ps, 1);
+    feed(&ps, &out, "SELECT 1;");
+    feed(&ps, &out, "\nSELECT 2;");
+    finish(&ps, &out);
+    assert_out(&out, "\x1b[200~SELECT 1;\nSELECT 2;\x1b[201~", "bracketed chunks");
+
+    /* Embedded end marker split across chunk boundaries is dropped */
+    memset(&out, 0, sizeof(out));
+    terminal_paste_stream_begin(&ps, 1);
+    feed(&ps, &out, "a\x1b[2");
+    feed(&ps, &out, "01~rm -rf\x1b");
+    feed(&ps, &out, "[201~b");
+    finish(&ps, &out);
+    assert_out(&out, "\x1b[200~arm -rfb\x1b[201~", "split end marker stripped");
+
+    /* A held partial match that turns out not to be a marker is released */
+    memset(&out, 0, sizeof(out));
+    terminal_paste_stream_begin(&ps, 1);
+    feed(&ps, &out, "x\x1b[20");
+    feed(&ps, &out, "0~\x1b\x1b[A");
+    finish(&ps, &out);
+    assert_out(&out, "\x1b[200~x\x1b[200~\x1b\x1b[A\x1b[201~", "partial match released");
+
+    /* Held bytes at the very end are flushed before the suffix */
+    memset(&out, 0, sizeof(out));
+    terminal_paste_stream_begin(&ps, 1);
+    feed(&ps, &out, "tail\x1b[2");
+    finish(&ps, &out);
+    assert_out(&out, "\x1b[200~tail\x1b[2\x1b[201~", "held tail flushed");
+
+    /* Empty bracketed paste still emits both markers */
+    memset(&out, 0, sizeof(out));
+    terminal_paste_stream_begin(&ps, 1);
+    finish(&ps, &out);
+    assert_out(&out, "\x1b[200~\x1b[201~", "empty paste");
+
+    test_print_ok("parser/paste_stream");
+    return 0;
+}
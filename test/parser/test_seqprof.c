@@ -0,0 +1,104 @@
+/*
+ * Control sequence profiler: keys, accumulation (from several threads at
+ * once too) and the sorted report.
+ * The parser hooks are only checked in SEQPROF=1 builds.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/test_common.h"
+#include "../../src/seqprof.h"
+
+static void test_keys(void) {
+    test_assert_true(seqprof_csi_class('?') == SEQPROF_CSI_Q, "? is DEC private");
+    test_assert_true(seqprof_csi_class('>') == SEQPROF_CSI_GT, "> class");
+    test_assert_true(seqprof_csi_class('1') == SEQPROF_CSI, "plain CSI");
+    test_assert_true(seqprof_osc_key("133;A", 5) == 133, "OSC number");
+    test_assert_true(seqprof_osc_key("0;title", 7) == 0, "OSC 0");
+    test_assert_true(seqprof_osc_key("99999;x", 7) == 255, "large OSC number is other");
+    test_assert_true(seqprof_osc_key(";x", 2) == 255, "missing OSC number is other");
+}
+
+static void test_report_sorted_by_time(void) {
+    char *out = NULL;
+    size_t len = 0;
+    FILE *fp;
+    const char *sgr, *decset, *osc;
+
+    seqprof_reset();
+    seqprof_note(SEQPROF_CSI, 'm', 6, 100);
+    seqprof_note(SEQPROF_CSI, 'm', 4, 100);
+    seqprof_note(SEQPROF_CSI_Q, 'h', 8, 1000);
+    seqprof_note(SEQPROF_OSC, 7, 30, 10);
+    test_assert_true(seqprof_entry(SEQPROF_CSI, 'm')->count == 2, "count accumulates");
+    test_assert_true(seqprof_entry(SEQPROF_CSI, 'm')->bytes == 10, "bytes accumulate");
+    test_assert_true(seqprof_entry(SEQPROF_CSI, 'm')->ticks == 200, "ticks accumulate");
+
+    fp = open_memstream(&out, &len);
+    seqprof_report(fp);
+    fclose(fp);
+    decset = strstr(out, "DECSET");
+    sgr = strstr(out, "SGR");
+    osc = strstr(out, "OSC 7");
+    test_assert_true(decset && sgr && osc, "all handlers reported");
+    test_assert_true(decset < sgr && sgr < osc, "sorted by total time");
+    test_assert_true(strstr(out, "CSI ? h") != NULL, "private class shown");
+    free(out);
+
+    seqprof_reset();
+    out = NULL;
+    fp = open_memstream(&out, &len);
+    seqprof_report(fp);
+    fclose(fp);
+    test_assert_true(len == 0, "empty profile prints nothing");
+    free(out);
+}
+
+#define NOTERS 4
+#define NOTES 100000
+
+static void *note_many(void *arg) {
+    (void)arg;
+    for (int i = 0; i < NOTES; i++)
+        seqprof_note(SEQPROF_CSI, 'H', 3, 2);
+    return NULL;
+}
+
+static void test_threads(void) {
+    pthread_t threads[NOTERS];
+    const SeqProfEntry *e;
+
+    seqprof_reset();
+    for (int i = 0; i < NOTERS; i++)
+        test_assert_true(pthread_create(&threads[i], NULL, note_many, NULL) == 0, "thread started");
+    for (int i = 0; i < NOTERS; i++)
+        pthread_join(threads[i], NULL);
+    e = seqprof_entry(SEQPROF_CSI, 'H');
+    test_assert_true(e->count == NOTERS * NOTES && e->bytes == 3ull * NOTERS * NOTES &&
+                     e->ticks == 2ull * NOTERS * NOTES, "no note lost between threads");
+    seqprof_reset();
+}
+
+static void test_parser_hooks(void) {
+#ifdef CUPID_SEQPROF
+    seqprof_reset();
+    test_reset_terminal(24, 80);
+    test_feed_string("\033[1;31mx\033[0m\033[?25l\033]2;t\007");
+    test_assert_true(seqprof_entry(SEQPROF_CSI, 'm')->count == 2, "SGR counted");
+    test_assert_true(seqprof_entry(SEQPROF_CSI, 'm')->bytes == 11, "SGR bytes");
+    test_assert_true(seqprof_entry(SEQPROF_CSI_Q, 'l')->count == 1, "DECRST counted");
+    test_assert_true(seqprof_entry(SEQPROF_OSC, 2)->count == 1, "OSC 2 counted");
+#endif
+}
+
+int main(void) {
+    test_keys();
+    test_report_sorted_by_time();
+    test_threads();
+    test_parser_hooks();
+    test_print_ok("parser/seqprof");
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Synchronized output (DECSET ?2026) and DECRQM mode reports.
+ */
+#include <string.h>
+
+#include "../common/test_common.h"
+
+typedef struct {
+    uint8_t bytes[64];
+    size_t len;
+} ResponseCapture;
+
+static void capture_response(const uint8_t *bytes, size_t len, void *ctx) {
+    ResponseCapture *cap = (ResponseCapture *)ctx;
+
+    if (!cap || !bytes) {
+        return;
+    }
+    if (len > sizeof(cap->bytes)) {
+        len = sizeof(cap->bytes);
+    }
+    memcpy(cap->bytes, bytes, len);
+    cap->len = len;
+}
+
+static void assert_query(const char *seq, const char *expected, const char *msg) {
+    ResponseCapture cap = {{0}, 0};
+
+    terminal_consume_bytes((const uint8_t *)seq, strlen(seq), &term_state, capture_response, &cap);
+    test_assert_true(cap.len == strlen(expected), msg);
+    test_assert_true(memcmp(cap.bytes, expected, cap.len) == 0, msg);
+}
+
+int main(void) {
+    test_reset_terminal(4, 10);
+    test_assert_mode("sync_update", term_state.sync_update, 0);
+    assert_query("\x1b[?2026$p", "\x1b[?2026;2$y", "?2026 reports reset");
+
+    /* BSU/ESU toggle the flag; content written meanwhile is still parsed */
+    test_feed_string("\x1b[?2026hAB");
+    test_assert_mode("sync_update", term_state.sync_update, 1);
+    test_assert_cell(0, 1, "B", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+    assert_query("\x1b[?2026$p", "\x1b[?2026;1$y", "?2026 reports set");
+    test_feed_string("\x1b[?2026l");
+    test_assert_mode("sync_update", term_state.sync_update, 0);
+
+    /* ESU then BSU in one read: the flag ends up set, the count shows the end */
+    {
+        unsigned long ends = term_state.sync_ends;
+
+        test_feed_string("\x1b[?2026hA\x1b[?2026l\x1b[?2026hB\x1b[?2026l\x1b[?2026h");
+        test_assert_mode("sync_update reopened", term_state.sync_update, 1);
+        test_assert_true(term_state.sync_ends == ends + 2, "each ESU counted");
+        test_feed_string("\x1b[?2026l\x1b[?2026l");
+        test_assert_true(term_state.sync_ends == ends + 3, "ESU without BSU not counted");
+    }
+
+    /* BSU split across reads */
+    test_feed_string("\x1b[?20");
+    test_feed_string("26h");
+    test_assert_mode("sync_update split", term_state.sync_update, 1);
+    test_feed_string("\x1b" "c");
+    test_assert_mode("sync_update after RIS", term_state.sync_update, 0);
+
+    /* Other DEC private modes */
+    test_reset_terminal(4, 10);
+    assert_query("\x1b[?25$p", "\x1b[?25;1$y", "?25 reports set");
+    test_feed_string("\x1b[?25l\x1b[?2004h");
+    assert_query("\x1b[?25$p", "\x1b[?25;2$y", "?25 reports reset");
+    assert_query("\x1b[?2004$p", "\x1b[?2004;1$y", "?2004 reports set");
+    assert_query("\x1b[?9999$p", "\x1b[?9999;0$y", "unknown private mode");
+
+    /* ANSI modes */
+    assert_query("\x1b[4$p", "\x1b[4;2$y", "IRM reports reset");
+    test_feed_string("\x1b[4h");
+    assert_query("\x1b[4$p", "\x1b[4;1$y", "IRM reports set");
+    assert_query("\x1b[3$p", "\x1b[3;0$y", "unknown ANSI mode");
+
+    /* DECRQM is not a cursor/erase command */
+    test_assert_cursor(0, 0);
+
+    test_print_ok("parser/sync_decrqm");
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * --daemon / --client plumbing: the request survives the wire, the forked
+ * child runs in the client's directory and environment with its arguments,
+ * and the client returns only once the child reports its window is up.
+ * Neither side trusts a socket in a directory other users can write.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../src/daemon.h"
+
+static void fail(const char *msg) {
+    fprintf(stderr, "TEST FAILURE: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+static char dir[] = "/tmp/cupid-daemon-XXXXXX";
+
+/* The "window": checks what arrived, then signals readiness unless told not to. */
+static int fake_window(int argc, char *argv[]) {
+    char cwd[PATH_MAX];
+
+    if (argc != 3 || strcmp(argv[1], "-e") != 0 || strcmp(argv[2], "true") != 0) {
+        if (argc == 2 && strcmp(argv[1], "fail") == 0)
+            return 3;           /* exits without a first frame */
+        return 1;
+    }
+    if (!getcwd(cwd, sizeof(cwd)) || strcmp(cwd, dir) != 0)
+        return 1;
+    /* The client's environment, not the daemon's. */
+    if (!getenv("LANG") || strcmp(getenv("LANG"), "xx_YY.UTF-8") != 0 ||
+        getenv("CUPID_DAEMON_ONLY") != NULL)
+        return 1;
+    daemon_window_ready();
+    daemon_window_ready();      /* second call is a no-op */
+    return 0;
+}
+
+static void test_wire(void) {
+    char buf[256];
+    char *args[] = { "cupidterminal", "-e", "sh", "-c", "", NULL };
+    char *env[] = { "TERM=xterm", "LANG=C.UTF-8", "noequals", "=x", "EMPTY=", NULL };
+    char *cwd;
+    char **argv, **envp;
+    size_t len;
+    int argc;
+
+    len = daemon_encode(buf, sizeof(buf), "/home/x", env, 5, args);
+    if (len == 0)
+        fail("request encodes");
+    argv = daemon_decode(buf, len, &cwd, &envp, &argc);
+    if (!argv || argc != 5 || strcmp(cwd, "/home/x") != 0)
+        fail("request decodes");
+    if (strcmp(argv[2], "sh") != 0 || argv[4][0] != '\0' || argv[5] != NULL)
+        fail("arguments keep order, empty strings and the terminator");
+    if (!envp[0] || strcmp(envp[0], "TERM=xterm") != 0 || strcmp(envp[1], "LANG=C.UTF-8") != 0 ||
+        strcmp(envp[2], "EMPTY=") != 0 || envp[3] != NULL)
+        fail("environment entries kept, malformed ones dropped");
+    free(argv);
+
+    len = daemon_encode(buf, sizeof(buf), "", NULL, 1, args);
+    argv = daemon_decode(buf, len, &cwd, &envp, &argc);
+    if (!argv || argc != 1 || envp[0] != NULL)
+        fail("empty environment");
+    free(argv);
+
+    if (daemon_encode(buf, 8, "/home/x", env, 5, args) != 0)
+        fail("oversized request refused");
+    if (daemon_decode(buf, 3, &cwd, &envp, &argc) != NULL)
+        fail("truncated request rejected");
+    memcpy(buf, "/\0A=1\0B\0\0x", 11);
+    if (daemon_decode(buf, 11, &cwd, &envp, &argc) != NULL)
+        fail("environment entry without '=' rejected");
+}
+
+static void test_socket_path(void) {
+    char path[128], want[128];
+
+    setenv("XDG_RUNTIME_DIR", "/run/user/7", 1);
+    if (daemon_socket_path(path, sizeof(path), "host:0.0") != 0 ||
+        strcmp(path, "/run/user/7/cupidterminal-host_0.0.sock") != 0)
+        fail("socket named after the display");
+    if (daemon_socket_path(path, 10, ":0") != -1)
+        fail("path that does not fit");
+    unsetenv("XDG_RUNTIME_DIR");
+    snprintf(want, sizeof(want), "/tmp/cupidterminal-%ld/_0.sock", (long)getuid());
+    if (daemon_socket_path(path, sizeof(path), NULL) != 0 || strcmp(path, want) != 0)
+        fail("without XDG_RUNTIME_DIR: a per-user directory in /tmp");
+}
+
+static void test_round_trip(void) {
+    char sock[256], file[256];
+    char *ok_args[] = { "cupidterminal", "-e", "true", NULL };
+    char *fail_args[] = { "cupidterminal", "fail", NULL };
+    struct timespec pause = { 0, 10000000 };
+    pid_t server;
+    int rc = 1;
+    int fd;
+
+    if (!mkdtemp(dir))
+        fail("temp dir");
+    snprintf(sock, sizeof(sock), "%s/d.sock", dir);
+    if (daemon_client(sock, 3, ok_args) != 1)
+        fail("no daemon: client fails");
+
+    server = fork();
+    if (server == 0) {
+        setenv("CUPID_DAEMON_ONLY", "1", 1);
+        daemon_serve(sock, fake_window);
+        _exit(2);
+    }
+    for (int tries = 0; tries < 200 && access(sock, F_OK) != 0; tries++)
+        nanosleep(&pause, NULL);
+
+    if (chdir(dir) != 0)
+        fail("enter temp dir");
+    setenv("LANG", "xx_YY.UTF-8", 1);
+    for (int tries = 0; tries < 50 && rc != 0; tries++) {
+        rc = daemon_client(sock, 3, ok_args);
+        if (rc != 0)
+            nanosleep(&pause, NULL);   /* bound but not yet listening */
+    }
+    if (rc != 0)
+        fail("window reports ready");
+    if (daemon_client(sock, 3, ok_args) != 0)
+        fail("second window from the same daemon");
+    if (daemon_client(sock, 2, fail_args) != 1)
+        fail("window that never drew: client fails");
+    if (daemon_serve(sock, fake_window) != -1)
+        fail("second daemon on a live socket refused");
+
+    /* The environment only goes to a socket nobody else could have made. */
+    if (chmod(dir, 0733) != 0)
+        fail("open up the temp dir");
+    if (daemon_client(sock, 3, ok_args) != 1)
+        fail("socket in a directory others can write: client refuses");
+    if (daemon_serve(sock, fake_window) != -1 || errno != EACCES)
+        fail("daemon refuses a shared directory");
+    if (chmod(dir, 0700) != 0)
+        fail("close the temp dir");
+    snprintf(file, sizeof(file), "%s/file.sock", dir);
+    fd = open(file, O_CREAT | O_WRONLY, 0600);
+    if (fd < 0)
+        fail("plain file");
+    close(fd);
+    if (daemon_client(file, 3, ok_args) != 1)
+        fail("client refuses a path that is not a socket");
+    if (daemon_serve(file, fake_window) != -1 || errno != EEXIST)
+        fail("daemon leaves a file on its path alone");
+    unlink(file);
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    unlink(sock);
+    if (chdir("/") != 0 || rmdir(dir) != 0)
+        fail("cleanup");
+}
+
+int main(void) {
+    test_wire();
+    test_socket_path();
+    test_round_trip();
+    printf("PASS: pty/daemon\n");
+    return 0;
+}
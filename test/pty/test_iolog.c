@@ -0,0 +1,100 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../src/iolog.h"
+
+static void fail(const char *msg) {
+    fprintf(stderr, "TEST FAILURE: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+static size_t slurp(const char *path, char *buf, size_t cap) {
+    FILE *fp = fopen(path, "rb");
+    size_t n;
+
+    if (!fp) fail("log file missing");
+    n = fread(buf, 1, cap - 1, fp);
+    buf[n] = '\0';
+    fclose(fp);
+    return n;
+}
+
+static void test_raw_tee(const char *path) {
+    static const char a[] = "hello \033[1mworld\033[0m\r\n";
+    static const char b[] = "\xe2\x94\x80 second chunk";
+    char got[256];
+    IologStats st;
+
+    if (iolog_open(path, IOLOG_RAW, 0, "xterm-256color", 24, 80) != 0) fail("raw open");
+    iolog_write((const uint8_t *)a, sizeof(a) - 1);
+    iolog_resize(30, 100); /* no effect on raw logs */
+    iolog_write((const uint8_t *)b, sizeof(b) - 1);
+    iolog_close();
+    if (slurp(path, got, sizeof(got)) != sizeof(a) + sizeof(b) - 2) fail("raw length");
+    if (memcmp(got, a, sizeof(a) - 1) != 0 || strcmp(got + sizeof(a) - 1, b) != 0)
+        fail("raw bytes copied verbatim");
+    iolog_get_stats(&st);
+    if (st.bytes_written != sizeof(a) + sizeof(b) - 2 || st.drops != 0) fail("raw stats");
+}
+
+static void test_asciicast(const char *path) {
+    /* A box-drawing character split across two reads must not be mangled. */
+    static const char a[] = "\033[31m\"q\"\\\xe2\x94";
+    static const char b[] = "\x80\xff\n";
+    char got[1024];
+
+    if (iolog_open(path, IOLOG_ASCIICAST, 0, "cupidterminal-256color", 24, 80) != 0)
+        fail("cast open");
+    iolog_write((const uint8_t *)a, sizeof(a) - 1);
+    iolog_write((const uint8_t *)b, sizeof(b) - 1);
+    iolog_resize(30, 100);
+    iolog_close();
+    slurp(path, got, sizeof(got));
+    if (strncmp(got, "{\"version\": 2, \"width\": 80, \"height\": 24,", 41) != 0)
+        fail("asciicast v2 header");
+    if (!strstr(got, "\"TERM\": \"cupidterminal-256color\"")) fail("TERM in header");
+    if (!strstr(got, ", \"o\", \"\\u001b[31m\\\"q\\\"\\\\\"]\n")) fail("escaped first event");
+    if (!strstr(got, ", \"o\", \"\xe2\x94\x80\\ufffd\\u000a\"]\n")) fail("UTF-8 carried, invalid byte replaced");
+    if (!strstr(got, ", \"r\", \"100x30\"]\n")) fail("resize event");
+}
+
+/* A FIFO nobody reads: the writer blocks in open() and the ring fills up.
+ * Output must be dropped and counted, never block the caller. */
+static void test_overflow_drops(const char *fifo) {
+    static uint8_t chunk[16384];
+    IologStats st;
+
+    if (mkfifo(fifo, 0600) != 0) fail("mkfifo");
+    if (iolog_open(fifo, IOLOG_RAW, 0, "xterm-256color", 24, 80) != 0) fail("fifo open");
+    memset(chunk, 'x', sizeof(chunk));
+    for (int i = 0; i < 64; i++)
+        iolog_write(chunk, sizeof(chunk));
+    iolog_get_stats(&st);
+    if (st.drops == 0 || st.bytes_dropped == 0) fail("overflow counted");
+    if (st.bytes_in + st.bytes_dropped != 64ull * sizeof(chunk)) fail("every byte accounted for");
+    iolog_close(); /* writer still in open(): must not hang */
+    unlink(fifo);
+}
+
+int main(void) {
+    char dir[] = "/tmp/cupid_iolog_XXXXXX";
+    char path[128];
+
+    if (!mkdtemp(dir)) fail("mkdtemp");
+    snprintf(path, sizeof(path), "%s/raw.log", dir);
+    test_raw_tee(path);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/session.cast", dir);
+    test_asciicast(path);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/fifo", dir);
+    test_overflow_drops(path);
+    rmdir(dir);
+    printf("PASS: pty/iolog\n");
+    return EXIT_SUCCESS;
+}
@@ -9,6 +9,11 @@
 
 #include "../../src/pty_session.h"
 
+/* Globals pty_session.c expects from main.c */
+char *utmp = NULL;
+char *scroll = NULL;
+char *stty_args = NULL;
+
 static void fail(const char *msg) {
     fprintf(stderr, "TEST FAILURE: %s\n", msg);
     exit(EXIT_FAILURE);
@@ -22,6 +27,7 @@ static void sleep_10ms(void) {
 }
 
 int main(void) {
+    char *sh_args[] = { "/bin/sh", NULL };
     PtySession session = {
         .master_fd = -1,
         .child_pid = -1,
@@ -32,7 +38,7 @@ int main(void) {
     int status = 0;
     int reaped = 0;
 
-    if (pty_session_spawn(&session, "/bin/sh", "xterm-256color") == -1) {
+    if (pty_session_spawn(&session, NULL, "/bin/sh", sh_args, "xterm-256color") == -1) {
         fail("pty_session_spawn failed");
     }
 
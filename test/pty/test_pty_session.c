@@ -12,6 +12,11 @@
 
 #include "../../src/pty_session.h"
 
+/* Globals pty_session.c expects from main.c */
+char *utmp = NULL;
+char *scroll = NULL;
+char *stty_args = NULL;
+
 static void die(const char *msg) {
     perror(msg);
     exit(EXIT_FAILURE);
@@ -25,6 +30,7 @@ static void sleep_10ms(void) {
 }
 
 int main(void) {
+    char *cat_args[] = { "/bin/cat", NULL };
     PtySession session = { .master_fd = -1, .child_pid = -1 };
     const char *payload = "phase1-pty-check\n";
     const char *marker = "phase1-pty-check";
@@ -34,7 +40,7 @@ int main(void) {
     struct winsize ws;
     int reaped = 0;
 
-    if (pty_session_spawn(&session, "/bin/cat", "xterm-256color") == -1) {
+    if (pty_session_spawn(&session, NULL, "/bin/cat", cat_args, "xterm-256color") == -1) {
         die("pty_session_spawn");
     }
 
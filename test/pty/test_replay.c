@@ -0,0 +1,109 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/iolog.h"
+#include "../../src/replay.h"
+
+static void fail(const char *msg) {
+    fprintf(stderr, "TEST FAILURE: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+static void write_file(const char *path, const char *data) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) fail("cannot create fixture");
+    fputs(data, fp);
+    fclose(fp);
+}
+
+static void test_raw_chunks(const char *path) {
+    Replay r;
+
+    write_file(path, "0123456789abcdefghij");
+    if (replay_load(path, 8, &r) != 0) fail("raw load");
+    if (r.timed || r.count != 3 || r.total != 20) fail("raw split into read-sized chunks");
+    if (r.chunks[2].len != 4 || memcmp(r.chunks[2].data, "ghij", 4) != 0) fail("raw tail chunk");
+    replay_free(&r);
+}
+
+static void test_asciicast_decode(const char *path) {
+    Replay r;
+
+    write_file(path,
+               "{\"version\": 2, \"width\": 80, \"height\": 24}\n"
+               "[0.5, \"o\", \"\\u001b[1mA\\\"\\\\\\n\"]\n"
+               "[0.75, \"i\", \"typed\"]\n"
+               "[1.0, \"r\", \"100x30\"]\n"
+               "[1.25, \"o\", \"\\u2500\\ud83d\\ude00\xc3\xa9\"]\n");
+    if (replay_load(path, 4096, &r) != 0) fail("cast load");
+    if (!r.timed || r.count != 2) fail("only output events kept");
+    if (r.chunks[0].t != 0.5 || r.chunks[1].t != 1.25) fail("timestamps kept");
+    if (r.chunks[0].len != 8 || memcmp(r.chunks[0].data, "\033[1mA\"\\\n", 8) != 0)
+        fail("escapes decoded");
+    if (r.chunks[1].len != 9 ||
+        memcmp(r.chunks[1].data, "\xe2\x94\x80\xf0\x9f\x98\x80\xc3\xa9", 9) != 0)
+        fail("\\u escapes and surrogate pairs become UTF-8");
+    replay_free(&r);
+}
+
+/* What -O records, --replay plays back byte for byte. */
+static void test_round_trip(const char *path) {
+    static const char a[] = "\033[38;2;1;2;3mred\033[0m\r\n\xe2\x94";
+    static const char b[] = "\x80 tail\x07";
+    Replay r;
+    size_t off = 0;
+    char got[64];
+
+    if (iolog_open(path, IOLOG_ASCIICAST, 0, "xterm-256color", 24, 80) != 0) fail("iolog open");
+    iolog_write((const uint8_t *)a, sizeof(a) - 1);
+    iolog_write((const uint8_t *)b, sizeof(b) - 1);
+    iolog_close();
+    if (replay_load(path, 4096, &r) != 0) fail("replay own recording");
+    for (size_t i = 0; i < r.count; i++) {
+        memcpy(got + off, r.chunks[i].data, r.chunks[i].len);
+        off += r.chunks[i].len;
+    }
+    if (off != sizeof(a) + sizeof(b) - 2 || memcmp(got, a, sizeof(a) - 1) != 0 ||
+        memcmp(got + sizeof(a) - 1, b, sizeof(b) - 1) != 0)
+        fail("recording round-trips");
+    replay_free(&r);
+}
+
+static void test_stats(void) {
+    ReplayStats st = { 0 };
+    char out[512];
+    FILE *fp = fmemopen(out, sizeof(out), "w");
+
+    for (int i = 1; i <= 200; i++)
+        replay_stats_note_frame(&st, i == 200 ? 50.0 : 1.0);
+    st.bytes = 1000000;
+    st.wall_ms = 1000.0;
+    replay_stats_report(&st, fp);
+    fclose(fp);
+    if (!strstr(out, "200 frames")) fail("frame count reported");
+    if (!strstr(out, "p99 1.000 ms, max 50.000 ms")) fail("p99 excludes the single outlier");
+    if (!strstr(out, "(1.00 MB/s)")) fail("throughput reported");
+    replay_stats_free(&st);
+}
+
+int main(void) {
+    char dir[] = "/tmp/cupid_replay_XXXXXX";
+    char path[128];
+
+    if (!mkdtemp(dir)) fail("mkdtemp");
+    snprintf(path, sizeof(path), "%s/stream.raw", dir);
+    test_raw_chunks(path);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/stream.cast", dir);
+    test_asciicast_decode(path);
+    test_round_trip(path);
+    unlink(path);
+    rmdir(dir);
+    test_stats();
+    printf("PASS: pty/replay\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+/*
+ * Procedural box drawing: every handled code point stays inside its cell,
+ * lines reach the cell edges they connect to, and the frontend batches
+ * such cells into one rect call per colour instead of glyphs.
+ */
+#include <string.h>
+
+#include "../common/test_common.h"
+#include "../../src/boxdraw.h"
+
+static RenderRect rects[BOXDRAW_MAX_RECTS];
+
+static int covered(int n, int px, int py) {
+    for (int i = 0; i < n; i++) {
+        if (px >= rects[i].x && px < rects[i].x + rects[i].w &&
+            py >= rects[i].y && py < rects[i].y + rects[i].h)
+            return 1;
+    }
+    return 0;
+}
+
+/* Rows (or columns) of the edge that carry the line. */
+static int edge_hits(int n, int x, int y, int w, int h, char edge) {
+    int hits = 0;
+
+    for (int i = 0; i < (edge == 'l' || edge == 'r' ? h : w); i++) {
+        switch (edge) {
+        case 'l': hits += covered(n, x, y + i); break;
+        case 'r': hits += covered(n, x + w - 1, y + i); break;
+        case 'u': hits += covered(n, x + i, y); break;
+        default:  hits += covered(n, x + i, y + h - 1); break;
+        }
+    }
+    return hits;
+}
+
+static void test_inside_cell(void) {
+    static const int sizes[][2] = { { 1, 1 }, { 5, 9 }, { 7, 15 }, { 8, 16 }, { 13, 27 }, { 30, 61 } };
+    int ok = 1;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int w = sizes[s][0], h = sizes[s][1];
+
+        for (uint32_t cp = 0x2500; cp < 0x2900; cp++) {
+            int shade;
+            int n;
+
+            if (!boxdraw_handles(cp, 1))
+                continue;
+            n = boxdraw_rects(cp, 100, 200, w, h, rects, &shade);
+            /* Sub-pixel parts of a 1x1 cell may vanish; U+2800 is blank. */
+            ok &= (n > 0 || w < 5 || cp == 0x2800) && n <= BOXDRAW_MAX_RECTS;
+            for (int i = 0; i < n; i++) {
+                ok &= rects[i].w > 0 && rects[i].h > 0;
+                ok &= rects[i].x >= 100 && rects[i].x + rects[i].w <= 100 + w;
+                ok &= rects[i].y >= 200 && rects[i].y + rects[i].h <= 200 + h;
+            }
+        }
+    }
+    test_assert_true(ok, "every procedural glyph is non-empty and inside its cell");
+    test_assert_true(!boxdraw_handles(0x2571, 1) && !boxdraw_handles(0x25A0, 1),
+                     "diagonals and geometric shapes stay with the font");
+    test_assert_true(!boxdraw_handles(0x28FF, 0) && boxdraw_handles(0x2588, 0),
+                     "Braille only when enabled");
+}
+
+static void test_lines_meet_edges(void) {
+    int shade;
+    int n;
+
+    n = boxdraw_rects(0x2500, 0, 0, 8, 16, rects, &shade);          /* ─ */
+    for (int x = 0; x < 8; x++)
+        test_assert_true(covered(n, x, 7), "horizontal line is continuous");
+    test_assert_true(edge_hits(n, 0, 0, 8, 16, 'u') == 0, "horizontal line leaves the top free");
+
+    n = boxdraw_rects(0x253C, 0, 0, 8, 16, rects, &shade);          /* ┼ */
+    test_assert_true(edge_hits(n, 0, 0, 8, 16, 'l') == 1 && edge_hits(n, 0, 0, 8, 16, 'r') == 1 &&
+                     edge_hits(n, 0, 0, 8, 16, 'u') == 1 && edge_hits(n, 0, 0, 8, 16, 'd') == 1,
+                     "light cross reaches all four edges one pixel wide");
+
+    n = boxdraw_rects(0x250C, 0, 0, 8, 16, rects, &shade);          /* ┌ */
+    test_assert_true(edge_hits(n, 0, 0, 8, 16, 'l') == 0 && edge_hits(n, 0, 0, 8, 16, 'u') == 0 &&
+                     edge_hits(n, 0, 0, 8, 16, 'r') == 1 && edge_hits(n, 0, 0, 8, 16, 'd') == 1,
+                     "corner reaches only its two edges");
+
+    n = boxdraw_rects(0x2554, 0, 0, 24, 48, rects, &shade);         /* ╔ */
+    test_assert_true(edge_hits(n, 0, 0, 24, 48, 'r') == 2 * 3 && edge_hits(n, 0, 0, 24, 48, 'd') == 2 * 3,
+                     "double corner has two lines on each edge");
+    test_assert_true(!covered(n, 12, 24 + 2), "double corner leaves its inner gap open");
+
+    n = boxdraw_rects(0x2501, 0, 0, 16, 32, rects, &shade);         /* ━ */
+    test_assert_true(edge_hits(n, 0, 0, 16, 32, 'l') == 4, "heavy line is twice as thick");
+
+    n = boxdraw_rects(0x2504, 0, 0, 12, 16, rects, &shade);         /* ┄ */
+    test_assert_true(n == 3 && edge_hits(n, 0, 0, 12, 16, 'r') == 0, "triple dash has three gaps");
+}
+
+static void test_blocks_and_braille(void) {
+    int shade;
+    int n;
+
+    n = boxdraw_rects(0x2588, 3, 4, 8, 16, rects, &shade);          /* █ */
+    test_assert_true(n == 1 && rects[0].x == 3 && rects[0].y == 4 && rects[0].w == 8 && rects[0].h == 16,
+                     "full block fills the cell");
+    n = boxdraw_rects(0x2584, 0, 0, 8, 16, rects, &shade);          /* ▄ */
+    test_assert_true(n == 1 && rects[0].y == 8 && rects[0].h == 8, "lower half block");
+    n = boxdraw_rects(0x2592, 0, 0, 8, 16, rects, &shade);          /* ▒ */
+    test_assert_true(n == 1 && shade == 2, "medium shade is one half-mixed rect");
+    n = boxdraw_rects(0x259A, 0, 0, 8, 16, rects, &shade);          /* ▚ */
+    test_assert_true(n == 2 && covered(n, 0, 0) && covered(n, 7, 15) && !covered(n, 7, 0),
+                     "diagonal quadrants");
+
+    n = boxdraw_rects(0x28FF, 0, 0, 8, 16, rects, &shade);          /* ⣿ */
+    test_assert_true(n == 8, "all eight Braille dots");
+    n = boxdraw_rects(0x2841, 0, 0, 8, 16, rects, &shade);          /* dots 1 and 7 */
+    test_assert_true(n == 2 && rects[0].x < 4 && rects[1].x < 4 && rects[0].y < 4 && rects[1].y >= 12,
+                     "Braille dots 1 and 7 in the left column, top and bottom");
+
+    test_assert_true(boxdraw_cell_cp("\xe2\x94\x80") == 0x2500 &&
+                     boxdraw_cell_cp("\xe2\xa3\xbf") == 0x28FF, "cell text decodes");
+    test_assert_true(boxdraw_cell_cp("\xe2\x94\x80\xcc\x81") == 0 && boxdraw_cell_cp("x") == 0 &&
+                     boxdraw_cell_cp("\xe2\x82\xac") == 0, "combining marks and other text stay glyphs");
+}
+
+static void test_frontend_batches(void) {
+    RenderBackend be;
+    RenderRecorder rec;
+    RenderParams params;
+    int rect_ops = 0, glyph_ops = 0;
+
+    test_reset_terminal(4, 10);
+    memset(&params, 0, sizeof(params));
+    params.width = 80;
+    params.height = 64;
+    params.cell_w = 8;
+    params.cell_h = 16;
+    params.ascent = 12;
+    params.boxdraw = 1;
+    params.boxdraw_braille = 1;
+    render_recorder_init(&be, &rec);
+    test_feed_string("\xe2\x94\x8c\xe2\x94\x80\xe2\x94\x80\xe2\xa3\xbf\xe2\x94\x90" "ab\x1b[31m\xe2\x96\x88");
+    render_invalidate();
+    render_frame(&be, &params);
+    for (size_t i = 0; i < rec.count; i++) {
+        if (rec.ops[i].kind == RENDER_OP_RECTS) {
+            rect_ops++;
+            if (rect_ops == 1)
+                test_assert_true(rec.ops[i].x < 8 && rec.ops[i].x + rec.ops[i].w > 32 &&
+                                 rec.ops[i].color == COLOR_DEFAULT_FG,
+                                 "five box cells in one default-colour batch");
+            else
+                test_assert_true(rec.ops[i].color == 1 && rec.ops[i].count == 1, "red block batched separately");
+        } else if (rec.ops[i].kind == RENDER_OP_GLYPHS) {
+            glyph_ops++;
+            test_assert_true(strcmp(rec.ops[i].text, "ab") == 0, "only the letters are glyphs");
+        }
+    }
+    test_assert_true(rect_ops == 2 && glyph_ops == 1, "two rect batches and one glyph run");
+
+    params.boxdraw = 0;
+    render_recorder_reset(&rec);
+    render_invalidate();
+    render_frame(&be, &params);
+    test_assert_true(rec.totals[RENDER_OP_RECTS] == 2, "boxdraw off draws no rect batches");
+    render_recorder_free(&rec);
+}
+
+int main(void) {
+    test_inside_cell();
+    test_lines_meet_edges();
+    test_blocks_and_braille();
+    test_frontend_batches();
+    test_print_ok("render/boxdraw");
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Background fallback matching: results arrive through the wake-up pipe and
+ * are handed out on the calling thread; results for replaced patterns are
+ * dropped.  Works without installed fonts (the match may then be NULL).
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <sys/select.h>
+
+#include "../common/test_common.h"
+#include "../../src/font_resolve.h"
+
+static uint32_t seen[16];
+static int seen_len;
+
+static void collect(uint32_t cp, uint8_t style, FcPattern *match, void *ctx) {
+    (void)style;
+    (*(int *)ctx)++;
+    if (seen_len < 16)
+        seen[seen_len++] = cp;
+    if (match)
+        FcPatternDestroy(match);
+}
+
+static int was_seen(uint32_t cp) {
+    for (int i = 0; i < seen_len; i++) {
+        if (seen[i] == cp)
+            return 1;
+    }
+    return 0;
+}
+
+/* Drain until cp shows up or ten seconds pass. */
+static int wait_for(uint32_t cp) {
+    for (int tries = 0; tries < 100 && !was_seen(cp); tries++) {
+        int fd = font_resolve_fd();
+        struct timeval tv = { 0, 100000 };
+        fd_set fds;
+        int calls = 0;
+
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        select(fd + 1, &fds, NULL, NULL, &tv);
+        font_resolve_drain(collect, &calls);
+    }
+    return was_seen(cp);
+}
+
+static void make_patterns(FcPattern *pats[FONT_RESOLVE_STYLES], const char *name) {
+    for (int s = 0; s < FONT_RESOLVE_STYLES; s++)
+        pats[s] = FcNameParse((const FcChar8 *)name);
+}
+
+static void free_patterns(FcPattern *pats[FONT_RESOLVE_STYLES]) {
+    for (int s = 0; s < FONT_RESOLVE_STYLES; s++)
+        FcPatternDestroy(pats[s]);
+}
+
+int main(void) {
+    FcPattern *pats[FONT_RESOLVE_STYLES];
+    int calls = 0;
+
+    FcInit();
+    test_assert_true(font_resolve_fd() == -1, "no fd before start");
+    test_assert_true(font_resolve_request(0x4E16, 0) == 0, "no requests before start");
+
+    make_patterns(pats, "monospace:pixelsize=14");
+    test_assert_true(font_resolve_start(pats) == 0, "resolver starts");
+    free_patterns(pats);    /* the resolver keeps its own references */
+    test_assert_true(font_resolve_running(), "resolver running");
+    test_assert_true(font_resolve_fd() >= 0, "wake-up fd");
+
+    test_assert_true(font_resolve_request(0x4E16, 1), "request queued");
+    test_assert_true(wait_for(0x4E16), "result delivered");
+    test_assert_true(font_resolve_drain(collect, &calls) == 0 && calls == 0,
+                     "drain with nothing ready delivers nothing");
+
+    /* A reload replaces the patterns: the old request never comes back. */
+    seen_len = 0;
+    font_resolve_request(0x1F600, 0);
+    make_patterns(pats, "monospace:pixelsize=28");
+    font_resolve_set_patterns(pats);
+    free_patterns(pats);
+    font_resolve_request(0x2603, 2);
+    test_assert_true(wait_for(0x2603), "request after reload delivered");
+    test_assert_true(!was_seen(0x1F600), "request for old patterns dropped");
+
+    /* Capacity: requests beyond the queue are refused, not lost silently. */
+    {
+        int queued = 0;
+
+        for (uint32_t cp = 0x10000; cp < 0x10000 + 2 * FONT_RESOLVE_QUEUE; cp++)
+            queued += font_resolve_request(cp, 3);
+        test_assert_true(queued <= FONT_RESOLVE_QUEUE, "queue is bounded");
+    }
+
+    font_resolve_stop();
+    test_assert_true(!font_resolve_running() && font_resolve_fd() == -1, "resolver stopped");
+    test_print_ok("render/font_resolve");
+    return 0;
+}
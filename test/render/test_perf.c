@@ -0,0 +1,76 @@
+/*
+ * Performance counters: parser sequence counts, frame histogram and the
+ * text shown by the HUD and the SIGUSR1 dump.
+ */
+#include <string.h>
+
+#include "../common/test_common.h"
+#include "../../src/perf.h"
+#include "../../src/render.h"
+
+static void test_parser_counts_sequences(void) {
+    TermParseStats before;
+
+    test_reset_terminal(24, 80);
+    before = term_parse_stats;
+    test_feed_string("ab\033[1mc\033]0;title\007\033Pq#0\033\\\0337\x9b" "2J");
+    test_assert_true(term_parse_stats.bytes - before.bytes == 29, "bytes counted");
+    test_assert_true(term_parse_stats.csi - before.csi == 2, "ESC [ and C1 CSI counted");
+    test_assert_true(term_parse_stats.osc - before.osc == 1, "OSC counted");
+    test_assert_true(term_parse_stats.str - before.str == 1, "DCS counted");
+    test_assert_true(term_parse_stats.esc - before.esc == 4, "ESC-introduced sequences counted");
+}
+
+static void test_frame_histogram(void) {
+    unsigned long hist[PERF_HIST_BUCKETS];
+
+    memcpy(hist, perf.frame_hist, sizeof(hist));
+    perf_note_frame(0.5);
+    perf_note_frame(1.0);
+    perf_note_frame(20.0);
+    perf_note_frame(500.0);
+    test_assert_true(perf.frame_hist[0] - hist[0] == 1, "sub-ms frame in first bucket");
+    test_assert_true(perf.frame_hist[1] - hist[1] == 1, "bucket bound is exclusive");
+    test_assert_true(perf.frame_hist[5] - hist[5] == 1, "20 ms frame under 33 ms");
+    test_assert_true(perf.frame_hist[PERF_HIST_BUCKETS - 1] - hist[PERF_HIST_BUCKETS - 1] == 1,
+                     "slow frame in open bucket");
+    test_assert_true(perf.frame_ms_max >= 500.0, "max frame time kept");
+    test_assert_true(perf_hist_bound(PERF_HIST_BUCKETS - 1) == 0, "last bucket is open");
+}
+
+static void test_format(void) {
+    FrameScheduler sched;
+    char buf[2048];
+    char small[40];
+    int lines, nl = 0;
+
+    test_reset_terminal(24, 80);
+    perf_set_scheduler(NULL);
+    lines = perf_format(buf, sizeof(buf));
+    for (const char *p = buf; *p; p++)
+        nl += *p == '\n';
+    test_assert_true(lines > 0 && lines == nl, "one newline per line");
+    test_assert_true(strstr(buf, "parse:") != NULL, "parser line");
+    test_assert_true(strstr(buf, "frame ms:") != NULL, "frame time line");
+    test_assert_true(strstr(buf, "history:") != NULL, "history line");
+    test_assert_true(strstr(buf, "sched:") == NULL, "no scheduler lines without one");
+
+    frame_sched_init(&sched, 2, 33, 30, 60);
+    sched.frames[FRAME_REASON_ECHO] = 7;
+    perf_set_scheduler(&sched);
+    perf_format(buf, sizeof(buf));
+    test_assert_true(strstr(buf, "echo 7") != NULL, "per-reason frame counts");
+    perf_set_scheduler(NULL);
+
+    lines = perf_format(small, sizeof(small));
+    test_assert_true(strlen(small) < sizeof(small), "truncated output stays terminated");
+    test_assert_true(lines <= 1, "only whole lines counted");
+}
+
+int main(void) {
+    test_parser_counts_sequences();
+    test_frame_histogram();
+    test_format();
+    test_print_ok("render/perf");
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Renderer frontend through the recording backend: damage, run batching,
+ * cursor handling and search highlights without an X server.
+ */
+#include <string.h>
+
+#include "../common/test_common.h"
+#include "../../src/render.h"
+
+#define CW 8
+#define CH 16
+#define PAD_X 10
+#define PAD_Y 5
+
+static RenderBackend be;
+static RenderRecorder rec;
+static RenderParams params;
+
+static void setup(int rows, int cols) {
+    test_reset_terminal(rows, cols);
+    memset(&params, 0, sizeof(params));
+    params.width = PAD_X + cols * CW;
+    params.height = PAD_Y + rows * CH;
+    params.left_pad = PAD_X;
+    params.top_pad = PAD_Y;
+    params.cell_w = CW;
+    params.cell_h = CH;
+    params.ascent = 12;
+    params.cursor_thickness = 2;
+    params.cursor_color = 256;
+    params.rcursor_color = 257;
+    render_invalidate();
+    render_notify_expose();
+}
+
+static int frame(void) {
+    render_recorder_reset(&rec);
+    return render_frame(&be, &params);
+}
+
+static int count(RenderOpKind kind) {
+    int n = 0;
+    for (size_t i = 0; i < rec.count; i++)
+        n += rec.ops[i].kind == kind;
+    return n;
+}
+
+static const RenderOp *find(RenderOpKind kind, int nth) {
+    for (size_t i = 0; i < rec.count; i++) {
+        if (rec.ops[i].kind == kind && nth-- == 0)
+            return &rec.ops[i];
+    }
+    return NULL;
+}
+
+static void test_first_frame_is_full(void) {
+    const RenderOp *copy;
+
+    setup(24, 80);
+    test_assert_true(frame() == 1, "first frame draws");
+    test_assert_true(rec.ops[0].kind == RENDER_OP_RECT && rec.ops[0].w == params.width &&
+                     rec.ops[0].h == params.height, "full frame clears whole target");
+    copy = find(RENDER_OP_COPY, 0);
+    test_assert_true(copy && copy->w == params.width && copy->h == params.height,
+                     "full frame presents whole target");
+    test_assert_true(count(RENDER_OP_CURSOR) == 1, "cursor drawn");
+    test_assert_true(frame() == 0 && rec.count == 0, "idle frame emits nothing");
+}
+
+static void test_one_cell_change_one_cell_damage(void) {
+    const RenderOp *copy, *glyphs;
+
+    setup(24, 80);
+    test_feed_string("\x1b[?25l");
+    frame();
+
+    strcpy(terminal_buffer[3][5].c, "X");
+    terminal_mark_cells_dirty(3, 5, 5);
+    test_assert_true(frame() == 1, "changed cell drawn");
+    copy = find(RENDER_OP_COPY, 0);
+    test_assert_true(count(RENDER_OP_COPY) == 1, "one present");
+    test_assert_true(copy->x == PAD_X + 5 * CW && copy->y == PAD_Y + 3 * CH &&
+                     copy->w == CW && copy->h == CH, "damage is exactly one cell");
+    glyphs = find(RENDER_OP_GLYPHS, 0);
+    test_assert_true(count(RENDER_OP_GLYPHS) == 1 && glyphs->count == 1 &&
+                     strcmp(glyphs->text, "X") == 0, "one glyph emitted");
+    test_assert_true(count(RENDER_OP_CURSOR) == 0, "hidden cursor not drawn");
+    for (size_t i = 0; i < rec.count; i++) {
+        const RenderOp *op = &rec.ops[i];
+        test_assert_true(op->x >= copy->x && op->y >= copy->y &&
+                         op->x + op->w <= copy->x + copy->w && op->y + op->h <= copy->y + copy->h,
+                         "every primitive inside the damage");
+    }
+}
+
+static void test_typed_character_damages_one_row(void) {
+    const RenderOp *copy;
+
+    setup(24, 80);
+    test_feed_string("\x1b[6;11H");
+    frame();
+    test_feed_string("a");
+    frame();
+    copy = find(RENDER_OP_COPY, 0);
+    test_assert_true(copy && copy->y == PAD_Y + 5 * CH && copy->h == CH,
+                     "typing damages only the cursor row");
+    test_assert_true(copy->w <= 4 * CW, "and only a few cells of it");
+}
+
+static void test_runs_are_batched(void) {
+    const RenderOp *a, *b;
+    int bg_rects = 0;
+
+    setup(4, 40);
+    test_feed_string("\x1b[?25l");
+    frame();
+    test_feed_string("\x1b[2;1Hhello \x1b[31mred\x1b[41m  \x1b[42m  \x1b[0m");
+    frame();
+    a = find(RENDER_OP_GLYPHS, 0);
+    b = find(RENDER_OP_GLYPHS, 1);
+    test_assert_true(count(RENDER_OP_GLYPHS) == 2, "one glyph call per colour run");
+    test_assert_true(a->count == 5 && strcmp(a->text, "hello") == 0, "default-colour run");
+    test_assert_true(b->count == 3 && strcmp(b->text, "red") == 0 && b->color == 1, "red run");
+    for (size_t i = 0; i < rec.count; i++) {
+        if (rec.ops[i].kind == RENDER_OP_RECT && (rec.ops[i].color == 1 || rec.ops[i].color == 2))
+            bg_rects++;
+    }
+    test_assert_true(bg_rects == 2, "one background rect per colour run");
+}
+
+static void test_cursor_move_erases_old_cell(void) {
+    const RenderOp *cur;
+
+    setup(24, 80);
+    test_feed_string("\x1b[3;3H");
+    frame();
+    test_feed_string("\x1b[10;20H");
+    frame();
+    cur = find(RENDER_OP_CURSOR, 0);
+    test_assert_true(cur && cur->x == PAD_X + 19 * CW && cur->y == PAD_Y + 9 * CH,
+                     "cursor drawn at new cell");
+    test_assert_true(rec.ops[0].kind == RENDER_OP_RECT && rec.ops[0].y == PAD_Y + 2 * CH,
+                     "old cursor cell repainted");
+}
+
+/* Marked cells swap colours, the current mark takes the cursor colours,
+ * and each row only picks up its own marks. */
+static void test_marks(void) {
+    static const RenderMark marks[] = {
+        { 1, 0, 1, 0 }, { 1, 6, 7, 1 }, { 3, 0, 1, 0 },
+    };
+    int fg_rects = 0, cur_rects = 0;
+
+    setup(4, 20);
+    test_feed_string("\x1b[?25l\x1b[2;1Hab ab ab\x1b[4;1Hab ab");
+    params.marks = marks;
+    params.nmarks = 3;
+    frame();
+    for (size_t i = 0; i < rec.count; i++) {
+        const RenderOp *op = &rec.ops[i];
+
+        if (op->kind != RENDER_OP_RECT)
+            continue;
+        if (op->color == COLOR_DEFAULT_FG) {
+            fg_rects++;
+            test_assert_true(op->x == PAD_X && op->w == 2 * CW &&
+                             (op->y == PAD_Y + CH || op->y == PAD_Y + 3 * CH), "highlight covers the mark");
+        } else if (op->color == params.cursor_color) {
+            cur_rects++;
+            test_assert_true(op->x == PAD_X + 6 * CW && op->w == 2 * CW && op->y == PAD_Y + CH,
+                             "current mark in the cursor colour");
+        }
+    }
+    test_assert_true(fg_rects == 2 && cur_rects == 1, "one rect per mark");
+    params.marks = NULL;
+    params.nmarks = 0;
+}
+
+int main(void) {
+    render_recorder_init(&be, &rec);
+    test_first_frame_is_full();
+    test_one_cell_change_one_cell_damage();
+    test_typed_character_damages_one_row();
+    test_runs_are_batched();
+    test_cursor_move_erases_old_cell();
+    test_marks();
+    render_recorder_free(&rec);
+    test_print_ok("render/frontend");
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Trace ring: wrap-around keeps the newest events and the dump is Chrome
+ * trace JSON with one complete ("X") event per span.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../common/test_common.h"
+#include "../../src/trace.h"
+
+static char *slurp(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    char *buf;
+    long n;
+
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    n = ftell(fp);
+    rewind(fp);
+    buf = malloc((size_t)n + 1);
+    if (buf && fread(buf, 1, (size_t)n, fp) != (size_t)n) {
+        free(buf);
+        buf = NULL;
+    }
+    if (buf)
+        buf[n] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+static int occurrences(const char *hay, const char *needle) {
+    int n = 0;
+    for (const char *p = strstr(hay, needle); p; p = strstr(p + 1, needle))
+        n++;
+    return n;
+}
+
+static void test_disabled_ring_records_nothing(void) {
+    trace_free();
+    trace_span("read", "io", trace_now(), 1);
+    test_assert_true(trace_count() == 0 && trace_recorded() == 0, "no ring, no events");
+}
+
+static void test_ring_keeps_newest(void) {
+    static const char *names[] = { "a", "b", "c", "d", "e", "f" };
+
+    test_assert_true(trace_init(4) == 0, "ring allocated");
+    for (int i = 0; i < 6; i++)
+        trace_span(names[i], "test", trace_now(), (uint64_t)i);
+    test_assert_true(trace_count() == 4, "count capped at capacity");
+    test_assert_true(trace_recorded() == 6, "every span recorded");
+}
+
+static void test_dump_is_chrome_trace(void) {
+    char path[] = "/tmp/cupid_trace_XXXXXX";
+    char *json;
+    int fd = mkstemp(path);
+
+    test_assert_true(fd >= 0, "temp file");
+    close(fd);
+    test_assert_true(trace_dump(path) == 0, "dump written");
+    json = slurp(path);
+    unlink(path);
+    test_assert_true(json != NULL, "dump readable");
+    test_assert_true(strncmp(json, "{\"displayTimeUnit\"", 18) == 0, "object header");
+    test_assert_true(strstr(json, "\"traceEvents\":[") != NULL, "traceEvents array");
+    test_assert_true(occurrences(json, "\"ph\":\"X\"") == 4, "one complete event per span");
+    test_assert_true(strstr(json, "\"name\":\"a\"") == NULL, "oldest events overwritten");
+    test_assert_true(strstr(json, "\"name\":\"c\"") < strstr(json, "\"name\":\"f\""), "oldest first");
+    test_assert_true(strstr(json, "\"args\":{\"n\":5}") != NULL, "span argument");
+    test_assert_true(strcmp(json + strlen(json) - 4, "\n]}\n") == 0, "closed array");
+    free(json);
+    trace_free();
+}
+
+int main(void) {
+    test_disabled_ring_records_nothing();
+    test_ring_keeps_newest();
+    test_dump_is_chrome_trace();
+    test_print_ok("render/trace");
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/frame_sched.h"
+
+static void check(int condition, const char *message) {
+    if (!condition) {
+        fprintf(stderr, "TEST FAILURE: %s\n", message);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static FrameScheduler fresh(double refresh_hz) {
+    FrameScheduler s;
+    frame_sched_init(&s, 2, 33, 10, refresh_hz);
+    return s;
+}
+
+static void test_nothing_pending_blocks(void) {
+    FrameScheduler s = fresh(0);
+    check(frame_sched_timeout(&s, 100) < 0, "idle scheduler should block");
+    check(frame_sched_due(&s, 100) == FRAME_REASON_NONE, "idle scheduler draws nothing");
+}
+
+static void test_echo_draws_immediately(void) {
+    FrameScheduler s = fresh(60);
+    frame_sched_note_frame(&s, 99.5, 0.5, FRAME_REASON_IDLE);
+    frame_sched_note_key(&s, 100);
+    frame_sched_note_output(&s, 100.4, 1, 0.01);
+    check(frame_sched_timeout(&s, 100.4) == 0, "echo timeout should be zero");
+    check(frame_sched_due(&s, 100.4) == FRAME_REASON_ECHO, "echo ignores refresh gating");
+    frame_sched_note_frame(&s, 100.5, 0.1, FRAME_REASON_ECHO);
+    frame_sched_note_output(&s, 100.6, 1, 0.01);
+    check(frame_sched_due(&s, 100.6) != FRAME_REASON_ECHO, "one echo frame per keystroke");
+    check(s.frames[FRAME_REASON_ECHO] == 1, "echo frame counted");
+    check(s.echo_samples == 1, "echo latency sampled");
+    check(s.echo_latency_ms > 0.49 && s.echo_latency_ms < 0.51, "key-to-photon latency measured");
+}
+
+static void test_idle_batching(void) {
+    FrameScheduler s = fresh(0);
+    double t;
+
+    frame_sched_note_output(&s, 1000, 64, 0.01);
+    check(frame_sched_due(&s, 1000.5) == FRAME_REASON_NONE, "waits for output to go idle");
+    t = frame_sched_timeout(&s, 1000.5);
+    check(t > 0 && t <= 2, "idle wait bounded by minlatency");
+    check(frame_sched_due(&s, 1002.1) == FRAME_REASON_IDLE, "idle frame after minlatency");
+}
+
+static void test_trickle_hits_deadline(void) {
+    FrameScheduler s = fresh(0);
+    double t;
+    FrameReason why = FRAME_REASON_NONE;
+
+    for (t = 0; t <= 40 && why == FRAME_REASON_NONE; t += 1) {
+        frame_sched_note_output(&s, 1000 + t, 16, 0.01);
+        why = frame_sched_due(&s, 1000 + t);
+    }
+    check(why != FRAME_REASON_NONE, "steady trickle still draws");
+    check(t <= 34, "trickle frame no later than maxlatency");
+}
+
+static void test_bulk_output_throttled(void) {
+    FrameScheduler s = fresh(60);
+    double t;
+    int frames = 0;
+
+    /* 64 KiB every millisecond for one second: ~64 MB/s */
+    for (t = 0; t < 1000; t += 1) {
+        frame_sched_note_output(&s, t, 65536, 0.3);
+        if (frame_sched_due(&s, t) != FRAME_REASON_NONE) {
+            frame_sched_note_frame(&s, t, 2.0, FRAME_REASON_BULK);
+            frames++;
+        }
+    }
+    check(s.bulk, "sustained output enters bulk mode");
+    check(s.bulk_entries == 1, "bulk entered once");
+    check(frames <= 15, "bulk output drawn at low frame rate");
+    check(frames >= 5, "bulk output still shows progress");
+
+    /* Output stops: final frame must come promptly */
+    check(frame_sched_due(&s, t + 60) != FRAME_REASON_NONE, "final frame after bulk ends");
+    check(!s.bulk, "bulk mode left when output stops");
+}
+
+static void test_refresh_rate_caps_frames(void) {
+    FrameScheduler s = fresh(100);
+    frame_sched_note_frame(&s, 1000, 0.5, FRAME_REASON_IDLE);
+    frame_sched_note_output(&s, 1001, 10, 0.01);
+    check(frame_sched_due(&s, 1005) == FRAME_REASON_NONE, "no frame before next refresh");
+    check(frame_sched_timeout(&s, 1005) >= 4.9, "waits until next refresh");
+    check(frame_sched_due(&s, 1010) == FRAME_REASON_IDLE, "frame at refresh boundary");
+    check(s.deferrals > 0, "deferral counted");
+}
+
+static void test_hidden_window_parses_only(void) {
+    FrameScheduler s = fresh(0);
+
+    frame_sched_set_visibility(&s, 0, 0);
+    frame_sched_note_output(&s, 1000, 100, 0.01);
+    check(frame_sched_timeout(&s, 1000) < 0, "hidden window blocks without timeout");
+    check(frame_sched_due(&s, 1100) == FRAME_REASON_NONE, "nothing drawn while hidden");
+    check(s.hidden_skips > 0, "hidden skip counted");
+    frame_sched_set_visibility(&s, 1, 0);
+    check(frame_sched_due(&s, 1100) == FRAME_REASON_IDLE, "pending frame drawn once visible");
+}
+
+static void test_unfocused_cap(void) {
+    FrameScheduler s = fresh(0);
+
+    frame_sched_set_unfocused_fps(&s, 10);
+    frame_sched_set_visibility(&s, 1, 0);
+    frame_sched_note_frame(&s, 1000, 0.5, FRAME_REASON_IDLE);
+    frame_sched_note_output(&s, 1010, 10, 0.01);
+    check(frame_sched_due(&s, 1050) == FRAME_REASON_NONE, "unfocused frames capped");
+    check(frame_sched_timeout(&s, 1050) >= 49.9, "waits for unfocused interval");
+    check(frame_sched_due(&s, 1100) == FRAME_REASON_IDLE, "frame after unfocused interval");
+    frame_sched_set_visibility(&s, 1, 1);
+    frame_sched_note_frame(&s, 1100, 0.5, FRAME_REASON_IDLE);
+    frame_sched_note_output(&s, 1101, 10, 0.01);
+    check(frame_sched_due(&s, 1104) == FRAME_REASON_IDLE, "focused window uncapped");
+}
+
+static void test_sync_update_holds_frames(void) {
+    FrameScheduler s = fresh(0);
+
+    frame_sched_set_sync_timeout(&s, 150);
+    frame_sched_note_output(&s, 1000, 100, 0.01);
+    frame_sched_set_sync(&s, 1, 1000);
+    check(frame_sched_due(&s, 1010) == FRAME_REASON_NONE, "frame held during sync update");
+    check(frame_sched_timeout(&s, 1010) > 139, "sleeps until sync deadline");
+    frame_sched_note_output(&s, 1020, 100, 0.01);
+    frame_sched_set_sync(&s, 0, 1020);
+    check(frame_sched_due(&s, 1020) == FRAME_REASON_SYNC, "present as soon as sync ends");
+    frame_sched_note_frame(&s, 1021, 0.5, FRAME_REASON_SYNC);
+    check(s.frames[FRAME_REASON_SYNC] == 1 && s.sync_holds > 0, "sync counters");
+
+    /* Never-closed update is released by the safety timeout */
+    frame_sched_note_output(&s, 2000, 100, 0.01);
+    frame_sched_set_sync(&s, 1, 2000);
+    check(frame_sched_due(&s, 2100) == FRAME_REASON_NONE, "held before timeout");
+    check(frame_sched_due(&s, 2151) != FRAME_REASON_NONE, "released after timeout");
+    check(s.sync_timeouts == 1, "timeout counted");
+    frame_sched_note_frame(&s, 2151, 0.5, FRAME_REASON_IDLE);
+
+    /* The terminal still reports the update open: more output is not held */
+    frame_sched_note_output(&s, 2200, 100, 0.01);
+    frame_sched_set_sync(&s, 1, 2200);
+    check(!s.sync_active, "expired update not re-armed");
+    check(frame_sched_due(&s, 2210) == FRAME_REASON_IDLE, "output after the timeout drawn normally");
+    frame_sched_note_frame(&s, 2210, 0.5, FRAME_REASON_IDLE);
+
+    /* Once it is closed, the next update holds frames again */
+    frame_sched_set_sync(&s, 0, 2300);
+    frame_sched_note_frame(&s, 2300, 0.5, FRAME_REASON_SYNC);
+    frame_sched_note_output(&s, 2400, 100, 0.01);
+    frame_sched_set_sync(&s, 1, 2400);
+    check(frame_sched_due(&s, 2410) == FRAME_REASON_NONE, "new update held after the old one closed");
+    check(s.sync_timeouts == 1, "still one timeout");
+}
+
+/* BSU ... ESU BSU in one read: the finished update is presented, then the
+ * new one holds frames as usual. */
+static void test_sync_end_and_restart_in_one_read(void) {
+    FrameScheduler s = fresh(0);
+
+    frame_sched_set_sync_timeout(&s, 150);
+    frame_sched_note_output(&s, 1000, 300, 0.01);
+    frame_sched_note_sync_end(&s, 1000);
+    frame_sched_set_sync(&s, 1, 1000);
+    check(s.sync_active, "new update open");
+    check(frame_sched_timeout(&s, 1000) == 0, "no sleep while a finished update waits");
+    check(frame_sched_due(&s, 1000) == FRAME_REASON_SYNC, "finished update presented");
+    frame_sched_note_frame(&s, 1001, 0.5, FRAME_REASON_SYNC);
+
+    frame_sched_note_output(&s, 1010, 100, 0.01);
+    frame_sched_set_sync(&s, 1, 1010);
+    check(frame_sched_due(&s, 1010) == FRAME_REASON_NONE, "new update holds frames");
+    check(frame_sched_timeout(&s, 1010) > 139, "sleeps until the new update's deadline");
+
+    /* Same again with the first BSU in an earlier read */
+    frame_sched_note_output(&s, 1020, 100, 0.01);
+    frame_sched_note_sync_end(&s, 1020);
+    frame_sched_set_sync(&s, 1, 1020);
+    check(frame_sched_due(&s, 1020) == FRAME_REASON_SYNC, "open update closed and reopened");
+    check(s.frames[FRAME_REASON_SYNC] == 1 && s.sync_timeouts == 0, "no timeout needed");
+}
+
+int main(void) {
+    test_nothing_pending_blocks();
+    test_echo_draws_immediately();
+    test_idle_batching();
+    test_trickle_hits_deadline();
+    test_bulk_output_throttled();
+    test_refresh_rate_caps_frames();
+    test_hidden_window_parses_only();
+    test_unfocused_cap();
+    test_sync_update_holds_frames();
+    test_sync_end_and_restart_in_one_read();
+    printf("PASS: sched/frame_sched\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+/*
+ * Cell-level damage tracking: printables and line edits dirty only the
+ * columns they touch; scrolling and whole-line operations dirty full rows.
+ */
+#include <string.h>
+
+#include "../common/test_common.h"
+
+static void clear_damage(void) {
+    memset(dirty_rows, DIRTY_ROW_CLEAN, (size_t)term_rows);
+}
+
+static void assert_span(int row, int lo, int hi, const char *message) {
+    test_assert_true(dirty_rows[row] == DIRTY_ROW_SPAN, message);
+    test_assert_true(dirty_col_lo[row] == lo && dirty_col_hi[row] == hi, message);
+}
+
+int main(void) {
+    /* A typed character damages only its neighbourhood, not the row */
+    test_reset_terminal(4, 20);
+    test_feed_string("\x1b[2;6H");
+    clear_damage();
+    test_feed_string("a");
+    assert_span(1, 4, 7, "printable dirties a few cells");
+    test_assert_true(dirty_rows[0] == DIRTY_ROW_CLEAN, "other rows stay clean");
+
+    /* Successive printables widen the span */
+    test_feed_string("bc");
+    assert_span(1, 4, 9, "span widens as text is typed");
+
+    /* EL from cursor dirties cursor..end */
+    clear_damage();
+    test_feed_string("\x1b[2;10H\x1b[K");
+    assert_span(1, 9, 19, "EL 0 dirties cursor to end of line");
+
+    /* DCH (readline backspace) dirties cursor..end */
+    clear_damage();
+    test_feed_string("\x1b[2;3H\x1b[P");
+    assert_span(1, 2, 19, "DCH dirties cursor to end of line");
+
+    /* Full-row damage is never narrowed by a later partial mark */
+    clear_damage();
+    test_feed_string("\x1b[2;1H\x1b[2K");
+    test_assert_true(dirty_rows[1] == DIRTY_ROW_SPAN, "EL 2 clears the full span");
+    test_feed_string("\x1b[L");
+    test_assert_true(dirty_rows[1] == DIRTY_ROW_FULL, "IL dirties whole rows");
+    test_feed_string("x");
+    test_assert_true(dirty_rows[1] == DIRTY_ROW_FULL, "full row stays full");
+
+    /* Scrolling dirties every row of the region */
+    clear_damage();
+    test_feed_string("\x1b[4;1H\n");
+    for (int r = 0; r < 4; r++)
+        test_assert_true(dirty_rows[r] == DIRTY_ROW_FULL, "scroll dirties full rows");
+
+    test_print_ok("screen/dirty_spans");
+    return 0;
+}
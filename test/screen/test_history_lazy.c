@@ -0,0 +1,43 @@
+/*
+ * Scrollback rows are allocated as lines scroll off, not up front, and
+ * survive a width change with the new columns blank.
+ */
+#include <string.h>
+
+#include "../common/test_common.h"
+
+int main(void) {
+    const TerminalCell *row;
+    size_t one_line;
+
+    test_reset_terminal(3, 10);
+    test_assert_true(terminal_history_bytes() == 0, "no scrollback before anything scrolls");
+
+    test_feed_string("one\r\ntwo\r\nthree\r\nfour");
+    test_assert_true(terminal_history_lines() == 1, "one line scrolled off");
+    one_line = terminal_history_bytes();
+    test_assert_true(one_line > 0 && one_line < 2000 * 10 * sizeof(TerminalCell),
+                     "only the used row is allocated");
+
+    test_feed_string("\r\nfive\r\nsix");
+    test_assert_true(terminal_history_lines() == 3, "three lines scrolled off");
+    test_assert_true(terminal_history_bytes() == one_line + 2 * 10 * sizeof(TerminalCell),
+                     "one row allocated per line");
+
+    resize_terminal(3, 14);
+    test_assert_true(terminal_history_lines() == 3, "history kept across a resize");
+    terminal_scrollback_up(3);
+    row = terminal_get_visible_row(0);
+    test_assert_true(row && strcmp(row[0].c, "o") == 0 && strcmp(row[2].c, "e") == 0,
+                     "oldest line intact after widening");
+    test_assert_true(row && row[13].c[0] == '\0' && row[13].bg == COLOR_DEFAULT_BG,
+                     "widened columns are blank");
+    terminal_scrollback_reset();
+
+    test_reset_terminal(3, 10);
+    test_assert_true(terminal_history_bytes() == 0 && terminal_history_lines() == 0,
+                     "reset frees the scrollback");
+
+    test_print_ok("screen/history_lazy");
+    return 0;
+}
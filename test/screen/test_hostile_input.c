@@ -0,0 +1,142 @@
+/*
+ * Hostile input: huge repeat and scroll counts must give the same screen as
+ * the literal stream, and over-long CSI must be swallowed, not printed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/test_common.h"
+
+static const char *const setup =
+    "1111\r\n2222\r\n3333\r\n4444\r\n5555\r\n6666\x1b[3;3H";
+
+static char *screen_after(const char *prefix, const char *body, size_t body_len,
+                          int *row, int *col) {
+    char *snap;
+
+    test_reset_terminal(6, 4);
+    test_feed_string(setup);
+    test_feed_string(prefix);
+    test_feed_bytes((const uint8_t *)body, body_len);
+    snap = test_snapshot_screen();
+    *row = term_state.row;
+    *col = term_state.col;
+    return snap;
+}
+
+static void check_rep(const char *prefix, const char *glyph, int n, const char *message) {
+    size_t glen = strlen(glyph);
+    char *literal = malloc(glen * ((size_t)n + 1));
+    char seq[32];
+    char *want;
+    char *got;
+    int want_row, want_col, got_row, got_col;
+
+    for (int i = 0; i <= n; i++) {
+        memcpy(literal + glen * (size_t)i, glyph, glen);
+    }
+    want = screen_after(prefix, literal, glen * ((size_t)n + 1), &want_row, &want_col);
+    snprintf(seq, sizeof(seq), "%s\x1b[%db", glyph, n);
+    got = screen_after(prefix, seq, strlen(seq), &got_row, &got_col);
+    test_assert_true(strcmp(want, got) == 0, message);
+    test_assert_true(want_row == got_row && want_col == got_col, message);
+    test_free_snapshot(want);
+    test_free_snapshot(got);
+    free(literal);
+}
+
+static void test_rep_matches_literal(void) {
+    static const char wide[] = "\xe7\x95\x8c";
+
+    check_rep("", "x", 5, "short REP");
+    check_rep("", "x", 1000003, "huge REP");
+    check_rep("\x1b[2;5r\x1b[3;3H", "x", 999999, "huge REP in a scroll region");
+    check_rep("\x1b[?7l", "x", 100000, "huge REP without autowrap");
+    check_rep("\x1b[4h", "x", 77777, "huge REP in insert mode");
+    check_rep("\x1b[1;1H\xe7\x95\x8c\xe7\x95\x8c\x1b[1;1H", "x", 2, "REP over half a wide glyph");
+    check_rep("\x1b[2;2H\xe7\x95\x8c\x1b[2;1H", "x", 8, "REP across a wide glyph and a wrap");
+    check_rep("\x1b[1;2H", wide, 5, "wide REP");
+    check_rep("\x1b[1;2Hx\x1b[1;1H", wide, 300001, "huge wide REP");
+    check_rep("\x1b[?7l\x1b[1;2H", wide, 9, "wide REP without autowrap");
+}
+
+static void test_scroll_counts(void) {
+    int r1, c1, r2, c2;
+    const char *steps = "\x1b[S\x1b[S\x1b[T\x1b[L\x1b[L\x1b[M";
+    const char *counts = "\x1b[2S\x1b[T\x1b[2L\x1b[M";
+    char *a = screen_after("\x1b[2;5r\x1b[3;1H", steps, strlen(steps), &r1, &c1);
+    char *b = screen_after("\x1b[2;5r\x1b[3;1H", counts, strlen(counts), &r2, &c2);
+
+    test_assert_true(strcmp(a, b) == 0, "multi-line SU/SD/IL/DL match repeated single steps");
+    test_free_snapshot(a);
+    test_free_snapshot(b);
+
+    test_reset_terminal(6, 4);
+    test_feed_string(setup);
+    test_feed_string("\x1b[2147483647S");
+    a = test_snapshot_screen();
+    test_assert_true(strcmp(a, "    \n    \n    \n    \n    \n    \n") == 0, "huge SU clears the screen");
+    test_free_snapshot(a);
+
+    test_reset_terminal(6, 4);
+    test_feed_string(setup);
+    test_feed_string("\x1b[1;2H\x1b[2147483647@Z\x1b[2;2H\x1b[2147483647P");
+    test_assert_cell(0, 0, "1", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+    test_assert_cell(0, 1, "Z", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+    test_assert_cell(0, 2, "", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+    test_assert_cell(1, 1, "", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+
+    /* Relative moves and tab counts saturate at the margins. */
+    test_reset_terminal(6, 4);
+    test_feed_string("\x1b[3;3H\x1b[2147483647C\x1b[2147483647B");
+    test_assert_cursor(5, 3);
+    test_feed_string("\x1b[2147483647I\x1b[2147483647Z\x1b[2147483647A");
+    test_assert_cursor(0, 0);
+    test_feed_string("\x1b[?6h\x1b[2;4r\x1b[2147483647;2147483647H");
+    test_assert_cursor(3, 3);
+}
+
+static void test_long_csi(void) {
+    test_reset_terminal(6, 4);
+    test_feed_string("\x1b[");
+    for (int i = 0; i < 3000; i++) {
+        test_feed_string("1;");
+    }
+    test_feed_string("31mZ");
+    test_assert_cell(0, 0, "Z", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+    test_assert_cursor(0, 1);
+
+    /* The same sequence in one read is ignored too. */
+    {
+        size_t len = 2 + 3000 * 2 + 4;
+        char *seq = malloc(len + 1);
+
+        memcpy(seq, "\x1b[", 2);
+        for (int i = 0; i < 3000; i++) {
+            memcpy(seq + 2 + i * 2, "1;", 2);
+        }
+        memcpy(seq + len - 4, "31mY", 5);
+        test_feed_bytes((const uint8_t *)seq, len);
+        free(seq);
+    }
+    test_assert_cell(0, 1, "Y", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+
+    /* A CSI dribbled one byte per read still parses. */
+    {
+        const char *seq = "\x1b[38;5;1;4mW";
+
+        for (const char *p = seq; *p; p++) {
+            test_feed_bytes((const uint8_t *)p, 1);
+        }
+    }
+    test_assert_cell(0, 2, "W", 1, COLOR_DEFAULT_BG, ATTR_UNDERLINE);
+}
+
+int main(void) {
+    test_rep_matches_literal();
+    test_scroll_counts();
+    test_long_csi();
+    test_print_ok("screen/hostile_input");
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * Scrollback search: plain and regex queries with smart case, the threaded
+ * scan agreeing with the inline one, lines matched as they scroll off,
+ * spilled history read by the workers, wide-cell columns and n/N order.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../common/test_common.h"
+#include "../../src/search.h"
+
+/* Matches of a plain, case-sensitive needle, counted the slow way. */
+static size_t brute_count(const char *needle) {
+    static char buf[200 * MAX_UTF8_CHAR_SIZE + 1];
+    unsigned long long total = terminal_history_total();
+    unsigned long long id = total - (unsigned long long)terminal_history_lines();
+    size_t n = 0;
+
+    for (; id < total + (unsigned long long)term_rows; id++) {
+        const TerminalCell *row = terminal_line(id);
+        const char *p;
+
+        if (!row)
+            continue;
+        search_line_text(row, term_cols, buf);
+        for (p = strstr(buf, needle); p; p = strstr(p + strlen(needle), needle))
+            n++;
+    }
+    return n;
+}
+
+static void feed_lines(int from, int to) {
+    char line[64];
+
+    for (int i = from; i < to; i++) {
+        snprintf(line, sizeof(line), "\r\nline %d%s", i, (i % 100 == 7) ? " Needle here" : "");
+        test_feed_string(line);
+    }
+}
+
+static void test_plain_and_case(void) {
+    test_reset_terminal(4, 30);
+    test_feed_string("alpha Beta\r\nbeta gamma\r\nBETA\r\none\r\ntwo\r\nthree");
+    test_assert_true(terminal_history_lines() == 2, "two lines in history");
+
+    test_assert_true(search_set_query("beta", 0) == 0 && !search_busy(), "short history scans inline");
+    test_assert_true(search_count() == 3, "lower case query ignores case");
+    search_set_query("Beta", 0);
+    test_assert_true(search_count() == 1, "upper case in the query makes it exact");
+    search_set_query("", 0);
+    test_assert_true(search_count() == 0 && search_active(), "empty query: active, no matches");
+    search_stop();
+    test_assert_true(!search_active(), "stopped");
+}
+
+static void test_regex(void) {
+    test_reset_terminal(4, 30);
+    feed_lines(0, 40);
+    test_assert_true(search_set_query("^line 1[0-9]$", 1) == 0, "regex compiles");
+    test_assert_true(search_count() == 10, "anchored regex");
+    test_assert_true(search_set_query("line (", 1) == -1 && search_failed(), "bad regex reported");
+    test_assert_true(search_count() == 0, "bad regex has no matches");
+    search_set_query("e", 1);
+    test_assert_true(search_count() == brute_count("e") && search_count() > 40,
+                     "every match in a line, not just the first");
+    search_stop();
+}
+
+static void test_threads(void) {
+    size_t inline_count, threaded;
+
+    test_reset_terminal(5, 40);
+    feed_lines(0, 1600);
+    test_assert_true(terminal_history_lines() >= 1000, "long history");
+
+    search_set_threads(1);
+    search_set_query("needle", 0);
+    test_assert_true(!search_busy(), "one thread scans inline");
+    inline_count = search_count();
+    test_assert_true(inline_count == brute_count("Needle"), "inline count");
+
+    search_set_threads(4);
+    search_set_query("needle", 0);
+    search_wait();
+    test_assert_true(search_fd() >= 0, "wake-up pipe");
+    search_poll();
+    threaded = search_count();
+    test_assert_true(threaded == inline_count, "sharded scan finds the same matches");
+
+    /* New output is matched as it scrolls into history. */
+    feed_lines(1600, 1800);
+    test_assert_true(search_count() == brute_count("Needle"), "incremental matches");
+
+    /* Editing the query while output arrived retakes the snapshot. */
+    search_set_query("needle h", 0);
+    search_wait();
+    test_assert_true(search_count() == brute_count("Needle h"), "rescan after output");
+
+    /* A reset is noticed where results are read, with no search_poll, even
+     * once the new history has grown past the old line count. */
+    test_reset_terminal(5, 40);
+    feed_lines(0, 2500);
+    search_count();
+    search_wait();
+    test_assert_true(search_count() == brute_count("Needle h") && !search_incomplete(),
+                     "results follow a reset");
+    search_stop();
+    search_set_threads(0);
+}
+
+static void test_spilled_history(void) {
+    char dir[] = "/tmp/cupid-search-XXXXXX";
+    size_t expected;
+
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    test_reset_terminal(4, 30);
+    test_assert_true(terminal_spill_open(dir, 0) == 0, "spill file opened");
+    feed_lines(0, 12000);
+    test_assert_true(terminal_history_lines() > 10000 && terminal_spill_bytes() > 0, "history spilled");
+    expected = brute_count("Needle");
+    test_assert_true(expected == 120, "brute count over the spill file");
+
+    search_set_threads(4);
+    search_set_query("needle", 0);
+    search_wait();
+    test_assert_true(search_count() == expected && !search_busy_spilled(), "workers read the spill file");
+    test_assert_true(search_next(-1) == 0 && search_current_index() == expected, "newest match");
+
+    /* One CPU: the spilled lines still go to a thread. */
+    search_set_threads(1);
+    search_set_query("needle h", 0);
+    search_wait();
+    test_assert_true(search_count() == expected, "single worker");
+
+    /* Lines spilled after the snapshot come from the history hook. */
+    feed_lines(12000, 12500);
+    test_assert_true(search_count() == brute_count("Needle"), "incremental matches past the snapshot");
+
+    /* A reset mid-scan empties the file the workers are reading. */
+    search_set_threads(4);
+    search_set_query("line", 0);
+    test_reset_terminal(4, 30);
+    feed_lines(0, 3000);
+    search_wait();
+    search_poll();
+    search_wait();
+    test_assert_true(search_count() == brute_count("line"), "scan after the reset matches the new history");
+    search_stop();
+    search_set_threads(0);
+    terminal_spill_close();
+    rmdir(dir);
+}
+
+static void test_navigation(void) {
+    int offset;
+
+    test_reset_terminal(4, 30);
+    feed_lines(0, 400);
+    search_set_query("needle", 0);
+    test_assert_true(search_count() == 4, "four matches");
+    test_assert_true(search_current_index() == 0, "none selected yet");
+
+    test_assert_true(search_next(-1) == 0 && search_current_index() == 4, "newest first");
+    test_assert_true(search_next(-1) == 0 && search_current_index() == 3, "n goes older");
+    offset = terminal_get_scrollback_offset();
+    test_assert_true(offset > 0, "scrolled back to the match");
+    {
+        RenderMark marks[8];
+        int n = search_visible_marks(marks, 8);
+        int current = 0;
+
+        for (int i = 0; i < n; i++)
+            current += marks[i].current;
+        test_assert_true(n >= 1 && current == 1, "current match visible and marked");
+    }
+    test_assert_true(search_next(+1) == 0 && search_current_index() == 4, "N goes newer");
+    test_assert_true(search_next(+1) == -1, "nothing newer than the newest");
+    search_next(-1);
+    search_next(-1);
+    search_next(-1);
+    test_assert_true(search_current_index() == 1 && search_next(-1) == -1, "nothing older");
+    test_assert_true(search_next(+1) == 0 && search_current_index() == 2, "second oldest");
+    /* The oldest match leaves the ring: the position follows without n/N. */
+    feed_lines(400, 2100);
+    test_assert_true(search_current_index() == 1, "position after older matches left history");
+    test_assert_true(search_count() == brute_count("Needle"), "count after eviction");
+    search_stop();
+    terminal_scrollback_reset();
+}
+
+static void test_wide_columns(void) {
+    RenderMark marks[4];
+    int n;
+
+    test_reset_terminal(3, 20);
+    test_feed_string("\xe6\x97\xa5\xe6\x9c\xac needle");
+    search_set_query("needle", 0);
+    n = search_visible_marks(marks, 4);
+    test_assert_true(n == 1 && marks[0].row == 0 && marks[0].c0 == 5 && marks[0].c1 == 10,
+                     "columns after wide cells");
+    search_set_query("\xe6\x9c\xac", 0);
+    n = search_visible_marks(marks, 4);
+    test_assert_true(n == 1 && marks[0].c0 == 2 && marks[0].c1 == 3, "wide match covers both cells");
+    search_stop();
+}
+
+int main(void) {
+    test_plain_and_case();
+    test_regex();
+    test_threads();
+    test_spilled_history();
+    test_navigation();
+    test_wide_columns();
+    test_print_ok("screen/search");
+    return 0;
+}
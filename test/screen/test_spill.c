@@ -0,0 +1,155 @@
+/*
+ * Scrollback spill file: lines leaving the in-memory ring go to disk and
+ * come back intact (text, colours, wide cells) when scrolled to, RAM stays
+ * flat as history grows, and the file is removed unless kept.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../common/test_common.h"
+#include "../../src/spill.h"
+
+static char dir[] = "/tmp/cupid-spill-XXXXXX";
+
+static int dir_entries(void) {
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    int n = 0;
+
+    if (!d)
+        return -1;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] != '.')
+            n++;
+    }
+    closedir(d);
+    return n;
+}
+
+static void feed_lines(int from, int to) {
+    char line[64];
+
+    for (int i = from; i < to; i++) {
+        snprintf(line, sizeof(line), "\r\n\x1b[3%dmline %d\x1b[m \xe6\x97\xa5", i % 8, i);
+        test_feed_string(line);
+    }
+}
+
+/* row holds "line <n>" in colour n % 8, then a wide glyph. */
+static int cells_are_line(const TerminalCell *row, int n) {
+    char want[32];
+    int len = snprintf(want, sizeof(want), "line %d", n);
+
+    for (int c = 0; c < len; c++) {
+        if (row[c].c[0] != want[c] || row[c].c[1] != '\0' || row[c].fg != (uint32_t)(n % 8))
+            return 0;
+    }
+    return strcmp(row[len + 1].c, "\xe6\x97\xa5") == 0 && row[len + 1].width == 2 &&
+           row[len + 2].is_continuation && row[len + 3].c[0] == '\0' &&
+           row[len + 3].bg == COLOR_DEFAULT_BG;
+}
+
+static int line_is(unsigned long long id, int n) {
+    const TerminalCell *row = terminal_line(id);
+
+    return row && cells_are_line(row, n);
+}
+
+int main(void) {
+    unsigned long long oldest;
+    size_t ram_small, ram_large;
+    const TerminalCell *row;
+    FILE *f;
+    char magic[8];
+
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    test_reset_terminal(4, 30);
+    test_assert_true(terminal_spill_open(dir, 0) == 0, "spill file opened");
+    test_assert_true(dir_entries() == 0 && terminal_spill_path() == NULL, "unkept file is unlinked at once");
+
+    feed_lines(0, 3000);
+    test_assert_true(terminal_history_lines() > 2000, "history beyond the ring");
+    test_assert_true(terminal_spill_bytes() > 0, "older lines on disk");
+    /* The blank first screen line is the oldest; "line 0" follows it. */
+    oldest = terminal_history_total() - (unsigned long long)terminal_history_lines() + 1;
+    test_assert_true(line_is(oldest, 0), "oldest spilled line decodes intact");
+    test_assert_true(line_is(oldest + 777, 777), "line from the middle of the file");
+    test_assert_true(line_is(oldest + 5, 5) && line_is(oldest + 6, 6), "cache hit and sequential read");
+    test_assert_true(line_is(terminal_history_total() - 1, 2995), "newest history line from the ring");
+
+    terminal_scrollback_up(1 << 20);
+    test_assert_true(terminal_get_scrollback_offset() == terminal_history_lines(), "scrolls to the start");
+    row = terminal_get_visible_row(1);
+    test_assert_true(row && strcmp(row[0].c, "l") == 0 && strcmp(row[5].c, "0") == 0,
+                     "oldest line shown at the top");
+    terminal_scrollback_reset();
+
+    ram_small = terminal_history_bytes();
+    feed_lines(3000, 20000);
+    ram_large = terminal_history_bytes();
+    test_assert_true(terminal_history_lines() == 19997, "no line dropped");
+    test_assert_true(ram_large < ram_small + 64 * 1024, "RAM does not grow with the spilled history");
+    oldest = terminal_history_total() - (unsigned long long)terminal_history_lines() + 1;
+    test_assert_true(line_is(oldest + 12345, 12345), "deep line after the write buffer flushed");
+
+    /* Rows come back at the current width. */
+    resize_terminal(4, 8);
+    row = terminal_line(oldest + 3);
+    test_assert_true(row && strcmp(row[5].c, "3") == 0, "narrowed row");
+    resize_terminal(4, 40);
+    test_assert_true(line_is(oldest + 3, 3), "widened row, blank past the text");
+
+    /* A view keeps reading its lines while the history moves on and resets. */
+    {
+        SpillView *view = terminal_spill_view();
+        SpillCursor cur = { 0 };
+        TerminalCell cells[40];
+        size_t lines = spill_view_lines(view);
+        int ok;
+
+        test_assert_true(view && lines > 0 && lines < (size_t)terminal_history_lines(), "view of the spilled lines");
+        feed_lines(20000, 20100);
+        test_reset_terminal(4, 30);
+        feed_lines(0, 2100);
+        /* View line 0 is the blank first screen line, then "line <n>". */
+        ok = spill_view_row(view, &cur, 1, cells, 40) == 0 && cells_are_line(cells, 0) &&
+             spill_view_row(view, &cur, 2, cells, 40) == 0 && cells_are_line(cells, 1) &&
+             spill_view_row(view, &cur, 12346, cells, 40) == 0 && cells_are_line(cells, 12345);
+        test_assert_true(ok, "view rows after the history was reset");
+        test_assert_true(spill_view_row(view, &cur, lines, cells, 40) == -1, "past the end of the view");
+        spill_view_close(view);
+    }
+
+    test_reset_terminal(4, 30);
+    test_assert_true(terminal_history_lines() == 0 && terminal_spill_bytes() <= 8, "reset forgets the file");
+    terminal_spill_close();
+
+    /* Kept files stay behind, starting with the magic. */
+    test_assert_true(terminal_spill_open(dir, 1) == 0 && terminal_spill_path() != NULL, "kept file");
+    feed_lines(0, 2100);
+    {
+        char path[256];
+
+        snprintf(path, sizeof(path), "%s", terminal_spill_path());
+        terminal_spill_close();
+        test_assert_true(dir_entries() == 1, "kept file survives close");
+        f = fopen(path, "rb");
+        test_assert_true(f && fread(magic, 1, 8, f) == 8 && memcmp(magic, "CUPIDSB1", 8) == 0,
+                         "close flushes the file");
+        if (f)
+            fclose(f);
+        unlink(path);
+    }
+    rmdir(dir);
+
+    test_print_ok("screen/spill");
+    return 0;
+}
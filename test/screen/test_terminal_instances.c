@@ -0,0 +1,156 @@
+/*
+ * Terminal instances: each keeps its own screen, cursor, modes, scrollback
+ * and counters, none of them disturbs the process's own terminal, input
+ * of any length is parsed whole, and instances fed on several threads at
+ * once end up as they do one by one.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/test_common.h"
+
+static char reply[64];
+
+static void capture(const uint8_t *bytes, size_t len, void *ctx) {
+    (void)ctx;
+    if (len < sizeof(reply)) {
+        memcpy(reply, bytes, len);
+        reply[len] = '\0';
+    }
+}
+
+static void feed(Terminal *t, const char *s) {
+    terminal_feed(t, (const uint8_t *)s, strlen(s), capture, NULL);
+}
+
+#define PARALLEL 4
+
+/* Scrolling, SGR, wide glyphs, erases and a resize: most of the engine. */
+static void *run_stream(void *arg) {
+    unsigned long long *sum = arg;
+    Terminal *t = terminal_create(6, 30);
+    char line[96];
+
+    *sum = 0;
+    if (!t) {
+        return NULL;
+    }
+    for (int i = 0; i < 3000; i++) {
+        int n = snprintf(line, sizeof(line), "\r\n\x1b[3%dm%d \xe6\x97\xa5\x1b[m\x1b[K%s", i % 8, i,
+                         (i % 97 == 0) ? "\x1b[2J\x1b[H" : "");
+        terminal_feed(t, (const uint8_t *)line, (size_t)n, NULL, NULL);
+        if (i == 1500) {
+            terminal_resize(t, 8, 24);
+        }
+    }
+    for (int r = 0; r < 8; r++) {
+        const TerminalCell *row = terminal_row(t, r);
+
+        for (int c = 0; row && c < 24; c++) {
+            *sum = *sum * 31 + (unsigned char)row[c].c[0] + row[c].fg + row[c].width;
+        }
+    }
+    *sum = *sum * 31 + (unsigned long long)terminal_get_state(t)->row;
+    terminal_destroy(t);
+    return NULL;
+}
+
+static void test_parallel(void) {
+    pthread_t threads[PARALLEL];
+    unsigned long long expect, sums[PARALLEL];
+
+    run_stream(&expect);
+    test_assert_true(expect != 0, "stream ran");
+    for (int i = 0; i < PARALLEL; i++) {
+        test_assert_true(pthread_create(&threads[i], NULL, run_stream, &sums[i]) == 0, "thread started");
+    }
+    for (int i = 0; i < PARALLEL; i++) {
+        pthread_join(threads[i], NULL);
+        test_assert_true(sums[i] == expect, "parallel instance matches the serial run");
+    }
+}
+
+/* One feed far larger than a read, finishing a CSI left open by the last. */
+static void test_long_input(void) {
+    const size_t len = 100 * 1024;
+    Terminal *t = terminal_create(3, 20);
+    char *big = malloc(len);
+    const TerminalCell *row;
+    TermParseStats st;
+
+    test_assert_true(t && big, "long input setup");
+    memset(big, '.', len);
+    memcpy(big, "1m", 2);
+    memcpy(big + len - 7, "\r\x1b[KEND", 7);
+    feed(t, "\x1b[3");
+    terminal_feed(t, (const uint8_t *)big, len, NULL, NULL);
+    row = terminal_row(t, 2);
+    test_assert_true(row && strcmp(row[0].c, "E") == 0 && strcmp(row[2].c, "D") == 0 && row[2].fg == 1,
+                     "end of a 100 KiB feed after a split CSI");
+    terminal_get_parse_stats(t, &st);
+    test_assert_true(st.bytes == len + 3, "every byte parsed");
+    free(big);
+    terminal_destroy(t);
+}
+
+int main(void) {
+    Terminal *a, *b;
+    const TerminalCell *row;
+    TermParseStats st;
+    int rows, cols;
+
+    test_reset_terminal(4, 10);
+    test_feed_string("main");
+
+    a = terminal_create(3, 8);
+    b = terminal_create(5, 20);
+    test_assert_true(a && b, "instances created");
+
+    feed(a, "alpha\x1b[?25l");
+    feed(b, "\x1b[31mbeta\x1b[2;3Hx");
+    feed(a, "\x1b[6n");
+    test_assert_true(strcmp(reply, "\x1b[1;6R") == 0, "cursor report from the instance's cursor");
+
+    row = terminal_row(a, 0);
+    test_assert_true(row && strcmp(row[0].c, "a") == 0 && strcmp(row[4].c, "a") == 0, "instance a screen");
+    test_assert_true(!terminal_get_state(a)->cursor_visible && terminal_get_state(b)->cursor_visible,
+                     "modes are per instance");
+    row = terminal_row(b, 0);
+    test_assert_true(row && strcmp(row[0].c, "b") == 0 && row[0].fg == 1, "instance b screen and SGR");
+    row = terminal_row(b, 1);
+    test_assert_true(row && strcmp(row[2].c, "x") == 0, "instance b cursor addressing");
+    test_assert_true(terminal_row(a, 3) == NULL, "row past the screen");
+
+    /* The process's terminal saw none of it. */
+    test_assert_cell(0, 0, "m", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+    test_assert_cursor(0, 4);
+    test_assert_true(term_rows == 4 && term_cols == 10, "process terminal size unchanged");
+    test_assert_true(term_state.cursor_visible, "process terminal modes unchanged");
+
+    feed(a, "\r\n1\r\n2\r\n3\r\n4");
+    terminal_resize(a, 3, 12);
+    terminal_size(a, &rows, &cols);
+    test_assert_true(rows == 3 && cols == 12, "instance resized");
+    row = terminal_row(a, 2);
+    test_assert_true(row && strcmp(row[0].c, "4") == 0, "content kept across the resize");
+    terminal_get_parse_stats(b, &st);
+    test_assert_true(st.csi == 2 && st.bytes == strlen("\x1b[31mbeta\x1b[2;3Hx"), "counters per instance");
+
+    terminal_destroy(a);
+    feed(b, "!");
+    row = terminal_row(b, 1);
+    test_assert_true(row && strcmp(row[3].c, "!") == 0, "other instance survives a destroy");
+    terminal_destroy(b);
+
+    test_feed_string("!");
+    test_assert_cell(0, 4, "!", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+
+    test_long_input();
+    test_parallel();
+    test_assert_cell(0, 4, "!", COLOR_DEFAULT_FG, COLOR_DEFAULT_BG, 0);
+
+    test_print_ok("screen/terminal_instances");
+    return 0;
+}